@@ -0,0 +1,122 @@
+#include "alloc_tracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+#ifdef AUDIOCAPTURE_TRACK_ALLOCATIONS
+// Plain thread_local PODs: reading them never allocates
+thread_local const char* t_armedThread = nullptr;
+
+std::atomic<uint64_t> g_violations{ 0 };
+std::atomic<const char*> g_lastViolationThread{ nullptr };
+std::atomic<size_t> g_lastViolationSize{ 0 };
+
+void OnAllocate(size_t size)
+{
+    if (t_armedThread) {
+        g_violations.fetch_add(1, std::memory_order_relaxed);
+        g_lastViolationThread.store(t_armedThread, std::memory_order_relaxed);
+        g_lastViolationSize.store(size, std::memory_order_relaxed);
+    }
+}
+
+void* Allocate(size_t size)
+{
+    OnAllocate(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* AllocateAligned(size_t size, size_t alignment)
+{
+    OnAllocate(size);
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    size_t rounded = ((size ? size : 1) + alignment - 1) / alignment * alignment;
+    return std::aligned_alloc(alignment, rounded);
+#endif
+}
+
+void FreeAligned(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+#endif
+
+}
+
+namespace AllocTracker {
+
+#ifdef AUDIOCAPTURE_TRACK_ALLOCATIONS
+
+bool IsEnabled() { return true; }
+void ArmCurrentThread(const char* threadName) { t_armedThread = threadName ? threadName : "unnamed"; }
+void DisarmCurrentThread() { t_armedThread = nullptr; }
+uint64_t GetViolationCount() { return g_violations.load(std::memory_order_relaxed); }
+const char* GetLastViolationThread() { return g_lastViolationThread.load(std::memory_order_relaxed); }
+size_t GetLastViolationSize() { return g_lastViolationSize.load(std::memory_order_relaxed); }
+void ResetViolations() { g_violations.store(0, std::memory_order_relaxed); }
+
+#else
+
+bool IsEnabled() { return false; }
+void ArmCurrentThread(const char*) {}
+void DisarmCurrentThread() {}
+uint64_t GetViolationCount() { return 0; }
+const char* GetLastViolationThread() { return nullptr; }
+size_t GetLastViolationSize() { return 0; }
+void ResetViolations() {}
+
+#endif
+
+}
+
+#ifdef AUDIOCAPTURE_TRACK_ALLOCATIONS
+
+// Global replacements (only in tracking builds)
+
+void* operator new(size_t size)
+{
+    if (void* ptr = Allocate(size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    if (void* ptr = Allocate(size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    if (void* ptr = AllocateAligned(size, (size_t)alignment)) return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    if (void* ptr = AllocateAligned(size, (size_t)alignment)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { FreeAligned(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { FreeAligned(ptr); }
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Debug-build heap allocation tracker for realtime threads.
+// When AUDIOCAPTURE_TRACK_ALLOCATIONS is defined (Debug configurations) the
+// global operator new/delete are replaced and every allocation made by an
+// armed thread is counted as a violation. Threads arm themselves once they
+// are past warm-up; in other builds all calls are no-ops.
+namespace AllocTracker {
+
+// Whether allocation tracking is compiled in
+bool IsEnabled();
+
+// Start counting allocations on the calling thread (name is for the log and
+// must be a string literal)
+void ArmCurrentThread(const char* threadName);
+
+// Stop counting allocations on the calling thread
+void DisarmCurrentThread();
+
+// Number of allocations made by armed threads since start or last Reset
+uint64_t GetViolationCount();
+
+// Name of the armed thread and size of the most recent violation
+const char* GetLastViolationThread();
+size_t GetLastViolationSize();
+
+void ResetViolations();
+
+}
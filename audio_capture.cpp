@@ -1,5 +1,10 @@
 #include "audio_capture.h"
+#include "alloc_tracker.h"
+#include "wave_format.h"
+#include "thread_scheduling.h"
 #include <mmsystem.h>
+#include <mmreg.h>
+#include <ksmedia.h>
 #include <chrono>
 #include <string>
 #include <cmath>
@@ -8,15 +13,53 @@
 #include <propsys.h>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
 
 #pragma comment(lib, "winmm.lib")
 #pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "mmdevapi.lib")
 
-const int WAVEFORM_BUFFER_SIZE = 48000; // 1 second at 48kHz (reduced for performance)
 const REFERENCE_TIME REFTIMES_PER_SEC = 10000000;
 const REFERENCE_TIME REFTIMES_PER_MILLISEC = 10000;
 
+// Packet buffers kept in the pool (each holds a full device buffer). Enough
+// for both writer queues to fill up while the recording thread holds one.
+const size_t PACKET_POOL_BLOCKS = 40;
+
+// Blocks queued per writer before it applies its overflow policy; at ~10 ms
+// packets this covers a few hundred milliseconds of stalled output
+const size_t FILE_QUEUE_BLOCKS = 16;
+const size_t STREAM_QUEUE_BLOCKS = 16;
+
+// Writer batching: the file is flushed in larger batches, the stream with
+// low latency
+const uint32_t FILE_BATCH_INTERVAL_MS = 50;
+const uint32_t STREAM_BATCH_INTERVAL_MS = 10;
+
+// Position jumps longer than this are treated as a device clock reset rather
+// than filled with silence
+const uint32_t MAX_GAP_SECONDS = 600;
+
+// Gaps kept for the sidecar index and cue chunk of one recording
+const size_t MAX_RECORDED_GAPS = 4096;
+
+const uint64_t FILETIME_PER_SEC = 10000000;
+
+// Loop iterations before a pipeline thread counts as warmed up and must stop
+// allocating (checked in debug builds by AllocTracker)
+const int ALLOC_WARMUP_ITERATIONS = 10;
+
+// Wait of the capture loop between buffer polls; anything beyond it counts
+// as wake-up jitter. StopCapture() wakes the loop early.
+const DWORD CAPTURE_WAIT_MS = 10;
+const int64_t CAPTURE_SLEEP_US = CAPTURE_WAIT_MS * 1000;
+
+// Failed re-acquisitions of a selected device before the default endpoint
+// is taken instead (about 0.6 s with the default backoff)
+const uint32_t DEVICE_FALLBACK_ATTEMPTS = 5;
+
 // Logging function
 void LogError(const char* message) {
     try {
@@ -42,104 +85,284 @@ void ShowError(const wchar_t* message, HRESULT hr) {
     LogError(logMsg.c_str());
 }
 
+// WASAPI buffer flags as PacketInfo flags
+uint32_t ToPacketFlags(DWORD bufferFlags) {
+    uint32_t flags = 0;
+    if (bufferFlags & AUDCLNT_BUFFERFLAGS_SILENT) flags |= PacketInfo::Silent;
+    if (bufferFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) flags |= PacketInfo::Discontinuity;
+    if (bufferFlags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) flags |= PacketInfo::TimestampError;
+    return flags;
+}
+
+// Current QueryPerformanceCounter time in 100 ns units (the unit of the
+// GetBuffer QPC position)
+uint64_t GetQpcTime100ns() {
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    uint64_t rate = (uint64_t)frequency.QuadPart;
+    return ticks / rate * FILETIME_PER_SEC + ticks % rate * FILETIME_PER_SEC / rate;
+}
+
+std::string ToUtf8(const std::wstring& text) {
+    int size = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0, nullptr, nullptr);
+    std::string result(size > 0 ? size : 0, '\0');
+    if (size > 0) {
+        WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), &result[0], size, nullptr, nullptr);
+    }
+    return result;
+}
+
+// Errors after which the client is useless: the device is gone or the
+// audio service restarted
+bool IsDeviceGone(HRESULT hr) {
+    return hr == AUDCLNT_E_DEVICE_INVALIDATED || hr == AUDCLNT_E_SERVICE_NOT_RUNNING ||
+        hr == AUDCLNT_E_RESOURCES_INVALIDATED;
+}
+
+// IEEE float, either by tag or as the subformat of an extensible format
+bool IsFloatFormat(const WAVEFORMATEX* format) {
+    if (format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) return true;
+    if (format->wFormatTag == WAVE_FORMAT_EXTENSIBLE && format->cbSize >= 22) {
+        const WAVEFORMATEXTENSIBLE* extensible = (const WAVEFORMATEXTENSIBLE*)format;
+        return IsEqualGUID(extensible->SubFormat, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT);
+    }
+    return false;
+}
+
+uint64_t GetFileTimeNow() {
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime(&now);
+    return ((uint64_t)now.dwHighDateTime << 32) | now.dwLowDateTime;
+}
+
+// Debug builds: complain about heap allocations made by warmed-up pipeline threads
+void ReportRealtimeAllocations() {
+    if (AllocTracker::GetViolationCount() == 0) return;
+
+    char message[160];
+    snprintf(message, sizeof(message), "Heap allocation on %s thread after warm-up (%llu total, last %zu bytes)",
+        AllocTracker::GetLastViolationThread(), (unsigned long long)AllocTracker::GetViolationCount(),
+        AllocTracker::GetLastViolationSize());
+    LogError(message);
+    AllocTracker::ResetViolations();
+    assert(!"Heap allocation on a realtime thread");
+}
+
 AudioCapture::AudioCapture()
 {
-    m_waveformBuffer.resize(WAVEFORM_BUFFER_SIZE, 0.0f);
-    m_waveformBufferSize = WAVEFORM_BUFFER_SIZE;
+    // Auto-reset: wakes the capture loop once per signal
+    m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
 }
 
 AudioCapture::~AudioCapture()
 {
+    if (m_initThread && m_initThread->joinable()) {
+        m_initThread->join();
+    }
+    StopCapture();
     StopRecording();
     if (m_audioFile != INVALID_HANDLE_VALUE) {
         CloseHandle(m_audioFile);
     }
+    if (m_wakeEvent) {
+        CloseHandle(m_wakeEvent);
+    }
+    UnlockPacketPool();
+}
+
+void AudioCapture::UnlockPacketPool()
+{
+    ThreadScheduling::UnlockMemory(m_lockedPool, m_lockedPoolSize);
+    m_lockedPool = nullptr;
+    m_lockedPoolSize = 0;
 }
 
-bool AudioCapture::Initialize()
+void AudioCapture::ReportWakeJitter()
 {
+    if (m_wakeJitter.GetCount() == 0) return;
+
+    char message[200];
+    snprintf(message, sizeof(message), "Capture thread (%s): wake-up late by p50 %lld us, p99 %lld us, p99.9 %lld us, max %lld us over %llu wake-ups",
+        ThreadScheduling::GetSchedulingClassName(m_captureScheduling),
+        (long long)m_wakeJitter.GetPercentile(0.5), (long long)m_wakeJitter.GetPercentile(0.99),
+        (long long)m_wakeJitter.GetPercentile(0.999), (long long)m_wakeJitter.GetMax(),
+        (unsigned long long)m_wakeJitter.GetCount());
+    LogError(message);
+}
+
+bool AudioCapture::BeginInitialize(HWND window, UINT message, DeviceType listType)
+{
+    if (m_initThread) return false;
+
+    // The UI thread keeps the apartment, and with it the objects created by
+    // the startup threads, alive
     HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
     if (FAILED(hr)) {
         ShowError(L"Failed to initialize COM", hr);
         return false;
     }
 
-    return InitializeWASAPI();
+    m_initResult = false;
+    m_initThread = std::make_unique<std::thread>(&AudioCapture::InitializeThread, this, window, message, listType);
+    return true;
+}
+
+bool AudioCapture::FinishInitialize(std::vector<AudioDevice>& devices)
+{
+    if (m_initThread) {
+        m_initThread->join();
+        m_initThread.reset();
+    }
+    devices = std::move(m_initDevices);
+    m_initDevices.clear();
+    return m_initResult;
+}
+
+void AudioCapture::InitializeThread(HWND window, UINT message, DeviceType listType)
+{
+    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    bool comInitialized = SUCCEEDED(hr);
+    bool ok = comInitialized;
+    if (!ok) {
+        ShowError(L"Failed to initialize COM", hr);
+    }
+
+    // Both tasks below share the enumerator
+    if (ok) {
+        hr = CoCreateInstance(
+            __uuidof(MMDeviceEnumerator), nullptr,
+            CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
+            (void**)m_deviceEnumerator.GetAddressOf());
+        if (FAILED(hr)) {
+            ShowError(L"Failed to create device enumerator", hr);
+            ok = false;
+        }
+    }
+
+    // Listing reads the property store of every endpoint; it overlaps with
+    // activating the default device and starting capture
+    std::thread listing;
+    if (ok) {
+        listing = std::thread([this, listType]() {
+            HRESULT listHr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+            m_initDevices = EnumerateAudioDevices(listType);
+            m_startup.Mark(StartupDevicesListed);
+            if (SUCCEEDED(listHr)) CoUninitialize();
+        });
+    }
+
+    ok = ok && InitializeWASAPI();
+    if (ok) {
+        m_startup.Mark(StartupClientActivated);
+        ok = StartCapture();
+    }
+    if (ok) {
+        m_startup.Mark(StartupCaptureStarted);
+    }
+
+    if (listing.joinable()) {
+        listing.join();
+    }
+    m_initResult = ok;
+    PostMessageW(window, message, ok ? 1 : 0, 0);
+
+    if (comInitialized) CoUninitialize();
+}
+
+void AudioCapture::ReportStartup()
+{
+    char message[320];
+    snprintf(message, sizeof(message), "Startup: first frame %s the %lld ms target (%s)",
+        m_startup.MetTarget() ? "within" : "missed",
+        (long long)(StartupTimer::TARGET_FIRST_FRAME_US / 1000), m_startup.Format().c_str());
+    LogError(message);
 }
 
 bool AudioCapture::StartCapture()
 {
-    if (m_isCapturing) return true;
+    CaptureState state = m_captureState.load();
+    if (state != Stopped) return state == Running;
+    if (!m_audioClient || !m_wakeEvent) return false;
 
+    auto startTime = std::chrono::steady_clock::now();
     HRESULT hr = m_audioClient->Start();
     if (FAILED(hr)) {
         ShowError(L"Failed to start audio capture", hr);
         return false;
     }
 
-    m_isCapturing = true;
+    m_wakeJitter.Reset();
+    StartTrace();
+    StartSharedRing();
+
+    // A stop signal left over from the previous run must not end this one
+    ResetEvent(m_wakeEvent);
+    m_captureState.store(Running);
     m_captureThread = std::make_unique<std::thread>(&AudioCapture::CaptureThread, this);
+
+    m_startLatencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
     return true;
 }
 
 bool AudioCapture::StopCapture()
 {
-    if (!m_isCapturing) return true;
+    CaptureState expected = Running;
+    if (!m_captureState.compare_exchange_strong(expected, Stopping)) return true;
 
-    try {
-        m_isCapturing = false;
-        m_stopCapture = true;  // Signal thread to stop
-        
-        // Stop audio client immediately
-        if (m_audioClient) {
-            m_audioClient->Stop();
-            m_audioClient->Reset();
-        }
-        
-        // Wait for capture thread with timeout (max 500ms)
-        if (m_captureThread && m_captureThread->joinable()) {
-            // Try to join with timeout
-            auto waitStart = std::chrono::high_resolution_clock::now();
-            while (m_captureThread->joinable()) {
-                Sleep(10);
-                auto elapsed = std::chrono::high_resolution_clock::now() - waitStart;
-                if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() > 500) {
-                    // Timeout - detach thread
-                    m_captureThread->detach();
-                    break;
-                }
-            }
-            
-            // Try final join if still joinable
-            if (m_captureThread->joinable()) {
-                m_captureThread->join();
-            }
-        }
-        
-        m_captureThread.reset();
-        m_stopCapture = false;
-        return true;
+    // A recording needs the capture thread; finish it first so its writers
+    // are drained and the header is final before the device stops
+    StopRecording();
+
+    // Wake the loop out of its wait; it sees Stopping and returns, so the
+    // join is bounded by the packet it may be processing
+    auto stopTime = std::chrono::steady_clock::now();
+    SetEvent(m_wakeEvent);
+    if (m_captureThread && m_captureThread->joinable()) {
+        m_captureThread->join();
     }
-    catch (const std::exception& e) {
-        // Log exception
-        LogError("Exception in StopCapture");
-        OutputDebugStringW(L"Exception in StopCapture\n");
-        return false;
+    m_captureThread.reset();
+    m_stopLatencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - stopTime).count();
+
+    // Nothing reads the client any more
+    if (m_audioClient) {
+        m_audioClient->Stop();
+        m_audioClient->Reset();
+    }
+
+    StopTrace();
+    m_sharedRing.Close();
+    m_captureState.store(Stopped);
+
+    ReportRealtimeAllocations();
+    ReportWakeJitter();
+    if (m_stopLatencyUs > CAPTURE_SLEEP_US) {
+        char message[128];
+        snprintf(message, sizeof(message), "Capture thread took %lld us to stop (start took %lld us)",
+            (long long)m_stopLatencyUs, (long long)m_startLatencyUs);
+        LogError(message);
     }
+    return true;
 }
 
 bool AudioCapture::InitializeWASAPI()
 {
     HRESULT hr;
 
-    // Create device enumerator
-    hr = CoCreateInstance(
-        __uuidof(MMDeviceEnumerator), nullptr,
-        CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
-        (void**)m_deviceEnumerator.GetAddressOf());
-    if (FAILED(hr)) {
-        ShowError(L"Failed to create device enumerator", hr);
-        return false;
+    // Create device enumerator (startup creates it up front, shared with the
+    // device listing that runs at the same time)
+    if (!m_deviceEnumerator) {
+        hr = CoCreateInstance(
+            __uuidof(MMDeviceEnumerator), nullptr,
+            CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
+            (void**)m_deviceEnumerator.GetAddressOf());
+        if (FAILED(hr)) {
+            ShowError(L"Failed to create device enumerator", hr);
+            return false;
+        }
     }
 
     // Use selected device if available, otherwise get default audio endpoint (loopback for system audio capture)
@@ -161,19 +384,6 @@ bool AudioCapture::InitializeWASAPI()
     }
     // If m_deviceSelected is true, m_device should already be set in SelectAudioDevice()
 
-    // Debug: Write current device info
-    {
-        HANDLE debugFile = CreateFileW(L"init_debug.txt", GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-        if (debugFile != INVALID_HANDLE_VALUE) {
-            std::string debugText = "Initializing device: " + std::string(m_currentDevice.name.begin(), m_currentDevice.name.end()) + "\n";
-            debugText += "Device type: " + std::string(m_currentDeviceType == RenderDevices ? "Render" : "Capture") + "\n";
-            debugText += "Device index: " + std::to_string(m_currentDevice.index) + "\n";
-            DWORD written;
-            WriteFile(debugFile, debugText.c_str(), (DWORD)debugText.length(), &written, nullptr);
-            CloseHandle(debugFile);
-        }
-    }
-
     // Create audio client
     hr = m_device->Activate(
         __uuidof(IAudioClient), CLSCTX_ALL, nullptr,
@@ -191,12 +401,13 @@ bool AudioCapture::InitializeWASAPI()
         return false;
     }
 
-    // For loopback capture, use a standard PCM format
-    // Copy the basic parameters but ensure it's PCM
-    m_waveFormat.wFormatTag = WAVE_FORMAT_PCM;
+    // Capture the engine's float mix as is and requantize it ourselves with
+    // dither (the engine would truncate); otherwise ask for 16-bit PCM
+    bool captureFloat = IsFloatFormat(pwfx) && pwfx->wBitsPerSample == 32;
+    m_waveFormat.wFormatTag = captureFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
     m_waveFormat.nChannels = pwfx->nChannels;  // Usually 2 for stereo
     m_waveFormat.nSamplesPerSec = pwfx->nSamplesPerSec;  // Usually 44100 or 48000
-    m_waveFormat.wBitsPerSample = 16;  // Use 16-bit for compatibility
+    m_waveFormat.wBitsPerSample = captureFloat ? 32 : 16;
     m_waveFormat.nBlockAlign = m_waveFormat.nChannels * m_waveFormat.wBitsPerSample / 8;
     m_waveFormat.nAvgBytesPerSec = m_waveFormat.nSamplesPerSec * m_waveFormat.nBlockAlign;
     m_waveFormat.cbSize = 0;
@@ -208,12 +419,15 @@ bool AudioCapture::InitializeWASAPI()
     hr = m_audioClient->IsFormatSupported(AUDCLNT_SHAREMODE_SHARED, &m_waveFormat, &closestMatch);
     if (FAILED(hr)) {
         if (hr == AUDCLNT_E_UNSUPPORTED_FORMAT && closestMatch) {
-            // Use the closest supported format
+            // Use the closest supported format. Only the WAVEFORMATEX part is
+            // kept, so an extensible format is reduced to its plain tag.
+            bool isFloat = IsFloatFormat(closestMatch);
             m_waveFormat = *closestMatch;
+            m_waveFormat.wFormatTag = isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+            m_waveFormat.cbSize = 0;
             CoTaskMemFree(closestMatch);
         } else {
             ShowError(L"Audio format not supported", hr);
-            CoTaskMemFree(pwfx);
             return false;
         }
     }
@@ -245,6 +459,24 @@ bool AudioCapture::InitializeWASAPI()
         return false;
     }
 
+    // Packet buffers for the pipeline threads
+    UnlockPacketPool();
+    SampleType sampleType = GetSampleType(m_waveFormat.wFormatTag == WAVE_FORMAT_IEEE_FLOAT, m_waveFormat.wBitsPerSample);
+    if (!m_pipeline.Configure(m_waveFormat.nSamplesPerSec, m_waveFormat.nChannels, sampleType, m_recordBits,
+                              m_bufferFrameCount, PACKET_POOL_BLOCKS)) {
+        ShowError(L"Failed to set up the recording pipeline for this format", E_FAIL);
+        return false;
+    }
+
+    // The capture thread writes into these; keep them out of the page file
+    BlockPool& pool = m_pipeline.GetPool();
+    if (ThreadScheduling::LockMemory(pool.GetStorage(), pool.GetStorageSize())) {
+        m_lockedPool = pool.GetStorage();
+        m_lockedPoolSize = pool.GetStorageSize();
+    } else {
+        LogError("Could not lock packet buffers in memory");
+    }
+
     // Get capture client
     hr = m_audioClient->GetService(
         __uuidof(IAudioCaptureClient),
@@ -254,6 +486,28 @@ bool AudioCapture::InitializeWASAPI()
         return false;
     }
 
+    // Conversion kernels for visualization and metering, fixed per format
+    m_sampleType = sampleType;
+    m_kernels = GetPacketKernels(m_sampleType, m_waveFormat.nChannels);
+    if (m_kernels) {
+        m_floatBuffer.assign((size_t)m_bufferFrameCount * m_waveFormat.nChannels, 0.0f);
+        m_planarBuffer.assign((size_t)m_bufferFrameCount * m_waveFormat.nChannels, 0.0f);
+        m_planes.resize(m_waveFormat.nChannels);
+        for (size_t c = 0; c < m_planes.size(); c++) {
+            m_planes[c] = m_planarBuffer.data() + c * m_bufferFrameCount;
+        }
+    } else {
+        char message[128];
+        snprintf(message, sizeof(message), "No sample conversion for %u-bit audio; waveform and meters stay idle",
+            (unsigned)m_waveFormat.wBitsPerSample);
+        LogError(message);
+    }
+
+    m_waveform.Reset(m_waveFormat.nChannels);
+    // Kept across a re-acquired device with the same format
+    m_history.Reset(m_waveFormat.nChannels, m_waveFormat.nSamplesPerSec, HISTORY_SECONDS);
+    m_loudness.Configure(m_waveFormat.nSamplesPerSec, m_waveFormat.nChannels);
+
     return true;
 }
 
@@ -272,17 +526,96 @@ bool AudioCapture::StartRecording(const wchar_t* filename)
         nullptr);
     
     if (m_audioFile == INVALID_HANDLE_VALUE) return false;
+    m_audioFileName = filename;
 
     // Write dummy WAV header (will update on stop)
     WriteWaveHeader();
 
-    m_bytesWritten = 44; // WAV header size
-    m_sampleCount = 0;
-    m_waveformPos = 0;
-    m_isRecording = true;
+    m_bytesWritten = BROADCAST_WAVE_HEADER_SIZE;
+    m_sampleCount.store(0, std::memory_order_relaxed);
+
+    // Refined to the first packet's capture time once it arrives
+    m_startFileTime = GetFileTimeNow();
+
+    // Audio is written by the file writer thread. A full queue never makes
+    // the capture thread wait: the block is written as silence instead and
+    // listed as lost in the gap index, so the file keeps its length
+    m_fileOutput.SetFile((void*)m_audioFile);
+    m_fileWriter.SetQueueDepth(FILE_QUEUE_BLOCKS);
+    m_fileWriter.SetPolicy(BatchedWriter::FillSilence);
+    m_fileWriter.SetBatchInterval(FILE_BATCH_INTERVAL_MS);
+
+    // Peak sidecar for instant overviews, built from what the writer writes
+    // (16-bit recordings only)
+    ByteOutput* fileOutput = &m_fileOutput;
+    if (m_pipeline.GetOutputBits() == 16) {
+        std::wstring peakName = m_audioFileName + L".peaks";
+        if (m_peakWriter.Open(_wfopen(peakName.c_str(), L"w+b"), m_waveFormat.nChannels, m_waveFormat.nSamplesPerSec)) {
+            m_peakOutput.SetOutput(&m_fileOutput, &m_peakWriter);
+            fileOutput = &m_peakOutput;
+        } else {
+            LogError("Failed to create peak file");
+        }
+    }
 
-    // Start recording thread
-    m_recordingThread = std::make_unique<std::thread>([this]() { RecordingThread(); });
+    // Event detection on the same bytes, off the capture thread
+    if (m_eventsEnabled) {
+        std::wstring eventName = m_audioFileName + L".events";
+        SampleType type = m_pipeline.GetOutputBits() == 16 ? SampleS16 : SampleS24;
+        if (m_events.Open(_wfopen(eventName.c_str(), L"w+b"), m_waveFormat.nChannels, m_waveFormat.nSamplesPerSec, type)) {
+            m_eventOutput.SetOutput(fileOutput, &m_events);
+            fileOutput = &m_eventOutput;
+        } else {
+            LogError("Failed to create event index");
+        }
+    }
+
+    // Block checksums while the data is still in cache; the header is
+    // rewritten and the cue chunk appended on stop, Finish() reads those back
+    if (m_manifestEnabled) {
+        std::wstring manifestName = m_audioFileName + L".manifest";
+        size_t slash = m_audioFileName.find_last_of(L"/\\");
+        std::wstring fileName = slash == std::wstring::npos ? m_audioFileName : m_audioFileName.substr(slash + 1);
+        if (m_manifest.Open(_wfopen(manifestName.c_str(), L"wb"), ToUtf8(fileName), BROADCAST_WAVE_HEADER_SIZE,
+                            BROADCAST_WAVE_HEADER_SIZE)) {
+            m_manifestOutput.SetOutput(fileOutput, &m_manifest);
+            fileOutput = &m_manifestOutput;
+        } else {
+            LogError("Failed to create manifest");
+        }
+    }
+
+    if (!m_fileWriter.Start(fileOutput, &m_pipeline.GetPool(), "file writer")) {
+        m_peakWriter.Close();
+        m_events.Close();
+        m_manifest.Close();
+        CloseHandle(m_audioFile);
+        m_audioFile = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    StartStreaming();
+
+    // Loopback audio is the mix itself; only microphones get denoised
+    NoiseSuppressor& suppressor = m_pipeline.GetNoiseSuppressor();
+    suppressor.SetEnabled(m_noiseSuppression && m_currentDeviceType == CaptureDevices);
+    m_pipeline.Begin(&m_fileWriter, &m_streamWriter, MAX_GAP_SECONDS, MAX_RECORDED_GAPS);
+    if (suppressor.GetLatency() > 0) {
+        char message[128];
+        snprintf(message, sizeof(message), "Noise suppression: %zu-point frames, %.1f ms latency (compensated)",
+            suppressor.GetFrameSize(), 1000.0 * suppressor.GetLatency() / m_waveFormat.nSamplesPerSec);
+        LogError(message);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_loudness.Reset();
+    }
+    m_dataGeneration.fetch_add(1, std::memory_order_release);
+
+    // The capture thread starts writing packets with the next one
+    {
+        std::lock_guard<std::mutex> lock(m_recordingMutex);
+        m_isRecording = true;
+    }
 
     return true;
 }
@@ -291,183 +624,426 @@ bool AudioCapture::StopRecording()
 {
     if (!m_isRecording) return false;
 
-    m_isRecording = false;
+    {
+        // Waits for the capture thread to finish the packet it is recording
+        std::lock_guard<std::mutex> lock(m_recordingMutex);
+        m_isRecording = false;
 
-    // Wait for thread
-    if (m_recordingThread && m_recordingThread->joinable()) {
-        m_recordingThread->join();
+        // Flush the samples still held back by the chain's look-ahead
+        m_pipeline.End();
+    }
+
+    // Write out everything still queued
+    m_fileWriter.Stop();
+    StopStreaming();
+    ReportRealtimeAllocations();
+
+    m_bytesWritten = BROADCAST_WAVE_HEADER_SIZE + m_fileWriter.GetStats().bytesWritten.load();
+    uint64_t clipped = m_pipeline.GetRequantizer().GetClippedSamples();
+    if (m_pipeline.IsRequantizing() && clipped > 0) {
+        char message[96];
+        snprintf(message, sizeof(message), "Recording clipped %llu samples", (unsigned long long)clipped);
+        LogError(message);
+    }
+    const NoiseSuppressor& suppressor = m_pipeline.GetNoiseSuppressor();
+    const DspNodeStats& suppressorStats = suppressor.GetStats();
+    if (suppressor.GetLatency() > 0 && suppressorStats.frames.load() > 0) {
+        double seconds = (double)suppressorStats.frames.load() / m_waveFormat.nSamplesPerSec;
+        char message[160];
+        snprintf(message, sizeof(message), "Noise suppression: %.2f%% of one core, at most %.0f us per packet",
+            100.0 * suppressorStats.nanoseconds.load() / 1e9 / seconds, suppressorStats.maxNanoseconds.load() / 1e3);
+        LogError(message);
+    }
+    if (m_pipeline.GetLostPackets() > 0 || m_fileWriter.GetStats().blocksDropped.load() > 0) {
+        char message[128];
+        snprintf(message, sizeof(message), "Recording lost %llu packets (pool exhausted) and %llu blocks (writer stalled)",
+            (unsigned long long)m_pipeline.GetLostPackets(), (unsigned long long)m_fileWriter.GetStats().blocksDropped.load());
+        LogError(message);
     }
 
     // Update WAV header with actual data size
     UpdateWaveHeader();
 
+    if (m_peakWriter.IsOpen()) {
+        LARGE_INTEGER fileSize = {};
+        GetFileSizeEx(m_audioFile, &fileSize);
+        if (!m_peakWriter.Finish(m_fileWriter.GetStats().bytesWritten.load(), (uint64_t)fileSize.QuadPart)) {
+            LogError("Failed to write peak file");
+        }
+    }
+
+    if (m_events.IsOpen()) {
+        if (!m_events.Finish()) {
+            LogError("Failed to write event index");
+        }
+        const EventDetector& detector = m_events.GetDetector();
+        if (detector.GetTotalCount() > 0) {
+            char message[192];
+            snprintf(message, sizeof(message), "Events: %llu clipping, %llu dropout, %llu dc, %llu jump, %llu transient",
+                (unsigned long long)detector.GetCount(EventClipping), (unsigned long long)detector.GetCount(EventDropout),
+                (unsigned long long)detector.GetCount(EventDcOffset), (unsigned long long)detector.GetCount(EventLevelJump),
+                (unsigned long long)detector.GetCount(EventTransient));
+            LogError(message);
+        }
+    }
+
     if (m_audioFile != INVALID_HANDLE_VALUE) {
         CloseHandle(m_audioFile);
         m_audioFile = INVALID_HANDLE_VALUE;
     }
 
+    if (m_manifest.IsOpen()) {
+        FILE* file = _wfopen(m_audioFileName.c_str(), L"rb");
+        if (!m_manifest.Finish(file)) {
+            LogError("Failed to write manifest");
+        }
+        if (file) fclose(file);
+        if (m_manifest.GetHashNs() > 0) {
+            char message[128];
+            snprintf(message, sizeof(message), "Manifest: %llu blocks, %.1f ms hashing on the file writer thread",
+                (unsigned long long)m_manifest.GetBlockCount(), m_manifest.GetHashNs() / 1e6);
+            LogError(message);
+        }
+    }
+
+    WriteGapIndex();
     return true;
 }
 
-void AudioCapture::WriteWaveHeader()
+void AudioCapture::SetStreamTarget(const std::string& target, StreamOutput::Format format,
+                                   BatchedWriter::OverflowPolicy policy)
 {
-    // RIFF header
-    char header[44] = {};
-    
-    // "RIFF"
-    header[0] = 'R'; header[1] = 'I'; header[2] = 'F'; header[3] = 'F';
-    
-    // File size - 8
-    *(uint32_t*)(header + 4) = 36; // Will update
-    
-    // "WAVE"
-    header[8] = 'W'; header[9] = 'A'; header[10] = 'V'; header[11] = 'E';
-    
-    // "fmt "
-    header[12] = 'f'; header[13] = 'm'; header[14] = 't'; header[15] = ' ';
-    
-    // Subchunk1Size
-    *(uint32_t*)(header + 16) = 16;
-    
-    // AudioFormat (PCM = 1)
-    *(uint16_t*)(header + 20) = 1;
-    
-    // NumChannels
-    *(uint16_t*)(header + 22) = m_waveFormat.nChannels;
-    
-    // SampleRate
-    *(uint32_t*)(header + 24) = m_waveFormat.nSamplesPerSec;
-    
-    // ByteRate
-    *(uint32_t*)(header + 28) = m_waveFormat.nAvgBytesPerSec;
-    
-    // BlockAlign
-    *(uint16_t*)(header + 32) = m_waveFormat.nBlockAlign;
-    
-    // BitsPerSample
-    *(uint16_t*)(header + 34) = m_waveFormat.wBitsPerSample;
-    
-    // "data"
-    header[36] = 'd'; header[37] = 'a'; header[38] = 't'; header[39] = 'a';
-    
-    // Subchunk2Size
-    *(uint32_t*)(header + 40) = 0; // Will update
+    m_streamTarget = target;
+    m_streamFormat = format;
+    m_streamPolicy = policy;
+}
 
-    DWORD written = 0;
-    WriteFile(m_audioFile, header, 44, &written, nullptr);
+bool AudioCapture::StartStreaming()
+{
+    if (m_streamTarget.empty()) return false;
+
+    if (!m_streamOutput.Open(m_streamTarget)) {
+        std::string message = "Invalid stream target: " + m_streamTarget;
+        LogError(message.c_str());
+        return false;
+    }
+
+    // WAV streams start with a header of unknown length, sent again to every
+    // new consumer after a reconnect
+    if (m_streamFormat == StreamOutput::Wave) {
+        uint8_t header[WAVE_HEADER_SIZE];
+        BuildWaveHeader(header, m_waveFormat.nSamplesPerSec, m_waveFormat.nChannels,
+            m_pipeline.GetOutputBits(), WAVE_SIZE_UNKNOWN);
+        m_streamWriter.SetPreamble(header, sizeof(header));
+    } else {
+        m_streamWriter.SetPreamble(nullptr, 0);
+    }
+
+    m_streamWriter.SetQueueDepth(STREAM_QUEUE_BLOCKS);
+    m_streamWriter.SetPolicy(m_streamPolicy);
+    m_streamWriter.SetBatchInterval(STREAM_BATCH_INTERVAL_MS);
+    if (!m_streamWriter.Start(&m_streamOutput, &m_pipeline.GetPool(), "stream writer")) {
+        m_streamOutput.Close();
+        return false;
+    }
+    return true;
 }
 
-void AudioCapture::UpdateWaveHeader()
+void AudioCapture::StopStreaming()
 {
-    // Calculate sizes
-    uint32_t dataSize = m_bytesWritten - 44;
-    uint32_t fileSize = m_bytesWritten - 8;
+    if (!m_streamWriter.IsRunning()) return;
 
-    // Seek to file size position
-    SetFilePointer(m_audioFile, 4, nullptr, FILE_BEGIN);
-    DWORD written = 0;
-    WriteFile(m_audioFile, &fileSize, 4, &written, nullptr);
+    m_streamWriter.Stop();
 
-    // Seek to data size position
-    SetFilePointer(m_audioFile, 40, nullptr, FILE_BEGIN);
-    WriteFile(m_audioFile, &dataSize, 4, &written, nullptr);
+    const WriterStats& stats = m_streamWriter.GetStats();
+    if (stats.blocksDropped.load() > 0 || stats.disconnects.load() > 0) {
+        char message[256];
+        snprintf(message, sizeof(message), "Stream %s: %llu bytes sent, %llu blocks dropped, %llu disconnects",
+            m_streamOutput.GetTarget().c_str(), (unsigned long long)stats.bytesWritten.load(),
+            (unsigned long long)stats.blocksDropped.load(), (unsigned long long)stats.disconnects.load());
+        LogError(message);
+    }
+    m_streamOutput.Close();
 }
 
-void AudioCapture::RecordingThread()
+void AudioCapture::SetTraceTarget(const std::wstring& path, bool payload)
 {
-    const DWORD flags = AUDCLNT_BUFFERFLAGS_SILENT;
-    UINT32 nextPacketSize = 0;
+    m_tracePath = path;
+    m_tracePayload = payload;
+}
 
-    while (m_isRecording) {
-        Sleep(10); // Small delay to avoid busy waiting
+bool AudioCapture::StartTrace()
+{
+    if (m_tracePath.empty()) return false;
 
-        // Get size of next capture package
-        HRESULT hr = m_captureClient->GetNextPacketSize(&nextPacketSize);
-        if (FAILED(hr)) continue;
+    m_traceFile = CreateFileW(m_tracePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_traceFile == INVALID_HANDLE_VALUE) {
+        LogError("Failed to create capture trace");
+        return false;
+    }
 
-        // Process all available packets
-        while (nextPacketSize > 0) {
-            BYTE* data = nullptr;
-            UINT32 numFramesAvailable = 0;
-            DWORD streamFlags = 0;
+    TraceFormat format;
+    format.sampleRate = m_waveFormat.nSamplesPerSec;
+    format.channels = m_waveFormat.nChannels;
+    format.bitsPerSample = m_waveFormat.wBitsPerSample;
+    format.isFloat = m_waveFormat.wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+    format.bufferFrames = m_bufferFrameCount;
+    format.hasPayload = m_tracePayload;
+    format.startFileTime = GetFileTimeNow();
+
+    m_traceStart = GetQpcTime100ns();
+    m_traceOutput.SetFile((void*)m_traceFile);
+    if (!m_traceRecorder.Start(&m_traceOutput, format)) {
+        LogError("Failed to start capture trace");
+        CloseHandle(m_traceFile);
+        m_traceFile = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    return true;
+}
 
-            hr = m_captureClient->GetBuffer(&data, &numFramesAvailable, &streamFlags, nullptr, nullptr);
-            if (FAILED(hr)) break;
+void AudioCapture::StopTrace()
+{
+    if (!m_traceRecorder.IsRunning()) return;
+
+    m_traceRecorder.Stop();
+    CloseHandle(m_traceFile);
+    m_traceFile = INVALID_HANDLE_VALUE;
+
+    if (m_traceRecorder.GetLostRecords() > 0) {
+        char message[128];
+        snprintf(message, sizeof(message), "Capture trace: %llu packets, %llu lost",
+            (unsigned long long)m_traceRecorder.GetRecordCount(),
+            (unsigned long long)m_traceRecorder.GetLostRecords());
+        LogError(message);
+    }
+}
 
-            // Convert audio data
-            int32_t bytesToWrite = numFramesAvailable * m_waveFormat.nBlockAlign;
+void AudioCapture::SetSharedRing(const std::string& name, uint32_t historyMs)
+{
+    m_sharedRingName = name;
+    m_sharedRingHistoryMs = historyMs;
+}
 
-            if (streamFlags & AUDCLNT_BUFFERFLAGS_SILENT) {
-                // Write silence
-                std::vector<uint8_t> silence(bytesToWrite, 0);
-                DWORD written = 0;
-                WriteFile(m_audioFile, silence.data(), bytesToWrite, &written, nullptr);
-            } else {
-                // Write actual audio data
-                DWORD written = 0;
-                WriteFile(m_audioFile, data, bytesToWrite, &written, nullptr);
+bool AudioCapture::StartSharedRing()
+{
+    if (m_sharedRingName.empty()) return false;
 
-                // Update waveform buffer for visualization
-                {
-                    std::lock_guard<std::mutex> lock(m_mutex);
-                    
-                    if (m_waveFormat.wBitsPerSample == 16) {
-                        int16_t* pcmData = (int16_t*)data;
-                        for (UINT32 i = 0; i < numFramesAvailable; i++) {
-                            float sample = pcmData[i * m_waveFormat.nChannels] / 32768.0f;
-                            
-                            // Use circular buffer instead of shifting
-                            m_waveformBuffer[m_waveformPos] = sample;
-                            m_waveformPos = (m_waveformPos + 1) % m_waveformBufferSize;
-                            
-                            m_sampleCount++;
-                        }
-                    }
-                }
-            }
+    // The ring carries the float conversion of every packet
+    if (!m_kernels) {
+        LogError("Shared ring needs a supported capture format");
+        return false;
+    }
+    uint32_t capacityFrames = (uint32_t)((uint64_t)m_waveFormat.nSamplesPerSec * m_sharedRingHistoryMs / 1000);
+    if (!m_sharedRing.Create(m_sharedRingName, m_waveFormat.nSamplesPerSec, m_waveFormat.nChannels, capacityFrames)) {
+        std::string message = "Failed to create shared ring " + m_sharedRingName;
+        LogError(message.c_str());
+        return false;
+    }
+    return true;
+}
 
-            m_bytesWritten += bytesToWrite;
+void AudioCapture::WriteWaveHeader()
+{
+    // Sizes and start time are filled in by UpdateWaveHeader() when recording stops
+    uint8_t header[BROADCAST_WAVE_HEADER_SIZE];
+    BuildBroadcastWaveHeader(header, m_waveFormat.nSamplesPerSec, m_waveFormat.nChannels,
+        m_pipeline.GetOutputBits(), 0, BroadcastExtension());
 
-            m_captureClient->ReleaseBuffer(numFramesAvailable);
+    DWORD written = 0;
+    WriteFile(m_audioFile, header, (DWORD)BROADCAST_WAVE_HEADER_SIZE, &written, nullptr);
+}
 
-            hr = m_captureClient->GetNextPacketSize(&nextPacketSize);
-            if (FAILED(hr)) break;
+void AudioCapture::UpdateWaveHeader()
+{
+    const uint64_t dataBytes = m_bytesWritten - BROADCAST_WAVE_HEADER_SIZE;
+    DWORD written = 0;
+
+    // Cue points where gaps were filled, appended after the (even padded)
+    // data. A recording past 4 GiB gets open-ended sizes and no cue chunk,
+    // which readers would take for samples.
+    std::vector<uint32_t> cuePoints;
+    for (const PacketTimeline::Gap& gap : m_pipeline.GetTimeline().GetGaps()) {
+        if (gap.frames > 0) cuePoints.push_back((uint32_t)gap.outputFrame);
+    }
+    if (GetWaveDataSize(dataBytes, BROADCAST_WAVE_HEADER_SIZE + GetCueChunkSize(cuePoints.size())) == WAVE_SIZE_UNKNOWN) {
+        cuePoints.clear();
+    }
+
+    uint32_t cueSize = 0;
+    if (!cuePoints.empty()) {
+        size_t padding = dataBytes & 1;
+        cueSize = (uint32_t)GetCueChunkSize(cuePoints.size());
+
+        std::vector<uint8_t> chunk(padding + cueSize, 0);
+        BuildCueChunk(chunk.data() + padding, cuePoints.data(), cuePoints.size());
+        SetFilePointer(m_audioFile, 0, nullptr, FILE_END);
+        WriteFile(m_audioFile, chunk.data(), (DWORD)chunk.size(), &written, nullptr);
+    }
+
+    // BWF origination: UTC time of the first frame and the sample count
+    // since UTC midnight, so recordings from several machines line up
+    FILETIME fileTime;
+    fileTime.dwLowDateTime = (DWORD)m_startFileTime;
+    fileTime.dwHighDateTime = (DWORD)(m_startFileTime >> 32);
+    SYSTEMTIME start = {};
+    FileTimeToSystemTime(&fileTime, &start);
+
+    char computerName[MAX_COMPUTERNAME_LENGTH + 1] = "";
+    DWORD nameLength = sizeof(computerName);
+    GetComputerNameA(computerName, &nameLength);
+
+    BroadcastExtension bext;
+    bext.description = "AudioCaptureCpp recording, origination time in UTC";
+    bext.originator = "AudioCaptureCpp";
+    bext.originatorReference = computerName;
+    snprintf(bext.originationDate, sizeof(bext.originationDate), "%04u-%02u-%02u",
+        (unsigned)start.wYear, (unsigned)start.wMonth, (unsigned)start.wDay);
+    snprintf(bext.originationTime, sizeof(bext.originationTime), "%02u:%02u:%02u",
+        (unsigned)start.wHour, (unsigned)start.wMinute, (unsigned)start.wSecond);
+
+    const uint64_t rate = m_waveFormat.nSamplesPerSec;
+    uint64_t secondsOfDay = start.wHour * 3600u + start.wMinute * 60u + start.wSecond;
+    uint64_t fraction = m_startFileTime % FILETIME_PER_SEC;
+    bext.timeReference = secondsOfDay * rate + fraction * rate / FILETIME_PER_SEC;
+
+    const uint32_t dataSize = GetWaveDataSize(dataBytes, BROADCAST_WAVE_HEADER_SIZE + cueSize);
+    uint8_t header[BROADCAST_WAVE_HEADER_SIZE];
+    BuildBroadcastWaveHeader(header, m_waveFormat.nSamplesPerSec, m_waveFormat.nChannels,
+        m_pipeline.GetOutputBits(), dataSize, bext, cueSize);
+
+    SetFilePointer(m_audioFile, 0, nullptr, FILE_BEGIN);
+    WriteFile(m_audioFile, header, (DWORD)BROADCAST_WAVE_HEADER_SIZE, &written, nullptr);
+}
+
+void AudioCapture::WriteGapIndex()
+{
+    if (m_pipeline.GetTimeline().GetGapCount() == 0) return;
+
+    // Sidecar next to the recording, one line per gap
+    std::wstring indexName = m_audioFileName + L".gaps.csv";
+    HANDLE indexFile = CreateFileW(indexName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (indexFile == INVALID_HANDLE_VALUE) {
+        LogError("Failed to create gap index");
+        return;
+    }
+
+    char line[160];
+    DWORD written = 0;
+    int length = snprintf(line, sizeof(line), "output_frame,device_position,timestamp_100ns,silence_frames,flags\n");
+    WriteFile(indexFile, line, (DWORD)length, &written, nullptr);
+
+    for (const PacketTimeline::Gap& gap : m_pipeline.GetTimeline().GetGaps()) {
+        length = snprintf(line, sizeof(line), "%llu,%llu,%llu,%llu,%s%s%s%s\n",
+            (unsigned long long)gap.outputFrame, (unsigned long long)gap.devicePosition,
+            (unsigned long long)gap.timestamp, (unsigned long long)gap.frames,
+            gap.lost ? "lost" : gap.frames > 0 ? "gap" : "resync",
+            (gap.flags & PacketInfo::Discontinuity) ? "|discontinuity" : "",
+            (gap.flags & PacketInfo::TimestampError) ? "|timestamp_error" : "",
+            (gap.flags & PacketInfo::Reacquired) ? "|reacquired" : "");
+        WriteFile(indexFile, line, (DWORD)length, &written, nullptr);
+    }
+
+    if (m_pipeline.GetTimeline().GetGapCount() > m_pipeline.GetTimeline().GetGaps().size()) {
+        length = snprintf(line, sizeof(line), "# %llu more gaps not listed\n",
+            (unsigned long long)(m_pipeline.GetTimeline().GetGapCount() - m_pipeline.GetTimeline().GetGaps().size()));
+        WriteFile(indexFile, line, (DWORD)length, &written, nullptr);
+    }
+    CloseHandle(indexFile);
+
+    char message[200];
+    snprintf(message, sizeof(message), "Recording had %llu gaps (%llu frames of silence inserted, %llu overlapping frames dropped, %llu device re-acquisitions)",
+        (unsigned long long)m_pipeline.GetTimeline().GetGapCount(), (unsigned long long)m_pipeline.GetTimeline().GetSilenceFrames(),
+        (unsigned long long)m_pipeline.GetTimeline().GetOverlapFrames(),
+        (unsigned long long)m_pipeline.GetTimeline().GetReacquireCount());
+    LogError(message);
+}
+
+void AudioCapture::RecordPacket(const BYTE* data, const PacketInfo& packet)
+{
+    if (!m_pipeline.GetTimeline().HasStarted() && !(packet.flags & PacketInfo::TimestampError)) {
+        // Wall-clock time of the first frame: now minus the packet's age
+        uint64_t now = GetQpcTime100ns();
+        uint64_t age = now > packet.timestamp ? now - packet.timestamp : 0;
+        if (age < FILETIME_PER_SEC) {
+            m_startFileTime = GetFileTimeNow() - age;
         }
     }
+
+    m_pipeline.Record(data, packet);
 }
 
 void AudioCapture::CaptureThread()
 {
-    const DWORD flags = AUDCLNT_BUFFERFLAGS_SILENT;
     UINT32 nextPacketSize = 0;
+    int iterations = 0;
+
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Capture);
+    m_captureScheduling = scheduling.schedulingClass;
+
+    // Re-acquiring a lost device activates new clients on this thread
+    HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    m_watchdog.Start((int64_t)(GetQpcTime100ns() / 10));
+    m_reacquired = false;
+
+    while (m_captureState.load(std::memory_order_acquire) == Running) {
+        // Poll interval; StopCapture() signals the event to end the wait early
+        auto sleepStart = std::chrono::steady_clock::now();
+        DWORD wait = WaitForSingleObject(m_wakeEvent, CAPTURE_WAIT_MS);
+        if (m_captureState.load(std::memory_order_acquire) != Running) break;
+        if (wait == WAIT_TIMEOUT) {
+            auto slept = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sleepStart);
+            m_wakeJitter.Record(slept.count() - CAPTURE_SLEEP_US);
+        }
 
-    // Debug counter
-    static int debugCounter = 0;
-    static int packetCounter = 0;
+        int64_t now = (int64_t)(GetQpcTime100ns() / 10);
+
+        // A lost device is retried with backoff. Recovery allocates, so the
+        // loop warms up again on the new client before it is re-armed.
+        if (m_watchdog.IsLost()) {
+            if (m_watchdog.IsRetryDue(now)) {
+                if (ReacquireDevice(m_watchdog.GetAttempts() >= DEVICE_FALLBACK_ATTEMPTS)) {
+                    uint32_t attempts = m_watchdog.GetAttempts() + 1;
+                    int64_t recoveryUs = m_watchdog.OnRecovered((int64_t)(GetQpcTime100ns() / 10));
+                    m_reacquired = true;
+                    iterations = 0;
+
+                    // The outage shows as silence on the history timeline
+                    if (m_kernels) {
+                        m_history.AddSilence((size_t)(recoveryUs * m_waveFormat.nSamplesPerSec / 1000000));
+                    }
 
-    while (m_isCapturing && !m_stopCapture) {
-        // Early exit check
-        if (m_stopCapture) break;
-        
-        Sleep(10); // Small delay to avoid busy waiting
+                    char message[128];
+                    snprintf(message, sizeof(message), "Capture device re-acquired after %.1f ms (%u attempts)",
+                        recoveryUs / 1000.0, attempts);
+                    LogError(message);
+                } else {
+                    m_watchdog.OnRetryFailed(now);
+                }
+            }
+            continue;
+        }
+
+        // Past warm-up the loop must not touch the heap
+        if (++iterations == ALLOC_WARMUP_ITERATIONS) {
+            AllocTracker::ArmCurrentThread("capture");
+        }
 
         // Get size of next capture package
         HRESULT hr = m_captureClient->GetNextPacketSize(&nextPacketSize);
         if (FAILED(hr)) {
-            if (m_stopCapture) break;
+            HandleDeviceError(now, hr);
             continue;
         }
 
-        // Debug: Write packet info every 100 iterations
-        debugCounter++;
-        if (debugCounter % 100 == 0) {
-            HANDLE debugFile = CreateFileW(L"capture_debug.txt", GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-            if (debugFile != INVALID_HANDLE_VALUE) {
-                std::string debugText = "Packets received: " + std::to_string(packetCounter) + "\n";
-                debugText += "Last packet size: " + std::to_string(nextPacketSize) + "\n";
-                DWORD written;
-                WriteFile(debugFile, debugText.c_str(), (DWORD)debugText.length(), &written, nullptr);
-                CloseHandle(debugFile);
+        // Nothing for a while: find out whether the device is still there.
+        // The device queries allocate.
+        if (nextPacketSize == 0 && m_watchdog.IsStalled(now)) {
+            AllocTracker::DisarmCurrentThread();
+            CheckStalledDevice(now);
+            if (!m_watchdog.IsLost() && iterations >= ALLOC_WARMUP_ITERATIONS) {
+                AllocTracker::ArmCurrentThread("capture");
             }
         }
 
@@ -477,91 +1053,223 @@ void AudioCapture::CaptureThread()
             UINT32 numFramesAvailable = 0;
             DWORD streamFlags = 0;
 
-            hr = m_captureClient->GetBuffer(&data, &numFramesAvailable, &streamFlags, nullptr, nullptr);
-            if (FAILED(hr)) break;
+            UINT64 devicePosition = 0;
+            UINT64 qpcPosition = 0;
 
-            packetCounter++;
+            hr = m_captureClient->GetBuffer(&data, &numFramesAvailable, &streamFlags, &devicePosition, &qpcPosition);
+            if (FAILED(hr)) {
+                HandleDeviceError(now, hr);
+                break;
+            }
+
+            m_watchdog.OnPacket(now);
+            m_startup.Mark(StartupFirstPacket);
+
+            if (m_traceRecorder.IsRunning()) {
+                TracePacket trace;
+                trace.arrival = GetQpcTime100ns() - m_traceStart;
+                trace.devicePosition = devicePosition;
+                trace.timestamp = qpcPosition;
+                trace.frames = numFramesAvailable;
+                trace.deviceFlags = streamFlags;
+                m_traceRecorder.Record(trace, data);
+            }
 
             if (!(streamFlags & AUDCLNT_BUFFERFLAGS_SILENT)) {
-                // Debug: Check if we have non-silent data
-                static int silentCounter = 0;
-                static int dataCounter = 0;
-                dataCounter++;
-                
-                if (dataCounter % 50 == 0) {  // Every 50th data packet
-                    HANDLE debugFile = CreateFileW(L"audio_data_debug.txt", GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-                    if (debugFile != INVALID_HANDLE_VALUE) {
-                        std::string debugText = "Data packets: " + std::to_string(dataCounter) + "\n";
-                        debugText += "Silent packets: " + std::to_string(silentCounter) + "\n";
-                        debugText += "Frames available: " + std::to_string(numFramesAvailable) + "\n";
-                        debugText += "Channels: " + std::to_string(m_waveFormat.nChannels) + "\n";
-                        debugText += "Bits per sample: " + std::to_string(m_waveFormat.wBitsPerSample) + "\n";
-                        
-                        // Check first few samples
-                        if (m_waveFormat.wBitsPerSample == 16 && numFramesAvailable > 0) {
-                            int16_t* pcmData = (int16_t*)data;
-                            debugText += "First sample: " + std::to_string(pcmData[0]) + "\n";
-                            if (numFramesAvailable > 1) {
-                                debugText += "Second sample: " + std::to_string(pcmData[1]) + "\n";
-                            }
-                        }
-                        
-                        DWORD written;
-                        WriteFile(debugFile, debugText.c_str(), (DWORD)debugText.length(), &written, nullptr);
-                        CloseHandle(debugFile);
-                    }
-                }
+                // Update waveform buffer for visualization; the kernels were
+                // picked for this format in InitializeWASAPI
+                if (m_kernels && numFramesAvailable <= m_bufferFrameCount) {
+                    const UINT32 channels = m_waveFormat.nChannels;
+                    m_kernels->toPlanar(data, numFramesAvailable, channels, m_planes.data());
+                    m_kernels->toFloat(data, numFramesAvailable, channels, m_floatBuffer.data());
+                    m_history.AddPlanar(m_planes.data(), numFramesAvailable);
 
-                // Update waveform buffer for visualization
-                {
                     std::lock_guard<std::mutex> lock(m_mutex);
-                    
-                    if (m_waveFormat.wBitsPerSample == 16) {
-                        int16_t* pcmData = (int16_t*)data;
-                        for (UINT32 i = 0; i < numFramesAvailable; i++) {
-                            float sample = pcmData[i * m_waveFormat.nChannels] / 32768.0f;
-                            
-                            // Shift waveform buffer
-                            for (int j = 0; j < WAVEFORM_BUFFER_SIZE - 1; j++) {
-                                m_waveformBuffer[j] = m_waveformBuffer[j + 1];
-                            }
-                            m_waveformBuffer[WAVEFORM_BUFFER_SIZE - 1] = sample;
-                            
-                            m_sampleCount++;
-                        }
-                    }
+                    m_waveform.WritePlanar(m_planes.data(), numFramesAvailable);
+                    m_sampleCount.fetch_add(numFramesAvailable, std::memory_order_relaxed);
+                    m_loudness.Process(m_floatBuffer.data(), numFramesAvailable);
                 }
+                m_dataGeneration.fetch_add(1, std::memory_order_release);
             } else {
-                static int silentCounter = 0;
-                silentCounter++;
+                // Silent packets keep the history's time axis
+                if (m_kernels) m_history.AddSilence(numFramesAvailable);
+            }
+
+            // Other processes read the same float frames from shared memory
+            if (m_sharedRing.IsOpen() && numFramesAvailable <= m_bufferFrameCount) {
+                if ((streamFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) || m_reacquired) {
+                    m_sharedRing.MarkDiscontinuity();
+                }
+                bool silent = (streamFlags & AUDCLNT_BUFFERFLAGS_SILENT) != 0;
+                m_sharedRing.Publish(silent ? nullptr : m_floatBuffer.data(), numFramesAvailable);
+            }
+
+            // Recording: place the packet on the device timeline and write it
+            if (m_isRecording) {
+                PacketInfo packet;
+                packet.devicePosition = devicePosition;
+                packet.timestamp = qpcPosition;
+                packet.frames = numFramesAvailable;
+                packet.flags = ToPacketFlags(streamFlags);
+                if (m_reacquired) packet.flags |= PacketInfo::Reacquired;
+
+                std::lock_guard<std::mutex> lock(m_recordingMutex);
+                if (m_isRecording) {
+                    RecordPacket(data, packet);
+                }
             }
 
             m_captureClient->ReleaseBuffer(numFramesAvailable);
+            m_reacquired = false;
 
             hr = m_captureClient->GetNextPacketSize(&nextPacketSize);
-            if (FAILED(hr)) break;
+            if (FAILED(hr)) {
+                HandleDeviceError(now, hr);
+                break;
+            }
         }
     }
+
+    AllocTracker::DisarmCurrentThread();
+    if (SUCCEEDED(comResult)) CoUninitialize();
+    ThreadScheduling::RestoreCurrentThread(scheduling);
 }
 
-// Removed - use GetWaveformBuffer() pointer directly with GetWaveformMutex()
+void AudioCapture::HandleDeviceError(int64_t now, HRESULT hr)
+{
+    m_watchdog.OnError(now, IsDeviceGone(hr));
+    if (m_watchdog.IsLost()) {
+        AllocTracker::DisarmCurrentThread();
+        OnDeviceLost(hr);
+    }
+}
+
+void AudioCapture::CheckStalledDevice(int64_t now)
+{
+    DWORD state = 0;
+    if (FAILED(m_device->GetState(&state)) || state != DEVICE_STATE_ACTIVE) {
+        m_watchdog.OnLost(now, DeviceWatchdog::Stalled);
+        OnDeviceLost(S_OK);
+        return;
+    }
+
+    // Following the default endpoint: the old one falls silent when the
+    // default changes
+    if (m_currentDevice.id == L"default") {
+        EDataFlow dataFlow = (m_currentDeviceType == RenderDevices) ? eRender : eCapture;
+        ComPtr<IMMDevice> defaultDevice;
+        LPWSTR defaultId = nullptr;
+        LPWSTR currentId = nullptr;
+        bool changed = false;
+        if (SUCCEEDED(m_deviceEnumerator->GetDefaultAudioEndpoint(dataFlow, eConsole, defaultDevice.GetAddressOf())) &&
+            SUCCEEDED(defaultDevice->GetId(&defaultId)) && SUCCEEDED(m_device->GetId(&currentId))) {
+            changed = wcscmp(defaultId, currentId) != 0;
+        }
+        CoTaskMemFree(defaultId);
+        CoTaskMemFree(currentId);
+        if (changed) {
+            m_watchdog.OnLost(now, DeviceWatchdog::EndpointChanged);
+            OnDeviceLost(S_OK);
+            return;
+        }
+    }
+
+    // Loopback of an endpoint that plays nothing delivers no packets either;
+    // a capture endpoint always does
+    if (m_currentDeviceType == RenderDevices) {
+        m_watchdog.OnAlive(now);
+    } else {
+        m_watchdog.OnLost(now, DeviceWatchdog::Stalled);
+        OnDeviceLost(S_OK);
+    }
+}
+
+void AudioCapture::OnDeviceLost(HRESULT hr)
+{
+    // The old client may still hold the stream open
+    m_audioClient->Stop();
+
+    char message[160];
+    snprintf(message, sizeof(message), "Capture device lost (%s, HRESULT 0x%08X); reconnecting",
+        DeviceWatchdog::GetCauseName(m_watchdog.GetLastCause()), (unsigned)hr);
+    LogError(message);
+}
+
+bool AudioCapture::ReacquireDevice(bool allowFallback)
+{
+    EDataFlow dataFlow = (m_currentDeviceType == RenderDevices) ? eRender : eCapture;
+    bool followDefault = m_currentDevice.id.empty() || m_currentDevice.id == L"default";
+
+    // The same device by ID, unless it stays gone
+    ComPtr<IMMDevice> device;
+    HRESULT hr = E_FAIL;
+    if (!followDefault) {
+        hr = m_deviceEnumerator->GetDevice(m_currentDevice.id.c_str(), device.GetAddressOf());
+        DWORD state = 0;
+        if (SUCCEEDED(hr) && (FAILED(device->GetState(&state)) || state != DEVICE_STATE_ACTIVE)) {
+            device.Reset();
+            hr = E_FAIL;
+        }
+    }
+    bool fellBack = false;
+    if (FAILED(hr)) {
+        if (!followDefault && !allowFallback) return false;
+        hr = m_deviceEnumerator->GetDefaultAudioEndpoint(dataFlow, eConsole, device.GetAddressOf());
+        if (FAILED(hr)) return false;
+        fellBack = !followDefault;
+    }
+
+    // Same format as before so the recording can go on; the engine converts
+    // if the new endpoint mixes at another rate or channel count
+    ComPtr<IAudioClient> audioClient;
+    hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)audioClient.GetAddressOf());
+    if (FAILED(hr)) return false;
+
+    DWORD streamFlags = AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY;
+    if (m_currentDeviceType == RenderDevices) {
+        streamFlags |= AUDCLNT_STREAMFLAGS_LOOPBACK;
+    }
+    hr = audioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, streamFlags, REFTIMES_PER_SEC, 0, &m_waveFormat, nullptr);
+    if (FAILED(hr)) return false;
+
+    // Packet buffers were sized for the first client
+    UINT32 bufferFrames = 0;
+    if (FAILED(audioClient->GetBufferSize(&bufferFrames)) || bufferFrames > m_bufferFrameCount) return false;
+
+    ComPtr<IAudioCaptureClient> captureClient;
+    hr = audioClient->GetService(__uuidof(IAudioCaptureClient), (void**)captureClient.GetAddressOf());
+    if (FAILED(hr)) return false;
+    hr = audioClient->Start();
+    if (FAILED(hr)) return false;
+
+    m_captureClient = captureClient;
+    m_audioClient = audioClient;
+    m_device = device;
+    if (fellBack) {
+        LogError("Selected capture device did not come back; using the default endpoint");
+    }
+    return true;
+}
 
 float AudioCapture::GetCurrentLevel() const
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    if (m_waveformBuffer.empty()) return 0.0f;
-    
-    // Calculate RMS of last 2400 samples (50ms at 48kHz) or less if buffer is small
-    const int numSamples = min(2400, (int)m_waveformBuffer.size());
-    float sum = 0.0f;
-    
-    // Calculate from the last numSamples positions (accounting for circular buffer)
-    for (int i = 0; i < numSamples; i++) {
-        int idx = (m_waveformPos - numSamples + i + m_waveformBufferSize) % m_waveformBufferSize;
-        sum += m_waveformBuffer[idx] * m_waveformBuffer[idx];
+    // RMS of channel 0 over the last 2400 samples (50ms at 48kHz)
+    const size_t numSamples = 2400;
+
+    // Retry if the writer overwrote the snapshot while we were reading it
+    for (int attempt = 0; attempt < 3; attempt++) {
+        WaveformView view;
+        if (!m_waveform.Snapshot(0, numSamples, view) || view.empty()) return 0.0f;
+
+        float sum = 0.0f;
+        for (float sample : view.first) sum += sample * sample;
+        for (float sample : view.second) sum += sample * sample;
+
+        if (m_waveform.IsValid(view)) {
+            return sqrt(sum / view.size());
+        }
     }
-    
-    return sqrt(sum / numSamples);
+    return 0.0f;
 }
 
 std::vector<AudioCapture::AudioDevice> AudioCapture::EnumerateAudioDevices(DeviceType type)
@@ -594,13 +1302,14 @@ std::vector<AudioCapture::AudioDevice> AudioCapture::EnumerateAudioDevices(Devic
     UINT count = 0;
     collection->GetCount(&count);
 
-    // Debug output - write to file
-    std::wstring debugFileName = (type == RenderDevices) ? L"audio_devices_render_debug.txt" : L"audio_devices_capture_debug.txt";
-    HANDLE debugFile = CreateFileW(debugFileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (debugFile != INVALID_HANDLE_VALUE) {
-        std::string debugText = (type == RenderDevices) ? "Available Render Devices:\n" : "Available Capture Devices:\n";
-        DWORD written;
-        WriteFile(debugFile, debugText.c_str(), (DWORD)debugText.length(), &written, nullptr);
+    // Default endpoint ID, looked up once for the whole list
+    LPWSTR pszDefaultId = nullptr;
+    IMMDevice* defaultDevice = nullptr;
+    if (SUCCEEDED(m_deviceEnumerator->GetDefaultAudioEndpoint(dataFlow, eConsole, &defaultDevice))) {
+        if (FAILED(defaultDevice->GetId(&pszDefaultId))) {
+            pszDefaultId = nullptr;
+        }
+        defaultDevice->Release();
     }
 
     for (UINT i = 0; i < count; ++i) {
@@ -632,45 +1341,33 @@ std::vector<AudioCapture::AudioDevice> AudioCapture::EnumerateAudioDevices(Devic
             PropVariantClear(&varName);
         }
 
-        // Get default device to check if this one is default
-        IMMDevice* defaultDevice = nullptr;
+        // The ID finds the device again after it was lost; it also tells
+        // whether this one is the default device
+        std::wstring deviceId;
         bool isDefault = false;
-        if (SUCCEEDED(m_deviceEnumerator->GetDefaultAudioEndpoint(dataFlow, eConsole, &defaultDevice))) {
-            LPWSTR pszDefaultId = nullptr;
-            if (SUCCEEDED(defaultDevice->GetId(&pszDefaultId))) {
-                LPWSTR pszCurrentId = nullptr;
-                if (SUCCEEDED(device->GetId(&pszCurrentId))) {
-                    isDefault = (wcscmp(pszDefaultId, pszCurrentId) == 0);
-                    CoTaskMemFree(pszCurrentId);
-                }
-                CoTaskMemFree(pszDefaultId);
-            }
-            defaultDevice->Release();
+        LPWSTR pszCurrentId = nullptr;
+        if (SUCCEEDED(device->GetId(&pszCurrentId))) {
+            deviceId = pszCurrentId;
+            isDefault = pszDefaultId && wcscmp(pszDefaultId, pszCurrentId) == 0;
+            CoTaskMemFree(pszCurrentId);
         }
 
         AudioDevice audioDevice;
         audioDevice.index = devices.size();
         audioDevice.name = deviceName;
-        audioDevice.id = L"";
+        audioDevice.id = deviceId;
         audioDevice.isDefault = isDefault;
 
         devices.push_back(audioDevice);
 
-        // Debug output
-        if (debugFile != INVALID_HANDLE_VALUE) {
-            std::string debugLine = "Device " + std::to_string(i) + ": " + std::string(deviceName.begin(), deviceName.end()) + (isDefault ? " (Default)" : "") + "\n";
-            DWORD written;
-            WriteFile(debugFile, debugLine.c_str(), (DWORD)debugLine.length(), &written, nullptr);
-        }
-
         if (props) {
             props->Release();
         }
         device->Release();
     }
 
-    if (debugFile != INVALID_HANDLE_VALUE) {
-        CloseHandle(debugFile);
+    if (pszDefaultId) {
+        CoTaskMemFree(pszDefaultId);
     }
 
     collection->Release();
@@ -680,15 +1377,8 @@ std::vector<AudioCapture::AudioDevice> AudioCapture::EnumerateAudioDevices(Devic
 bool AudioCapture::SelectAudioDevice(int deviceIndex, DeviceType type)
 {
     try {
-        // Wait a bit for capture thread to actually stop (max 100ms with retries)
-        for (int retry = 0; retry < 10; retry++) {
-            if (!m_isCapturing && !m_isRecording) {
-                break;  // Safe to proceed
-            }
-            Sleep(10);
-        }
-        
-        if (m_isCapturing || m_isRecording) {
+        // StopCapture() returns with the capture thread joined
+        if (m_captureState.load() != Stopped || m_isRecording) {
             ShowError(L"Cannot select device while capturing or recording", S_OK);
             return false;
         }
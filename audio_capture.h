@@ -8,9 +8,36 @@
 #include <thread>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <string>
+#include "waveform_ring.h"
+#include "block_pool.h"
+#include "loudness_meter.h"
+#include "dsp_nodes.h"
+#include "batched_writer.h"
+#include "stream_output.h"
+#include "device_watchdog.h"
+#include "event_index.h"
+#include "manifest.h"
+#include "recording_pipeline.h"
+#include "peak_file.h"
+#include "capture_trace.h"
+#include "shared_ring.h"
+#include "thread_scheduling.h"
+#include "sample_kernels.h"
+#include "startup_timer.h"
+#include "waveform_history.h"
 
 using Microsoft::WRL::ComPtr;
 
+const int WAVEFORM_BUFFER_SIZE = 48000; // 1 second at 48kHz for the live view
+const int MAX_WAVEFORM_CHANNELS = 8;
+
+// Overview of the last hours for the scrolling timeline (WaveformHistory):
+// 24 h at any format in 64 MB, the finest detail as far back as fits
+const uint32_t HISTORY_SECONDS = 24 * 3600;
+const size_t HISTORY_BUDGET_BYTES = 64 * 1024 * 1024;
+
 class AudioCapture
 {
 public:
@@ -19,6 +46,14 @@ public:
         CaptureDevices  // Microphones (for direct capture)
     };
 
+    // Capture thread lifecycle. Start/stop are called from one (UI) thread;
+    // Stopping lasts from the stop signal until the thread has been joined.
+    enum CaptureState {
+        Stopped,
+        Running,
+        Stopping
+    };
+
     struct AudioDevice
     {
         int index;
@@ -30,13 +65,37 @@ public:
     AudioCapture();
     ~AudioCapture();
 
-    bool Initialize();
+    // Startup that keeps the UI responsive: initializes COM on the calling
+    // (UI) thread, then on background threads activates the default device
+    // and starts capture while the `listType` devices are listed in
+    // parallel. Posts `message` to `window` when done (wParam 1 on success);
+    // call FinishInitialize() then. Until that only the startup timer may
+    // be used.
+    bool BeginInitialize(HWND window, UINT message, DeviceType listType = RenderDevices);
+
+    // Joins the startup threads (waits if they are still running) and hands
+    // over the device list; true if capture is running
+    bool FinishInitialize(std::vector<AudioDevice>& devices);
+
     bool StartCapture();
+
+    // Ends a running recording (writers drained, header final), wakes the
+    // capture thread and joins it
     bool StopCapture();
     bool StartRecording(const wchar_t* filename);
     bool StopRecording();
-    bool IsRecording() const { return m_isRecording; }
-    bool IsCapturing() const { return m_isCapturing; }
+    bool IsRecording() const { return m_isRecording.load(); }
+    bool IsCapturing() const { return m_captureState.load() == Running; }
+    CaptureState GetCaptureState() const { return m_captureState.load(); }
+
+    // Duration of the last StartCapture() and of the last stop signal-to-join
+    int64_t GetStartLatencyUs() const { return m_startLatencyUs; }
+    int64_t GetStopLatencyUs() const { return m_stopLatencyUs; }
+
+    // Startup phases since this object was constructed; the capture thread
+    // marks the first packet. ReportStartup() logs them against the target.
+    StartupTimer& GetStartupTimer() { return m_startup; }
+    void ReportStartup();
     
     // Device enumeration
     std::vector<AudioDevice> EnumerateAudioDevices(DeviceType type = RenderDevices);
@@ -44,20 +103,107 @@ public:
     AudioDevice GetCurrentDevice() const { return m_currentDevice; }
     DeviceType GetCurrentDeviceType() const { return m_currentDeviceType; }
     
-    // Get waveform buffer for visualization (use with GetWaveformBufferAccessor)
-    std::mutex& GetWaveformMutex() { return m_mutex; }
-    const std::vector<float>& GetWaveformBufferRef() const { return m_waveformBuffer; }
+    // Recent samples per channel for visualization and analysis. Readers take
+    // lock-free snapshots (WaveformRing::Snapshot/ReadSince) and validate them
+    // with WaveformRing::IsValid after use.
+    const WaveformRing& GetWaveformRing() const { return m_waveform; }
+
+    // Min/max/RMS overview of everything captured in the last HISTORY_SECONDS,
+    // queried lock-free (WaveformHistory::GetSummaries)
+    const WaveformHistory& GetWaveformHistory() const { return m_history; }
     float GetCurrentLevel() const;
-    int GetSampleCount() const { return m_sampleCount; }
-    int GetWaveformPosition() const { return m_waveformPos; }
-    int GetWaveformBufferSize() const { return m_waveformBufferSize; }
+    uint64_t GetSampleCount() const { return m_sampleCount.load(std::memory_order_relaxed); }
+
+    // EBU R128 loudness of the captured stream (reset when recording starts)
+    const LoudnessMeter& GetLoudnessMeter() const { return m_loudness; }
+
+    // Processing applied to recorded audio before it is written. Stage
+    // parameters can change at any time; add or remove nodes only while
+    // not recording.
+    RecordingStages& GetRecordingStages() { return m_pipeline.GetStages(); }
+    DspChain& GetRecordingChain() { return m_pipeline.GetChain(); }
+
+    // Spectral noise suppression for microphone capture (off by default).
+    // Applies to capture devices only and takes effect on the next
+    // StartRecording(); adds one FFT frame (~21 ms) of latency, which the
+    // recording compensates.
+    void SetNoiseSuppression(bool enabled) { m_noiseSuppression = enabled; }
+    NoiseSuppressor& GetNoiseSuppressor() { return m_pipeline.GetNoiseSuppressor(); }
+
+    // Depth of recorded files (16 or 24). Float or 24/32-bit capture is
+    // requantized with dither (see GetRequantizer for dither and noise
+    // shaping); takes effect when the device is (re)initialized.
+    void SetRecordingBitDepth(uint16_t bits) { m_recordBits = bits; }
+    uint16_t GetRecordingBitDepth() const { return m_pipeline.GetOutputBits(); }
+    Requantizer& GetRequantizer() { return m_pipeline.GetRequantizer(); }
+
+    // Integrity manifest "<file>.manifest" with CRC32C per 1 MiB block and of
+    // the whole file, computed by the file writer thread (on by default).
+    // Takes effect on the next StartRecording(); check with AudioVerify.
+    void SetManifestEnabled(bool enabled) { m_manifestEnabled = enabled; }
+
+    // Event index "<file>.events" (clipping, dropouts, DC offset, level
+    // jumps, transients), detected on the file writer thread (on by default).
+    // Takes effect on the next StartRecording(); list with AudioEvents.
+    void SetEventsEnabled(bool enabled) { m_eventsEnabled = enabled; }
+    const EventDetector& GetEventDetector() const { return m_events.GetDetector(); }
+
+    // Live copy of the recorded (processed) audio for external encoders, see
+    // StreamOutput for targets. Takes effect on the next StartRecording();
+    // an empty target turns streaming off.
+    void SetStreamTarget(const std::string& target, StreamOutput::Format format = StreamOutput::RawPcm,
+                         BatchedWriter::OverflowPolicy policy = BatchedWriter::DropNewest);
+    bool IsStreaming() const { return m_streamWriter.IsRunning(); }
+    const BatchedWriter& GetStreamWriter() const { return m_streamWriter; }
+
+    // Device timeline of the current recording: gaps filled with silence,
+    // overlaps trimmed. Gaps are also written to "<file>.gaps.csv" on stop.
+    const PacketTimeline& GetRecordingTimeline() const { return m_pipeline.GetTimeline(); }
+
+    // Capture trace of every device packet for offline replay (AudioReplay).
+    // Takes effect on the next StartCapture(); an empty path turns it off.
+    // With `payload` the audio is stored too, otherwise metadata only.
+    void SetTraceTarget(const std::wstring& path, bool payload);
+    bool IsTracing() const { return m_traceRecorder.IsRunning(); }
+    const CaptureTraceRecorder& GetTraceRecorder() const { return m_traceRecorder; }
+
+    // Shared-memory ring "NAME" with the captured stream as float for other
+    // processes (SharedRingReader, AudioRing monitor), holding `historyMs` of
+    // audio. Takes effect on the next StartCapture(); an empty name turns it off.
+    void SetSharedRing(const std::string& name, uint32_t historyMs = 2000);
+    bool IsSharingRing() const { return m_sharedRing.IsOpen(); }
+
+    // Device-loss detection and recovery of the capture loop. A lost device
+    // is re-acquired by ID (or the default endpoint again, when following it);
+    // after repeated failures a selected device falls back to the default.
+    // The recording continues with the outage filled with silence.
+    DeviceWatchdog& GetDeviceWatchdog() { return m_watchdog; }
+    const DeviceWatchdog& GetDeviceWatchdog() const { return m_watchdog; }
+    bool IsDeviceLost() const { return m_watchdog.IsLost(); }
+
+    // Incremented every time new waveform data is published; the UI repaints
+    // only when this changes
+    uint64_t GetDataGeneration() const { return m_dataGeneration.load(std::memory_order_acquire); }
 
 private:
+    void InitializeThread(HWND window, UINT message, DeviceType listType);
     bool InitializeWASAPI();
     void CaptureThread();
-    void RecordingThread();
+    void RecordPacket(const BYTE* data, const PacketInfo& packet);
     void WriteWaveHeader();
     void UpdateWaveHeader();
+    void WriteGapIndex();
+    bool StartStreaming();
+    void StopStreaming();
+    bool StartTrace();
+    void StopTrace();
+    bool StartSharedRing();
+    void UnlockPacketPool();
+    void ReportWakeJitter();
+    void HandleDeviceError(int64_t now, HRESULT hr);
+    void CheckStalledDevice(int64_t now);
+    void OnDeviceLost(HRESULT hr);
+    bool ReacquireDevice(bool allowFallback);
     void ProcessAudioData();
 
     // WASAPI interfaces
@@ -66,32 +212,95 @@ private:
     ComPtr<IAudioClient> m_audioClient;
     ComPtr<IAudioCaptureClient> m_captureClient;
 
+    // Background startup (BeginInitialize/FinishInitialize)
+    std::unique_ptr<std::thread> m_initThread;
+    std::vector<AudioDevice> m_initDevices;
+    bool m_initResult = false;
+    StartupTimer m_startup;
+
     // Current selected device
     AudioDevice m_currentDevice = {};
     DeviceType m_currentDeviceType = RenderDevices;
     bool m_deviceSelected = false;
 
     // Capture state
-    bool m_isCapturing = false;
-    bool m_stopCapture = false;  // Signal to stop capture thread
+    std::atomic<CaptureState> m_captureState{ Stopped };
+    HANDLE m_wakeEvent = nullptr;   // Ends the capture loop's wait early (stop)
     std::unique_ptr<std::thread> m_captureThread;
+    int64_t m_startLatencyUs = 0;
+    int64_t m_stopLatencyUs = 0;
+    WakeJitterMeter m_wakeJitter;   // How late the capture loop wakes from its sleep
+    ThreadScheduling::Class m_captureScheduling = ThreadScheduling::Default;  // What the capture thread got
+    DeviceWatchdog m_watchdog;
+    bool m_reacquired = false;      // Capture thread: next packet is the first after a re-acquisition
 
-    // Recording state
-    bool m_isRecording = false;
-    std::unique_ptr<std::thread> m_recordingThread;
-    mutable std::mutex m_mutex;
+    // Recording state. The capture thread is the only reader of the capture
+    // client; while recording it also places and writes every packet.
+    std::atomic<bool> m_isRecording{ false };
+    std::mutex m_recordingMutex;  // Held by the capture thread while it records a packet
+    std::mutex m_mutex;           // Serializes waveform/loudness updates
     
     // File handling
     HANDLE m_audioFile = INVALID_HANDLE_VALUE;
-    DWORD m_bytesWritten = 0;
-    
-    // Audio data (45 seconds at 48kHz = 2,160,000 samples)
-    std::vector<float> m_waveformBuffer;
-    int m_waveformPos = 0;
-    int m_sampleCount = 0;
-    int m_waveformBufferSize = 0;  // Actual size in samples
+    std::wstring m_audioFileName;
+    uint64_t m_bytesWritten = 0;   // Header included; may pass 4 GiB
+    uint64_t m_startFileTime = 0;   // UTC of the first recorded frame (FILETIME units)
+    FileOutput m_fileOutput;
+    BatchedWriter m_fileWriter;     // Writes packet blocks off the recording thread
+    PeakFileWriter m_peakWriter;    // "<file>.peaks", fed by the file writer thread
+    PeakOutput m_peakOutput;
+    bool m_manifestEnabled = true;
+    ManifestWriter m_manifest;      // "<file>.manifest", fed by the file writer thread
+    ManifestOutput m_manifestOutput;
+    bool m_noiseSuppression = false;
+    bool m_eventsEnabled = true;
+    EventIndexWriter m_events;      // "<file>.events", fed by the file writer thread
+    EventOutput m_eventOutput;
+
+    // Live stream output
+    std::string m_streamTarget;
+    StreamOutput::Format m_streamFormat = StreamOutput::RawPcm;
+    BatchedWriter::OverflowPolicy m_streamPolicy = BatchedWriter::DropNewest;
+    StreamOutput m_streamOutput;
+    BatchedWriter m_streamWriter;
+
+    // Capture trace, recorded by the capture thread for every packet
+    std::wstring m_tracePath;
+    bool m_tracePayload = false;
+    HANDLE m_traceFile = INVALID_HANDLE_VALUE;
+    FileOutput m_traceOutput;
+    CaptureTraceRecorder m_traceRecorder;
+    uint64_t m_traceStart = 0;      // QPC time of StartCapture, 100 ns
+
+    // Shared-memory ring for other processes, published by the capture thread
+    std::string m_sharedRingName;
+    uint32_t m_sharedRingHistoryMs = 2000;
+    SharedRingPublisher m_sharedRing;
+
+    // Timeline placement, DSP and packet buffers of the recorded stream;
+    // the pool is sized from the negotiated format in InitializeWASAPI
+    RecordingPipeline m_pipeline;
+
+    // Audio data for visualization (planar ring, all channels)
+    WaveformRing m_waveform{ MAX_WAVEFORM_CHANNELS, WAVEFORM_BUFFER_SIZE };
+    WaveformHistory m_history{ MAX_WAVEFORM_CHANNELS, HISTORY_BUDGET_BYTES };  // Written by the capture thread only
+    std::atomic<uint64_t> m_sampleCount{0};   // 64 bits: a 32-bit count wraps after ~12 hours at 48 kHz
+    LoudnessMeter m_loudness;  // Fed under m_mutex like the waveform
+    std::atomic<uint64_t> m_dataGeneration{0};
     
-    // Audio format
+    // Audio format (as captured; recordings use m_recordBits)
     WAVEFORMATEX m_waveFormat = {};
+    uint16_t m_recordBits = 16;
     UINT32 m_bufferFrameCount = 0;
+
+    // Per-format conversion of packets for the waveform and meters, with
+    // scratch sized to the device buffer (the capture thread never allocates)
+    SampleType m_sampleType = SampleUnknown;
+    const PacketKernels* m_kernels = nullptr;
+    std::vector<float> m_floatBuffer;     // Interleaved
+    std::vector<float> m_planarBuffer;    // One plane of m_bufferFrameCount per channel
+    std::vector<float*> m_planes;
+
+    const void* m_lockedPool = nullptr;   // Region locked with ThreadScheduling::LockMemory
+    size_t m_lockedPoolSize = 0;
 };
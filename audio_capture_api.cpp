@@ -0,0 +1,172 @@
+#include "audio_capture_api.h"
+#include <cstring>
+#include <new>
+#include "audio_session.h"
+
+static_assert((uint32_t)PacketInfo::Silent == AC_PACKET_SILENT, "packet flags are part of the C ABI");
+static_assert((uint32_t)PacketInfo::Discontinuity == AC_PACKET_DISCONTINUITY, "packet flags are part of the C ABI");
+static_assert((uint32_t)PacketInfo::TimestampError == AC_PACKET_TIMESTAMP_ERROR, "packet flags are part of the C ABI");
+static_assert((uint32_t)PacketInfo::Reacquired == AC_PACKET_REACQUIRED, "packet flags are part of the C ABI");
+
+struct ac_session
+{
+    AudioSession session;
+    ac_packet_callback callback = nullptr;
+    void* user = nullptr;
+};
+
+namespace {
+
+// Translates the session's view to the C struct; both live on the stack of
+// the delivering thread, the planes stay in the pool block
+void ForwardPacket(const PacketView& packet, void* user)
+{
+    const ac_session* session = (const ac_session*)user;
+    ac_packet_view view;
+    view.struct_size = sizeof(view);
+    view.sample_rate = packet.sampleRate;
+    view.channels = packet.channels;
+    view.frames = packet.frames;
+    view.flags = packet.flags;
+    view.position = packet.position;
+    view.time_ns = packet.time;
+    view.planes = packet.planes;
+    session->callback(&view, session->user);
+}
+
+}
+
+extern "C" {
+
+uint32_t ac_get_api_version(void)
+{
+    return AC_API_VERSION;
+}
+
+const char* ac_result_string(ac_result result)
+{
+    switch (result) {
+    case AC_OK: return "ok";
+    case AC_ERROR_INVALID_ARGUMENT: return "invalid argument";
+    case AC_ERROR_INVALID_STATE: return "invalid state";
+    case AC_ERROR_UNSUPPORTED: return "unsupported";
+    case AC_ERROR_IO: return "i/o error";
+    case AC_ERROR_TIMEOUT: return "timeout";
+    case AC_ERROR_OUT_OF_MEMORY: return "out of memory";
+    default: return "unknown error";
+    }
+}
+
+uint64_t ac_get_time_ns(void)
+{
+    return GetSharedRingTime();
+}
+
+ac_result ac_session_create(ac_session** session)
+{
+    if (!session) return AC_ERROR_INVALID_ARGUMENT;
+    *session = new (std::nothrow) ac_session;
+    return *session ? AC_OK : AC_ERROR_OUT_OF_MEMORY;
+}
+
+void ac_session_destroy(ac_session* session)
+{
+    delete session;
+}
+
+ac_result ac_session_set_source_tone(ac_session* session, uint32_t sample_rate, uint32_t channels,
+                                     double frequency, double level_db, uint32_t packet_frames, int realtime)
+{
+    if (!session) return AC_ERROR_INVALID_ARGUMENT;
+    if (session->session.IsStarted()) return AC_ERROR_INVALID_STATE;
+    if (!session->session.SetToneSource(sample_rate, channels, frequency, level_db, packet_frames, realtime != 0)) {
+        return AC_ERROR_INVALID_ARGUMENT;
+    }
+    return AC_OK;
+}
+
+ac_result ac_session_set_source_trace(ac_session* session, const char* path, int realtime)
+{
+    if (!session || !path) return AC_ERROR_INVALID_ARGUMENT;
+    if (session->session.IsStarted()) return AC_ERROR_INVALID_STATE;
+    return session->session.SetTraceSource(path, realtime != 0) ? AC_OK : AC_ERROR_IO;
+}
+
+ac_result ac_session_set_recording(ac_session* session, const char* wav_path, uint32_t bits)
+{
+    if (!session) return AC_ERROR_INVALID_ARGUMENT;
+    if (session->session.IsStarted()) return AC_ERROR_INVALID_STATE;
+    if (!session->session.SetRecording(wav_path ? wav_path : "", (uint16_t)bits)) return AC_ERROR_UNSUPPORTED;
+    return AC_OK;
+}
+
+ac_result ac_session_set_shared_ring(ac_session* session, const char* name, uint32_t history_ms)
+{
+    if (!session) return AC_ERROR_INVALID_ARGUMENT;
+    if (session->session.IsStarted()) return AC_ERROR_INVALID_STATE;
+    if (!session->session.SetSharedRing(name ? name : "", history_ms)) return AC_ERROR_INVALID_ARGUMENT;
+    return AC_OK;
+}
+
+ac_result ac_session_set_callback(ac_session* session, ac_packet_callback callback, void* user,
+                                  ac_delivery delivery, uint32_t queue_packets)
+{
+    if (!session || (delivery != AC_DELIVERY_INLINE && delivery != AC_DELIVERY_CONSUMER_THREAD)) {
+        return AC_ERROR_INVALID_ARGUMENT;
+    }
+    if (session->session.IsStarted()) return AC_ERROR_INVALID_STATE;
+
+    session->callback = callback;
+    session->user = user;
+    session->session.SetCallback(callback ? &ForwardPacket : nullptr, session,
+        delivery == AC_DELIVERY_INLINE ? AudioSession::Inline : AudioSession::ConsumerThread, queue_packets);
+    return AC_OK;
+}
+
+ac_result ac_session_start(ac_session* session)
+{
+    if (!session) return AC_ERROR_INVALID_ARGUMENT;
+    if (session->session.IsStarted()) return AC_ERROR_INVALID_STATE;
+    return session->session.Start() ? AC_OK : AC_ERROR_IO;
+}
+
+ac_result ac_session_stop(ac_session* session)
+{
+    if (!session) return AC_ERROR_INVALID_ARGUMENT;
+    session->session.Stop();
+    return AC_OK;
+}
+
+ac_result ac_session_wait(ac_session* session, uint32_t timeout_ms)
+{
+    if (!session) return AC_ERROR_INVALID_ARGUMENT;
+    if (!session->session.IsStarted()) return AC_ERROR_INVALID_STATE;
+    return session->session.WaitForEnd(timeout_ms) ? AC_OK : AC_ERROR_TIMEOUT;
+}
+
+ac_result ac_session_get_stats(const ac_session* session, ac_session_stats* stats)
+{
+    if (!session || !stats || stats->struct_size < sizeof(uint32_t)) return AC_ERROR_INVALID_ARGUMENT;
+
+    // Fill only what the caller's version of the struct has room for
+    const AudioSession::Stats& source = session->session.GetStats();
+    ac_session_stats current;
+    current.struct_size = sizeof(current);
+    current.packets = source.packets.load(std::memory_order_relaxed);
+    current.frames = source.frames.load(std::memory_order_relaxed);
+    current.delivered = source.delivered.load(std::memory_order_relaxed);
+    current.dropped = source.dropped.load(std::memory_order_relaxed);
+    current.elapsed_ns = source.elapsedNs.load(std::memory_order_relaxed);
+
+    const DeviceWatchdog::Telemetry& device = session->session.GetDeviceWatchdog().GetTelemetry();
+    current.device_losses = device.losses.load(std::memory_order_relaxed);
+    current.device_recoveries = device.recoveries.load(std::memory_order_relaxed);
+    current.max_recovery_ns = (uint64_t)device.maxRecoveryUs.load(std::memory_order_relaxed) * 1000;
+
+    size_t size = stats->struct_size < sizeof(current) ? stats->struct_size : sizeof(current);
+    memcpy(stats, &current, size);
+    stats->struct_size = (uint32_t)size;
+    return AC_OK;
+}
+
+}
@@ -0,0 +1,129 @@
+#ifndef AUDIO_CAPTURE_API_H
+#define AUDIO_CAPTURE_API_H
+
+/*
+ * C interface of the capture core (AudioCaptureApi library). Sessions are
+ * opaque handles; structs passed across the boundary start with their size
+ * so fields can be appended without breaking existing callers. Functions
+ * return AC_OK or a negative ac_result.
+ *
+ * A session has one source, optional sinks (WAV recording, shared-memory
+ * ring) and one packet callback. The callback receives read-only planar
+ * float views that point straight into the session's packet buffers; they
+ * are valid only until the callback returns. AC_DELIVERY_INLINE calls it on
+ * the session's pump thread (cheap consumers; it delays the next packet),
+ * AC_DELIVERY_CONSUMER_THREAD on a thread of its own behind a queue that
+ * drops packets, counting them, when the consumer falls behind.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(AUDIO_CAPTURE_API_EXPORTS)
+#    define AC_API __declspec(dllexport)
+#  else
+#    define AC_API __declspec(dllimport)
+#  endif
+#else
+#  define AC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AC_API_VERSION 1
+
+typedef enum ac_result {
+    AC_OK = 0,
+    AC_ERROR_INVALID_ARGUMENT = -1,
+    AC_ERROR_INVALID_STATE = -2,    /* e.g. configuring a started session */
+    AC_ERROR_UNSUPPORTED = -3,      /* format or source not available */
+    AC_ERROR_IO = -4,               /* file, trace or shared memory */
+    AC_ERROR_TIMEOUT = -5,
+    AC_ERROR_OUT_OF_MEMORY = -6
+} ac_result;
+
+typedef enum ac_delivery {
+    AC_DELIVERY_INLINE = 0,
+    AC_DELIVERY_CONSUMER_THREAD = 1
+} ac_delivery;
+
+/* ac_packet_view.flags */
+#define AC_PACKET_SILENT 1u
+#define AC_PACKET_DISCONTINUITY 2u
+#define AC_PACKET_TIMESTAMP_ERROR 4u
+#define AC_PACKET_REACQUIRED 8u         /* First packet after the device was re-acquired */
+
+typedef struct ac_packet_view {
+    uint32_t struct_size;
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t frames;
+    uint32_t flags;
+    uint64_t position;              /* Device frame position of the first frame */
+    uint64_t time_ns;               /* ac_get_time_ns() when the packet arrived */
+    const float* const* planes;     /* planes[channel][frame], read-only */
+} ac_packet_view;
+
+typedef void (*ac_packet_callback)(const ac_packet_view* packet, void* user);
+
+typedef struct ac_session_stats {
+    uint32_t struct_size;           /* Set by the caller */
+    uint64_t packets;               /* Delivered by the source */
+    uint64_t frames;
+    uint64_t delivered;             /* Callback invocations */
+    uint64_t dropped;               /* Consumer queue full or buffers exhausted */
+    uint64_t elapsed_ns;            /* Pump run time, once the source ended */
+    uint64_t device_losses;         /* Source device lost (error or stall) */
+    uint64_t device_recoveries;     /* ... and re-acquired */
+    uint64_t max_recovery_ns;       /* Longest loss-to-recovery time */
+} ac_session_stats;
+
+typedef struct ac_session ac_session;
+
+AC_API uint32_t ac_get_api_version(void);
+AC_API const char* ac_result_string(ac_result result);
+
+/* Clock shared by all processes on the machine, in nanoseconds */
+AC_API uint64_t ac_get_time_ns(void);
+
+AC_API ac_result ac_session_create(ac_session** session);
+
+/* Stops the session if needed; null is ignored */
+AC_API void ac_session_destroy(ac_session* session);
+
+/* Sources, while stopped. The tone runs until stopped; `realtime` paces
+ * packets like a capture device instead of producing them as fast as
+ * possible. A trace is a file written by AudioCaptureCpp --trace=PATH. */
+AC_API ac_result ac_session_set_source_tone(ac_session* session, uint32_t sample_rate, uint32_t channels,
+                                            double frequency, double level_db, uint32_t packet_frames,
+                                            int realtime);
+AC_API ac_result ac_session_set_source_trace(ac_session* session, const char* path, int realtime);
+
+/* Sinks, while stopped; null or empty turns them off. bits is 16 or 24. */
+AC_API ac_result ac_session_set_recording(ac_session* session, const char* wav_path, uint32_t bits);
+AC_API ac_result ac_session_set_shared_ring(ac_session* session, const char* name, uint32_t history_ms);
+
+/* Packet callback, while stopped; null turns delivery off. queue_packets is
+ * the consumer thread's backlog (ignored inline). The callback must not call
+ * into the session. */
+AC_API ac_result ac_session_set_callback(ac_session* session, ac_packet_callback callback, void* user,
+                                         ac_delivery delivery, uint32_t queue_packets);
+
+AC_API ac_result ac_session_start(ac_session* session);
+
+/* Stops the source, delivers what is queued and finalizes the sinks */
+AC_API ac_result ac_session_stop(ac_session* session);
+
+/* Waits for a finite source (trace) to end; AC_ERROR_TIMEOUT otherwise */
+AC_API ac_result ac_session_wait(ac_session* session, uint32_t timeout_ms);
+
+AC_API ac_result ac_session_get_stats(const ac_session* session, ac_session_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,468 @@
+#include "audio_session.h"
+#include <chrono>
+#include <cstring>
+#include "alloc_tracker.h"
+#include "thread_scheduling.h"
+#include "wave_format.h"
+
+namespace {
+
+// Same buffering as a live recording
+const size_t RECORD_POOL_BLOCKS = 40;
+const size_t RECORD_QUEUE_BLOCKS = 16;
+const uint32_t RECORD_MAX_GAP_SECONDS = 10;
+const size_t RECORD_MAX_GAPS = 10000;
+
+// View blocks beyond the consumer queue: one being filled, one being consumed
+const size_t SPARE_VIEW_BLOCKS = 4;
+
+// Tone packets before the pump counts as warmed up and must stop allocating
+const int PUMP_WARMUP_PACKETS = 10;
+
+// Consumer wait between checks for Stop(); packets wake it right away
+const uint32_t CONSUMER_WAIT_MS = 10;
+
+// Poll interval of the simulated device, as the capture loop's
+const uint32_t DEVICE_POLL_MS = 10;
+
+// Planes start on cache lines
+const size_t PLANE_ALIGN = 64;
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+int64_t GetTimeUs()
+{
+    return (int64_t)(GetSharedRingTime() / 1000);
+}
+
+}
+
+// Start of every view block, followed by the plane table and the planes
+struct AudioSession::BlockHeader
+{
+    PacketView view;
+};
+
+AudioSession::~AudioSession()
+{
+    Stop();
+}
+
+bool AudioSession::SetToneSource(uint32_t sampleRate, uint32_t channels, double frequency, double levelDb,
+                                 uint32_t packetFrames, bool realtime)
+{
+    if (IsStarted() || sampleRate == 0 || channels == 0 || packetFrames == 0) return false;
+
+    m_sourceType = ToneSource;
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_sampleType = SampleF32;
+    m_maxPacketFrames = packetFrames;
+    m_realtime = realtime;
+    m_toneFrequency = frequency;
+    m_toneLevelDb = levelDb;
+    return true;
+}
+
+bool AudioSession::SetSimulatedDeviceSource(uint32_t sampleRate, uint32_t channels, double frequency,
+                                            double levelDb, uint32_t packetFrames,
+                                            const std::vector<SyntheticDevice::Fault>& faults)
+{
+    if (!SetToneSource(sampleRate, channels, frequency, levelDb, packetFrames, true)) return false;
+    m_sourceType = DeviceSource;
+    m_faults = faults;
+    return true;
+}
+
+bool AudioSession::SetTraceSource(const std::string& path, bool realtime)
+{
+    if (IsStarted() || !m_trace.Open(path.c_str())) return false;
+
+    const TraceFormat& format = m_trace.GetFormat();
+    SampleType type = GetSampleType(format.isFloat, format.bitsPerSample);
+    if (type == SampleUnknown || format.channels == 0 || format.bufferFrames == 0) {
+        m_sourceType = NoSource;
+        return false;
+    }
+
+    m_sourceType = TraceSource;
+    m_sampleRate = format.sampleRate;
+    m_channels = format.channels;
+    m_sampleType = type;
+    m_maxPacketFrames = format.bufferFrames;
+    m_realtime = realtime;
+    return true;
+}
+
+bool AudioSession::SetRecording(const std::string& path, uint16_t bits)
+{
+    if (IsStarted() || (bits != 16 && bits != 24)) return false;
+    m_recordPath = path;
+    m_recordBits = bits;
+    return true;
+}
+
+bool AudioSession::SetSharedRing(const std::string& name, uint32_t historyMs)
+{
+    if (IsStarted() || (!name.empty() && historyMs == 0)) return false;
+    m_ringName = name;
+    m_ringHistoryMs = historyMs;
+    return true;
+}
+
+void AudioSession::SetCallback(PacketCallback callback, void* user, Delivery delivery, size_t queuePackets)
+{
+    if (IsStarted()) return;
+    m_callback = callback;
+    m_user = user;
+    m_delivery = delivery;
+    m_queuePackets = queuePackets > 0 ? queuePackets : 1;
+}
+
+bool AudioSession::Start()
+{
+    if (IsStarted() || m_sourceType == NoSource) return false;
+
+    m_kernels = GetPacketKernels(m_sampleType, m_channels);
+    if (!m_kernels) return false;
+
+    // View blocks: header, plane table, then one aligned plane per channel
+    if (m_callback) {
+        size_t planeStride = AlignUp((size_t)m_maxPacketFrames * sizeof(float), PLANE_ALIGN);
+        m_viewHeaderSize = AlignUp(sizeof(BlockHeader) + m_channels * sizeof(float*), PLANE_ALIGN);
+        size_t blocks = (m_delivery == ConsumerThread ? m_queuePackets : 0) + SPARE_VIEW_BLOCKS;
+        if (!m_viewPool.Configure(m_viewHeaderSize + planeStride * m_channels, blocks)) return false;
+    }
+
+    if (!m_recordPath.empty()) {
+        if (!m_pipeline.Configure(m_sampleRate, (uint16_t)m_channels, m_sampleType, m_recordBits,
+                                  m_maxPacketFrames, RECORD_POOL_BLOCKS)) {
+            return false;
+        }
+        // Replace rather than truncate a previous recording: on ext4 truncating
+        // a file that was just written first flushes its data to disk, which
+        // added tens of milliseconds to every restart
+        remove(m_recordPath.c_str());
+        m_recordFile = fopen(m_recordPath.c_str(), "w+b");
+        if (!m_recordFile) return false;
+
+        // The header is rewritten with the final size when the session stops
+        uint8_t header[WAVE_HEADER_SIZE];
+        BuildWaveHeader(header, m_sampleRate, (uint16_t)m_channels, m_recordBits, 0);
+        m_recordWriter.SetPreamble(header, sizeof(header));
+        m_recordWriter.SetQueueDepth(RECORD_QUEUE_BLOCKS);
+        m_recordWriter.SetPolicy(BatchedWriter::FillSilence);   // Overflow keeps the file's length, never waits
+        m_recordOutput.SetFile(m_recordFile);
+        if (!m_recordWriter.Start(&m_recordOutput, &m_pipeline.GetPool(), "session writer")) {
+            fclose(m_recordFile);
+            m_recordFile = nullptr;
+            return false;
+        }
+        m_pipeline.Begin(&m_recordWriter, nullptr, RECORD_MAX_GAP_SECONDS, RECORD_MAX_GAPS);
+    }
+
+    if (!m_ringName.empty()) {
+        uint32_t capacityFrames = (uint32_t)((uint64_t)m_sampleRate * m_ringHistoryMs / 1000);
+        if (!m_ring.Create(m_ringName, m_sampleRate, m_channels, capacityFrames)) {
+            FinishRecording();
+            return false;
+        }
+        m_interleaved.assign((size_t)m_maxPacketFrames * m_channels, 0.0f);
+    }
+
+    m_stats.packets = 0;
+    m_stats.frames = 0;
+    m_stats.delivered = 0;
+    m_stats.dropped = 0;
+    m_stats.elapsedNs = 0;
+    m_stats.recordedFrames = 0;
+    m_watchdog.ResetTelemetry();
+    m_stopping = false;
+    m_pumpDone = false;
+
+    if (m_callback && m_delivery == ConsumerThread) {
+        size_t size = 1;
+        while (size < m_queuePackets) size <<= 1;
+        m_queue.assign(size, nullptr);
+        m_queueMask = size - 1;
+        m_head = 0;
+        m_tail = 0;
+        m_consumerStop = false;
+        m_consumer = std::make_unique<std::thread>(&AudioSession::ConsumerLoop, this);
+    }
+
+    m_pump = std::make_unique<std::thread>(&AudioSession::PumpThread, this);
+    return true;
+}
+
+void AudioSession::Stop()
+{
+    if (!IsStarted()) return;
+
+    m_stopping = true;
+    m_pump->join();
+    m_pump.reset();
+
+    // The consumer delivers everything queued before it exits
+    if (m_consumer) {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_consumerStop = true;
+        }
+        m_wake.notify_one();
+        m_consumer->join();
+        m_consumer.reset();
+    }
+
+    FinishRecording();
+    m_ring.Close();
+}
+
+bool AudioSession::WaitForEnd(uint32_t timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_endMutex);
+    return m_ended.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this]() {
+        return m_pumpDone.load(std::memory_order_acquire);
+    });
+}
+
+void AudioSession::FinishRecording()
+{
+    if (!m_recordFile) return;
+
+    m_pipeline.End();
+    m_recordWriter.Stop();
+
+    uint64_t dataBytes = m_recordWriter.GetStats().bytesWritten.load() - WAVE_HEADER_SIZE;
+    m_stats.recordedFrames = dataBytes / m_pipeline.GetBlockAlign();
+    uint8_t header[WAVE_HEADER_SIZE];
+    BuildWaveHeader(header, m_sampleRate, (uint16_t)m_channels, m_recordBits,
+        GetWaveDataSize(dataBytes, WAVE_HEADER_SIZE));
+    fseek(m_recordFile, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), m_recordFile);
+    fclose(m_recordFile);
+    m_recordFile = nullptr;
+}
+
+void AudioSession::PumpThread()
+{
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Capture);
+    const auto start = std::chrono::steady_clock::now();
+
+    if (m_sourceType == ToneSource) {
+        SyntheticSource source(m_sampleRate, m_channels);
+        source.AddSine(m_toneFrequency, m_toneLevelDb, 1.0);
+        source.SetLooping(true);
+
+        std::vector<float> packet((size_t)m_maxPacketFrames * m_channels);
+        const auto period = std::chrono::nanoseconds((int64_t)m_maxPacketFrames * 1000000000 / m_sampleRate);
+        auto next = start;
+        uint64_t position = 0;
+        int iterations = 0;
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            source.Read(packet.data(), m_maxPacketFrames);
+
+            PacketInfo info;
+            info.devicePosition = position;
+            info.timestamp = GetSharedRingTime() / 100;
+            info.frames = m_maxPacketFrames;
+            OnPacket((const uint8_t*)packet.data(), info);
+            position += m_maxPacketFrames;
+
+            // Past warm-up the pump must not touch the heap
+            if (++iterations == PUMP_WARMUP_PACKETS) {
+                AllocTracker::ArmCurrentThread("session pump");
+            }
+            if (m_realtime) {
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+        }
+    } else if (m_sourceType == DeviceSource) {
+        PumpSimulatedDevice();
+    } else if (m_sourceType == TraceSource) {
+        m_trace.Run(m_realtime ? TraceReplay::OriginalTiming : TraceReplay::AsFastAsPossible,
+            [this](const uint8_t* data, const PacketInfo& packet) { OnPacket(data, packet); }, &m_stopping);
+    }
+
+    AllocTracker::DisarmCurrentThread();
+    m_stats.elapsedNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    {
+        std::lock_guard<std::mutex> lock(m_endMutex);
+        m_pumpDone = true;
+    }
+    m_ended.notify_all();
+    ThreadScheduling::RestoreCurrentThread(scheduling);
+}
+
+void AudioSession::PumpSimulatedDevice()
+{
+    SyntheticDevice device(m_sampleRate, m_channels, m_maxPacketFrames);
+    device.GetSource().AddSine(m_toneFrequency, m_toneLevelDb, 1.0);
+    for (const SyntheticDevice::Fault& fault : m_faults) {
+        device.AddFault(fault);
+    }
+
+    std::vector<float> packet((size_t)m_maxPacketFrames * m_channels);
+    int64_t now = GetTimeUs();
+    device.Start(now);
+    m_watchdog.Start(now);
+    bool reacquired = false;
+    int iterations = 0;
+
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(DEVICE_POLL_MS));
+        now = GetTimeUs();
+
+        // Past warm-up the pump must not touch the heap
+        if (++iterations == PUMP_WARMUP_PACKETS) {
+            AllocTracker::ArmCurrentThread("session pump");
+        }
+
+        if (m_watchdog.IsLost()) {
+            if (m_watchdog.IsRetryDue(now)) {
+                if (device.Reacquire(now)) {
+                    m_watchdog.OnRecovered(now);
+                    reacquired = true;
+                } else {
+                    m_watchdog.OnRetryFailed(now);
+                }
+            }
+            continue;
+        }
+
+        PacketInfo info;
+        SyntheticDevice::ReadResult result;
+        while ((result = device.Read(now, packet.data(), info)) == SyntheticDevice::Packet) {
+            if (reacquired) {
+                info.flags |= PacketInfo::Reacquired;
+                reacquired = false;
+            }
+            m_watchdog.OnPacket(now);
+            OnPacket((const uint8_t*)packet.data(), info);
+        }
+
+        if (result == SyntheticDevice::DeviceLost) {
+            m_watchdog.OnError(now, true);
+        } else if (m_watchdog.IsStalled(now)) {
+            m_watchdog.OnLost(now, DeviceWatchdog::Stalled);
+        }
+    }
+}
+
+void AudioSession::OnPacket(const uint8_t* data, const PacketInfo& packet)
+{
+    m_stats.packets.fetch_add(1, std::memory_order_relaxed);
+    m_stats.frames.fetch_add(packet.frames, std::memory_order_relaxed);
+
+    if (m_recordFile) {
+        m_pipeline.Record(data, packet);
+    }
+    if (packet.frames > m_maxPacketFrames) {
+        m_stats.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    bool silent = !data || (packet.flags & PacketInfo::Silent);
+
+    if (m_ring.IsOpen()) {
+        if (packet.flags & (PacketInfo::Discontinuity | PacketInfo::Reacquired)) {
+            m_ring.MarkDiscontinuity();
+        }
+        if (silent) {
+            m_ring.Publish(nullptr, packet.frames);
+        } else if (m_sampleType == SampleF32) {
+            m_ring.Publish((const float*)data, packet.frames);
+        } else {
+            m_kernels->toFloat(data, packet.frames, m_channels, m_interleaved.data());
+            m_ring.Publish(m_interleaved.data(), packet.frames);
+        }
+    }
+
+    if (!m_callback) return;
+
+    uint8_t* block = m_viewPool.Acquire();
+    if (!block) {
+        m_stats.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    BlockHeader* header = (BlockHeader*)block;
+    float** planes = (float**)(block + sizeof(BlockHeader));
+    if (silent) {
+        // Every plane reads the pool's zero block; nothing to convert
+        for (uint32_t c = 0; c < m_channels; c++) planes[c] = (float*)m_viewPool.GetSilence();
+    } else {
+        size_t planeStride = AlignUp((size_t)m_maxPacketFrames * sizeof(float), PLANE_ALIGN);
+        for (uint32_t c = 0; c < m_channels; c++) {
+            planes[c] = (float*)(block + m_viewHeaderSize + c * planeStride);
+        }
+        m_kernels->toPlanar(data, packet.frames, m_channels, planes);
+    }
+
+    header->view.sampleRate = m_sampleRate;
+    header->view.channels = m_channels;
+    header->view.frames = packet.frames;
+    header->view.flags = packet.flags;
+    header->view.position = packet.devicePosition;
+    header->view.time = GetSharedRingTime();
+    header->view.planes = planes;
+    Deliver(block);
+}
+
+void AudioSession::Deliver(uint8_t* block)
+{
+    if (m_delivery == Inline) {
+        m_callback(((const BlockHeader*)block)->view, m_user);
+        m_stats.delivered.fetch_add(1, std::memory_order_relaxed);
+        m_viewPool.Release(block);
+        return;
+    }
+
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) >= m_queuePackets) {
+        m_stats.dropped.fetch_add(1, std::memory_order_relaxed);
+        m_viewPool.Release(block);
+        return;
+    }
+    m_queue[tail & m_queueMask] = block;
+    {
+        // Publishing under the mutex keeps the consumer from missing the wake-up
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_tail.store(tail + 1, std::memory_order_release);
+    }
+    m_wake.notify_one();
+}
+
+void AudioSession::ConsumerLoop()
+{
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Writer);
+
+    for (;;) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(CONSUMER_WAIT_MS), [this, head]() {
+                return m_consumerStop.load(std::memory_order_relaxed) ||
+                       m_tail.load(std::memory_order_acquire) != head;
+            });
+            stop = m_consumerStop.load(std::memory_order_relaxed);
+        }
+
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            uint8_t* block = m_queue[head & m_queueMask];
+            m_callback(((const BlockHeader*)block)->view, m_user);
+            m_stats.delivered.fetch_add(1, std::memory_order_relaxed);
+            m_viewPool.Release(block);
+            m_head.store(head + 1, std::memory_order_release);
+        }
+        if (stop && tail == m_tail.load(std::memory_order_acquire)) break;
+    }
+
+    ThreadScheduling::RestoreCurrentThread(scheduling);
+}
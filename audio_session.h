@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "batched_writer.h"
+#include "block_pool.h"
+#include "device_watchdog.h"
+#include "recording_pipeline.h"
+#include "shared_ring.h"
+#include "stream_output.h"
+#include "synthetic_device.h"
+#include "synthetic_source.h"
+#include "trace_replay.h"
+
+// Read-only planar view of one packet. The planes point into a pool block
+// (or the pool's silence block) that stays valid until the callback returns.
+struct PacketView
+{
+    uint32_t sampleRate = 0;
+    uint32_t channels = 0;
+    uint32_t frames = 0;
+    uint32_t flags = 0;              // PacketInfo::Flags
+    uint64_t position = 0;           // Device frame position of the first frame
+    uint64_t time = 0;               // GetSharedRingTime() when the packet arrived
+    const float* const* planes = nullptr;
+};
+
+// Embeddable capture session: one source, optional sinks (recording to a
+// WAV file, shared-memory ring) and one packet callback, driven by a pump
+// thread. Each packet is converted once into a pool block as planar float;
+// the callback gets a view straight into that block. Inline delivery calls
+// it on the pump (for cheap consumers: it delays the next packet); the
+// consumer thread delivery hands the block over through a queue without
+// copying and drops packets, counting them, when the consumer falls behind.
+// Configure and start/stop from one thread; the callback must not call back
+// into the session.
+class AudioSession
+{
+public:
+    enum Delivery {
+        Inline,
+        ConsumerThread
+    };
+
+    using PacketCallback = void (*)(const PacketView& packet, void* user);
+
+    // Counters, readable from any thread
+    struct Stats
+    {
+        std::atomic<uint64_t> packets{ 0 };        // From the source
+        std::atomic<uint64_t> frames{ 0 };
+        std::atomic<uint64_t> delivered{ 0 };      // Callback invocations
+        std::atomic<uint64_t> dropped{ 0 };        // Consumer queue full or pool empty
+        std::atomic<uint64_t> elapsedNs{ 0 };      // Pump run time, set when the source ends
+        std::atomic<uint64_t> recordedFrames{ 0 }; // In the recording, set when it is finished
+    };
+
+    AudioSession() = default;
+    ~AudioSession();
+
+    AudioSession(const AudioSession&) = delete;
+    AudioSession& operator=(const AudioSession&) = delete;
+
+    // Sources (one at a time, while stopped). A tone source runs forever;
+    // `realtime` paces packets like a device instead of as fast as possible.
+    bool SetToneSource(uint32_t sampleRate, uint32_t channels, double frequency, double levelDb,
+                       uint32_t packetFrames, bool realtime);
+    bool SetTraceSource(const std::string& path, bool realtime);
+
+    // Tone from a simulated device that fails as scheduled; the pump detects
+    // the losses and re-acquires the device like the capture loop does (see
+    // GetDeviceWatchdog), recordings continue with the outage filled. Always
+    // paced in real time.
+    bool SetSimulatedDeviceSource(uint32_t sampleRate, uint32_t channels, double frequency, double levelDb,
+                                  uint32_t packetFrames, const std::vector<SyntheticDevice::Fault>& faults);
+
+    // Sinks; an empty path or name turns the sink off
+    bool SetRecording(const std::string& path, uint16_t bits);
+    bool SetSharedRing(const std::string& name, uint32_t historyMs);
+
+    // Callback for every packet; null turns delivery off. queuePackets is
+    // the consumer thread's backlog before packets are dropped.
+    void SetCallback(PacketCallback callback, void* user, Delivery delivery, size_t queuePackets);
+
+    bool Start();
+
+    // Stop the source, deliver what is queued and finalize the sinks
+    void Stop();
+
+    // True from Start() until Stop(), even after a finite source ended
+    bool IsStarted() const { return m_pump != nullptr; }
+
+    // Wait until the source ended (trace fully replayed) or the timeout
+    // passes; true if it ended
+    bool WaitForEnd(uint32_t timeoutMs);
+
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint32_t GetChannels() const { return m_channels; }
+    const Stats& GetStats() const { return m_stats; }
+
+    // Loss detection and recovery of the simulated device; configure while
+    // stopped, telemetry readable any time
+    DeviceWatchdog& GetDeviceWatchdog() { return m_watchdog; }
+    const DeviceWatchdog& GetDeviceWatchdog() const { return m_watchdog; }
+
+    // Placement of the last recording (gaps, re-acquisitions), once stopped
+    const PacketTimeline& GetRecordingTimeline() const { return m_pipeline.GetTimeline(); }
+
+private:
+    enum SourceType { NoSource, ToneSource, TraceSource, DeviceSource };
+
+    struct BlockHeader;
+
+    void PumpThread();
+    void PumpSimulatedDevice();
+    void ConsumerLoop();
+    void OnPacket(const uint8_t* data, const PacketInfo& packet);
+    void Deliver(uint8_t* block);
+    void FinishRecording();
+
+    // Source
+    SourceType m_sourceType = NoSource;
+    uint32_t m_sampleRate = 0;
+    uint32_t m_channels = 0;
+    SampleType m_sampleType = SampleUnknown;
+    uint32_t m_maxPacketFrames = 0;
+    bool m_realtime = false;
+    double m_toneFrequency = 0.0;
+    double m_toneLevelDb = 0.0;
+    std::vector<SyntheticDevice::Fault> m_faults;
+    DeviceWatchdog m_watchdog;
+    TraceReplay m_trace;
+    const PacketKernels* m_kernels = nullptr;
+
+    // Sinks
+    std::string m_recordPath;
+    uint16_t m_recordBits = 16;
+    FILE* m_recordFile = nullptr;
+    StdioOutput m_recordOutput;
+    BatchedWriter m_recordWriter;
+    RecordingPipeline m_pipeline;
+
+    std::string m_ringName;
+    uint32_t m_ringHistoryMs = 0;
+    SharedRingPublisher m_ring;
+    std::vector<float> m_interleaved;   // Ring input
+
+    // Delivery: planar packet blocks, handed to the consumer without copying
+    PacketCallback m_callback = nullptr;
+    void* m_user = nullptr;
+    Delivery m_delivery = Inline;
+    size_t m_queuePackets = 0;
+    BlockPool m_viewPool;
+    size_t m_viewHeaderSize = 0;
+
+    std::vector<uint8_t*> m_queue;      // Single producer (pump), single consumer
+    size_t m_queueMask = 0;
+    std::atomic<size_t> m_head{ 0 };
+    std::atomic<size_t> m_tail{ 0 };
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::unique_ptr<std::thread> m_consumer;
+
+    // Pump
+    std::unique_ptr<std::thread> m_pump;
+    std::atomic<bool> m_stopping{ false };
+    std::atomic<bool> m_pumpDone{ false };
+    std::atomic<bool> m_consumerStop{ false };
+    std::mutex m_endMutex;
+    std::condition_variable m_ended;
+    Stats m_stats;
+};
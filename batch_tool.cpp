@@ -0,0 +1,461 @@
+// AudioBatch: processes many recordings in parallel.
+//
+//   AudioBatch [--threads=N] [--loudness] [--normalize=LUFS] [--out=DIR]
+//              [--peaks] [--bits=8|16] recording_1.wav ...
+//   AudioBatch --ebu-check
+//
+// Files are memory mapped and spread over a work-stealing pool. Loudness is
+// measured per file (gating needs the whole programme); normalization and
+// peak building are split into fixed-size chunks, so a single long file
+// still keeps every core busy. With no operation given, --loudness is used.
+// --ebu-check measures the EBU Tech 3341 (1-5) and Tech 3342 (101-104)
+// reference signals at 48 and 44.1 kHz, as float and as 16-bit PCM, and
+// exits with 1 if a result is outside the tolerance the specs allow.
+
+#include "dsp_nodes.h"
+#include "loudness_meter.h"
+#include "mapped_file.h"
+#include "peak_file.h"
+#include "synthetic_source.h"
+#include "task_pool.h"
+#include "wave_format.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Frames per chunk task; a multiple of the coarse peak level
+const uint64_t CHUNK_FRAMES = (uint64_t)PEAK_COARSE_FRAMES * 256;
+
+// Frames handed to the loudness meter / DSP chain at a time
+const size_t SLICE_FRAMES = 8192;
+
+// Quieter programmes are not normalized (gain would only raise noise)
+const double MIN_NORMALIZE_LUFS = -70.0;
+
+// Expected results of the EBU reference signals (SyntheticSource::LoadEbuTest).
+// Tech 3341 specifies the integrated loudness of tests 1-5, Tech 3342 the
+// loudness range of 101-104; NAN where the spec gives nothing. Every signal
+// is a 1 kHz sine, so its true peak is the level of its loudest step.
+struct EbuCase
+{
+    int test;
+    double integrated;
+    double loudnessRange;
+    double truePeak;
+};
+
+const EbuCase EBU_CASES[] = {
+    { 1, -23.0, NAN, -23.0 },
+    { 2, -33.0, NAN, -33.0 },
+    { 3, -23.0, NAN, -23.0 },
+    { 4, -23.0, NAN, -23.0 },
+    { 5, -23.0, NAN, -20.0 },
+    { 101, NAN, 10.0, -20.0 },
+    { 102, NAN, 5.0, -15.0 },
+    { 103, NAN, 20.0, -20.0 },
+    { 104, NAN, 15.0, -20.0 },
+};
+
+const uint32_t EBU_SAMPLE_RATES[] = { 48000, 44100 };
+const uint32_t EBU_CHANNELS = 2;
+
+// Tolerances of Tech 3341 (integrated, true peak) and Tech 3342 (range)
+const double EBU_INTEGRATED_TOLERANCE = 0.1;
+const double EBU_RANGE_TOLERANCE = 1.0;
+const double EBU_TRUE_PEAK_OVER = 0.2;
+const double EBU_TRUE_PEAK_UNDER = 0.4;
+
+struct Options
+{
+    unsigned threads = 0;
+    bool loudness = false;
+    bool normalize = false;
+    double targetLufs = -23.0;
+    std::string outDir;
+    bool peaks = false;
+    int peakBits = 16;
+};
+
+struct Summary
+{
+    std::atomic<uint64_t> files{ 0 };
+    std::atomic<uint64_t> failures{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+    std::mutex printMutex;
+};
+
+struct FileJob
+{
+    std::string path;
+    MappedFile input;
+    WaveInfo info;
+    uint64_t dataSize = 0;
+    uint64_t frames = 0;
+
+    double integrated = -HUGE_VAL;
+    double loudnessRange = 0.0;
+    double truePeak = -HUGE_VAL;
+
+    bool normalizing = false;
+    double gainDb = 0.0;
+    std::string outputPath;
+
+    std::vector<int16_t> peaks;           // Fine level, filled by the chunk tasks
+    std::atomic<uint64_t> remainingChunks{ 0 };
+    std::atomic<bool> failed{ false };
+    std::string error;
+};
+
+const Options* g_options = nullptr;
+Summary g_summary;
+
+std::string GetOutputPath(const std::string& path)
+{
+    if (g_options->outDir.empty()) {
+        size_t dot = path.rfind('.');
+        size_t slash = path.find_last_of("/\\");
+        std::string stem = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? path.substr(0, dot) : path;
+        return stem + ".norm.wav";
+    }
+
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return g_options->outDir + "/" + name;
+}
+
+const int16_t* GetSamples(const FileJob& job, uint64_t frame)
+{
+    return (const int16_t*)(job.input.GetData() + job.info.dataOffset + frame * job.info.blockAlign);
+}
+
+void Fail(FileJob& job, const char* error)
+{
+    bool expected = false;
+    if (job.failed.compare_exchange_strong(expected, true)) {
+        job.error = error;
+    }
+}
+
+// Runs once every chunk of the file is done
+void FinishFile(FileJob& job)
+{
+    if (!job.failed && g_options->peaks) {
+        PeakFileWriter writer;
+        std::string peakPath = job.path + ".peaks";
+        if (!writer.Open(fopen(peakPath.c_str(), "w+b"), job.info.channels, job.info.sampleRate, g_options->peakBits)) {
+            Fail(job, "cannot create peak file");
+        } else {
+            writer.AddPeaks(job.peaks.data(), job.peaks.size() / (job.info.channels * 2), job.frames);
+            if (!writer.Finish(job.dataSize, job.input.GetSize())) {
+                Fail(job, "cannot write peak file");
+            }
+        }
+    }
+
+    char line[512];
+    if (job.failed) {
+        snprintf(line, sizeof(line), "%s: %s", job.path.c_str(), job.error.c_str());
+        g_summary.failures.fetch_add(1);
+    } else {
+        int length = snprintf(line, sizeof(line), "%s:", job.path.c_str());
+        if (g_options->loudness || g_options->normalize) {
+            length += snprintf(line + length, sizeof(line) - length, " %.1f LUFS, LRA %.1f LU, %.1f dBTP",
+                job.integrated, job.loudnessRange, job.truePeak);
+        }
+        if (job.normalizing) {
+            length += snprintf(line + length, sizeof(line) - length, ", %+.1f dB -> %s%s", job.gainDb,
+                job.outputPath.c_str(), job.truePeak + job.gainDb > 0.0 ? " (clipped)" : "");
+        } else if (g_options->normalize) {
+            length += snprintf(line + length, sizeof(line) - length, ", too quiet to normalize");
+        }
+        if (g_options->peaks) {
+            snprintf(line + length, sizeof(line) - length, ", peaks written");
+        }
+        g_summary.bytes.fetch_add(job.dataSize);
+    }
+    g_summary.files.fetch_add(1);
+
+    job.input.Close();
+
+    std::lock_guard<std::mutex> lock(g_summary.printMutex);
+    fprintf(job.failed ? stderr : stdout, "%s\n", line);
+}
+
+void ProcessChunk(FileJob& job, uint64_t chunk)
+{
+    const uint64_t first = chunk * CHUNK_FRAMES;
+    const size_t frames = (size_t)(job.frames - first < CHUNK_FRAMES ? job.frames - first : CHUNK_FRAMES);
+    const uint16_t channels = job.info.channels;
+
+    // WAV data chunks are 16-bit aligned unless a foreign writer misplaced
+    // them; copy in that case
+    const int16_t* samples = GetSamples(job, first);
+    std::vector<int16_t> aligned;
+    if (((uintptr_t)samples & 1) != 0) {
+        aligned.resize((size_t)frames * channels);
+        memcpy(aligned.data(), samples, aligned.size() * sizeof(int16_t));
+        samples = aligned.data();
+    }
+    job.input.Prefetch(job.info.dataOffset + first * job.info.blockAlign, (uint64_t)frames * job.info.blockAlign);
+
+    if (g_options->peaks && !job.failed) {
+        ComputePeaks(samples, frames, channels, PEAK_FINE_FRAMES,
+            job.peaks.data() + (size_t)(first / PEAK_FINE_FRAMES) * channels * 2);
+    }
+
+    if (job.normalizing && !job.failed) {
+        // Gain starts at its target, so chunks join without a ramp
+        DspChain chain;
+        GainStage& gain = chain.Add(std::make_unique<StageNode<GainStage>>())->Get<GainStage>();
+        gain.SetGainDb((float)job.gainDb);
+        chain.Prepare(job.info.sampleRate, channels, SLICE_FRAMES);
+
+        std::vector<int16_t> output((size_t)frames * channels);
+        for (size_t done = 0; done < frames; done += SLICE_FRAMES) {
+            size_t count = frames - done < SLICE_FRAMES ? frames - done : SLICE_FRAMES;
+            chain.ProcessS16(samples + done * channels, output.data() + done * channels, count);
+        }
+
+        FILE* file = fopen(job.outputPath.c_str(), "r+b");
+        bool ok = file != nullptr;
+#ifdef _WIN32
+        ok = ok && _fseeki64(file, (long long)(WAVE_HEADER_SIZE + first * job.info.blockAlign), SEEK_SET) == 0;
+#else
+        ok = ok && fseeko(file, (off_t)(WAVE_HEADER_SIZE + first * job.info.blockAlign), SEEK_SET) == 0;
+#endif
+        ok = ok && fwrite(output.data(), job.info.blockAlign, frames, file) == frames;
+        if (file && fclose(file) != 0) ok = false;
+        if (!ok) Fail(job, "cannot write output");
+    }
+}
+
+void ProcessFile(TaskPool& pool, std::shared_ptr<FileJob> job)
+{
+    if (!job->input.Open(job->path.c_str())) {
+        Fail(*job, "cannot open");
+        FinishFile(*job);
+        return;
+    }
+
+    const uint64_t fileSize = job->input.GetSize();
+    WaveInfo& info = job->info;
+    if (!ParseWaveHeader(job->input.GetData(), (size_t)fileSize, info)) {
+        Fail(*job, "not a WAV file");
+        FinishFile(*job);
+        return;
+    }
+    if (info.formatTag != 1 || info.bitsPerSample != 16 || info.blockAlign != info.channels * 2) {
+        Fail(*job, "only 16-bit PCM is supported");
+        FinishFile(*job);
+        return;
+    }
+
+    job->dataSize = info.dataSize;
+    if (job->dataSize == WAVE_SIZE_UNKNOWN || info.dataOffset + job->dataSize > fileSize) {
+        job->dataSize = fileSize - info.dataOffset;
+    }
+    job->frames = job->dataSize / info.blockAlign;
+    job->dataSize = job->frames * info.blockAlign;
+
+    // Loudness gating needs the whole file in order
+    if (g_options->loudness || g_options->normalize) {
+        LoudnessMeter meter;
+        if (!meter.Configure(info.sampleRate, info.channels)) {
+            Fail(*job, "unsupported channel count for loudness");
+            FinishFile(*job);
+            return;
+        }
+        job->input.Prefetch(info.dataOffset, job->dataSize);
+        for (uint64_t done = 0; done < job->frames; done += SLICE_FRAMES) {
+            size_t count = (size_t)(job->frames - done < SLICE_FRAMES ? job->frames - done : SLICE_FRAMES);
+            meter.ProcessS16(GetSamples(*job, done), count);
+        }
+        job->integrated = meter.GetIntegrated();
+        job->loudnessRange = meter.GetLoudnessRange();
+        job->truePeak = meter.GetTruePeak();
+    }
+
+    if (g_options->normalize && job->integrated > MIN_NORMALIZE_LUFS) {
+        if (job->dataSize > 0xFFFFFFFFull - WAVE_HEADER_SIZE) {
+            Fail(*job, "too large to normalize into a WAV file");
+            FinishFile(*job);
+            return;
+        }
+
+        job->normalizing = true;
+        job->gainDb = g_options->targetLufs - job->integrated;
+        job->outputPath = GetOutputPath(job->path);
+
+        // Create the output at full size so chunks can be written in any order
+        uint8_t header[WAVE_HEADER_SIZE];
+        BuildWaveHeader(header, info.sampleRate, info.channels, 16, (uint32_t)job->dataSize);
+        FILE* file = fopen(job->outputPath.c_str(), "wb");
+        bool ok = file && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+        if (ok && job->dataSize > 0) {
+            const uint8_t zero = 0;
+#ifdef _WIN32
+            ok = _fseeki64(file, (long long)(WAVE_HEADER_SIZE + job->dataSize - 1), SEEK_SET) == 0;
+#else
+            ok = fseeko(file, (off_t)(WAVE_HEADER_SIZE + job->dataSize - 1), SEEK_SET) == 0;
+#endif
+            ok = ok && fwrite(&zero, 1, 1, file) == 1;
+        }
+        if (file && fclose(file) != 0) ok = false;
+        if (!ok) {
+            Fail(*job, "cannot create output");
+            FinishFile(*job);
+            return;
+        }
+    }
+
+    if (g_options->peaks) {
+        job->peaks.resize((size_t)((job->frames + PEAK_FINE_FRAMES - 1) / PEAK_FINE_FRAMES) * info.channels * 2);
+    }
+
+    uint64_t chunkCount = (job->normalizing || g_options->peaks) ? (job->frames + CHUNK_FRAMES - 1) / CHUNK_FRAMES : 0;
+    if (chunkCount == 0) {
+        FinishFile(*job);
+        return;
+    }
+
+    // Chunks land on this worker's deque; idle workers steal them
+    job->remainingChunks = chunkCount;
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        pool.Submit([job, chunk]() {
+            ProcessChunk(*job, chunk);
+            if (job->remainingChunks.fetch_sub(1) == 1) {
+                FinishFile(*job);
+            }
+        });
+    }
+}
+
+// Feed every reference signal to a float and a 16-bit meter and compare
+// the results with the spec; returns the exit code
+int RunEbuCheck()
+{
+    int failures = 0;
+    std::vector<float> samples(SLICE_FRAMES * EBU_CHANNELS);
+    std::vector<int16_t> pcm(SLICE_FRAMES * EBU_CHANNELS);
+
+    printf("Test    Rate  Input  Integrated     LRA   True peak\n");
+    for (uint32_t sampleRate : EBU_SAMPLE_RATES) {
+        for (const EbuCase& ebu : EBU_CASES) {
+            SyntheticSource source(sampleRate, EBU_CHANNELS);
+            LoudnessMeter floatMeter, pcmMeter;
+            if (!source.LoadEbuTest(ebu.test) || !floatMeter.Configure(sampleRate, EBU_CHANNELS) ||
+                !pcmMeter.Configure(sampleRate, EBU_CHANNELS)) {
+                fprintf(stderr, "Cannot set up EBU test %d at %u Hz\n", ebu.test, sampleRate);
+                return 1;
+            }
+
+            size_t count;
+            while ((count = source.Read(samples.data(), SLICE_FRAMES)) > 0) {
+                floatMeter.Process(samples.data(), count);
+                for (size_t i = 0; i < count * EBU_CHANNELS; i++) {
+                    pcm[i] = (int16_t)lrintf(std::clamp(samples[i] * 32768.0f, -32768.0f, 32767.0f));
+                }
+                pcmMeter.ProcessS16(pcm.data(), count);
+            }
+
+            const LoudnessMeter* meters[] = { &floatMeter, &pcmMeter };
+            const char* inputs[] = { "f32", "s16" };
+            for (int m = 0; m < 2; m++) {
+                double integrated = meters[m]->GetIntegrated();
+                double range = meters[m]->GetLoudnessRange();
+                double truePeak = meters[m]->GetTruePeak();
+
+                bool ok = truePeak <= ebu.truePeak + EBU_TRUE_PEAK_OVER && truePeak >= ebu.truePeak - EBU_TRUE_PEAK_UNDER;
+                if (!std::isnan(ebu.integrated)) ok = ok && fabs(integrated - ebu.integrated) <= EBU_INTEGRATED_TOLERANCE;
+                if (!std::isnan(ebu.loudnessRange)) ok = ok && fabs(range - ebu.loudnessRange) <= EBU_RANGE_TOLERANCE;
+                if (!ok) failures++;
+
+                printf("%4d  %6u  %s  %7.2f LUFS  %5.2f LU  %6.2f dBTP  %s\n", ebu.test, sampleRate, inputs[m],
+                    integrated, range, truePeak, ok ? "ok" : "FAIL");
+            }
+        }
+    }
+
+    if (failures > 0) {
+        printf("%d results outside the EBU tolerances\n", failures);
+        return 1;
+    }
+    printf("All EBU Tech 3341/3342 results within tolerance\n");
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--ebu-check") == 0) {
+            return RunEbuCheck();
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            options.threads = (unsigned)atoi(arg + 10);
+        } else if (strcmp(arg, "--loudness") == 0) {
+            options.loudness = true;
+        } else if (strncmp(arg, "--normalize=", 12) == 0) {
+            options.normalize = true;
+            options.targetLufs = atof(arg + 12);
+        } else if (strncmp(arg, "--out=", 6) == 0) {
+            options.outDir = arg + 6;
+        } else if (strcmp(arg, "--peaks") == 0) {
+            options.peaks = true;
+        } else if (strncmp(arg, "--bits=", 7) == 0) {
+            options.peakBits = atoi(arg + 7);
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty() || (options.peakBits != 8 && options.peakBits != 16)) {
+        fprintf(stderr, "Usage: AudioBatch [--threads=N] [--loudness] [--normalize=LUFS] [--out=DIR] [--peaks] [--bits=8|16] file.wav...\n"
+                        "       AudioBatch --ebu-check\n");
+        return 2;
+    }
+    if (!options.loudness && !options.normalize && !options.peaks) {
+        options.loudness = true;
+    }
+    g_options = &options;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t steals = 0;
+    unsigned threadCount = 0;
+    {
+        TaskPool pool(options.threads);
+        threadCount = pool.GetThreadCount();
+        for (const std::string& file : files) {
+            auto job = std::make_shared<FileJob>();
+            job->path = file;
+            pool.Submit([&pool, job]() { ProcessFile(pool, job); });
+        }
+        pool.Wait();
+        steals = pool.GetStealCount();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = g_summary.bytes.load() / 1048576.0;
+    printf("%llu files (%llu failed), %.1f MB in %.2f s: %.1f files/s, %.1f MB/s on %u threads (%llu steals)\n",
+        (unsigned long long)g_summary.files.load(), (unsigned long long)g_summary.failures.load(),
+        megabytes, seconds, seconds > 0.0 ? g_summary.files.load() / seconds : 0.0,
+        seconds > 0.0 ? megabytes / seconds : 0.0, threadCount, (unsigned long long)steals);
+    return g_summary.failures.load() > 0 ? 1 : 0;
+}
@@ -0,0 +1,334 @@
+#include "batched_writer.h"
+#include "alloc_tracker.h"
+#include "thread_scheduling.h"
+#include <cstring>
+
+namespace {
+
+// Pause between attempts to reach an output that is not connected
+const auto RECONNECT_INTERVAL = std::chrono::milliseconds(500);
+
+size_t RoundUpPow2(size_t value)
+{
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+}
+
+void WriterStats::Clear()
+{
+    bytesWritten.store(0, std::memory_order_relaxed);
+    blocksWritten.store(0, std::memory_order_relaxed);
+    writeCalls.store(0, std::memory_order_relaxed);
+    blocksDropped.store(0, std::memory_order_relaxed);
+    bytesDropped.store(0, std::memory_order_relaxed);
+    connects.store(0, std::memory_order_relaxed);
+    disconnects.store(0, std::memory_order_relaxed);
+}
+
+BatchedWriter::~BatchedWriter()
+{
+    Stop();
+}
+
+void BatchedWriter::SetPreamble(const void* data, size_t size)
+{
+    m_preamble.assign((const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+bool BatchedWriter::Start(ByteOutput* output, BlockPool* pool, const char* threadName)
+{
+    if (m_thread || !output || !pool || m_queueDepth == 0) return false;
+
+    m_output = output;
+    m_pool = pool;
+    m_threadName = threadName;
+
+    m_queue.assign(RoundUpPow2(m_queueDepth), Entry{});
+    m_mask = m_queue.size() - 1;
+    m_wakeThreshold = m_queueDepth > 1 ? m_queueDepth / 2 : 1;
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_owedSilence = 0;
+
+    m_connected = false;
+    m_frontWritten = 0;
+    m_preambleWritten = 0;
+
+    m_stats.Clear();
+    m_startTime = std::chrono::steady_clock::now();
+
+    m_thread = std::make_unique<std::thread>(&BatchedWriter::WriterThread, this);
+    return true;
+}
+
+void BatchedWriter::Stop()
+{
+    if (!m_thread) return;
+
+    // The producer is done; silence owed from an overflow still belongs at
+    // the end of the stream
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_drainTimeoutMs);
+    while (m_owedSilence > 0) {
+        QueueOwedSilence(m_tail.load(std::memory_order_relaxed));
+        if (m_owedSilence == 0 || std::chrono::steady_clock::now() >= deadline) break;
+        Notify();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (m_owedSilence > 0) {
+        m_stats.bytesDropped.fetch_add(m_owedSilence, std::memory_order_relaxed);
+        m_owedSilence = 0;
+    }
+
+    m_stopping.store(true, std::memory_order_release);
+    Notify();
+    if (m_thread->joinable()) {
+        m_thread->join();
+    }
+    m_thread.reset();
+}
+
+bool BatchedWriter::Submit(uint8_t* block, size_t offset, size_t size)
+{
+    return Enqueue(Entry{ block, (uint32_t)offset, (uint32_t)size });
+}
+
+bool BatchedWriter::SubmitSilence(size_t size)
+{
+    // Entry sizes are 32-bit; a long gap becomes several entries
+    bool queued = true;
+    while (size > 0) {
+        size_t part = size < MAX_SILENCE_ENTRY ? size : MAX_SILENCE_ENTRY;
+        queued = Enqueue(Entry{ nullptr, 0, (uint32_t)part }) && queued;
+        size -= part;
+    }
+    return queued;
+}
+
+bool BatchedWriter::Enqueue(const Entry& entry)
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+
+    // Silence owed from an overflow goes first so bytes stay in order
+    if (m_owedSilence > 0) {
+        tail = QueueOwedSilence(tail);
+    }
+
+    if (m_owedSilence > 0 || tail - m_head.load(std::memory_order_acquire) >= m_queueDepth) {
+        if (m_policy == Block) {
+            // Give the writer a bounded chance to make room
+            Notify();
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_blockTimeoutMs);
+            while (tail - m_head.load(std::memory_order_acquire) >= m_queueDepth &&
+                   !m_stopping.load(std::memory_order_relaxed) &&
+                   std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        if (m_owedSilence > 0 || tail - m_head.load(std::memory_order_acquire) >= m_queueDepth) {
+            if (m_policy == FillSilence) {
+                // No waiting: the bytes become silence, queued with the next
+                // entry that finds room
+                m_owedSilence += entry.size;
+                Notify();
+                if (!entry.block) return true;
+            }
+            m_stats.blocksDropped.fetch_add(1, std::memory_order_relaxed);
+            m_stats.bytesDropped.fetch_add(entry.size, std::memory_order_relaxed);
+            if (entry.block) m_pool->Release(entry.block);
+            return false;
+        }
+    }
+
+    m_queue[tail & m_mask] = entry;
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    // Wake the writer early once half the queue is in use
+    if (tail + 1 - m_head.load(std::memory_order_relaxed) >= m_wakeThreshold) {
+        Notify();
+    }
+    return true;
+}
+
+size_t BatchedWriter::QueueOwedSilence(size_t tail)
+{
+    while (m_owedSilence > 0 && tail - m_head.load(std::memory_order_acquire) < m_queueDepth) {
+        size_t part = m_owedSilence < MAX_SILENCE_ENTRY ? m_owedSilence : MAX_SILENCE_ENTRY;
+        m_queue[tail & m_mask] = Entry{ nullptr, 0, (uint32_t)part };
+        m_tail.store(++tail, std::memory_order_release);
+        m_owedSilence -= part;
+    }
+    return tail;
+}
+
+double BatchedWriter::GetThroughput() const
+{
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+    if (seconds <= 0.0) return 0.0;
+    return m_stats.bytesWritten.load(std::memory_order_relaxed) / seconds;
+}
+
+void BatchedWriter::Notify()
+{
+    // Passing through the mutex keeps the writer from missing the wake-up
+    // between checking the queue and going to sleep; it holds the mutex
+    // only for that check, never across I/O
+    { std::lock_guard<std::mutex> lock(m_wakeMutex); }
+    m_wake.notify_one();
+}
+
+bool BatchedWriter::TryConnect()
+{
+    if (!m_output->Connect()) return false;
+
+    m_preambleWritten = 0;
+    m_stats.connects.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void BatchedWriter::DropFront()
+{
+    size_t head = m_head.load(std::memory_order_relaxed);
+    const Entry& entry = m_queue[head & m_mask];
+
+    m_stats.blocksDropped.fetch_add(1, std::memory_order_relaxed);
+    m_stats.bytesDropped.fetch_add(entry.size - m_frontWritten, std::memory_order_relaxed);
+    if (entry.block) m_pool->Release(entry.block);
+
+    m_frontWritten = 0;
+    m_head.store(head + 1, std::memory_order_release);
+}
+
+void BatchedWriter::WriterThread()
+{
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Writer);
+
+    // Connecting and the output's first write (decorators open their side
+    // files) may allocate; the thread is armed once a batch got through
+    // and disarmed again while it reconnects
+    bool armed = false;
+
+    IoSpan spans[MAX_SPANS];
+    auto nextConnect = std::chrono::steady_clock::now();
+    auto drainDeadline = std::chrono::steady_clock::time_point::max();
+
+    for (;;) {
+        // Collect a batch: sleep for the batch interval unless the queue is
+        // filling up or we are asked to stop
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(m_batchIntervalMs), [this]() {
+                return m_stopping.load(std::memory_order_acquire) ||
+                       m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed) >= m_wakeThreshold;
+            });
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        bool stopping = m_stopping.load(std::memory_order_acquire);
+        if (stopping && drainDeadline == std::chrono::steady_clock::time_point::max()) {
+            drainDeadline = now + std::chrono::milliseconds(m_drainTimeoutMs);
+        }
+
+        if (!m_connected && now >= nextConnect) {
+            m_connected = TryConnect();
+            nextConnect = now + RECONNECT_INTERVAL;
+        }
+        if (!m_connected && stopping) break;
+
+        while (m_connected) {
+            // Preamble remainder first, then queued blocks
+            size_t count = 0;
+            if (m_preambleWritten < m_preamble.size()) {
+                spans[count++] = IoSpan{ m_preamble.data() + m_preambleWritten, m_preamble.size() - m_preambleWritten };
+            }
+
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t tail = m_tail.load(std::memory_order_acquire);
+            for (size_t i = head; i != tail && count < MAX_SPANS; i++) {
+                const Entry& entry = m_queue[i & m_mask];
+                size_t skip = (i == head) ? m_frontWritten : 0;
+                if (entry.block) {
+                    spans[count++] = IoSpan{ entry.block + entry.offset + skip, entry.size - skip };
+                    continue;
+                }
+
+                // Silence: the pool's zero block, as often as it takes
+                size_t left = entry.size - skip;
+                while (left > 0 && count < MAX_SPANS) {
+                    size_t part = left < m_pool->GetBlockSize() ? left : m_pool->GetBlockSize();
+                    spans[count++] = IoSpan{ m_pool->GetSilence(), part };
+                    left -= part;
+                }
+                if (left > 0) break;
+            }
+            if (count == 0) break;
+
+            int64_t written = m_output->WriteGather(spans, count);
+            m_stats.writeCalls.fetch_add(1, std::memory_order_relaxed);
+
+            if (written < 0) {
+                // Restart the stream on a block boundary after reconnecting
+                AllocTracker::DisarmCurrentThread();
+                armed = false;
+                m_output->Disconnect();
+                m_connected = false;
+                m_stats.disconnects.fetch_add(1, std::memory_order_relaxed);
+                if (m_frontWritten > 0) {
+                    DropFront();
+                }
+                nextConnect = std::chrono::steady_clock::now() + RECONNECT_INTERVAL;
+                break;
+            }
+
+            if (written == 0) {
+                m_output->WaitWritable(m_batchIntervalMs);
+                break;
+            }
+
+            m_stats.bytesWritten.fetch_add((uint64_t)written, std::memory_order_relaxed);
+            if (!armed) {
+                AllocTracker::ArmCurrentThread(m_threadName);
+                armed = true;
+            }
+
+            // Consume the preamble, then whole blocks
+            size_t remaining = (size_t)written;
+            if (m_preambleWritten < m_preamble.size()) {
+                size_t part = m_preamble.size() - m_preambleWritten;
+                if (part > remaining) part = remaining;
+                m_preambleWritten += part;
+                remaining -= part;
+            }
+            while (remaining > 0) {
+                const Entry& entry = m_queue[head & m_mask];
+                size_t left = entry.size - m_frontWritten;
+                if (remaining < left) {
+                    m_frontWritten += remaining;
+                    break;
+                }
+                remaining -= left;
+                if (entry.block) m_pool->Release(entry.block);
+                m_stats.blocksWritten.fetch_add(1, std::memory_order_relaxed);
+                m_frontWritten = 0;
+                m_head.store(++head, std::memory_order_release);
+            }
+        }
+
+        if (stopping) {
+            size_t pending = m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed);
+            if (pending == 0 || std::chrono::steady_clock::now() >= drainDeadline) break;
+        }
+    }
+
+    // Whatever could not be written in time is dropped
+    while (m_tail.load(std::memory_order_acquire) != m_head.load(std::memory_order_relaxed)) {
+        DropFront();
+    }
+
+    AllocTracker::DisarmCurrentThread();
+    ThreadScheduling::RestoreCurrentThread(scheduling);
+}
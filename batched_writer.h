@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "block_pool.h"
+
+// One contiguous piece of a vectored write
+struct IoSpan
+{
+    const uint8_t* data;
+    size_t size;
+};
+
+// Destination of a BatchedWriter (file, pipe, socket, ...). Only the writer
+// thread calls these.
+class ByteOutput
+{
+public:
+    virtual ~ByteOutput() = default;
+
+    // Establish (or re-establish) the connection without blocking for long.
+    // Returns false if the output is not available yet.
+    virtual bool Connect() { return true; }
+
+    // Drop a broken connection before the next Connect()
+    virtual void Disconnect() {}
+
+    // Write as much of the spans as possible in one call. Returns the bytes
+    // written, 0 if the output cannot take data right now, -1 on failure.
+    virtual int64_t WriteGather(const IoSpan* spans, size_t count) = 0;
+
+    // Wait until the output can take data again (or the timeout expires)
+    virtual void WaitWritable(uint32_t timeoutMs) { (void)timeoutMs; }
+};
+
+// Counters of a BatchedWriter, readable from any thread
+struct WriterStats
+{
+    std::atomic<uint64_t> bytesWritten{ 0 };
+    std::atomic<uint64_t> blocksWritten{ 0 };
+    std::atomic<uint64_t> writeCalls{ 0 };
+    std::atomic<uint64_t> blocksDropped{ 0 };   // With FillSilence, zeros stand in
+    std::atomic<uint64_t> bytesDropped{ 0 };
+    std::atomic<uint64_t> connects{ 0 };
+    std::atomic<uint64_t> disconnects{ 0 };
+
+    void Clear();
+};
+
+// Moves pool blocks to a ByteOutput on its own thread. The producer queues
+// blocks with Submit() (never blocking on I/O); the writer thread collects
+// everything queued and hands it to the output as one vectored write, then
+// returns the blocks to the pool. A broken output is reconnected
+// periodically; the preamble (e.g. a stream header) is sent again on every
+// new connection and a partly sent block is dropped so the stream restarts
+// on a frame boundary.
+class BatchedWriter
+{
+public:
+    enum OverflowPolicy {
+        DropNewest,  // Full queue: drop the submitted block
+        Block,       // Full queue: wait up to the block timeout, then drop
+        FillSilence  // Full queue: drop the block without waiting and write as
+                     // many zero bytes in its place once there is room
+    };
+
+    BatchedWriter() = default;
+    ~BatchedWriter();
+
+    BatchedWriter(const BatchedWriter&) = delete;
+    BatchedWriter& operator=(const BatchedWriter&) = delete;
+
+    // Settings, applied by the next Start()
+    void SetQueueDepth(size_t blocks) { m_queueDepth = blocks; }
+    void SetPolicy(OverflowPolicy policy) { m_policy = policy; }
+    void SetBatchInterval(uint32_t ms) { m_batchIntervalMs = ms; }
+    void SetBlockTimeout(uint32_t ms) { m_blockTimeoutMs = ms; }
+    void SetDrainTimeout(uint32_t ms) { m_drainTimeoutMs = ms; }
+    void SetPreamble(const void* data, size_t size);
+
+    bool Start(ByteOutput* output, BlockPool* pool, const char* threadName);
+
+    // Write out what is queued, silence still owed included (up to the
+    // drain timeout), and stop the thread
+    void Stop();
+
+    bool IsRunning() const { return m_thread != nullptr; }
+
+    // Queue `size` bytes at `offset` in a pool block. The writer takes over
+    // the caller's reference and releases it once written or dropped.
+    // Returns false if the block was dropped (with FillSilence: replaced by
+    // zeros, so the stream keeps its length). Single producer.
+    bool Submit(uint8_t* block, size_t offset, size_t size);
+
+    // Queue `size` bytes of silence, written from the pool's zero block so
+    // a gap of any length takes no pool block. Same overflow policy as
+    // Submit(), except that FillSilence never drops it; returns false if it
+    // was dropped. Single producer.
+    bool SubmitSilence(size_t size);
+
+    const WriterStats& GetStats() const { return m_stats; }
+
+    // Blocks queued and not yet written (approximate from other threads)
+    size_t GetQueuedBlocks() const
+    {
+        size_t head = m_head.load(std::memory_order_acquire);   // First: the head never passes the tail
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+
+    // Average bytes per second written since Start()
+    double GetThroughput() const;
+
+private:
+    struct Entry
+    {
+        uint8_t* block;     // Null for silence
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    static const size_t MAX_SPANS = 64;
+    static const size_t MAX_SILENCE_ENTRY = (size_t)1 << 30;
+
+    bool Enqueue(const Entry& entry);
+    size_t QueueOwedSilence(size_t tail);
+    void WriterThread();
+    bool TryConnect();
+    void DropFront();
+    void Notify();
+
+    // Settings
+    size_t m_queueDepth = 32;
+    OverflowPolicy m_policy = DropNewest;
+    uint32_t m_batchIntervalMs = 20;
+    uint32_t m_blockTimeoutMs = 500;
+    uint32_t m_drainTimeoutMs = 2000;
+    std::vector<uint8_t> m_preamble;
+    const char* m_threadName = "writer";
+
+    ByteOutput* m_output = nullptr;
+    BlockPool* m_pool = nullptr;
+    std::unique_ptr<std::thread> m_thread;
+
+    // Single-producer/single-consumer queue of blocks
+    std::vector<Entry> m_queue;
+    size_t m_mask = 0;
+    size_t m_wakeThreshold = 1;        // Queued blocks that wake the writer early
+    std::atomic<size_t> m_head{ 0 };   // Next entry to write (writer thread)
+    std::atomic<size_t> m_tail{ 0 };   // Next free slot (producer)
+    size_t m_owedSilence = 0;          // FillSilence bytes not queued yet (producer)
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_stopping{ false };
+
+    // Writer-thread state
+    bool m_connected = false;
+    size_t m_frontWritten = 0;      // Bytes of the front entry already written
+    size_t m_preambleWritten = 0;   // Bytes of the preamble sent on this connection
+
+    std::chrono::steady_clock::time_point m_startTime;
+    WriterStats m_stats;
+};
@@ -0,0 +1,113 @@
+#include "block_pool.h"
+#include <cstring>
+
+namespace {
+
+// Keep blocks cache-line aligned so stages never share lines
+const size_t BLOCK_ALIGNMENT = 64;
+
+size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}
+
+bool BlockPool::Configure(size_t blockSize, size_t blockCount)
+{
+    if (blockSize == 0 || blockCount == 0 || blockCount >= EMPTY) return false;
+
+    size_t stride = AlignUp(blockSize, BLOCK_ALIGNMENT);
+    size_t storageSize = stride * blockCount + BLOCK_ALIGNMENT;
+
+    // Only grow the allocations; a smaller format reuses the storage
+    if (storageSize > m_storageSize) {
+        m_storage.reset(new uint8_t[storageSize]);
+        m_storageSize = storageSize;
+    }
+    if (stride > m_silenceSize) {
+        m_silence.reset(new uint8_t[stride]);
+        memset(m_silence.get(), 0, stride);
+        m_silenceSize = stride;
+    }
+    if (blockCount > m_nextSize) {
+        m_next.reset(new std::atomic<uint32_t>[blockCount]);
+        m_refs.reset(new std::atomic<uint32_t>[blockCount]);
+        m_nextSize = blockCount;
+    }
+
+    m_blockSize = stride;
+    m_blockCount = blockCount;
+
+    // Link all blocks into the free list
+    for (size_t i = 0; i < blockCount; i++) {
+        m_next[i].store(i + 1 < blockCount ? (uint32_t)(i + 1) : EMPTY, std::memory_order_relaxed);
+        m_refs[i].store(0, std::memory_order_relaxed);
+    }
+    m_head.store(PackHead(0, 0), std::memory_order_release);
+    m_available.store(blockCount, std::memory_order_relaxed);
+    return true;
+}
+
+uint8_t* BlockPool::Acquire()
+{
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t index = (uint32_t)head;
+        if (index == EMPTY) return nullptr;
+
+        uint32_t next = m_next[index].load(std::memory_order_relaxed);
+        uint64_t newHead = PackHead(next, (uint32_t)(head >> 32) + 1);
+        if (m_head.compare_exchange_weak(head, newHead, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            m_available.fetch_sub(1, std::memory_order_relaxed);
+            m_refs[index].store(1, std::memory_order_relaxed);
+            return BlockAt(index);
+        }
+    }
+}
+
+void BlockPool::AddRef(uint8_t* block)
+{
+    if (!block) return;
+    m_refs[IndexOf(block)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void BlockPool::Release(uint8_t* block)
+{
+    if (!block) return;
+
+    uint32_t index = IndexOf(block);
+    if (m_refs[index].fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    for (;;) {
+        m_next[index].store((uint32_t)head, std::memory_order_relaxed);
+        uint64_t newHead = PackHead(index, (uint32_t)(head >> 32) + 1);
+        if (m_head.compare_exchange_weak(head, newHead, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            m_available.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+uint8_t* BlockPool::BlockAt(uint32_t index) const
+{
+    uintptr_t base = AlignUp((uintptr_t)m_storage.get(), BLOCK_ALIGNMENT);
+    return (uint8_t*)base + (size_t)index * m_blockSize;
+}
+
+uint32_t BlockPool::IndexOf(const uint8_t* block) const
+{
+    uintptr_t base = AlignUp((uintptr_t)m_storage.get(), BLOCK_ALIGNMENT);
+    return (uint32_t)(((uintptr_t)block - base) / m_blockSize);
+}
+
+bool BlockPool::Owns(const uint8_t* block) const
+{
+    if (!m_storage || !block) return false;
+
+    uintptr_t base = AlignUp((uintptr_t)m_storage.get(), BLOCK_ALIGNMENT);
+    uintptr_t address = (uintptr_t)block;
+    return address >= base && address < base + m_blockSize * m_blockCount &&
+           (address - base) % m_blockSize == 0;
+}
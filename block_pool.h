@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Fixed-size block pool for packet buffers.
+// All blocks are allocated once by Configure() (sized from the negotiated
+// format when the device is initialized); Acquire/Release are lock-free and
+// never touch the heap, so pipeline threads can use them in steady state.
+// Blocks are reference counted so one packet can be handed to several
+// consumers (e.g. the file and stream writers) without copying.
+class BlockPool
+{
+public:
+    BlockPool() = default;
+    ~BlockPool() = default;
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // (Re)allocate blockCount blocks of blockSize bytes. Must not be called
+    // while other threads hold blocks. Reuses the storage if it is big enough.
+    bool Configure(size_t blockSize, size_t blockCount);
+
+    // Take a block (reference count 1), or nullptr if the pool is exhausted
+    uint8_t* Acquire();
+
+    // Add a reference for another consumer of the block
+    void AddRef(uint8_t* block);
+
+    // Drop a reference; the block returns to the pool with the last one
+    void Release(uint8_t* block);
+
+    // Read-only block of zeros, at least GetBlockSize() bytes
+    const uint8_t* GetSilence() const { return m_silence.get(); }
+
+    size_t GetBlockSize() const { return m_blockSize; }
+    size_t GetBlockCount() const { return m_blockCount; }
+    size_t GetAvailableCount() const { return m_available.load(std::memory_order_relaxed); }
+
+    // True if the pointer is a block of this pool
+    bool Owns(const uint8_t* block) const;
+
+    // Memory backing the blocks (e.g. to lock it into RAM)
+    const uint8_t* GetStorage() const { return m_storage.get(); }
+    size_t GetStorageSize() const { return m_storageSize; }
+
+private:
+    static const uint32_t EMPTY = 0xFFFFFFFFu;
+
+    static uint64_t PackHead(uint32_t index, uint32_t tag) { return (uint64_t(tag) << 32) | index; }
+
+    uint8_t* BlockAt(uint32_t index) const;
+    uint32_t IndexOf(const uint8_t* block) const;
+
+    std::unique_ptr<uint8_t[]> m_storage;
+    std::unique_ptr<uint8_t[]> m_silence;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_next;  // Free-list links
+    std::unique_ptr<std::atomic<uint32_t>[]> m_refs;  // Reference counts
+    size_t m_storageSize = 0;
+    size_t m_silenceSize = 0;
+    size_t m_nextSize = 0;
+    size_t m_blockSize = 0;
+    size_t m_blockCount = 0;
+
+    // Free-list head: block index in the low half, ABA tag in the high half
+    std::atomic<uint64_t> m_head{ EMPTY };
+    std::atomic<size_t> m_available{ 0 };
+};
@@ -0,0 +1,319 @@
+#include "capture_trace.h"
+#include <cstring>
+
+namespace {
+
+const char TRACE_MAGIC[4] = { 'A', 'C', 'T', 'R' };
+const uint16_t TRACE_VERSION = 1;
+const uint16_t TRACE_HAS_PAYLOAD = 1;
+const uint16_t TRACE_IS_FLOAT = 2;
+
+// Blocks of packed records; metadata-only traces fit ~1600 records per block
+const size_t TRACE_MIN_BLOCK_SIZE = 64 * 1024;
+const size_t TRACE_POOL_BLOCKS = 16;
+const size_t TRACE_QUEUE_BLOCKS = 12;
+
+// Hand a block to the writer at least this often so a crash loses little
+const uint32_t TRACE_FLUSH_RECORDS = 100;
+const uint32_t TRACE_BATCH_INTERVAL_MS = 100;
+
+// Read buffer of the trace reader
+const size_t TRACE_READ_BUFFER = 1 << 20;
+
+void PutU16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+void PutU32(uint8_t* p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+void PutU64(uint8_t* p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+uint16_t GetU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t GetU32(const uint8_t* p)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+uint64_t GetU64(const uint8_t* p)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+void BuildTraceHeader(uint8_t* header, const TraceFormat& format)
+{
+    memset(header, 0, TRACE_HEADER_SIZE);
+    memcpy(header, TRACE_MAGIC, 4);
+    PutU16(header + 4, TRACE_VERSION);
+    PutU16(header + 6, (uint16_t)TRACE_HEADER_SIZE);
+    PutU32(header + 8, format.sampleRate);
+    PutU16(header + 12, format.channels);
+    PutU16(header + 14, format.bitsPerSample);
+    PutU16(header + 16, (uint16_t)format.GetBlockAlign());
+    PutU16(header + 18, (format.hasPayload ? TRACE_HAS_PAYLOAD : 0) | (format.isFloat ? TRACE_IS_FLOAT : 0));
+    PutU32(header + 20, format.bufferFrames);
+    PutU64(header + 24, format.startFileTime);
+}
+
+void BuildTraceRecord(uint8_t* record, const TracePacket& packet, uint32_t payloadBytes)
+{
+    PutU64(record, packet.arrival);
+    PutU64(record + 8, packet.devicePosition);
+    PutU64(record + 16, packet.timestamp);
+    PutU32(record + 24, packet.frames);
+    PutU32(record + 28, packet.deviceFlags);
+    PutU32(record + 32, payloadBytes);
+    PutU16(record + 36, (uint16_t)packet.type);
+    PutU16(record + 38, 0);
+}
+
+}
+
+uint32_t GetTracePacketFlags(uint32_t deviceFlags)
+{
+    uint32_t flags = 0;
+    if (deviceFlags & TRACE_FLAG_SILENT) flags |= PacketInfo::Silent;
+    if (deviceFlags & TRACE_FLAG_DISCONTINUITY) flags |= PacketInfo::Discontinuity;
+    if (deviceFlags & TRACE_FLAG_TIMESTAMP_ERROR) flags |= PacketInfo::TimestampError;
+    return flags;
+}
+
+// CaptureTraceRecorder
+
+CaptureTraceRecorder::~CaptureTraceRecorder()
+{
+    Stop();
+}
+
+bool CaptureTraceRecorder::Start(ByteOutput* output, const TraceFormat& format)
+{
+    if (IsRunning() || !output) return false;
+
+    m_format = format;
+
+    // A block always takes a Lost record plus the largest packet
+    size_t largest = 2 * TRACE_RECORD_SIZE + (format.hasPayload ? (size_t)format.bufferFrames * format.GetBlockAlign() : 0);
+    m_blockSize = largest > TRACE_MIN_BLOCK_SIZE ? largest : TRACE_MIN_BLOCK_SIZE;
+    if (!m_pool.Configure(m_blockSize, TRACE_POOL_BLOCKS)) return false;
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    BuildTraceHeader(header, format);
+    m_writer.SetPreamble(header, sizeof(header));
+
+    // The capture thread must never wait for the trace
+    m_writer.SetQueueDepth(TRACE_QUEUE_BLOCKS);
+    m_writer.SetPolicy(BatchedWriter::DropNewest);
+    m_writer.SetBatchInterval(TRACE_BATCH_INTERVAL_MS);
+
+    m_block = nullptr;
+    m_used = 0;
+    m_blockRecords = 0;
+    m_blockLostRecords = 0;
+    m_blockCarriedLost = 0;
+    m_records = 0;
+    m_lostRecords = 0;
+    m_pendingLost = 0;
+
+    return m_writer.Start(output, &m_pool, "trace writer");
+}
+
+void CaptureTraceRecorder::Stop()
+{
+    if (!IsRunning()) return;
+
+    // Report a trailing loss if there is room for it
+    if (m_pendingLost > 0) {
+        TracePacket lost;
+        lost.type = TracePacket::Lost;
+        Append(lost, nullptr, 0);
+    }
+    if (m_block) {
+        SubmitBlock();
+    }
+    m_writer.Stop();
+}
+
+void CaptureTraceRecorder::Record(const TracePacket& packet, const uint8_t* payload)
+{
+    uint32_t payloadBytes = 0;
+    if (m_format.hasPayload && payload && packet.type == TracePacket::Packet &&
+        !(packet.deviceFlags & TRACE_FLAG_SILENT) && packet.frames <= m_format.bufferFrames) {
+        payloadBytes = (uint32_t)(packet.frames * m_format.GetBlockAlign());
+    }
+
+    if (!Append(packet, payload, payloadBytes)) {
+        m_pendingLost++;
+        m_lostRecords++;
+        return;
+    }
+    m_records++;
+
+    if (m_blockRecords >= TRACE_FLUSH_RECORDS) {
+        SubmitBlock();
+    }
+}
+
+bool CaptureTraceRecorder::Append(const TracePacket& packet, const uint8_t* payload, uint32_t payloadBytes)
+{
+    size_t needed = TRACE_RECORD_SIZE + payloadBytes + (m_pendingLost > 0 ? TRACE_RECORD_SIZE : 0);
+    if (m_block && m_used + needed > m_blockSize) {
+        SubmitBlock();
+    }
+    if (!m_block) {
+        m_block = m_pool.Acquire();
+        if (!m_block) return false;
+        m_used = 0;
+        m_blockRecords = 0;
+        m_blockLostRecords = 0;
+        m_blockCarriedLost = 0;
+    }
+
+    if (m_pendingLost > 0 && packet.type != TracePacket::Lost) {
+        TracePacket lost;
+        lost.type = TracePacket::Lost;
+        lost.arrival = packet.arrival;
+        lost.frames = (uint32_t)(m_pendingLost > 0xFFFFFFFFu ? 0xFFFFFFFFu : m_pendingLost);
+        BuildTraceRecord(m_block + m_used, lost, 0);
+        m_used += TRACE_RECORD_SIZE;
+        m_blockRecords++;
+        m_blockLostRecords++;
+        m_blockCarriedLost += m_pendingLost;
+        m_pendingLost = 0;
+    }
+
+    if (packet.type == TracePacket::Lost) {
+        TracePacket lost = packet;
+        lost.frames = (uint32_t)(m_pendingLost > 0xFFFFFFFFu ? 0xFFFFFFFFu : m_pendingLost);
+        BuildTraceRecord(m_block + m_used, lost, 0);
+        m_blockLostRecords++;
+        m_blockCarriedLost += m_pendingLost;
+        m_pendingLost = 0;
+    } else {
+        BuildTraceRecord(m_block + m_used, packet, payloadBytes);
+    }
+    m_used += TRACE_RECORD_SIZE;
+    if (payloadBytes > 0) {
+        memcpy(m_block + m_used, payload, payloadBytes);
+        m_used += payloadBytes;
+    }
+    m_blockRecords++;
+    return true;
+}
+
+void CaptureTraceRecorder::SubmitBlock()
+{
+    if (m_used == 0) {
+        m_pool.Release(m_block);
+    } else if (!m_writer.Submit(m_block, 0, m_used)) {
+        // The writer released the block; its packets count as lost, and so
+        // do the earlier losses its Lost records were reporting
+        uint32_t packets = m_blockRecords - m_blockLostRecords;
+        m_pendingLost += packets + m_blockCarriedLost;
+        m_lostRecords += packets;
+    }
+    m_block = nullptr;
+    m_used = 0;
+    m_blockRecords = 0;
+    m_blockLostRecords = 0;
+    m_blockCarriedLost = 0;
+}
+
+// CaptureTraceReader
+
+CaptureTraceReader::~CaptureTraceReader()
+{
+    Close();
+}
+
+bool CaptureTraceReader::Open(const char* path)
+{
+    Close();
+
+    m_file = fopen(path, "rb");
+    if (!m_file) return false;
+    setvbuf(m_file, nullptr, _IOFBF, TRACE_READ_BUFFER);
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+        memcmp(header, TRACE_MAGIC, 4) != 0 || GetU16(header + 4) != TRACE_VERSION ||
+        GetU16(header + 6) != TRACE_HEADER_SIZE) {
+        Close();
+        return false;
+    }
+
+    m_format.sampleRate = GetU32(header + 8);
+    m_format.channels = GetU16(header + 12);
+    m_format.bitsPerSample = GetU16(header + 14);
+    m_format.hasPayload = (GetU16(header + 18) & TRACE_HAS_PAYLOAD) != 0;
+    m_format.isFloat = (GetU16(header + 18) & TRACE_IS_FLOAT) != 0;
+    m_format.bufferFrames = GetU32(header + 20);
+    m_format.startFileTime = GetU64(header + 24);
+
+    if (m_format.sampleRate == 0 || m_format.channels == 0 || m_format.GetBlockAlign() == 0) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void CaptureTraceReader::Close()
+{
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool CaptureTraceReader::Next(TracePacket& packet, std::vector<uint8_t>& payload)
+{
+    if (!m_file) return false;
+
+    uint8_t record[TRACE_RECORD_SIZE];
+    size_t got = fread(record, 1, sizeof(record), m_file);
+    if (got != sizeof(record)) {
+        m_truncated = got > 0;
+        return false;
+    }
+
+    packet.arrival = GetU64(record);
+    packet.devicePosition = GetU64(record + 8);
+    packet.timestamp = GetU64(record + 16);
+    packet.frames = GetU32(record + 24);
+    packet.deviceFlags = GetU32(record + 28);
+    packet.payloadBytes = GetU32(record + 32);
+    packet.type = (TracePacket::Type)GetU16(record + 36);
+
+    // A payload never exceeds the device buffer; anything else is corrupt
+    if (packet.payloadBytes > (uint64_t)m_format.bufferFrames * m_format.GetBlockAlign()) {
+        m_truncated = true;
+        return false;
+    }
+
+    payload.resize(packet.payloadBytes);
+    if (packet.payloadBytes > 0 && fread(payload.data(), 1, packet.payloadBytes, m_file) != packet.payloadBytes) {
+        m_truncated = true;
+        return false;
+    }
+    return true;
+}
+
+bool CaptureTraceReader::Rewind()
+{
+    m_truncated = false;
+    return m_file && fseek(m_file, (long)TRACE_HEADER_SIZE, SEEK_SET) == 0;
+}
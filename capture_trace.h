@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "batched_writer.h"
+#include "block_pool.h"
+#include "packet_timeline.h"
+
+// Capture trace: the exact packet sequence a device delivered, for replaying
+// timing-dependent bugs elsewhere. Little-endian; a 48-byte header followed
+// by 40-byte records, each optionally followed by the packet payload:
+//
+//   arrival      u64   100 ns since the trace started (when the packet was read)
+//   position     u64   device position of the first frame
+//   timestamp    u64   device (QPC) timestamp of the first frame, 100 ns
+//   frames       u32   packet size as reported by the device
+//   deviceFlags  u32   AUDCLNT_BUFFERFLAGS_* bits, unmodified
+//   payloadBytes u32   bytes following the record (0 when not recorded or silent)
+//   type         u16   TracePacket::Type
+//   reserved     u16
+
+const size_t TRACE_HEADER_SIZE = 48;
+const size_t TRACE_RECORD_SIZE = 40;
+
+// AUDCLNT_BUFFERFLAGS_* values as stored in traces
+const uint32_t TRACE_FLAG_DISCONTINUITY = 0x1;
+const uint32_t TRACE_FLAG_SILENT = 0x2;
+const uint32_t TRACE_FLAG_TIMESTAMP_ERROR = 0x4;
+
+// PacketInfo flags for the stored device flags
+uint32_t GetTracePacketFlags(uint32_t deviceFlags);
+
+struct TraceFormat
+{
+    uint32_t sampleRate = 0;
+    uint16_t channels = 0;
+    uint16_t bitsPerSample = 0;
+    uint32_t bufferFrames = 0;     // Device buffer, the largest possible packet
+    bool hasPayload = false;
+    bool isFloat = false;          // 32-bit samples are IEEE float rather than PCM
+    uint64_t startFileTime = 0;    // UTC when the trace started (FILETIME units), informational
+
+    size_t GetBlockAlign() const { return (size_t)channels * bitsPerSample / 8; }
+};
+
+struct TracePacket
+{
+    enum Type : uint16_t {
+        Packet = 1,
+        Lost = 2      // Records the recorder had to drop; `frames` holds the count
+    };
+
+    uint64_t arrival = 0;
+    uint64_t devicePosition = 0;
+    uint64_t timestamp = 0;
+    uint32_t frames = 0;
+    uint32_t deviceFlags = 0;
+    uint32_t payloadBytes = 0;
+    Type type = Packet;
+};
+
+// Records a trace from the capture thread. Records are packed into pool
+// blocks and written by a BatchedWriter thread; Record() never blocks or
+// allocates. When the writer falls behind whole blocks are dropped and a
+// Lost record marks the hole.
+class CaptureTraceRecorder
+{
+public:
+    CaptureTraceRecorder() = default;
+    ~CaptureTraceRecorder();
+
+    CaptureTraceRecorder(const CaptureTraceRecorder&) = delete;
+    CaptureTraceRecorder& operator=(const CaptureTraceRecorder&) = delete;
+
+    // Write the header and start the writer thread. `output` must outlive Stop().
+    bool Start(ByteOutput* output, const TraceFormat& format);
+
+    // Write what is buffered and stop the writer thread
+    void Stop();
+
+    bool IsRunning() const { return m_writer.IsRunning(); }
+
+    // Payload is only stored for non-silent packets when the format has it
+    void Record(const TracePacket& packet, const uint8_t* payload);
+
+    uint64_t GetRecordCount() const { return m_records; }
+    uint64_t GetLostRecords() const { return m_lostRecords; }
+
+private:
+    bool Append(const TracePacket& packet, const uint8_t* payload, uint32_t payloadBytes);
+    void SubmitBlock();
+
+    TraceFormat m_format;
+    BlockPool m_pool;
+    BatchedWriter m_writer;
+    size_t m_blockSize = 0;
+
+    uint8_t* m_block = nullptr;     // Block being filled
+    size_t m_used = 0;
+    uint32_t m_blockRecords = 0;
+    uint32_t m_blockLostRecords = 0;    // Lost records among them
+    uint64_t m_blockCarriedLost = 0;    // Losses those records report
+
+    uint64_t m_records = 0;
+    uint64_t m_lostRecords = 0;
+    uint64_t m_pendingLost = 0;     // Not reported in the trace yet
+};
+
+// Sequential reader of a trace file
+class CaptureTraceReader
+{
+public:
+    CaptureTraceReader() = default;
+    ~CaptureTraceReader();
+
+    CaptureTraceReader(const CaptureTraceReader&) = delete;
+    CaptureTraceReader& operator=(const CaptureTraceReader&) = delete;
+
+    bool Open(const char* path);
+    void Close();
+
+    const TraceFormat& GetFormat() const { return m_format; }
+
+    // Next record; `payload` receives its payload (empty if none). Returns
+    // false at the end of the trace or on a truncated record.
+    bool Next(TracePacket& packet, std::vector<uint8_t>& payload);
+
+    // Back to the first record
+    bool Rewind();
+
+    // Whether Next() stopped at a partial record (a trace cut off mid-write)
+    bool IsTruncated() const { return m_truncated; }
+
+private:
+    FILE* m_file = nullptr;
+    bool m_truncated = false;
+    TraceFormat m_format;
+};
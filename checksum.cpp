@@ -0,0 +1,235 @@
+#include "checksum.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_X86 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET
+#else
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CRC32C_ARM 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <windows.h>
+#define CRC32C_TARGET
+#else
+#include <arm_acle.h>
+#if defined(__ARM_FEATURE_CRC32)
+#define CRC32C_TARGET
+#elif defined(__clang__)
+#define CRC32C_TARGET __attribute__((target("crc")))
+#else
+#define CRC32C_TARGET __attribute__((target("arch=armv8-a+crc")))
+#endif
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+#endif
+
+namespace {
+
+// Castagnoli polynomial, bit-reversed
+const uint32_t CRC32C_POLY = 0x82F63B78u;
+
+struct Crc32cTables
+{
+    uint32_t slice[8][256];   // slice[k][b]: CRC of byte b followed by k zero bytes
+    uint32_t x2n[32];         // x^(2^n) mod P, for Crc32cCombine
+
+    Crc32cTables()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+            }
+            slice[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                slice[k][i] = (slice[k - 1][i] >> 8) ^ slice[0][slice[k - 1][i] & 0xFF];
+            }
+        }
+
+        x2n[0] = 1u << 30;   // x^1
+        for (int n = 1; n < 32; n++) {
+            x2n[n] = MultModP(x2n[n - 1], x2n[n - 1]);
+        }
+    }
+
+    // a * b modulo the polynomial, both bit-reversed; a must not be 0
+    static uint32_t MultModP(uint32_t a, uint32_t b)
+    {
+        uint32_t m = 1u << 31;
+        uint32_t p = 0;
+        for (;;) {
+            if (a & m) {
+                p ^= b;
+                if ((a & (m - 1)) == 0) break;
+            }
+            m >>= 1;
+            b = (b & 1) ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+        }
+        return p;
+    }
+};
+
+const Crc32cTables& GetTables()
+{
+    static const Crc32cTables tables;
+    return tables;
+}
+
+#ifdef CRC32C_X86
+CRC32C_TARGET uint32_t Crc32cHardware(uint32_t crc, const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t c = ~crc;
+    while (size > 0 && ((uintptr_t)p & 7) != 0) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        size--;
+    }
+    while (size >= 8) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        c = _mm_crc32_u64(c, value);
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        size--;
+    }
+    return ~(uint32_t)c;
+}
+
+bool HasHardwareCrc32c()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+const char* HARDWARE_NAME = "sse4.2";
+#endif
+
+#ifdef CRC32C_ARM
+CRC32C_TARGET uint32_t Crc32cHardware(uint32_t crc, const void* data, size_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t c = ~crc;
+    while (size > 0 && ((uintptr_t)p & 7) != 0) {
+        c = __crc32cb(c, *p++);
+        size--;
+    }
+    while (size >= 8) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        c = __crc32cd(c, value);
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        c = __crc32cb(c, *p++);
+        size--;
+    }
+    return ~c;
+}
+
+bool HasHardwareCrc32c()
+{
+#if defined(_MSC_VER)
+    return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != 0;
+#elif defined(__ARM_FEATURE_CRC32) || defined(__APPLE__)
+    return true;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return false;
+#endif
+}
+
+const char* HARDWARE_NAME = "armv8-crc";
+#endif
+
+struct Crc32cDispatch
+{
+    uint32_t (*function)(uint32_t crc, const void* data, size_t size);
+    const char* name;
+};
+
+const Crc32cDispatch& GetDispatch()
+{
+    static const Crc32cDispatch dispatch = []() {
+#if defined(CRC32C_X86) || defined(CRC32C_ARM)
+        if (HasHardwareCrc32c()) return Crc32cDispatch{ Crc32cHardware, HARDWARE_NAME };
+#endif
+        return Crc32cDispatch{ Crc32cPortable, "slicing-by-8" };
+    }();
+    return dispatch;
+}
+
+}
+
+uint32_t Crc32cPortable(uint32_t crc, const void* data, size_t size)
+{
+    const uint32_t (*table)[256] = GetTables().slice;
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+
+    while (size > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+        size--;
+    }
+
+    // Eight bytes per step (little-endian loads)
+    while (size >= 8) {
+        uint32_t low, high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+        low ^= crc;
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        p += 8;
+        size -= 8;
+    }
+
+    while (size > 0) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+        size--;
+    }
+    return ~crc;
+}
+
+uint32_t Crc32c(uint32_t crc, const void* data, size_t size)
+{
+    return GetDispatch().function(crc, data, size);
+}
+
+uint32_t Crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t sizeB)
+{
+    // crcA shifted over sizeB zero bytes: multiply by x^(8 * sizeB)
+    const Crc32cTables& tables = GetTables();
+    uint32_t shift = 1u << 31;   // x^0
+    for (unsigned n = 3; sizeB > 0; sizeB >>= 1, n++) {
+        if (sizeB & 1) shift = Crc32cTables::MultModP(tables.x2n[n & 31], shift);
+    }
+    return Crc32cTables::MultModP(shift, crcA) ^ crcB;
+}
+
+const char* GetCrc32cImplementation()
+{
+    return GetDispatch().name;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC32C (Castagnoli), the checksum of iSCSI, ext4 and cloud object stores.
+// Uses the CPU's CRC instructions (SSE4.2 on x86, the ARMv8 CRC extension)
+// when present and slicing-by-8 tables otherwise; all give the same result.
+// Like zlib's crc32(): pass 0 to start and the previous result to continue.
+
+uint32_t Crc32c(uint32_t crc, const void* data, size_t size);
+
+// Table-driven implementation, e.g. to compare against
+uint32_t Crc32cPortable(uint32_t crc, const void* data, size_t size);
+
+// CRC of A followed by B from the CRCs of both parts and B's length
+uint32_t Crc32cCombine(uint32_t crcA, uint32_t crcB, uint64_t sizeB);
+
+// "sse4.2", "armv8-crc" or "slicing-by-8"
+const char* GetCrc32cImplementation();
@@ -0,0 +1,295 @@
+#include "coro_runtime.h"
+#include "thread_scheduling.h"
+
+namespace {
+
+// Ready slots allocated up front; the ring grows (once) beyond this many
+// coroutines ready at the same time
+const size_t READY_CAPACITY = 256;
+
+// Wait of the I/O thread for an output that cannot take data right now
+const uint32_t IO_WRITABLE_WAIT_MS = 50;
+
+// Busy waits before a write gives up with what it has written
+const int IO_MAX_BUSY_WAITS = 20;
+
+}
+
+// CoroTask
+
+CoroTask::~CoroTask()
+{
+    // Never spawned
+    if (m_handle) m_handle.destroy();
+}
+
+void CoroTask::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+{
+    CoroScheduler* scheduler = handle.promise().scheduler;
+    handle.destroy();
+    scheduler->OnTaskDone();
+}
+
+// CoroScheduler
+
+CoroScheduler::CoroScheduler(unsigned threads)
+{
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    m_ready.resize(READY_CAPACITY);
+    for (unsigned i = 0; i < threads; i++) {
+        m_workers.emplace_back(&CoroScheduler::WorkerThread, this);
+    }
+    m_ioThread = std::thread(&CoroScheduler::IoThread, this);
+}
+
+CoroScheduler::~CoroScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_timerWake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_ioMutex);
+        m_ioStopping = true;
+    }
+    m_ioWake.notify_all();
+    m_ioThread.join();
+}
+
+void CoroScheduler::Spawn(CoroTask task)
+{
+    std::coroutine_handle<CoroTask::promise_type> handle = task.m_handle;
+    task.m_handle = nullptr;
+    handle.promise().scheduler = this;
+    {
+        std::lock_guard<std::mutex> lock(m_liveMutex);
+        m_live++;
+    }
+    Schedule(handle);
+}
+
+void CoroScheduler::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_liveMutex);
+    m_idle.wait(lock, [this]() { return m_live == 0; });
+}
+
+void CoroScheduler::OnTaskDone()
+{
+    std::lock_guard<std::mutex> lock(m_liveMutex);
+    if (--m_live == 0) m_idle.notify_all();
+}
+
+void CoroScheduler::PushReady(std::coroutine_handle<> handle)
+{
+    if (m_readyCount == m_ready.size()) {
+        // Unroll the ring into a larger one
+        std::vector<std::coroutine_handle<>> ready(m_ready.size() * 2);
+        for (size_t i = 0; i < m_readyCount; i++) {
+            ready[i] = m_ready[(m_readyHead + i) % m_ready.size()];
+        }
+        m_ready.swap(ready);
+        m_readyHead = 0;
+    }
+    m_ready[(m_readyHead + m_readyCount++) % m_ready.size()] = handle;
+}
+
+void CoroScheduler::Schedule(std::coroutine_handle<> handle)
+{
+    // Wake a worker only if none is awake to pick it up anyway
+    bool wakeIdle = false;
+    bool wakeTimer = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        PushReady(handle);
+        if (m_idleWorkers > 0) {
+            wakeIdle = WakeIdleWorker();
+        } else if (m_timerWaiting) {
+            wakeTimer = true;
+        }
+    }
+    if (wakeIdle) {
+        m_wake.notify_one();
+    } else if (wakeTimer) {
+        m_timerWake.notify_one();
+    }
+}
+
+bool CoroScheduler::WakeIdleWorker()
+{
+    // Workers already woken take the first ready coroutines; a burst of
+    // them wakes no more workers than there is work
+    if (m_idleWorkers <= m_wakesPending || m_readyCount + (m_timers ? 1 : 0) <= m_wakesPending) return false;
+    m_wakesPending++;
+    return true;
+}
+
+void CoroScheduler::AddTimer(SleepAwaiter* timer)
+{
+    // A new first timer changes how long the timer worker waits; without
+    // one, an idle worker takes over the timers
+    bool wakeIdle = false;
+    bool wakeTimer = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        SleepAwaiter** link = &m_timers;
+        while (*link && (*link)->m_time <= timer->m_time) {
+            link = &(*link)->m_next;
+        }
+        timer->m_next = *link;
+        *link = timer;
+        if (m_timerWaiting) {
+            wakeTimer = m_timers == timer;
+        } else {
+            wakeIdle = WakeIdleWorker();
+        }
+    }
+    if (wakeTimer) {
+        m_timerWake.notify_one();
+    } else if (wakeIdle) {
+        m_wake.notify_one();
+    }
+}
+
+void CoroScheduler::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_handle = handle;
+    m_scheduler.AddTimer(this);
+}
+
+void CoroScheduler::WorkerThread()
+{
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Writer);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        while (m_timers && m_timers->m_time <= now) {
+            SleepAwaiter* timer = m_timers;
+            m_timers = timer->m_next;
+            PushReady(timer->m_handle);
+        }
+
+        if (m_readyCount > 0) {
+            std::coroutine_handle<> handle = m_ready[m_readyHead];
+            m_readyHead = (m_readyHead + 1) % m_ready.size();
+            m_readyCount--;
+
+            // While this one is busy, another worker takes the rest and the
+            // timers
+            if ((m_readyCount > 0 || (m_timers && !m_timerWaiting)) && WakeIdleWorker()) m_wake.notify_one();
+
+            lock.unlock();
+            handle.resume();
+            lock.lock();
+            continue;
+        }
+        if (m_stopping) break;
+
+        // One worker waits for the next timer, the others until woken
+        if (m_timers && !m_timerWaiting) {
+            // A copy: the timer may fire on another worker meanwhile
+            auto deadline = m_timers->m_time;
+            m_timerWaiting = true;
+            m_timerWake.wait_until(lock, deadline);
+            m_timerWaiting = false;
+        } else {
+            m_idleWorkers++;
+            m_wake.wait(lock);
+            m_idleWorkers--;
+            if (m_wakesPending > 0) m_wakesPending--;
+        }
+    }
+    lock.unlock();
+
+    ThreadScheduling::RestoreCurrentThread(scheduling);
+}
+
+void CoroScheduler::WriteAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_handle = handle;
+    m_scheduler.AddWrite(this);
+}
+
+void CoroScheduler::AddWrite(WriteAwaiter* write)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_ioMutex);
+        write->m_next = nullptr;
+        if (m_writesTail) {
+            m_writesTail->m_next = write;
+        } else {
+            m_writesHead = write;
+        }
+        m_writesTail = write;
+    }
+    m_ioWake.notify_one();
+}
+
+int64_t CoroScheduler::RunWrite(const WriteAwaiter& write)
+{
+    const IoSpan* spans = write.m_spans;
+    size_t count = write.m_count;
+    int64_t total = 0;
+    int busyWaits = 0;
+
+    for (;;) {
+        int64_t written = write.m_output.WriteGather(spans, count);
+        if (written < 0) return -1;
+        if (written == 0) {
+            if (++busyWaits > IO_MAX_BUSY_WAITS) return total;
+            write.m_output.WaitWritable(IO_WRITABLE_WAIT_MS);
+            continue;
+        }
+        total += written;
+
+        // Skip what was written; a partly written span continues from a copy
+        size_t index = 0;
+        uint64_t remaining = (uint64_t)written;
+        while (index < count && spans[index].size <= remaining) {
+            remaining -= spans[index].size;
+            index++;
+        }
+        if (index == count) return total;
+
+        if (spans == m_ioSpans.data()) {
+            m_ioSpans.erase(m_ioSpans.begin(), m_ioSpans.begin() + (ptrdiff_t)index);
+        } else {
+            m_ioSpans.assign(spans + index, spans + count);
+        }
+        m_ioSpans[0].data += remaining;
+        m_ioSpans[0].size -= (size_t)remaining;
+        spans = m_ioSpans.data();
+        count = m_ioSpans.size();
+    }
+}
+
+void CoroScheduler::IoThread()
+{
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Writer);
+
+    for (;;) {
+        WriteAwaiter* write = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_ioMutex);
+            m_ioWake.wait(lock, [this]() { return m_writesHead != nullptr || m_ioStopping; });
+            if (!m_writesHead) break;
+            write = m_writesHead;
+            m_writesHead = write->m_next;
+            if (!m_writesHead) m_writesTail = nullptr;
+        }
+
+        write->m_result = RunWrite(*write);
+        Schedule(write->m_handle);
+    }
+
+    ThreadScheduling::RestoreCurrentThread(scheduling);
+}
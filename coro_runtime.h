@@ -0,0 +1,400 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "batched_writer.h"
+
+// Small C++20 coroutine runtime behind the AudioSinks benchmark, which runs
+// the same sinks as thread-per-stage and as coroutines to compare the two.
+// The live pipeline (AudioCapture, AudioSession) does not use it; its
+// stages keep a thread each. Stages are coroutines (CoroTask) that wait on
+// packet queues (CoroQueue), timers (CoroScheduler::Sleep) and writes
+// (CoroScheduler::Write); a fixed pool of workers resumes whichever is
+// ready, and blocking writes run on one I/O thread so a slow output never
+// holds a worker. The realtime pump stays on its own thread and feeds the
+// queues with TryPush(), which never blocks on a consumer and allocates
+// nothing. Awaiters live in the coroutine frames and are linked
+// intrusively, so waiting allocates nothing either; only starting a task
+// allocates its frame.
+
+class CoroScheduler;
+
+// Coroutine run by a CoroScheduler: created suspended, started by Spawn(),
+// its frame is freed when it returns. Errors are reported through the
+// state the coroutine works on, not exceptions.
+class CoroTask
+{
+public:
+    struct promise_type
+    {
+        CoroScheduler* scheduler = nullptr;
+
+        CoroTask get_return_object()
+        {
+            return CoroTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept { return FinalAwaiter(); }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    CoroTask(CoroTask&& other) noexcept : m_handle(other.m_handle) { other.m_handle = nullptr; }
+    ~CoroTask();
+
+    CoroTask(const CoroTask&) = delete;
+    CoroTask& operator=(const CoroTask&) = delete;
+    CoroTask& operator=(CoroTask&&) = delete;
+
+private:
+    friend class CoroScheduler;
+
+    // Frees the frame and tells the scheduler the task is done
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+        void await_resume() noexcept {}
+    };
+
+    explicit CoroTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+// Fixed pool of workers resuming coroutines, with timers and an I/O thread.
+// Everything may be called from any thread, including the realtime pump
+// (Schedule allocates nothing once the ready queue has grown to the number
+// of coroutines). Wait() for the tasks before destroying the scheduler.
+class CoroScheduler
+{
+public:
+    // Resumes the awaiting coroutine once the time has come
+    class SleepAwaiter
+    {
+    public:
+        bool await_ready() const { return std::chrono::steady_clock::now() >= m_time; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const {}
+
+    private:
+        friend class CoroScheduler;
+        SleepAwaiter(CoroScheduler& scheduler, std::chrono::steady_clock::time_point time)
+            : m_scheduler(scheduler), m_time(time) {}
+
+        CoroScheduler& m_scheduler;
+        std::chrono::steady_clock::time_point m_time;
+        std::coroutine_handle<> m_handle;
+        SleepAwaiter* m_next = nullptr;
+    };
+
+    // Runs a write on the I/O thread; resumes with the bytes written (all of
+    // them unless the output failed or stayed busy), or -1 on failure
+    class WriteAwaiter
+    {
+    public:
+        bool await_ready() const { return m_count == 0; }
+        void await_suspend(std::coroutine_handle<> handle);
+        int64_t await_resume() const { return m_result; }
+
+    private:
+        friend class CoroScheduler;
+        WriteAwaiter(CoroScheduler& scheduler, ByteOutput& output, const IoSpan* spans, size_t count)
+            : m_scheduler(scheduler), m_output(output), m_spans(spans), m_count(count) {}
+
+        CoroScheduler& m_scheduler;
+        ByteOutput& m_output;
+        const IoSpan* m_spans;
+        size_t m_count;
+        int64_t m_result = 0;
+        std::coroutine_handle<> m_handle;
+        WriteAwaiter* m_next = nullptr;
+    };
+
+    // threads == 0: one worker per hardware thread
+    explicit CoroScheduler(unsigned threads = 0);
+    ~CoroScheduler();
+
+    CoroScheduler(const CoroScheduler&) = delete;
+    CoroScheduler& operator=(const CoroScheduler&) = delete;
+
+    // Start the task on a worker
+    void Spawn(CoroTask task);
+
+    // Block until every spawned task returned. Must not be called from a task.
+    void Wait();
+
+    // Resume `handle` on a worker
+    void Schedule(std::coroutine_handle<> handle);
+
+    // co_await scheduler.Sleep(ms): resume on a worker after `ms`
+    SleepAwaiter Sleep(uint32_t ms)
+    {
+        return SleepAwaiter(*this, std::chrono::steady_clock::now() + std::chrono::milliseconds(ms));
+    }
+
+    // co_await scheduler.Write(output, spans, count): the spans must stay
+    // valid until the coroutine resumes
+    WriteAwaiter Write(ByteOutput& output, const IoSpan* spans, size_t count)
+    {
+        return WriteAwaiter(*this, output, spans, count);
+    }
+
+private:
+    friend class CoroTask;
+
+    void WorkerThread();
+    void IoThread();
+    void AddTimer(SleepAwaiter* timer);
+    void AddWrite(WriteAwaiter* write);
+    int64_t RunWrite(const WriteAwaiter& write);
+    void PushReady(std::coroutine_handle<> handle);
+    bool WakeIdleWorker();
+    void OnTaskDone();
+
+    std::vector<std::thread> m_workers;
+    std::thread m_ioThread;
+
+    // Ready coroutines (ring) and timers (sorted by time), under m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_wake;        // Idle workers
+    std::condition_variable m_timerWake;   // The worker waiting for the next timer
+    std::vector<std::coroutine_handle<>> m_ready;
+    size_t m_readyHead = 0;
+    size_t m_readyCount = 0;
+    SleepAwaiter* m_timers = nullptr;
+    unsigned m_idleWorkers = 0;
+    unsigned m_wakesPending = 0;           // Idle workers notified but not yet running
+    bool m_timerWaiting = false;
+    bool m_stopping = false;
+
+    // Pending writes (FIFO), under m_ioMutex
+    std::mutex m_ioMutex;
+    std::condition_variable m_ioWake;
+    WriteAwaiter* m_writesHead = nullptr;
+    WriteAwaiter* m_writesTail = nullptr;
+    bool m_ioStopping = false;
+    std::vector<IoSpan> m_ioSpans;         // Remainder of a partial write
+
+    std::mutex m_liveMutex;
+    std::condition_variable m_idle;
+    size_t m_live = 0;                     // Spawned tasks not yet returned
+};
+
+// Bounded queue from producers (threads such as the realtime pump, or
+// coroutines) to one consumer coroutine. A value pushed while the consumer
+// waits is handed straight to it. Configure while unused; everything else
+// may be called from any thread.
+template <typename T>
+class CoroQueue
+{
+public:
+    class PopAwaiter
+    {
+    public:
+        bool await_ready() const { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) { return m_queue.SuspendPop(this, handle); }
+        bool await_resume() const { return m_result; }
+
+    private:
+        friend class CoroQueue;
+        PopAwaiter(CoroQueue& queue, T& value) : m_queue(queue), m_value(value) {}
+
+        CoroQueue& m_queue;
+        T& m_value;
+        bool m_result = false;
+        std::coroutine_handle<> m_handle;
+    };
+
+    class PushAwaiter
+    {
+    public:
+        bool await_ready() const { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) { return m_queue.SuspendPush(this, handle); }
+        bool await_resume() const { return m_result; }
+
+    private:
+        friend class CoroQueue;
+        PushAwaiter(CoroQueue& queue, const T& value) : m_queue(queue), m_value(value) {}
+
+        CoroQueue& m_queue;
+        T m_value;
+        bool m_result = false;
+        std::coroutine_handle<> m_handle;
+        PushAwaiter* m_next = nullptr;
+    };
+
+    explicit CoroQueue(CoroScheduler& scheduler) : m_scheduler(scheduler) {}
+
+    CoroQueue(const CoroQueue&) = delete;
+    CoroQueue& operator=(const CoroQueue&) = delete;
+
+    // Room for `capacity` values; reopens a closed queue
+    void Configure(size_t capacity)
+    {
+        m_items.assign(capacity > 0 ? capacity : 1, T());
+        m_head = 0;
+        m_count = 0;
+        m_closed = false;
+    }
+
+    // Never waits and allocates nothing; false if the queue is full or closed
+    bool TryPush(const T& value)
+    {
+        PopAwaiter* consumer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed) return false;
+            if (m_consumer) {
+                consumer = HandOver(value);
+            } else if (m_count < m_items.size()) {
+                m_items[(m_head + m_count++) % m_items.size()] = value;
+            } else {
+                return false;
+            }
+        }
+        if (consumer) m_scheduler.Schedule(consumer->m_handle);
+        return true;
+    }
+
+    // co_await queue.Push(value): waits while the queue is full; false if it
+    // is closed
+    PushAwaiter Push(const T& value) { return PushAwaiter(*this, value); }
+
+    // co_await queue.Pop(value): waits while the queue is empty; false once
+    // it is closed and drained
+    PopAwaiter Pop(T& value) { return PopAwaiter(*this, value); }
+
+    // Take a value if one is queued
+    bool TryPop(T& value)
+    {
+        PushAwaiter* producer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_count == 0) return false;
+            producer = TakeFront(value);
+        }
+        if (producer) m_scheduler.Schedule(producer->m_handle);
+        return true;
+    }
+
+    // No more values: waiting producers fail, the consumer drains what is
+    // queued and then Pop() returns false
+    void Close()
+    {
+        PopAwaiter* consumer = nullptr;
+        PushAwaiter* producers = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            consumer = m_consumer;
+            m_consumer = nullptr;
+            producers = m_producersHead;
+            m_producersHead = nullptr;
+            m_producersTail = nullptr;
+        }
+        // Each awaiter may be destroyed as soon as its coroutine resumes
+        while (producers) {
+            PushAwaiter* next = producers->m_next;
+            m_scheduler.Schedule(producers->m_handle);
+            producers = next;
+        }
+        if (consumer) m_scheduler.Schedule(consumer->m_handle);
+    }
+
+private:
+    // Give `value` to the waiting consumer (under the lock)
+    PopAwaiter* HandOver(const T& value)
+    {
+        PopAwaiter* consumer = m_consumer;
+        m_consumer = nullptr;
+        consumer->m_value = value;
+        consumer->m_result = true;
+        return consumer;
+    }
+
+    // Pop the front value and refill from the first waiting producer (under
+    // the lock); returns that producer to resume
+    PushAwaiter* TakeFront(T& value)
+    {
+        value = m_items[m_head];
+        m_head = (m_head + 1) % m_items.size();
+        m_count--;
+
+        PushAwaiter* producer = m_producersHead;
+        if (!producer) return nullptr;
+        m_producersHead = producer->m_next;
+        if (!m_producersHead) m_producersTail = nullptr;
+        m_items[(m_head + m_count++) % m_items.size()] = producer->m_value;
+        producer->m_result = true;
+        return producer;
+    }
+
+    bool SuspendPop(PopAwaiter* awaiter, std::coroutine_handle<> handle)
+    {
+        PushAwaiter* producer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_count > 0) {
+                producer = TakeFront(awaiter->m_value);
+                awaiter->m_result = true;
+            } else if (m_closed) {
+                awaiter->m_result = false;
+                return false;
+            } else {
+                awaiter->m_handle = handle;
+                m_consumer = awaiter;
+                return true;
+            }
+        }
+        if (producer) m_scheduler.Schedule(producer->m_handle);
+        return false;
+    }
+
+    bool SuspendPush(PushAwaiter* awaiter, std::coroutine_handle<> handle)
+    {
+        PopAwaiter* consumer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed) {
+                awaiter->m_result = false;
+                return false;
+            }
+            awaiter->m_result = true;
+            if (m_consumer) {
+                consumer = HandOver(awaiter->m_value);
+            } else if (m_count < m_items.size()) {
+                m_items[(m_head + m_count++) % m_items.size()] = awaiter->m_value;
+            } else {
+                awaiter->m_handle = handle;
+                awaiter->m_result = false;   // Until a slot frees up
+                if (m_producersTail) {
+                    m_producersTail->m_next = awaiter;
+                } else {
+                    m_producersHead = awaiter;
+                }
+                m_producersTail = awaiter;
+                return true;
+            }
+        }
+        if (consumer) m_scheduler.Schedule(consumer->m_handle);
+        return false;
+    }
+
+    CoroScheduler& m_scheduler;
+    std::mutex m_mutex;
+    std::vector<T> m_items;              // Ring
+    size_t m_head = 0;
+    size_t m_count = 0;
+    bool m_closed = false;
+    PopAwaiter* m_consumer = nullptr;    // Waiting in Pop()
+    PushAwaiter* m_producersHead = nullptr;
+    PushAwaiter* m_producersTail = nullptr;
+};
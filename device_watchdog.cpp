@@ -0,0 +1,112 @@
+#include "device_watchdog.h"
+
+void DeviceWatchdog::Start(int64_t nowUs)
+{
+    m_lost.store(false, std::memory_order_release);
+    m_cause = NoLoss;
+    m_lastSeenUs = nowUs;
+    m_errorRun = 0;
+    m_attempts = 0;
+    m_backoffMs = 0;
+}
+
+void DeviceWatchdog::OnPacket(int64_t nowUs)
+{
+    m_lastSeenUs = nowUs;
+    m_errorRun = 0;
+}
+
+void DeviceWatchdog::OnAlive(int64_t nowUs)
+{
+    m_lastSeenUs = nowUs;
+}
+
+void DeviceWatchdog::OnError(int64_t nowUs, bool invalidated)
+{
+    m_telemetry.errors.fetch_add(1, std::memory_order_relaxed);
+    if (IsLost()) return;
+
+    if (invalidated) {
+        OnLost(nowUs, DeviceInvalidated);
+    } else if (++m_errorRun >= m_config.errorLimit) {
+        OnLost(nowUs, RepeatedErrors);
+    }
+}
+
+void DeviceWatchdog::OnLost(int64_t nowUs, Cause cause)
+{
+    if (IsLost()) return;
+
+    m_cause = cause;
+    m_lostAtUs = nowUs;
+    m_attempts = 0;
+    m_backoffMs = m_config.initialBackoffMs;
+    m_nextRetryUs = nowUs + (int64_t)m_backoffMs * 1000;
+    m_telemetry.losses.fetch_add(1, std::memory_order_relaxed);
+    if (cause == Stalled) {
+        m_telemetry.stalls.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_lost.store(true, std::memory_order_release);
+}
+
+bool DeviceWatchdog::IsStalled(int64_t nowUs) const
+{
+    return !IsLost() && nowUs - m_lastSeenUs >= (int64_t)m_config.stallMs * 1000;
+}
+
+bool DeviceWatchdog::IsRetryDue(int64_t nowUs) const
+{
+    return IsLost() && nowUs >= m_nextRetryUs;
+}
+
+void DeviceWatchdog::OnRetryFailed(int64_t nowUs)
+{
+    m_attempts++;
+    m_telemetry.failedAttempts.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t next = (uint64_t)m_backoffMs * 2;
+    m_backoffMs = next < m_config.maxBackoffMs ? (uint32_t)next : m_config.maxBackoffMs;
+    m_nextRetryUs = nowUs + (int64_t)m_backoffMs * 1000;
+}
+
+int64_t DeviceWatchdog::OnRecovered(int64_t nowUs)
+{
+    int64_t recovery = nowUs - m_lostAtUs;
+    m_attempts++;
+    m_telemetry.recoveries.fetch_add(1, std::memory_order_relaxed);
+    m_telemetry.lastRecoveryUs.store(recovery, std::memory_order_relaxed);
+    m_telemetry.totalRecoveryUs.fetch_add(recovery, std::memory_order_relaxed);
+    if (recovery > m_telemetry.maxRecoveryUs.load(std::memory_order_relaxed)) {
+        m_telemetry.maxRecoveryUs.store(recovery, std::memory_order_relaxed);
+    }
+
+    m_cause = NoLoss;
+    m_lastSeenUs = nowUs;
+    m_errorRun = 0;
+    m_lost.store(false, std::memory_order_release);
+    return recovery;
+}
+
+void DeviceWatchdog::ResetTelemetry()
+{
+    m_telemetry.losses = 0;
+    m_telemetry.stalls = 0;
+    m_telemetry.errors = 0;
+    m_telemetry.recoveries = 0;
+    m_telemetry.failedAttempts = 0;
+    m_telemetry.lastRecoveryUs = 0;
+    m_telemetry.maxRecoveryUs = 0;
+    m_telemetry.totalRecoveryUs = 0;
+}
+
+const char* DeviceWatchdog::GetCauseName(Cause cause)
+{
+    switch (cause) {
+    case NoLoss: return "none";
+    case DeviceInvalidated: return "device invalidated";
+    case RepeatedErrors: return "repeated errors";
+    case Stalled: return "stalled";
+    case EndpointChanged: return "default endpoint changed";
+    default: return "unknown";
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Decides when a capture device counts as lost and when to try to get it
+// back. The capture loop reports what it sees (packets, failed calls, a
+// device confirmed present without packets); while the device is lost it
+// asks IsRetryDue() and re-acquires the device when it says so. Attempts
+// back off exponentially from initialBackoffMs up to maxBackoffMs.
+//
+// All calls come from the capture thread; times are microseconds on any
+// monotonic clock. The telemetry and IsLost() can be read from any thread.
+class DeviceWatchdog
+{
+public:
+    struct Config
+    {
+        uint32_t stallMs = 2000;          // No packets (or signs of life) this long is a stall
+        uint32_t errorLimit = 5;          // Consecutive failed calls that count as a loss
+        uint32_t initialBackoffMs = 20;   // First re-acquisition attempt after the loss
+        uint32_t maxBackoffMs = 2000;
+    };
+
+    enum Cause {
+        NoLoss,
+        DeviceInvalidated,   // AUDCLNT_E_DEVICE_INVALIDATED and similar
+        RepeatedErrors,
+        Stalled,
+        EndpointChanged      // Following the default device and it changed
+    };
+
+    struct Telemetry
+    {
+        std::atomic<uint64_t> losses{ 0 };
+        std::atomic<uint64_t> stalls{ 0 };          // Losses detected as stalls
+        std::atomic<uint64_t> errors{ 0 };          // Failed calls, including transient ones
+        std::atomic<uint64_t> recoveries{ 0 };
+        std::atomic<uint64_t> failedAttempts{ 0 };
+        std::atomic<int64_t> lastRecoveryUs{ 0 };   // Loss detected to device re-acquired
+        std::atomic<int64_t> maxRecoveryUs{ 0 };
+        std::atomic<int64_t> totalRecoveryUs{ 0 };
+    };
+
+    void Configure(const Config& config) { m_config = config; }
+    const Config& GetConfig() const { return m_config; }
+
+    // Capture (re)started with a working device
+    void Start(int64_t nowUs);
+
+    void OnPacket(int64_t nowUs);
+
+    // The device is known to be present although no packets arrive (e.g.
+    // loopback of a silent endpoint)
+    void OnAlive(int64_t nowUs);
+
+    // A device call failed; `invalidated` for errors that mean the device
+    // (or the audio service) is gone
+    void OnError(int64_t nowUs, bool invalidated);
+
+    void OnLost(int64_t nowUs, Cause cause);
+
+    // Healthy, but nothing heard from the device for stallMs
+    bool IsStalled(int64_t nowUs) const;
+
+    bool IsLost() const { return m_lost.load(std::memory_order_acquire); }
+    Cause GetLastCause() const { return m_cause; }
+    uint32_t GetAttempts() const { return m_attempts; }
+
+    // While lost: the next re-acquisition attempt is due
+    bool IsRetryDue(int64_t nowUs) const;
+    void OnRetryFailed(int64_t nowUs);
+
+    // Device re-acquired; returns the recovery time in microseconds
+    int64_t OnRecovered(int64_t nowUs);
+
+    const Telemetry& GetTelemetry() const { return m_telemetry; }
+    void ResetTelemetry();
+
+    static const char* GetCauseName(Cause cause);
+
+private:
+    Config m_config;
+    std::atomic<bool> m_lost{ false };
+    Cause m_cause = NoLoss;
+    int64_t m_lastSeenUs = 0;       // Last packet or sign of life
+    uint32_t m_errorRun = 0;        // Consecutive failed calls
+    int64_t m_lostAtUs = 0;
+    int64_t m_nextRetryUs = 0;
+    uint32_t m_backoffMs = 0;
+    uint32_t m_attempts = 0;
+    Telemetry m_telemetry;
+};
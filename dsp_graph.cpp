@@ -0,0 +1,170 @@
+#include "dsp_graph.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void DspNodeStats::Record(size_t blockFrames, uint64_t elapsed)
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    frames.fetch_add(blockFrames, std::memory_order_relaxed);
+    nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+    if (elapsed > maxNanoseconds.load(std::memory_order_relaxed)) {
+        maxNanoseconds.store(elapsed, std::memory_order_relaxed);
+    }
+}
+
+void DspNodeStats::Clear()
+{
+    calls.store(0, std::memory_order_relaxed);
+    frames.store(0, std::memory_order_relaxed);
+    nanoseconds.store(0, std::memory_order_relaxed);
+    maxNanoseconds.store(0, std::memory_order_relaxed);
+}
+
+void DspChain::Prepare(uint32_t sampleRate, uint32_t channels, size_t maxFrames)
+{
+    m_channels = channels;
+    m_maxFrames = maxFrames;
+    m_scratch.assign((size_t)channels * maxFrames, 0.0f);
+    m_channelPointers.resize(channels);
+    for (uint32_t c = 0; c < channels; c++) {
+        m_channelPointers[c] = m_scratch.data() + (size_t)c * maxFrames;
+    }
+
+    for (auto& node : m_nodes) {
+        node->Prepare(sampleRate, channels, maxFrames);
+        node->GetStats().Clear();
+    }
+}
+
+void DspChain::Reset()
+{
+    for (auto& node : m_nodes) {
+        node->Reset();
+    }
+}
+
+void DspChain::Process(AudioBlock& block)
+{
+    for (auto& node : m_nodes) {
+        if (!node->IsActive()) continue;
+        auto start = std::chrono::steady_clock::now();
+        node->Process(block);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        node->GetStats().Record(block.frames,
+            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+}
+
+void DspChain::InterleaveS16(int16_t* output, size_t frames)
+{
+    for (uint32_t c = 0; c < m_channels; c++) {
+        const float* samples = m_channelPointers[c];
+        for (size_t i = 0; i < frames; i++) {
+            float scaled = samples[i] * 32768.0f;
+            scaled = std::clamp(scaled, -32768.0f, 32767.0f);
+            output[i * m_channels + c] = (int16_t)lrintf(scaled);
+        }
+    }
+}
+
+void DspChain::ProcessS16(const int16_t* input, int16_t* output, size_t frames)
+{
+    // Work through the input in scratch-sized pieces
+    while (frames > 0) {
+        size_t count = std::min(frames, m_maxFrames);
+
+        for (uint32_t c = 0; c < m_channels; c++) {
+            float* samples = m_channelPointers[c];
+            for (size_t i = 0; i < count; i++) {
+                samples[i] = input[i * m_channels + c] / 32768.0f;
+            }
+        }
+
+        AudioBlock block;
+        block.channels = m_channelPointers.data();
+        block.channelCount = m_channels;
+        block.frames = count;
+        Process(block);
+
+        InterleaveS16(output, count);
+
+        input += count * m_channels;
+        output += count * m_channels;
+        frames -= count;
+    }
+}
+
+void DspChain::ProcessSilenceS16(int16_t* output, size_t frames)
+{
+    while (frames > 0) {
+        size_t count = std::min(frames, m_maxFrames);
+
+        for (uint32_t c = 0; c < m_channels; c++) {
+            std::fill(m_channelPointers[c], m_channelPointers[c] + count, 0.0f);
+        }
+
+        AudioBlock block;
+        block.channels = m_channelPointers.data();
+        block.channelCount = m_channels;
+        block.frames = count;
+        Process(block);
+
+        InterleaveS16(output, count);
+
+        output += count * m_channels;
+        frames -= count;
+    }
+}
+
+void DspChain::ProcessF32(const float* input, float* output, size_t frames)
+{
+    while (frames > 0) {
+        size_t count = std::min(frames, m_maxFrames);
+
+        for (uint32_t c = 0; c < m_channels; c++) {
+            float* samples = m_channelPointers[c];
+            if (input) {
+                for (size_t i = 0; i < count; i++) {
+                    samples[i] = input[i * m_channels + c];
+                }
+            } else {
+                std::fill(samples, samples + count, 0.0f);
+            }
+        }
+
+        AudioBlock block;
+        block.channels = m_channelPointers.data();
+        block.channelCount = m_channels;
+        block.frames = count;
+        Process(block);
+
+        for (uint32_t c = 0; c < m_channels; c++) {
+            const float* samples = m_channelPointers[c];
+            for (size_t i = 0; i < count; i++) {
+                output[i * m_channels + c] = samples[i];
+            }
+        }
+
+        if (input) input += count * m_channels;
+        output += count * m_channels;
+        frames -= count;
+    }
+}
+
+size_t DspChain::GetLatency() const
+{
+    size_t latency = 0;
+    for (const auto& node : m_nodes) {
+        latency += node->GetLatency();
+    }
+    return latency;
+}
+
+bool DspChain::IsActive() const
+{
+    for (const auto& node : m_nodes) {
+        if (node->IsActive()) return true;
+    }
+    return false;
+}
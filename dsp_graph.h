@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+// Planar block of float audio processed in place by DSP nodes
+struct AudioBlock
+{
+    float* const* channels = nullptr;   // channelCount pointers to `frames` samples
+    uint32_t channelCount = 0;
+    size_t frames = 0;
+};
+
+// Cost counters kept per node (updated by the processing thread, readable
+// from any thread)
+struct DspNodeStats
+{
+    std::atomic<uint64_t> calls{ 0 };
+    std::atomic<uint64_t> frames{ 0 };
+    std::atomic<uint64_t> nanoseconds{ 0 };
+    std::atomic<uint64_t> maxNanoseconds{ 0 };
+
+    void Record(size_t blockFrames, uint64_t elapsed);
+    void Clear();
+};
+
+// Block-based processing node. Nodes process the block in place.
+class DspNode
+{
+public:
+    virtual ~DspNode() = default;
+
+    // Called before processing starts (may allocate)
+    virtual void Prepare(uint32_t sampleRate, uint32_t channels, size_t maxFrames) = 0;
+
+    // Process one block in place (must not allocate)
+    virtual void Process(AudioBlock& block) = 0;
+
+    // Clear filter/envelope state without changing parameters
+    virtual void Reset() {}
+
+    // Algorithmic delay in frames
+    virtual size_t GetLatency() const { return 0; }
+
+    // Whether Process() can currently change the block. Inactive nodes are
+    // skipped; a node with latency must stay active. Polled per block on the
+    // processing thread.
+    virtual bool IsActive() const { return true; }
+
+    virtual const char* GetName() const = 0;
+
+    DspNodeStats& GetStats() { return m_stats; }
+    const DspNodeStats& GetStats() const { return m_stats; }
+
+private:
+    DspNodeStats m_stats;
+};
+
+// Compile-time chain of per-sample stages fused into a single loop.
+// Each Stage provides:
+//   static constexpr const char* NAME;
+//   void Prepare(uint32_t sampleRate, uint32_t channels);
+//   void Reset();
+//   void BeginBlock();                    // Latch parameters for the block
+//   float ProcessSample(float x, uint32_t channel);
+//   size_t GetLatency() const;
+//   bool IsActive() const;                // False while the stage is a pass-through
+// The samples of a channel pass through every stage in one pass, so adjacent
+// stages cost no extra memory traffic.
+template <typename... Stages>
+class FusedChain : public DspNode
+{
+public:
+    void Prepare(uint32_t sampleRate, uint32_t channels, size_t) override
+    {
+        std::apply([&](auto&... stage) { (stage.Prepare(sampleRate, channels), ...); }, m_stages);
+    }
+
+    void Process(AudioBlock& block) override
+    {
+        std::apply([](auto&... stage) { (stage.BeginBlock(), ...); }, m_stages);
+
+        for (uint32_t c = 0; c < block.channelCount; c++) {
+            float* samples = block.channels[c];
+            for (size_t i = 0; i < block.frames; i++) {
+                float x = samples[i];
+                std::apply([&](auto&... stage) { ((x = stage.ProcessSample(x, c)), ...); }, m_stages);
+                samples[i] = x;
+            }
+        }
+    }
+
+    void Reset() override
+    {
+        std::apply([](auto&... stage) { (stage.Reset(), ...); }, m_stages);
+    }
+
+    size_t GetLatency() const override
+    {
+        return std::apply([](const auto&... stage) { return (size_t(0) + ... + stage.GetLatency()); }, m_stages);
+    }
+
+    bool IsActive() const override
+    {
+        return std::apply([](const auto&... stage) { return (false || ... || stage.IsActive()); }, m_stages);
+    }
+
+    const char* GetName() const override
+    {
+        if constexpr (sizeof...(Stages) == 1) {
+            return std::tuple_element_t<0, std::tuple<Stages...>>::NAME;
+        } else {
+            return "FusedChain";
+        }
+    }
+
+    template <typename Stage>
+    Stage& Get() { return std::get<Stage>(m_stages); }
+
+private:
+    std::tuple<Stages...> m_stages;
+};
+
+// A single stage as a standalone node
+template <typename Stage>
+using StageNode = FusedChain<Stage>;
+
+// Runtime-configurable chain of nodes applied in place, in order.
+// Configure (Add/Clear/Prepare) only while no thread is processing.
+class DspChain
+{
+public:
+    DspChain() = default;
+
+    DspChain(const DspChain&) = delete;
+    DspChain& operator=(const DspChain&) = delete;
+
+    // Append a node; returns it for parameter access
+    template <typename Node>
+    Node* Add(std::unique_ptr<Node> node)
+    {
+        Node* raw = node.get();
+        m_nodes.push_back(std::move(node));
+        return raw;
+    }
+
+    void Clear() { m_nodes.clear(); }
+
+    // Allocate per-node state and the planar scratch buffers
+    void Prepare(uint32_t sampleRate, uint32_t channels, size_t maxFrames);
+    void Reset();
+
+    // Run every active node on the block, updating each node's cost counters
+    void Process(AudioBlock& block);
+
+    // Convenience for interleaved 16-bit PCM: deinterleave into the planar
+    // scratch, process, then write saturated samples to `output` (which may
+    // alias `input`). frames must not exceed the prepared maxFrames.
+    void ProcessS16(const int16_t* input, int16_t* output, size_t frames);
+
+    // Same, with a block of silence as input (used to flush latency)
+    void ProcessSilenceS16(int16_t* output, size_t frames);
+
+    // Interleaved float in and out, for sources that are requantized after
+    // the chain (see Requantizer). A null input processes silence.
+    void ProcessF32(const float* input, float* output, size_t frames);
+
+    // Total algorithmic delay of the chain in frames
+    size_t GetLatency() const;
+
+    // Whether any node is active; when not, the chain is an identity and
+    // callers can copy the signal instead of processing it
+    bool IsActive() const;
+
+    bool IsEmpty() const { return m_nodes.empty(); }
+    size_t GetNodeCount() const { return m_nodes.size(); }
+    DspNode& GetNode(size_t index) { return *m_nodes[index]; }
+    const DspNode& GetNode(size_t index) const { return *m_nodes[index]; }
+
+private:
+    void InterleaveS16(int16_t* output, size_t frames);
+
+    std::vector<std::unique_ptr<DspNode>> m_nodes;
+    std::vector<float> m_scratch;            // Planar, channel c at c * m_maxFrames
+    std::vector<float*> m_channelPointers;
+    uint32_t m_channels = 0;
+    size_t m_maxFrames = 0;
+};
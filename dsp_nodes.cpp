@@ -0,0 +1,109 @@
+#include "dsp_nodes.h"
+#include <algorithm>
+
+namespace {
+
+const float PI = 3.14159265f;
+const float GAIN_RAMP_MS = 5.0f;
+
+// A ramp this close to unity is finished (the one-pole never reaches it exactly)
+const float GAIN_UNITY_TOLERANCE = 1e-6f;
+
+// One-pole coefficient reaching ~63% of a step after `ms` milliseconds
+float OnePoleCoefficient(float ms, uint32_t sampleRate)
+{
+    float samples = ms * 0.001f * (float)sampleRate;
+    return samples <= 1.0f ? 1.0f : 1.0f - expf(-1.0f / samples);
+}
+
+}
+
+void GainStage::Prepare(uint32_t sampleRate, uint32_t channels)
+{
+    m_smoothing = OnePoleCoefficient(GAIN_RAMP_MS, sampleRate);
+    m_gain.assign(channels, m_targetGain.load(std::memory_order_relaxed));
+}
+
+void GainStage::Reset()
+{
+    std::fill(m_gain.begin(), m_gain.end(), m_targetGain.load(std::memory_order_relaxed));
+}
+
+bool GainStage::IsActive() const
+{
+    // Stays active until a ramp back to 0 dB has settled
+    if (m_targetGain.load(std::memory_order_relaxed) != 1.0f) return true;
+    for (float gain : m_gain) {
+        if (fabsf(gain - 1.0f) > GAIN_UNITY_TOLERANCE) return true;
+    }
+    return false;
+}
+
+void DcBlockerStage::Prepare(uint32_t sampleRate, uint32_t channels)
+{
+    m_r = expf(-2.0f * PI * m_cutoff / (float)sampleRate);
+    m_x1.assign(channels, 0.0f);
+    m_y1.assign(channels, 0.0f);
+}
+
+void DcBlockerStage::Reset()
+{
+    std::fill(m_x1.begin(), m_x1.end(), 0.0f);
+    std::fill(m_y1.begin(), m_y1.end(), 0.0f);
+}
+
+void NoiseGateStage::SetTiming(float attackMs, float holdMs, float releaseMs)
+{
+    m_attackMs = attackMs;
+    m_holdMs = holdMs;
+    m_releaseMs = releaseMs;
+}
+
+void NoiseGateStage::Prepare(uint32_t sampleRate, uint32_t channels)
+{
+    m_attack = OnePoleCoefficient(m_attackMs, sampleRate);
+    m_release = OnePoleCoefficient(m_releaseMs, sampleRate);
+    m_holdSamples = (uint32_t)(m_holdMs * 0.001f * (float)sampleRate);
+
+    // Envelope falls 60 dB over 10 ms
+    m_envelopeDecay = powf(0.001f, 1.0f / (0.010f * (float)sampleRate));
+
+    m_envelope.assign(channels, 0.0f);
+    m_gain.assign(channels, 0.0f);
+    m_holdRemaining.assign(channels, 0);
+}
+
+void NoiseGateStage::Reset()
+{
+    std::fill(m_envelope.begin(), m_envelope.end(), 0.0f);
+    std::fill(m_gain.begin(), m_gain.end(), 0.0f);
+    std::fill(m_holdRemaining.begin(), m_holdRemaining.end(), 0);
+}
+
+void LimiterStage::SetTiming(float lookaheadMs, float releaseMs)
+{
+    m_lookaheadMs = lookaheadMs;
+    m_releaseMs = releaseMs;
+}
+
+void LimiterStage::Prepare(uint32_t sampleRate, uint32_t channels)
+{
+    // The limiter is bypassed (and adds no latency) unless enabled at Prepare
+    m_lookahead = m_enabled.load(std::memory_order_relaxed)
+        ? std::max<size_t>(1, (size_t)(m_lookaheadMs * 0.001f * (float)sampleRate))
+        : 0;
+    m_release = OnePoleCoefficient(m_releaseMs, sampleRate);
+
+    m_delay.assign(channels * m_lookahead, 0.0f);
+    m_minValues.assign(channels * (m_lookahead + 1), 1.0f);
+    m_minIndices.assign(channels * (m_lookahead + 1), 0);
+    m_state.assign(channels, ChannelState());
+}
+
+void LimiterStage::Reset()
+{
+    std::fill(m_delay.begin(), m_delay.end(), 0.0f);
+    std::fill(m_minValues.begin(), m_minValues.end(), 1.0f);
+    std::fill(m_minIndices.begin(), m_minIndices.end(), 0);
+    std::fill(m_state.begin(), m_state.end(), ChannelState());
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "dsp_graph.h"
+
+// Per-sample processing stages for FusedChain (see dsp_graph.h).
+// Parameters are set from any thread through atomics and latched once per
+// block in BeginBlock(); all state is allocated in Prepare().
+
+// Gain with a short one-pole ramp to avoid zipper noise
+class GainStage
+{
+public:
+    static constexpr const char* NAME = "Gain";
+
+    void SetGainDb(float db) { m_targetGain.store(powf(10.0f, db / 20.0f), std::memory_order_relaxed); }
+
+    void Prepare(uint32_t sampleRate, uint32_t channels);
+    void Reset();
+    void BeginBlock() { m_blockTarget = m_targetGain.load(std::memory_order_relaxed); }
+    size_t GetLatency() const { return 0; }
+    bool IsActive() const;
+
+    float ProcessSample(float x, uint32_t channel)
+    {
+        float& gain = m_gain[channel];
+        gain += (m_blockTarget - gain) * m_smoothing;
+        return x * gain;
+    }
+
+private:
+    std::atomic<float> m_targetGain{ 1.0f };
+    float m_blockTarget = 1.0f;
+    float m_smoothing = 1.0f;
+    std::vector<float> m_gain;
+};
+
+// First-order DC-blocking high-pass: y[n] = x[n] - x[n-1] + R * y[n-1]
+class DcBlockerStage
+{
+public:
+    static constexpr const char* NAME = "DcBlocker";
+
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    void SetCutoff(float hz) { m_cutoff = hz; }  // Takes effect on Prepare
+
+    void Prepare(uint32_t sampleRate, uint32_t channels);
+    void Reset();
+    void BeginBlock() { m_blockEnabled = m_enabled.load(std::memory_order_relaxed); }
+    size_t GetLatency() const { return 0; }
+    bool IsActive() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    float ProcessSample(float x, uint32_t channel)
+    {
+        if (!m_blockEnabled) return x;
+        float y = x - m_x1[channel] + m_r * m_y1[channel];
+        m_x1[channel] = x;
+        m_y1[channel] = y;
+        return y;
+    }
+
+private:
+    std::atomic<bool> m_enabled{ false };
+    bool m_blockEnabled = false;
+    float m_cutoff = 5.0f;
+    float m_r = 0.0f;
+    std::vector<float> m_x1;
+    std::vector<float> m_y1;
+};
+
+// Noise gate with peak envelope, hold time and smoothed open/close
+class NoiseGateStage
+{
+public:
+    static constexpr const char* NAME = "NoiseGate";
+
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    void SetThresholdDb(float db) { m_threshold.store(powf(10.0f, db / 20.0f), std::memory_order_relaxed); }
+
+    // Timing in milliseconds, takes effect on Prepare
+    void SetTiming(float attackMs, float holdMs, float releaseMs);
+
+    void Prepare(uint32_t sampleRate, uint32_t channels);
+    void Reset();
+    void BeginBlock()
+    {
+        m_blockEnabled = m_enabled.load(std::memory_order_relaxed);
+        m_blockThreshold = m_threshold.load(std::memory_order_relaxed);
+    }
+    size_t GetLatency() const { return 0; }
+    bool IsActive() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    float ProcessSample(float x, uint32_t channel)
+    {
+        if (!m_blockEnabled) return x;
+
+        float& envelope = m_envelope[channel];
+        float& gain = m_gain[channel];
+        uint32_t& hold = m_holdRemaining[channel];
+
+        envelope = fmaxf(fabsf(x), envelope * m_envelopeDecay);
+
+        float target;
+        if (envelope >= m_blockThreshold) {
+            hold = m_holdSamples;
+            target = 1.0f;
+        } else if (hold > 0) {
+            hold--;
+            target = 1.0f;
+        } else {
+            target = 0.0f;
+        }
+
+        float coeff = target > gain ? m_attack : m_release;
+        gain += (target - gain) * coeff;
+        return x * gain;
+    }
+
+private:
+    std::atomic<bool> m_enabled{ false };
+    std::atomic<float> m_threshold{ 0.001f };  // -60 dBFS
+    bool m_blockEnabled = false;
+    float m_blockThreshold = 0.001f;
+    float m_attackMs = 1.0f;
+    float m_holdMs = 50.0f;
+    float m_releaseMs = 100.0f;
+    float m_attack = 1.0f;
+    float m_release = 1.0f;
+    float m_envelopeDecay = 0.0f;
+    uint32_t m_holdSamples = 0;
+    std::vector<float> m_envelope;
+    std::vector<float> m_gain;
+    std::vector<uint32_t> m_holdRemaining;
+};
+
+// Look-ahead peak limiter. The signal is delayed by the look-ahead so the
+// gain reduction (sliding-window minimum of the required gain) is in place
+// before a peak arrives. Latency is fixed at Prepare.
+class LimiterStage
+{
+public:
+    static constexpr const char* NAME = "Limiter";
+
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    void SetCeilingDb(float db) { m_ceiling.store(powf(10.0f, db / 20.0f), std::memory_order_relaxed); }
+
+    // Look-ahead (fixes the latency) and release, take effect on Prepare
+    void SetTiming(float lookaheadMs, float releaseMs);
+
+    void Prepare(uint32_t sampleRate, uint32_t channels);
+    void Reset();
+    void BeginBlock()
+    {
+        m_blockEnabled = m_enabled.load(std::memory_order_relaxed);
+        m_blockCeiling = m_ceiling.load(std::memory_order_relaxed);
+    }
+    size_t GetLatency() const { return m_lookahead; }
+    bool IsActive() const { return m_lookahead > 0; }
+
+    float ProcessSample(float x, uint32_t channel)
+    {
+        if (m_lookahead == 0) return x;
+
+        const size_t window = m_lookahead + 1;
+        float* delay = m_delay.data() + channel * m_lookahead;
+        float* minValues = m_minValues.data() + channel * window;
+        uint64_t* minIndices = m_minIndices.data() + channel * window;
+        ChannelState& state = m_state[channel];
+
+        // Delay line
+        size_t slot = (size_t)(state.position % m_lookahead);
+        float delayed = delay[slot];
+        delay[slot] = x;
+
+        // Required gain for the incoming sample
+        float magnitude = fabsf(x);
+        float required = (m_blockEnabled && magnitude > m_blockCeiling) ? m_blockCeiling / magnitude : 1.0f;
+
+        // Sliding-window minimum (monotonic deque in a ring)
+        while (state.count > 0) {
+            size_t back = (state.head + state.count - 1) % window;
+            if (minValues[back] > required) break;
+            state.count--;
+        }
+        size_t tail = (state.head + state.count) % window;
+        minValues[tail] = required;
+        minIndices[tail] = state.position;
+        state.count++;
+        if (minIndices[state.head] + window <= state.position) {
+            state.head = (state.head + 1) % window;
+            state.count--;
+        }
+        float windowMin = minValues[state.head];
+
+        // Drop immediately, recover with the release time
+        if (windowMin < state.gain) {
+            state.gain = windowMin;
+        } else {
+            state.gain += (windowMin - state.gain) * m_release;
+        }
+
+        state.position++;
+        float y = delayed * state.gain;
+        if (m_blockEnabled) {
+            y = fminf(fmaxf(y, -m_blockCeiling), m_blockCeiling);
+        }
+        return y;
+    }
+
+private:
+    struct ChannelState
+    {
+        uint64_t position = 0;
+        size_t head = 0;
+        size_t count = 0;
+        float gain = 1.0f;
+    };
+
+    std::atomic<bool> m_enabled{ false };
+    std::atomic<float> m_ceiling{ 0.989f };  // -0.1 dBFS
+    bool m_blockEnabled = false;
+    float m_blockCeiling = 0.989f;
+    float m_lookaheadMs = 1.5f;
+    float m_releaseMs = 50.0f;
+    float m_release = 1.0f;
+    size_t m_lookahead = 0;
+    std::vector<float> m_delay;
+    std::vector<float> m_minValues;
+    std::vector<uint64_t> m_minIndices;
+    std::vector<ChannelState> m_state;
+};
+
+// Recording chain applied before the file write: gain, DC blocker, noise
+// gate and limiter fused into one loop
+using RecordingStages = FusedChain<GainStage, DcBlockerStage, NoiseGateStage, LimiterStage>;
@@ -0,0 +1,396 @@
+#include "event_detector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Analysis block; every detector works on whole blocks
+const uint32_t BLOCK_MS = 5;
+
+// Clipping: runs of at least this many full-scale samples, merged into one
+// event while they follow each other within the merge window
+const uint32_t CLIP_MIN_RUN = 3;
+const uint32_t CLIP_MERGE_MS = 50;
+
+// Digital silence shorter than this is not reported
+const uint32_t DROPOUT_MIN_MS = 10;
+
+// DC offset: mean of a 1 s window beyond -40 dBFS
+const uint32_t DC_WINDOW_BLOCKS = 1000 / BLOCK_MS;
+const double DC_THRESHOLD = 0.01;
+
+// Level jump: consecutive 100 ms windows differing by 20 dB, the louder one
+// above -50 dBFS; one report per second at most
+const uint32_t LEVEL_WINDOW_BLOCKS = 100 / BLOCK_MS;
+const double LEVEL_JUMP_DB = 20.0;
+const double LEVEL_FLOOR = 1e-5;
+const uint32_t JUMP_HOLDOFF_MS = 1000;
+
+// Transient: a block 15 dB above the average of the last ~100 ms and above
+// -40 dBFS, at most one per 100 ms
+const double TRANSIENT_RATIO = 31.6227766;
+const double TRANSIENT_FLOOR = 1e-4;
+const double TRANSIENT_AVERAGE_MS = 100.0;
+const uint32_t TRANSIENT_HOLDOFF_MS = 100;
+
+// Events held between two TakeEvents() calls
+const size_t EVENT_BUFFER = 4096;
+
+const char* const EVENT_TYPE_NAMES[EVENT_TYPE_COUNT + 1] = {
+    nullptr, "clipping", "dropout", "dc", "jump", "transient"
+};
+
+// Largest sample magnitude of the encoding, in the kernels' float scale
+float GetClipLevel(SampleType type)
+{
+    switch (type) {
+        case SampleS16: return 32767.0f / 32768.0f;
+        case SampleS24: return 8388607.0f / 8388608.0f;
+        default: return 1.0f;
+    }
+}
+
+double ToDb(double ratio)
+{
+    return 10.0 * std::log10(ratio);
+}
+
+}
+
+const char* GetEventTypeName(uint16_t type)
+{
+    return type <= EVENT_TYPE_COUNT ? EVENT_TYPE_NAMES[type] : nullptr;
+}
+
+uint16_t ParseEventType(const char* name)
+{
+    for (uint16_t type = 1; type <= EVENT_TYPE_COUNT; type++) {
+        if (strcmp(name, EVENT_TYPE_NAMES[type]) == 0) return type;
+    }
+    return 0;
+}
+
+bool EventDetector::Configure(uint16_t channels, uint32_t sampleRate, SampleType type)
+{
+    m_kernels = GetPacketKernels(type, channels);
+    if (!m_kernels || sampleRate == 0) return false;
+
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+    m_frameSize = channels * GetSampleSize(type);
+    m_clipLevel = GetClipLevel(type);
+
+    // A whole number of lanes per block
+    m_blockFrames = std::max<uint32_t>(sampleRate * BLOCK_MS / 1000 / LANES * LANES, LANES * 8);
+    m_blocksPerLevel = LEVEL_WINDOW_BLOCKS;
+    m_blocksPerDc = DC_WINDOW_BLOCKS;
+    m_clipMerge = sampleRate * CLIP_MERGE_MS / 1000;
+    m_dropoutMinimum = sampleRate * DROPOUT_MIN_MS / 1000;
+    m_jumpHoldoff = sampleRate * JUMP_HOLDOFF_MS / 1000;
+    m_transientHoldoff = sampleRate * TRANSIENT_HOLDOFF_MS / 1000;
+    m_averageWeight = 1.0 - std::exp(-(double)m_blockFrames / sampleRate * 1000.0 / TRANSIENT_AVERAGE_MS);
+
+    m_state.assign(channels, Channel());
+    m_block.assign((size_t)m_blockFrames * channels, 0.0f);
+    m_planes.assign(channels, nullptr);
+    m_blockUsed = 0;
+    m_blockStart = 0;
+    m_blockCount = 0;
+    m_carry.assign(m_frameSize, 0);
+    m_carryUsed = 0;
+    m_pending.assign(EVENT_BUFFER, DetectedEvent());
+    m_pendingCount = 0;
+    m_frames = 0;
+    for (std::atomic<uint64_t>& count : m_counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    m_dropped.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+void EventDetector::AddBytes(const uint8_t* data, size_t size)
+{
+    if (!m_kernels) return;
+
+    // Complete a frame left over from the previous call
+    if (m_carryUsed > 0) {
+        size_t part = std::min(m_frameSize - m_carryUsed, size);
+        memcpy(m_carry.data() + m_carryUsed, data, part);
+        m_carryUsed += part;
+        data += part;
+        size -= part;
+        if (m_carryUsed < m_frameSize) return;
+
+        m_carryUsed = 0;
+        AddBytes(m_carry.data(), m_frameSize);
+    }
+
+    size_t frames = size / m_frameSize;
+    while (frames > 0) {
+        uint32_t take = (uint32_t)std::min<size_t>(frames, m_blockFrames - m_blockUsed);
+        for (uint16_t c = 0; c < m_channels; c++) {
+            m_planes[c] = m_block.data() + (size_t)c * m_blockFrames + m_blockUsed;
+        }
+        m_kernels->toPlanar(data, take, m_channels, m_planes.data());
+
+        data += take * m_frameSize;
+        frames -= take;
+        m_frames += take;
+        m_blockUsed += take;
+        if (m_blockUsed == m_blockFrames) {
+            AnalyzeBlock(m_blockFrames);
+        }
+    }
+
+    size_t rest = size % m_frameSize;
+    if (rest > 0) {
+        memcpy(m_carry.data(), data, rest);
+        m_carryUsed = rest;
+    }
+}
+
+void EventDetector::Flush()
+{
+    if (!m_kernels) return;
+
+    if (m_blockUsed > 0) {
+        AnalyzeBlock(m_blockUsed);
+    }
+    for (uint16_t c = 0; c < m_channels; c++) {
+        Channel& state = m_state[c];
+        if (state.clipRunLength > 0) {
+            ScanClipping(state, c, nullptr, 0);
+        }
+        if (state.clipOpen) {
+            CloseClipping(state, c);
+        }
+        CloseZeros(state, c);
+        if (state.dcOpen) {
+            Emit(EventDcOffset, c, state.dcStart, m_blockStart - state.dcStart, state.dcValue);
+            state.dcOpen = false;
+        }
+    }
+    m_carryUsed = 0;
+}
+
+void EventDetector::AnalyzeBlock(uint32_t frames)
+{
+    const uint64_t blockEnd = m_blockStart + frames;
+    const bool fullBlock = frames == m_blockFrames;
+    const bool levelDone = fullBlock && (m_blockCount + 1) % m_blocksPerLevel == 0;
+    const bool dcDone = fullBlock && (m_blockCount + 1) % m_blocksPerDc == 0;
+    const uint32_t vectorFrames = frames / LANES * LANES;
+
+    for (uint16_t c = 0; c < m_channels; c++) {
+        Channel& state = m_state[c];
+        const float* __restrict samples = m_block.data() + (size_t)c * m_blockFrames;
+
+        // One pass for all statistics, eight independent lanes
+        float sum[LANES] = {};
+        float squares[LANES] = {};
+        int32_t clipped[LANES] = {};
+        int32_t zeros[LANES] = {};
+        const float clipLevel = m_clipLevel;
+        for (uint32_t i = 0; i < vectorFrames; i += LANES) {
+            for (size_t lane = 0; lane < LANES; lane++) {
+                float value = samples[i + lane];
+                sum[lane] += value;
+                squares[lane] += value * value;
+                clipped[lane] += std::fabs(value) >= clipLevel ? 1 : 0;
+                zeros[lane] += value == 0.0f ? 1 : 0;
+            }
+        }
+        double blockSum = 0.0;
+        double blockSquares = 0.0;
+        uint32_t clipCount = 0;
+        uint32_t zeroCount = 0;
+        for (size_t lane = 0; lane < LANES; lane++) {
+            blockSum += sum[lane];
+            blockSquares += squares[lane];
+            clipCount += (uint32_t)clipped[lane];
+            zeroCount += (uint32_t)zeros[lane];
+        }
+        for (uint32_t i = vectorFrames; i < frames; i++) {
+            float value = samples[i];
+            blockSum += value;
+            blockSquares += value * value;
+            clipCount += std::fabs(value) >= clipLevel ? 1 : 0;
+            zeroCount += value == 0.0f ? 1 : 0;
+        }
+
+        // Clipping: sample-exact runs only where there are clipped samples
+        if (clipCount > 0 || state.clipRunLength > 0) {
+            ScanClipping(state, c, samples, clipCount > 0 ? frames : 0);
+        }
+        if (state.clipOpen && state.clipRunLength == 0 && blockEnd - state.clipEnd > m_clipMerge) {
+            CloseClipping(state, c);
+        }
+
+        // Digital silence: whole blocks extend the run, mixed ones are scanned
+        if (zeroCount == frames) {
+            if (state.zeroLength == 0) state.zeroStart = m_blockStart;
+            state.zeroLength += frames;
+        } else if (zeroCount == 0) {
+            CloseZeros(state, c);
+        } else {
+            ScanZeros(state, c, samples, frames);
+        }
+
+        // DC offset over whole windows
+        state.dcSum += blockSum;
+        if (dcDone) {
+            const uint64_t windowFrames = (uint64_t)m_blocksPerDc * m_blockFrames;
+            const double mean = state.dcSum / windowFrames;
+            if (std::fabs(mean) >= DC_THRESHOLD) {
+                if (!state.dcOpen) {
+                    state.dcOpen = true;
+                    state.dcStart = blockEnd - windowFrames;
+                    state.dcValue = (float)mean;
+                } else if (std::fabs(mean) > std::fabs(state.dcValue)) {
+                    state.dcValue = (float)mean;
+                }
+            } else if (state.dcOpen) {
+                Emit(EventDcOffset, c, state.dcStart, blockEnd - windowFrames - state.dcStart, state.dcValue);
+                state.dcOpen = false;
+            }
+            state.dcSum = 0.0;
+        }
+
+        // Level jumps between consecutive windows; silence is left to the
+        // dropout detector
+        state.levelEnergy += blockSquares;
+        if (levelDone) {
+            const uint64_t windowFrames = (uint64_t)m_blocksPerLevel * m_blockFrames;
+            const uint64_t windowStart = blockEnd - windowFrames;
+            const double energy = state.levelEnergy / windowFrames;
+            const double last = state.lastLevelEnergy;
+            if (last > 0.0 && energy > 0.0 && std::max(energy, last) >= LEVEL_FLOOR &&
+                windowStart >= state.lastJumpEnd) {
+                double change = ToDb(energy / last);
+                if (std::fabs(change) >= LEVEL_JUMP_DB) {
+                    Emit(EventLevelJump, c, windowStart, windowFrames, (float)change);
+                    state.lastJumpEnd = windowStart + m_jumpHoldoff;
+                }
+            }
+            state.lastLevelEnergy = energy;
+            state.levelEnergy = 0.0;
+        }
+
+        // Energy onset against the recent average; the onset is placed at
+        // the first sample reaching the block's RMS
+        const double energy = blockSquares / frames;
+        if (state.averageEnergy >= 0.0 && energy >= TRANSIENT_FLOOR &&
+            energy >= state.averageEnergy * TRANSIENT_RATIO && m_blockStart >= state.transientHoldoff) {
+            const float rms = (float)std::sqrt(energy);
+            uint32_t onset = 0;
+            while (onset + 1 < frames && std::fabs(samples[onset]) < rms) onset++;
+            double rise = state.averageEnergy > 0.0 ? ToDb(energy / state.averageEnergy) : ToDb(energy / LEVEL_FLOOR);
+            Emit(EventTransient, c, m_blockStart + onset, 1, (float)rise);
+            state.transientHoldoff = m_blockStart + onset + m_transientHoldoff;
+        }
+        if (state.averageEnergy < 0.0) {
+            state.averageEnergy = energy;
+        } else {
+            state.averageEnergy += m_averageWeight * (energy - state.averageEnergy);
+        }
+    }
+
+    m_blockStart = blockEnd;
+    m_blockCount++;
+    m_blockUsed = 0;
+}
+
+void EventDetector::ScanClipping(Channel& state, uint16_t channel, const float* samples, uint32_t frames)
+{
+    // frames == 0 ends the current run at the block start
+    for (uint32_t i = 0; i <= frames; i++) {
+        if (i < frames && std::fabs(samples[i]) >= m_clipLevel) {
+            if (state.clipRunLength == 0) state.clipRunStart = m_blockStart + i;
+            state.clipRunLength++;
+            continue;
+        }
+        if (state.clipRunLength == 0) continue;
+        if (i == frames && frames > 0) break;   // The run may go on in the next block
+
+        // A run just ended
+        if (state.clipRunLength >= CLIP_MIN_RUN) {
+            if (state.clipOpen && state.clipRunStart - state.clipEnd > m_clipMerge) {
+                CloseClipping(state, channel);
+            }
+            if (!state.clipOpen) {
+                state.clipOpen = true;
+                state.clipStart = state.clipRunStart;
+                state.clipSamples = 0;
+            }
+            state.clipEnd = state.clipRunStart + state.clipRunLength;
+            state.clipSamples += state.clipRunLength;
+        }
+        state.clipRunLength = 0;
+    }
+}
+
+void EventDetector::CloseClipping(Channel& state, uint16_t channel)
+{
+    Emit(EventClipping, channel, state.clipStart, state.clipEnd - state.clipStart, (float)state.clipSamples);
+    state.clipOpen = false;
+}
+
+void EventDetector::ScanZeros(Channel& state, uint16_t channel, const float* samples, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; i++) {
+        if (samples[i] == 0.0f) {
+            if (state.zeroLength == 0) state.zeroStart = m_blockStart + i;
+            state.zeroLength++;
+        } else if (state.zeroLength > 0) {
+            CloseZeros(state, channel);
+        }
+    }
+}
+
+void EventDetector::CloseZeros(Channel& state, uint16_t channel)
+{
+    if (state.zeroLength >= m_dropoutMinimum && state.zeroLength > 0) {
+        Emit(EventDropout, channel, state.zeroStart, state.zeroLength, 0.0f);
+    }
+    state.zeroLength = 0;
+}
+
+void EventDetector::Emit(uint16_t type, uint16_t channel, uint64_t frame, uint64_t frames, float value)
+{
+    m_counts[type].fetch_add(1, std::memory_order_relaxed);
+    if (m_pendingCount == m_pending.size()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    DetectedEvent& event = m_pending[m_pendingCount++];
+    event.frame = frame;
+    event.frames = (uint32_t)std::min<uint64_t>(std::max<uint64_t>(frames, 1), UINT32_MAX);
+    event.type = type;
+    event.channel = channel;
+    event.value = value;
+}
+
+size_t EventDetector::TakeEvents(DetectedEvent* out, size_t capacity)
+{
+    size_t count = std::min(capacity, m_pendingCount);
+    std::copy(m_pending.begin(), m_pending.begin() + (ptrdiff_t)count, out);
+    std::copy(m_pending.begin() + (ptrdiff_t)count, m_pending.begin() + (ptrdiff_t)m_pendingCount, m_pending.begin());
+    m_pendingCount -= count;
+    return count;
+}
+
+uint64_t EventDetector::GetCount(uint16_t type) const
+{
+    return type <= EVENT_TYPE_COUNT ? m_counts[type].load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t EventDetector::GetTotalCount() const
+{
+    uint64_t total = 0;
+    for (uint16_t type = 1; type <= EVENT_TYPE_COUNT; type++) {
+        total += GetCount(type);
+    }
+    return total;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "sample_kernels.h"
+
+// Kinds of events the detector flags, as stored in event indexes
+enum EventType : uint16_t {
+    EventClipping = 1,   // Run(s) of full-scale samples; value = clipped samples
+    EventDropout,        // Digital silence (exact zeros); value unused
+    EventDcOffset,       // Mean over 1 s windows beyond the threshold; value = largest mean
+    EventLevelJump,      // 100 ms level changed sharply; value = change in dB
+    EventTransient       // Energy onset over the recent level; value = rise in dB
+};
+
+const uint16_t EVENT_TYPE_COUNT = 5;
+
+// Short name ("clipping", "dropout", "dc", "jump", "transient"); null if unknown
+const char* GetEventTypeName(uint16_t type);
+
+// Event type for a short name; 0 if unknown
+uint16_t ParseEventType(const char* name);
+
+struct DetectedEvent
+{
+    uint64_t frame = 0;     // First frame
+    uint32_t frames = 0;    // Duration (1 for instants)
+    uint16_t type = 0;      // EventType
+    uint16_t channel = 0;
+    float value = 0.0f;     // Per type, see EventType
+};
+
+// Online detector for problems in a recorded stream: clipping runs, digital
+// silence, DC offset, sudden level changes and transients, per channel.
+// Interleaved PCM is converted into planar blocks of 5 ms, and each block is
+// reduced per channel in one pass (sum, energy, full-scale and zero counts
+// over eight lanes, so the loop vectorizes). Sample-exact edges are only
+// searched in the rare blocks that have clipped or zero samples; everything
+// else works on the block statistics.
+// Events are collected until TakeEvents(). AddBytes() allocates nothing and
+// is called from one thread; the counts may be read from any thread.
+class EventDetector
+{
+public:
+    EventDetector() = default;
+
+    EventDetector(const EventDetector&) = delete;
+    EventDetector& operator=(const EventDetector&) = delete;
+
+    // Format of the stream (s16 or s24 as recorded, s32 and f32 also work);
+    // clears all state
+    bool Configure(uint16_t channels, uint32_t sampleRate, SampleType type);
+
+    // Interleaved samples; frames may be split across calls at any byte
+    void AddBytes(const uint8_t* data, size_t size);
+
+    // End of the stream: analyze the partial block and close open events
+    void Flush();
+
+    // Events detected since the last call, in the order they ended (runs
+    // are reported when they end, so start frames are not sorted). Events
+    // beyond the buffer between two calls are counted as dropped.
+    size_t TakeEvents(DetectedEvent* out, size_t capacity);
+    size_t GetPendingCount() const { return m_pendingCount; }
+
+    uint16_t GetChannels() const { return m_channels; }
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint32_t GetBlockFrames() const { return m_blockFrames; }
+    uint64_t GetFrames() const { return m_frames; }
+
+    // Events of a type detected since Configure(); readable from any thread
+    uint64_t GetCount(uint16_t type) const;
+    uint64_t GetTotalCount() const;
+    uint64_t GetDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t LANES = 8;
+
+    // Per channel state carried from block to block
+    struct Channel
+    {
+        // Clipping: the run being counted and the event it extends
+        uint64_t clipRunStart = 0;
+        uint32_t clipRunLength = 0;
+        bool clipOpen = false;
+        uint64_t clipStart = 0;
+        uint64_t clipEnd = 0;
+        uint32_t clipSamples = 0;
+
+        // Digital silence run (length 0: none)
+        uint64_t zeroStart = 0;
+        uint64_t zeroLength = 0;
+
+        // DC: running sum over the window, open excursion
+        double dcSum = 0.0;
+        bool dcOpen = false;
+        uint64_t dcStart = 0;
+        float dcValue = 0.0f;
+
+        // Level: energy of the 100 ms window being built and the last one
+        double levelEnergy = 0.0;
+        double lastLevelEnergy = -1.0;   // None yet
+        uint64_t lastJumpEnd = 0;
+
+        // Transient: slow average of block energies, holdoff
+        double averageEnergy = -1.0;     // None yet
+        uint64_t transientHoldoff = 0;   // First frame a new onset may start
+    };
+
+    void AnalyzeBlock(uint32_t frames);
+    void ScanClipping(Channel& state, uint16_t channel, const float* samples, uint32_t frames);
+    void ScanZeros(Channel& state, uint16_t channel, const float* samples, uint32_t frames);
+    void CloseClipping(Channel& state, uint16_t channel);
+    void CloseZeros(Channel& state, uint16_t channel);
+    void Emit(uint16_t type, uint16_t channel, uint64_t frame, uint64_t frames, float value);
+
+    uint16_t m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    const PacketKernels* m_kernels = nullptr;
+    size_t m_frameSize = 0;
+    float m_clipLevel = 1.0f;       // |sample| at or above: full scale
+
+    // Block sizes in frames, derived from the sample rate
+    uint32_t m_blockFrames = 0;
+    uint32_t m_blocksPerLevel = 0;
+    uint32_t m_blocksPerDc = 0;
+    uint32_t m_clipMerge = 0;
+    uint32_t m_dropoutMinimum = 0;
+    uint32_t m_jumpHoldoff = 0;
+    uint32_t m_transientHoldoff = 0;
+    double m_averageWeight = 0.0;
+
+    std::vector<Channel> m_state;
+    std::vector<float> m_block;         // One plane of m_blockFrames per channel
+    std::vector<float*> m_planes;       // Write positions in m_block
+    uint32_t m_blockUsed = 0;
+    uint64_t m_blockStart = 0;          // Stream frame of m_block[0]
+    uint32_t m_blockCount = 0;          // Blocks analyzed
+
+    std::vector<uint8_t> m_carry;       // Frame split across AddBytes calls
+    size_t m_carryUsed = 0;
+
+    std::vector<DetectedEvent> m_pending;
+    size_t m_pendingCount = 0;
+
+    uint64_t m_frames = 0;
+    std::atomic<uint64_t> m_counts[EVENT_TYPE_COUNT + 1] = {};
+    std::atomic<uint64_t> m_dropped{ 0 };
+};
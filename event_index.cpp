@@ -0,0 +1,283 @@
+#include "event_index.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char EVENT_MAGIC[4] = { 'A', 'C', 'E', 'V' };
+const uint16_t EVENT_VERSION = 1;
+const uint32_t EVENT_COMPLETE = 1;
+
+// Records buffered between writes
+const size_t EVENT_BUFFER_RECORDS = 256;
+
+void PutU16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+void PutU32(uint8_t* p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+void PutU64(uint8_t* p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+uint16_t GetU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t GetU32(const uint8_t* p)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+uint64_t GetU64(const uint8_t* p)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+bool Seek(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+void EncodeRecord(uint8_t* record, const DetectedEvent& event)
+{
+    uint32_t value;
+    memcpy(&value, &event.value, sizeof(value));
+    PutU64(record, event.frame);
+    PutU32(record + 8, event.frames);
+    PutU16(record + 12, event.type);
+    PutU16(record + 14, event.channel);
+    PutU32(record + 16, value);
+    PutU32(record + 20, 0);
+}
+
+DetectedEvent DecodeRecord(const uint8_t* record)
+{
+    DetectedEvent event;
+    uint32_t value = GetU32(record + 16);
+    event.frame = GetU64(record);
+    event.frames = GetU32(record + 8);
+    event.type = GetU16(record + 12);
+    event.channel = GetU16(record + 14);
+    memcpy(&event.value, &value, sizeof(value));
+    return event;
+}
+
+bool EarlierEvent(const DetectedEvent& a, const DetectedEvent& b)
+{
+    return a.frame < b.frame;
+}
+
+}
+
+// EventIndexWriter
+
+EventIndexWriter::~EventIndexWriter()
+{
+    Close();
+}
+
+bool EventIndexWriter::Open(FILE* file, uint16_t channels, uint32_t sampleRate, SampleType type)
+{
+    Close();
+    if (!file) return false;
+    if (!m_detector.Configure(channels, sampleRate, type)) {
+        fclose(file);
+        return false;
+    }
+
+    // Everything the pipeline thread touches is allocated here
+    m_file = file;
+    setvbuf(m_file, nullptr, _IONBF, 0);
+    m_events.assign(EVENT_BUFFER_RECORDS, DetectedEvent());
+    m_buffer.assign(EVENT_RECORD_SIZE * EVENT_BUFFER_RECORDS, 0);
+    m_bufferUsed = 0;
+    m_count = 0;
+    m_failed = false;
+
+    WriteHeader(false);
+    return !m_failed;
+}
+
+void EventIndexWriter::Close()
+{
+    if (!m_file) return;
+    FlushBuffer();
+    WriteHeader(false);
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void EventIndexWriter::AddBytes(const uint8_t* data, size_t size)
+{
+    if (!m_file) return;
+    m_detector.AddBytes(data, size);
+    Drain();
+}
+
+void EventIndexWriter::Drain()
+{
+    while (m_detector.GetPendingCount() > 0) {
+        size_t count = m_detector.TakeEvents(m_events.data(), m_events.size());
+        for (size_t i = 0; i < count; i++) {
+            EncodeRecord(m_buffer.data() + m_bufferUsed, m_events[i]);
+            m_bufferUsed += EVENT_RECORD_SIZE;
+            m_count++;
+            if (m_bufferUsed == m_buffer.size()) {
+                FlushBuffer();
+            }
+        }
+    }
+}
+
+void EventIndexWriter::FlushBuffer()
+{
+    if (m_bufferUsed == 0) return;
+    if (!Seek(m_file, EVENT_HEADER_SIZE + (m_count * EVENT_RECORD_SIZE - m_bufferUsed)) ||
+        fwrite(m_buffer.data(), 1, m_bufferUsed, m_file) != m_bufferUsed) {
+        m_failed = true;
+    }
+    m_bufferUsed = 0;
+}
+
+void EventIndexWriter::WriteHeader(bool complete)
+{
+    uint8_t header[EVENT_HEADER_SIZE] = {};
+    memcpy(header, EVENT_MAGIC, 4);
+    PutU16(header + 4, EVENT_VERSION);
+    PutU16(header + 6, (uint16_t)EVENT_HEADER_SIZE);
+    PutU16(header + 8, m_detector.GetChannels());
+    PutU16(header + 10, (uint16_t)EVENT_RECORD_SIZE);
+    PutU32(header + 12, m_detector.GetSampleRate());
+    PutU32(header + 16, complete ? EVENT_COMPLETE : 0);
+    PutU64(header + 24, m_count);
+    PutU64(header + 32, m_detector.GetFrames());
+    PutU64(header + 40, m_detector.GetDroppedCount());
+
+    if (!Seek(m_file, 0) || fwrite(header, 1, sizeof(header), m_file) != sizeof(header)) {
+        m_failed = true;
+    }
+}
+
+bool EventIndexWriter::Finish()
+{
+    if (!m_file) return false;
+
+    m_detector.Flush();
+    Drain();
+    FlushBuffer();
+
+    // Runs were reported when they ended; sort by start once, here
+    std::vector<uint8_t> records((size_t)m_count * EVENT_RECORD_SIZE);
+    if (!m_failed && m_count > 0 &&
+        (!Seek(m_file, EVENT_HEADER_SIZE) || fread(records.data(), 1, records.size(), m_file) != records.size())) {
+        m_failed = true;
+    }
+    if (!m_failed && m_count > 0) {
+        std::vector<DetectedEvent> events((size_t)m_count);
+        for (size_t i = 0; i < events.size(); i++) {
+            events[i] = DecodeRecord(records.data() + i * EVENT_RECORD_SIZE);
+        }
+        std::stable_sort(events.begin(), events.end(), EarlierEvent);
+        for (size_t i = 0; i < events.size(); i++) {
+            EncodeRecord(records.data() + i * EVENT_RECORD_SIZE, events[i]);
+        }
+        if (!Seek(m_file, EVENT_HEADER_SIZE) || fwrite(records.data(), 1, records.size(), m_file) != records.size()) {
+            m_failed = true;
+        }
+    }
+
+    if (!m_failed) WriteHeader(true);
+    bool ok = !m_failed && fflush(m_file) == 0;
+    fclose(m_file);
+    m_file = nullptr;
+    return ok;
+}
+
+// EventIndex
+
+bool EventIndex::Load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    bool ok = Load(file);
+    fclose(file);
+    return ok;
+}
+
+bool EventIndex::Load(FILE* file)
+{
+    m_events.clear();
+
+    uint8_t header[EVENT_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) return false;
+    if (memcmp(header, EVENT_MAGIC, 4) != 0 || GetU16(header + 4) != EVENT_VERSION) return false;
+
+    const size_t headerSize = GetU16(header + 6);
+    const size_t recordSize = GetU16(header + 10);
+    if (headerSize < EVENT_HEADER_SIZE || recordSize < EVENT_RECORD_SIZE) return false;
+
+    m_channels = GetU16(header + 8);
+    m_sampleRate = GetU32(header + 12);
+    m_complete = (GetU32(header + 16) & EVENT_COMPLETE) != 0;
+    m_frames = GetU64(header + 32);
+    m_dropped = GetU64(header + 40);
+
+    // An incomplete index has its records up to the end of the file
+    uint64_t count = GetU64(header + 24);
+    if (!Seek(file, headerSize)) return false;
+    std::vector<uint8_t> record(recordSize);
+    for (uint64_t i = 0; !m_complete || i < count; i++) {
+        if (fread(record.data(), 1, recordSize, file) != recordSize) {
+            if (m_complete) return false;
+            break;
+        }
+        m_events.push_back(DecodeRecord(record.data()));
+    }
+
+    if (!m_complete) {
+        std::stable_sort(m_events.begin(), m_events.end(), EarlierEvent);
+    }
+    return true;
+}
+
+size_t EventIndex::FindFirst(uint64_t frame) const
+{
+    DetectedEvent key;
+    key.frame = frame;
+    return (size_t)(std::lower_bound(m_events.begin(), m_events.end(), key, EarlierEvent) - m_events.begin());
+}
+
+// EventOutput
+
+int64_t EventOutput::WriteGather(const IoSpan* spans, size_t count)
+{
+    int64_t written = m_output->WriteGather(spans, count);
+
+    // Feed exactly the bytes that reached the output, in order
+    if (written > 0 && m_events) {
+        uint64_t remaining = (uint64_t)written;
+        for (size_t i = 0; i < count && remaining > 0; i++) {
+            size_t part = spans[i].size < remaining ? spans[i].size : (size_t)remaining;
+            m_events->AddBytes(spans[i].data, part);
+            remaining -= part;
+        }
+    }
+    return written;
+}
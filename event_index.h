@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "batched_writer.h"
+#include "event_detector.h"
+
+// Event index sidecar ("recording_N.wav.events") with the problems an
+// EventDetector found in a recording. Little-endian, 64-byte header followed
+// by 24-byte records (frame u64, frames u32, type u16, channel u16, value
+// f32, reserved u32). Records are appended as the detector reports them;
+// Finish() sorts them by frame and marks the file complete. A file without
+// the complete flag was cut off and is sorted on load.
+
+const size_t EVENT_HEADER_SIZE = 64;
+const size_t EVENT_RECORD_SIZE = 24;
+
+// Builds an event index from the bytes of a recording as they are written.
+// AddBytes allocates nothing, so it can run on a pipeline thread.
+class EventIndexWriter
+{
+public:
+    EventIndexWriter() = default;
+    ~EventIndexWriter();
+
+    EventIndexWriter(const EventIndexWriter&) = delete;
+    EventIndexWriter& operator=(const EventIndexWriter&) = delete;
+
+    // Take ownership of `file` (opened for reading and writing, e.g. "w+b")
+    // for a stream of the given format and write a placeholder header
+    bool Open(FILE* file, uint16_t channels, uint32_t sampleRate, SampleType type);
+
+    // Interleaved samples as written to the WAV; frames may be split across
+    // calls at any byte
+    void AddBytes(const uint8_t* data, size_t size);
+
+    // Close the open events, sort the index and complete it
+    bool Finish();
+
+    // Close without finishing (the file stays readable as incomplete)
+    void Close();
+
+    bool IsOpen() const { return m_file != nullptr; }
+    const EventDetector& GetDetector() const { return m_detector; }
+
+private:
+    void Drain();
+    void FlushBuffer();
+    void WriteHeader(bool complete);
+
+    FILE* m_file = nullptr;
+    EventDetector m_detector;
+    std::vector<DetectedEvent> m_events;   // Taken from the detector
+    std::vector<uint8_t> m_buffer;         // Encoded records not yet written
+    size_t m_bufferUsed = 0;
+    uint64_t m_count = 0;
+    bool m_failed = false;
+};
+
+// Loaded event index, sorted by frame
+class EventIndex
+{
+public:
+    bool Load(const char* path);
+    bool Load(FILE* file);
+
+    bool IsComplete() const { return m_complete; }
+    uint16_t GetChannels() const { return m_channels; }
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint64_t GetFrames() const { return m_frames; }       // Analyzed
+    uint64_t GetDropped() const { return m_dropped; }     // Detected but not stored
+
+    const std::vector<DetectedEvent>& GetEvents() const { return m_events; }
+
+    // Index of the first event starting at or after `frame`
+    size_t FindFirst(uint64_t frame) const;
+
+private:
+    std::vector<DetectedEvent> m_events;
+    uint16_t m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_dropped = 0;
+    bool m_complete = false;
+};
+
+// ByteOutput that forwards to another output and feeds every byte written
+// to an EventIndexWriter, so detection runs on the writer thread
+class EventOutput : public ByteOutput
+{
+public:
+    void SetOutput(ByteOutput* output, EventIndexWriter* events) { m_output = output; m_events = events; }
+
+    bool Connect() override { return m_output->Connect(); }
+    void Disconnect() override { m_output->Disconnect(); }
+    int64_t WriteGather(const IoSpan* spans, size_t count) override;
+    void WaitWritable(uint32_t timeoutMs) override { m_output->WaitWritable(timeoutMs); }
+
+private:
+    ByteOutput* m_output = nullptr;
+    EventIndexWriter* m_events = nullptr;
+};
@@ -0,0 +1,229 @@
+// AudioFaults: exercises device-loss recovery against a simulated device.
+//
+//   AudioFaults [--seconds=N] [--rate=HZ] [--channels=N] [--packet-ms=N]
+//               [--stall-ms=N] [--backoff-ms=MIN:MAX] [--record=FILE.wav] [FAULT...]
+//
+// FAULT is lost@SECONDS[+DURATION] (reads fail as with an unplugged device)
+// or stall@SECONDS[+DURATION] (packets stop without an error); the device
+// cannot be re-acquired until DURATION has passed. Without faults a default
+// schedule covering both kinds is used. The tone is recorded through the
+// normal recording path; every recovery is reported with its time, and at
+// the end the recording must span the whole run with the outages filled.
+// The exit code is 1 if a loss was not recovered, the recording is short or
+// (Debug builds) a warmed-up pump or writer thread allocated.
+
+#include "alloc_tracker.h"
+#include "audio_session.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// How often the main thread looks at the telemetry
+const int REPORT_POLL_MS = 5;
+
+// The recording may be shorter than the run by the first packet and the
+// poll interval at either end
+const double SPAN_TOLERANCE_PACKETS = 4.0;
+
+struct Options
+{
+    double seconds = 0.0;        // 0 = one second past the last fault
+    uint32_t sampleRate = 48000;
+    uint32_t channels = 2;
+    uint32_t packetMs = 10;
+    uint32_t stallMs = 500;
+    uint32_t minBackoffMs = 20;
+    uint32_t maxBackoffMs = 1000;
+    std::string recordPath = "audio_faults.wav";
+    std::vector<SyntheticDevice::Fault> faults;
+};
+
+// "lost@1.5+0.3" or "stall@4"
+bool ParseFault(const char* text, SyntheticDevice::Fault& fault)
+{
+    const char* at = strchr(text, '@');
+    if (!at) return false;
+
+    std::string type(text, at - text);
+    if (type == "lost") {
+        fault.type = SyntheticDevice::Lost;
+    } else if (type == "stall") {
+        fault.type = SyntheticDevice::Stall;
+    } else {
+        return false;
+    }
+
+    char* end = nullptr;
+    fault.atSeconds = strtod(at + 1, &end);
+    fault.seconds = 0.0;
+    if (end && *end == '+') {
+        fault.seconds = strtod(end + 1, &end);
+    }
+    return end && *end == '\0' && fault.atSeconds >= 0.0 && fault.seconds >= 0.0;
+}
+
+const char* GetFaultName(SyntheticDevice::FaultType type)
+{
+    return type == SyntheticDevice::Lost ? "lost" : "stall";
+}
+
+// Debug builds: heap allocations made by warmed-up pipeline threads fail the
+// check. Returns false (after printing them) if there were any.
+bool CheckRealtimeAllocations()
+{
+    if (AllocTracker::GetViolationCount() == 0) return true;
+    printf("Heap allocations after warm-up: %llu, the last %zu bytes on the %s thread\n",
+        (unsigned long long)AllocTracker::GetViolationCount(), AllocTracker::GetLastViolationSize(),
+        AllocTracker::GetLastViolationThread());
+    return false;
+}
+
+int Run(Options& options)
+{
+    if (options.faults.empty()) {
+        options.faults = {
+            { SyntheticDevice::Lost, 1.0, 0.3 },     // Unplugged and plugged back in
+            { SyntheticDevice::Stall, 2.5, 1.0 },    // Driver hangs for a second
+            { SyntheticDevice::Lost, 5.0, 0.0 },     // Endpoint reset, back at once
+        };
+    }
+    double lastFaultEnd = 0.0;
+    for (const SyntheticDevice::Fault& fault : options.faults) {
+        if (fault.atSeconds + fault.seconds > lastFaultEnd) lastFaultEnd = fault.atSeconds + fault.seconds;
+    }
+    if (options.seconds <= 0.0) options.seconds = lastFaultEnd + 1.0;
+
+    AudioSession session;
+    uint32_t packetFrames = options.sampleRate * options.packetMs / 1000;
+    if (!session.SetSimulatedDeviceSource(options.sampleRate, options.channels, 997.0, -20.0, packetFrames,
+                                          options.faults) ||
+        !session.SetRecording(options.recordPath, 16)) {
+        fprintf(stderr, "Invalid format\n");
+        return 2;
+    }
+    DeviceWatchdog::Config config;
+    config.stallMs = options.stallMs;
+    config.initialBackoffMs = options.minBackoffMs;
+    config.maxBackoffMs = options.maxBackoffMs;
+    session.GetDeviceWatchdog().Configure(config);
+
+    printf("Simulated device: %u Hz, %u channels, %u ms packets; stall after %u ms, backoff %u..%u ms\n",
+        options.sampleRate, options.channels, options.packetMs, options.stallMs, options.minBackoffMs,
+        options.maxBackoffMs);
+    for (const SyntheticDevice::Fault& fault : options.faults) {
+        printf("  %s at %.3f s for %.3f s\n", GetFaultName(fault.type), fault.atSeconds, fault.seconds);
+    }
+
+    if (!session.Start()) {
+        fprintf(stderr, "%s: cannot start the session\n", options.recordPath.c_str());
+        return 2;
+    }
+
+    // Report each recovery as the telemetry shows it
+    const DeviceWatchdog::Telemetry& telemetry = session.GetDeviceWatchdog().GetTelemetry();
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t reportedLosses = 0;
+    uint64_t reportedRecoveries = 0;
+    uint64_t stallsSeen = 0;
+    uint64_t attemptsSeen = 0;
+    for (;;) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t losses = telemetry.losses.load();
+        if (losses > reportedLosses) {
+            uint64_t stalls = telemetry.stalls.load();
+            printf("%7.3f s  device lost (%s)\n", elapsed, stalls > stallsSeen ? "stalled" : "device invalidated");
+            stallsSeen = stalls;
+            reportedLosses = losses;
+        }
+        uint64_t recoveries = telemetry.recoveries.load();
+        if (recoveries > reportedRecoveries) {
+            uint64_t attempts = telemetry.failedAttempts.load() + recoveries;
+            printf("%7.3f s  recovered in %.1f ms, %llu attempts\n", elapsed,
+                telemetry.lastRecoveryUs.load() / 1000.0, (unsigned long long)(attempts - attemptsSeen));
+            attemptsSeen = attempts;
+            reportedRecoveries = recoveries;
+        }
+
+        if (elapsed >= options.seconds) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(REPORT_POLL_MS));
+    }
+    session.Stop();
+
+    const AudioSession::Stats& stats = session.GetStats();
+    uint64_t losses = telemetry.losses.load();
+    uint64_t recoveries = telemetry.recoveries.load();
+    printf("%.2f s: %llu losses (%llu stalls), %llu recoveries, %llu failed attempts; recovery mean %.1f ms, max %.1f ms\n",
+        options.seconds, (unsigned long long)losses, (unsigned long long)telemetry.stalls.load(),
+        (unsigned long long)recoveries, (unsigned long long)telemetry.failedAttempts.load(),
+        recoveries ? telemetry.totalRecoveryUs.load() / 1000.0 / (double)recoveries : 0.0,
+        telemetry.maxRecoveryUs.load() / 1000.0);
+
+    const PacketTimeline& timeline = session.GetRecordingTimeline();
+    double elapsed = stats.elapsedNs.load() / 1e9;
+    double span = (double)timeline.GetOutputFrames() / options.sampleRate;
+    double tolerance = SPAN_TOLERANCE_PACKETS * options.packetMs / 1000.0;
+    bool spanOk = span <= elapsed && elapsed - span <= tolerance &&
+        stats.recordedFrames.load() == timeline.GetOutputFrames();
+    printf("%s: %.3f s recorded for %.3f s run, %llu re-acquisitions, %.3f s of outage filled%s\n",
+        options.recordPath.c_str(), (double)stats.recordedFrames.load() / options.sampleRate, elapsed,
+        (unsigned long long)timeline.GetReacquireCount(), (double)timeline.GetSilenceFrames() / options.sampleRate,
+        spanOk ? "" : " (SHORT)");
+
+    bool recovered = losses == recoveries && recoveries >= options.faults.size();
+    bool allocated = !CheckRealtimeAllocations();
+    return recovered && spanOk && !allocated ? 0 : 1;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--seconds=", 10) == 0) {
+            options.seconds = atof(arg + 10);
+        } else if (strncmp(arg, "--rate=", 7) == 0) {
+            options.sampleRate = (uint32_t)atoi(arg + 7);
+        } else if (strncmp(arg, "--channels=", 11) == 0) {
+            options.channels = (uint32_t)atoi(arg + 11);
+        } else if (strncmp(arg, "--packet-ms=", 12) == 0) {
+            options.packetMs = (uint32_t)atoi(arg + 12);
+        } else if (strncmp(arg, "--stall-ms=", 11) == 0) {
+            options.stallMs = (uint32_t)atoi(arg + 11);
+        } else if (strncmp(arg, "--backoff-ms=", 13) == 0) {
+            char* end = nullptr;
+            options.minBackoffMs = (uint32_t)strtoul(arg + 13, &end, 10);
+            options.maxBackoffMs = end && *end == ':' ? (uint32_t)strtoul(end + 1, nullptr, 10) : options.minBackoffMs;
+        } else if (strncmp(arg, "--record=", 9) == 0) {
+            options.recordPath = arg + 9;
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        } else {
+            SyntheticDevice::Fault fault;
+            if (!ParseFault(arg, fault)) {
+                fprintf(stderr, "Bad fault %s (lost@SECONDS[+DURATION] or stall@SECONDS[+DURATION])\n", arg);
+                return 2;
+            }
+            options.faults.push_back(fault);
+        }
+    }
+
+    if (options.sampleRate == 0 || options.channels == 0 || options.packetMs == 0 || options.minBackoffMs == 0 ||
+        options.maxBackoffMs < options.minBackoffMs || options.recordPath.empty()) {
+        fprintf(stderr, "Usage: AudioFaults [--seconds=N] [--rate=HZ] [--channels=N] [--packet-ms=N] [--stall-ms=N]\n"
+            "                   [--backoff-ms=MIN:MAX] [--record=FILE.wav] [FAULT...]\n");
+        return 2;
+    }
+
+    return Run(options);
+}
@@ -0,0 +1,165 @@
+#include "fft.h"
+#include <cmath>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const size_t MIN_SIZE = 16;
+
+// One group of radix-2 butterflies; the halves never overlap, so the loop
+// vectorizes
+void Butterflies(float* __restrict ar, float* __restrict ai, float* __restrict br, float* __restrict bi,
+                 const float* __restrict wr, const float* __restrict wi, size_t count)
+{
+    for (size_t j = 0; j < count; j++) {
+        float tr = br[j] * wr[j] - bi[j] * wi[j];
+        float ti = br[j] * wi[j] + bi[j] * wr[j];
+        br[j] = ar[j] - tr;
+        bi[j] = ai[j] - ti;
+        ar[j] += tr;
+        ai[j] += ti;
+    }
+}
+
+}
+
+bool RealFft::Configure(size_t size)
+{
+    if (size < MIN_SIZE || (size & (size - 1)) != 0) return false;
+
+    m_size = size;
+    m_half = size / 2;
+
+    uint32_t bits = 0;
+    while (((size_t)1 << bits) < m_half) bits++;
+    m_reverse.resize(m_half);
+    for (size_t i = 0; i < m_half; i++) {
+        uint32_t reversed = 0;
+        for (uint32_t b = 0; b < bits; b++) {
+            if (i & ((size_t)1 << b)) reversed |= 1u << (bits - 1 - b);
+        }
+        m_reverse[i] = reversed;
+    }
+
+    // Twiddles of each stage side by side, so a stage reads them in order
+    m_twiddleReal.assign(m_half, 0.0f);
+    m_twiddleImag.assign(m_half, 0.0f);
+    for (size_t span = 1; span < m_half; span *= 2) {
+        for (size_t j = 0; j < span; j++) {
+            double angle = -PI * (double)j / (double)span;
+            m_twiddleReal[span - 1 + j] = (float)cos(angle);
+            m_twiddleImag[span - 1 + j] = (float)sin(angle);
+        }
+    }
+
+    m_splitReal.resize(m_half + 1);
+    m_splitImag.resize(m_half + 1);
+    for (size_t k = 0; k <= m_half; k++) {
+        double angle = -PI * (double)k / (double)m_half;
+        m_splitReal[k] = (float)cos(angle);
+        m_splitImag[k] = (float)sin(angle);
+    }
+
+    m_real.assign(m_half, 0.0f);
+    m_imag.assign(m_half, 0.0f);
+    return true;
+}
+
+void RealFft::Transform(float* real, float* imag, bool inverse)
+{
+    const size_t points = m_half;
+
+    // Conjugating before and after turns the forward transform into the inverse
+    if (inverse) {
+        for (size_t i = 0; i < points; i++) imag[i] = -imag[i];
+    }
+
+    // The first two stages need no multiplications (twiddles 1 and -i)
+    for (size_t k = 0; k < points; k += 4) {
+        float r0 = real[k] + real[k + 1], i0 = imag[k] + imag[k + 1];
+        float r1 = real[k] - real[k + 1], i1 = imag[k] - imag[k + 1];
+        float r2 = real[k + 2] + real[k + 3], i2 = imag[k + 2] + imag[k + 3];
+        float r3 = real[k + 2] - real[k + 3], i3 = imag[k + 2] - imag[k + 3];
+        real[k] = r0 + r2;
+        imag[k] = i0 + i2;
+        real[k + 2] = r0 - r2;
+        imag[k + 2] = i0 - i2;
+        real[k + 1] = r1 + i3;
+        imag[k + 1] = i1 - r3;
+        real[k + 3] = r1 - i3;
+        imag[k + 3] = i1 + r3;
+    }
+
+    // Input is in bit-reversed order; each stage doubles the span
+    for (size_t span = 4; span < points; span *= 2) {
+        const float* wr = m_twiddleReal.data() + span - 1;
+        const float* wi = m_twiddleImag.data() + span - 1;
+        for (size_t k = 0; k < points; k += 2 * span) {
+            Butterflies(real + k, imag + k, real + k + span, imag + k + span, wr, wi, span);
+        }
+    }
+
+    if (inverse) {
+        for (size_t i = 0; i < points; i++) imag[i] = -imag[i];
+    }
+}
+
+void RealFft::Forward(const float* input, float* real, float* imag)
+{
+    const size_t points = m_half;
+
+    // Even samples as the real part, odd ones as the imaginary part
+    for (size_t n = 0; n < points; n++) {
+        m_real[m_reverse[n]] = input[2 * n];
+        m_imag[m_reverse[n]] = input[2 * n + 1];
+    }
+    Transform(m_real.data(), m_imag.data(), false);
+
+    // Split into the spectra of the even and odd samples and combine
+    for (size_t k = 0; k <= points; k++) {
+        size_t index = k == points ? 0 : k;
+        size_t mirror = k == 0 ? 0 : points - k;
+        float zr = m_real[index], zi = m_imag[index];
+        float cr = m_real[mirror], ci = -m_imag[mirror];
+
+        float evenReal = 0.5f * (zr + cr);
+        float evenImag = 0.5f * (zi + ci);
+        float oddReal = 0.5f * (zi - ci);
+        float oddImag = -0.5f * (zr - cr);
+
+        float wr = m_splitReal[k], wi = m_splitImag[k];
+        real[k] = evenReal + oddReal * wr - oddImag * wi;
+        imag[k] = evenImag + oddReal * wi + oddImag * wr;
+    }
+}
+
+void RealFft::Inverse(const float* real, const float* imag, float* output)
+{
+    const size_t points = m_half;
+
+    // Recombine the even and odd spectra into the complex input, bit-reversed
+    for (size_t k = 0; k < points; k++) {
+        float xr = real[k], xi = imag[k];
+        float cr = real[points - k], ci = -imag[points - k];
+
+        float evenReal = 0.5f * (xr + cr);
+        float evenImag = 0.5f * (xi + ci);
+        float dr = 0.5f * (xr - cr);
+        float di = 0.5f * (xi - ci);
+
+        // Odd spectrum: difference times the conjugate split twiddle
+        float wr = m_splitReal[k], wi = -m_splitImag[k];
+        float oddReal = dr * wr - di * wi;
+        float oddImag = dr * wi + di * wr;
+
+        m_real[m_reverse[k]] = evenReal - oddImag;
+        m_imag[m_reverse[k]] = evenImag + oddReal;
+    }
+    Transform(m_real.data(), m_imag.data(), true);
+
+    const float scale = 1.0f / (float)points;
+    for (size_t n = 0; n < points; n++) {
+        output[2 * n] = m_real[n] * scale;
+        output[2 * n + 1] = m_imag[n] * scale;
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Real FFT of a power-of-two size for block spectral processing. A real
+// frame of N samples is transformed as a complex FFT of N/2 points plus a
+// split step. Spectra are kept as separate real and imaginary arrays of
+// N/2 + 1 bins, so every butterfly stage is a loop over contiguous floats
+// with its own twiddle table and vectorizes. All tables and scratch are
+// allocated in Configure(); transforms allocate nothing.
+class RealFft
+{
+public:
+    // Size in samples (power of two, at least 16)
+    bool Configure(size_t size);
+
+    size_t GetSize() const { return m_size; }
+    size_t GetBinCount() const { return m_size / 2 + 1; }
+
+    // `input` has GetSize() samples; `real` and `imag` GetBinCount() bins
+    void Forward(const float* input, float* real, float* imag);
+
+    // Inverse of Forward, scaled so Inverse(Forward(x)) == x
+    void Inverse(const float* real, const float* imag, float* output);
+
+private:
+    void Transform(float* real, float* imag, bool inverse);
+
+    size_t m_size = 0;
+    size_t m_half = 0;                   // Points of the complex FFT
+    std::vector<uint32_t> m_reverse;     // Bit-reversed index per point
+    std::vector<float> m_twiddleReal;    // Per stage, stage of span s at s - 1
+    std::vector<float> m_twiddleImag;
+    std::vector<float> m_splitReal;      // e^(-i pi k / half) for the split step
+    std::vector<float> m_splitImag;
+    std::vector<float> m_real;           // Complex scratch
+    std::vector<float> m_imag;
+};
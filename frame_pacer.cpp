@@ -0,0 +1,72 @@
+#include "frame_pacer.h"
+#include <algorithm>
+
+namespace {
+
+const int MIN_FPS = 1;
+const int MAX_FPS = 240;
+
+const unsigned OCCLUDED_INTERVAL_MS = 250;   // Only watching for visibility changes
+const unsigned MINIMIZED_INTERVAL_MS = 1000;
+
+// Idle back-off: after this many ticks without new data, slow down
+const int IDLE_TICKS_SHORT = 10;
+const int IDLE_TICKS_LONG = 50;
+const unsigned IDLE_INTERVAL_SHORT_MS = 100;
+const unsigned IDLE_INTERVAL_LONG_MS = 250;
+
+}
+
+void FramePacer::SetMaxFps(int fps)
+{
+    m_maxFps = std::clamp(fps, MIN_FPS, MAX_FPS);
+}
+
+void FramePacer::SetVisibility(Visibility visibility)
+{
+    if (visibility == m_visibility) return;
+
+    // Whatever arrived while hidden was never drawn
+    if (visibility == Visible) {
+        m_dirty = true;
+        m_idleTicks = 0;
+    }
+    m_visibility = visibility;
+}
+
+bool FramePacer::OnTick(uint64_t generation)
+{
+    if (generation != m_lastGeneration) {
+        m_lastGeneration = generation;
+        m_dirty = true;
+    }
+
+    if (m_visibility != Visible) return false;
+
+    if (m_dirty) {
+        m_dirty = false;
+        m_idleTicks = 0;
+        return true;
+    }
+
+    if (m_idleTicks < IDLE_TICKS_LONG) m_idleTicks++;
+    return false;
+}
+
+unsigned FramePacer::GetIntervalMs() const
+{
+    unsigned frameInterval = 1000u / (unsigned)m_maxFps;
+
+    switch (m_visibility) {
+        case Minimized:
+            return std::max(frameInterval, MINIMIZED_INTERVAL_MS);
+        case Occluded:
+            return std::max(frameInterval, OCCLUDED_INTERVAL_MS);
+        case Visible:
+            break;
+    }
+
+    if (m_idleTicks >= IDLE_TICKS_LONG) return std::max(frameInterval, IDLE_INTERVAL_LONG_MS);
+    if (m_idleTicks >= IDLE_TICKS_SHORT) return std::max(frameInterval, IDLE_INTERVAL_SHORT_MS);
+    return frameInterval;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// Decides when the visualizer needs a repaint and how often to wake up.
+// A frame is only drawn when the capture data generation changed or the view
+// was invalidated (scroll, resize). The tick interval follows the configured
+// max FPS, drops when the window is occluded or minimized, and backs off
+// further after a run of idle ticks so an idle app barely wakes up.
+class FramePacer
+{
+public:
+    enum Visibility {
+        Visible,
+        Occluded,   // Window shown but fully covered
+        Minimized
+    };
+
+    FramePacer() = default;
+
+    void SetMaxFps(int fps);
+    int GetMaxFps() const { return m_maxFps; }
+
+    void SetVisibility(Visibility visibility);
+    Visibility GetVisibility() const { return m_visibility; }
+
+    // Force a repaint on the next tick (view scrolled, resized, etc.)
+    void Invalidate() { m_dirty = true; }
+
+    // Called once per tick with the latest data generation. Returns true when
+    // a frame should be drawn. Never returns true while minimized.
+    bool OnTick(uint64_t generation);
+
+    // Timer period to use for the next tick
+    unsigned GetIntervalMs() const;
+
+private:
+    int m_maxFps = 30;
+    Visibility m_visibility = Visible;
+    bool m_dirty = true;
+    uint64_t m_lastGeneration = 0;
+    int m_idleTicks = 0;
+};
@@ -0,0 +1,208 @@
+// AudioJitter: wake-up jitter of a capture thread competing with CPU hogs.
+//
+//   AudioJitter [--seconds=N] [--hogs=N] [--period-ms=N] [--rate=HZ]
+//               [--channels=N] [--sched=off] [--sched-capture=POLICY]
+//               [--budget-us=N]
+//
+// A thread paced like the capture loop wakes every --period-ms, reads a
+// packet from a SyntheticSource and runs it through the recording stages
+// and a loudness meter, while --hogs threads (default: two per CPU) spin
+// over cache-sized buffers at normal priority. How late each wake-up comes
+// is recorded with the WakeJitterMeter the capture thread uses. The load
+// runs twice: with scheduling off as the baseline, then with the capture
+// role's policy (default realtime:80, see ThreadScheduling::ParsePolicy).
+// --sched=off runs only the baseline. The exit code is 1 if the policy
+// took effect and its p99 lateness still exceeds --budget-us.
+
+#include "dsp_graph.h"
+#include "dsp_nodes.h"
+#include "loudness_meter.h"
+#include "synthetic_source.h"
+#include "thread_scheduling.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Floats per hog buffer: 2 MB, larger than most per-core caches
+const size_t HOG_BUFFER_FLOATS = 512 * 1024;
+
+struct Options
+{
+    double seconds = 10.0;
+    unsigned hogs = 0;          // 0 = two per CPU
+    uint32_t periodMs = 10;
+    uint32_t sampleRate = 48000;
+    uint32_t channels = 2;
+    bool schedule = true;
+    std::string capturePolicy = "realtime:80";
+    int64_t budgetUs = 1000;
+};
+
+struct PassResult
+{
+    ThreadScheduling::Class applied = ThreadScheduling::Default;
+    WakeJitterMeter jitter;
+    uint64_t missed = 0;        // Wakes later than a whole period
+};
+
+void HogThread(const std::atomic<bool>& stop)
+{
+    std::vector<float> buffer(HOG_BUFFER_FLOATS, 1.0f);
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (float& value : buffer) {
+            value = value * 0.999f + 0.001f;
+        }
+    }
+}
+
+// The capture stand-in: paced wakes, one packet of work each
+void CaptureThread(const Options& options, PassResult& result)
+{
+    ThreadScheduling::Applied applied = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Capture);
+    result.applied = applied.schedulingClass;
+
+    const size_t packetFrames = (size_t)options.sampleRate * options.periodMs / 1000;
+    SyntheticSource source(options.sampleRate, options.channels);
+    source.AddSine(997.0, -18.0, 1.0);
+    source.AddNoise(-40.0, 1.0);
+    source.SetLooping(true);
+
+    DspChain chain;
+    RecordingStages* stages = chain.Add(std::make_unique<RecordingStages>());
+    stages->Get<DcBlockerStage>().SetEnabled(true);
+    stages->Get<LimiterStage>().SetEnabled(true);
+    chain.Prepare(options.sampleRate, options.channels, packetFrames);
+
+    LoudnessMeter meter;
+    meter.Configure(options.sampleRate, options.channels);
+    std::vector<float> packet(packetFrames * options.channels);
+
+    const auto period = std::chrono::milliseconds(options.periodMs);
+    const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(options.seconds);
+    auto next = std::chrono::steady_clock::now() + period;
+    while (next < end) {
+        std::this_thread::sleep_until(next);
+        auto now = std::chrono::steady_clock::now();
+        int64_t lateUs = std::chrono::duration_cast<std::chrono::microseconds>(now - next).count();
+        result.jitter.Record(lateUs);
+
+        source.Read(packet.data(), packetFrames);
+        chain.ProcessF32(packet.data(), packet.data(), packetFrames);
+        meter.Process(packet.data(), packetFrames);
+
+        // A wake later than a period drops the ticks it missed instead of
+        // catching up in a burst, like a device buffer that overflowed
+        next += period;
+        if (now >= next) {
+            result.missed += (uint64_t)((now - next) / period) + 1;
+            next += ((now - next) / period + 1) * period;
+        }
+    }
+
+    ThreadScheduling::RestoreCurrentThread(applied);
+}
+
+void RunPass(const Options& options, unsigned hogs, bool schedule, PassResult& result)
+{
+    ThreadScheduling::SetEnabled(schedule);
+
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> hogThreads;
+    for (unsigned i = 0; i < hogs; i++) {
+        hogThreads.emplace_back([&stop]() { HogThread(stop); });
+    }
+
+    std::thread capture([&]() { CaptureThread(options, result); });
+    capture.join();
+
+    stop.store(true, std::memory_order_relaxed);
+    for (std::thread& thread : hogThreads) {
+        thread.join();
+    }
+}
+
+void PrintPass(const char* label, const PassResult& result)
+{
+    printf("%-28s %-9s  p50 %5lld us  p99 %5lld us  p99.9 %5lld us  max %6lld us  %llu wakes, %llu missed\n",
+        label, ThreadScheduling::GetSchedulingClassName(result.applied),
+        (long long)result.jitter.GetPercentile(0.5), (long long)result.jitter.GetPercentile(0.99),
+        (long long)result.jitter.GetPercentile(0.999), (long long)result.jitter.GetMax(),
+        (unsigned long long)result.jitter.GetCount(), (unsigned long long)result.missed);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--seconds=", 10) == 0) {
+            options.seconds = atof(arg + 10);
+        } else if (strncmp(arg, "--hogs=", 7) == 0) {
+            options.hogs = (unsigned)atoi(arg + 7);
+        } else if (strncmp(arg, "--period-ms=", 12) == 0) {
+            options.periodMs = (uint32_t)atoi(arg + 12);
+        } else if (strncmp(arg, "--rate=", 7) == 0) {
+            options.sampleRate = (uint32_t)atoi(arg + 7);
+        } else if (strncmp(arg, "--channels=", 11) == 0) {
+            options.channels = (uint32_t)atoi(arg + 11);
+        } else if (strcmp(arg, "--sched=off") == 0) {
+            options.schedule = false;
+        } else if (strncmp(arg, "--sched-capture=", 16) == 0) {
+            options.capturePolicy = arg + 16;
+        } else if (strncmp(arg, "--budget-us=", 12) == 0) {
+            options.budgetUs = atoll(arg + 12);
+        } else {
+            fprintf(stderr, "Usage: AudioJitter [--seconds=N] [--hogs=N] [--period-ms=N] [--rate=HZ] [--channels=N] "
+                            "[--sched=off] [--sched-capture=POLICY] [--budget-us=N]\n");
+            return 2;
+        }
+    }
+
+    ThreadScheduling::Policy policy;
+    if (options.seconds <= 0.0 || options.periodMs == 0 || options.sampleRate < 8000 || options.channels == 0 ||
+        options.channels > (uint32_t)LoudnessMeter::MAX_CHANNELS ||
+        !ThreadScheduling::ParsePolicy(options.capturePolicy.c_str(), policy)) {
+        fprintf(stderr, "Invalid load test parameters\n");
+        return 2;
+    }
+    ThreadScheduling::SetPolicy(ThreadScheduling::Capture, policy);
+
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    unsigned hogs = options.hogs > 0 ? options.hogs : 2 * cpus;
+    printf("%u ms wakes for %.0f s against %u CPU hogs on %u CPUs\n", options.periodMs, options.seconds, hogs, cpus);
+
+    PassResult baseline;
+    RunPass(options, hogs, false, baseline);
+    PrintPass("--sched=off", baseline);
+    if (!options.schedule) return 0;
+
+    PassResult scheduled;
+    RunPass(options, hogs, true, scheduled);
+    std::string label = "--sched-capture=" + options.capturePolicy;
+    PrintPass(label.c_str(), scheduled);
+
+    if (scheduled.applied != policy.schedulingClass) {
+        printf("The policy asked for %s but got %s (missing privilege?)\n",
+            ThreadScheduling::GetSchedulingClassName(policy.schedulingClass),
+            ThreadScheduling::GetSchedulingClassName(scheduled.applied));
+        return 0;
+    }
+    if (scheduled.jitter.GetPercentile(0.99) > options.budgetUs) {
+        printf("p99 lateness %lld us exceeds the %lld us budget\n",
+            (long long)scheduled.jitter.GetPercentile(0.99), (long long)options.budgetUs);
+        return 1;
+    }
+    return 0;
+}
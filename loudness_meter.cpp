@@ -0,0 +1,348 @@
+#include "loudness_meter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Speaker bits (same values as the WAVEFORMATEXTENSIBLE dwChannelMask)
+const uint32_t CHANNEL_FRONT_LEFT = 0x1;
+const uint32_t CHANNEL_FRONT_RIGHT = 0x2;
+const uint32_t CHANNEL_FRONT_CENTER = 0x4;
+const uint32_t CHANNEL_LOW_FREQUENCY = 0x8;
+const uint32_t CHANNEL_BACK_LEFT = 0x10;
+const uint32_t CHANNEL_BACK_RIGHT = 0x20;
+const uint32_t CHANNEL_BACK_CENTER = 0x100;
+const uint32_t CHANNEL_SIDE_LEFT = 0x200;
+const uint32_t CHANNEL_SIDE_RIGHT = 0x400;
+
+const double SURROUND_WEIGHT = 1.41;  // +1.5 dB, BS.1770-4 Table 3
+
+const double ABSOLUTE_GATE = -70.0;
+const double INTEGRATED_RELATIVE_GATE = -10.0;
+const double RANGE_RELATIVE_GATE = -20.0;
+
+const double HISTOGRAM_MIN = -70.0;
+const double HISTOGRAM_MAX = 5.0;
+const int HISTOGRAM_BINS_PER_LU = 100;
+const int HISTOGRAM_BINS = (int)((HISTOGRAM_MAX - HISTOGRAM_MIN) * HISTOGRAM_BINS_PER_LU);
+
+// BS.1770-4 Annex 2 true-peak interpolation filter, 4 phases x 12 taps
+const float TRUE_PEAK_COEFFS[4][12] = {
+    { 0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+     -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+      0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+    {-0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+     -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+      0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+    {-0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+     -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+      0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+    {-0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+     -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+      0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f },
+};
+
+double EnergyToLoudness(double energy)
+{
+    return energy > 0.0 ? -0.691 + 10.0 * log10(energy) : -HUGE_VAL;
+}
+
+uint32_t DefaultChannelMask(uint32_t channels)
+{
+    switch (channels) {
+        case 1: return CHANNEL_FRONT_CENTER;
+        case 2: return CHANNEL_FRONT_LEFT | CHANNEL_FRONT_RIGHT;
+        case 4: return CHANNEL_FRONT_LEFT | CHANNEL_FRONT_RIGHT | CHANNEL_BACK_LEFT | CHANNEL_BACK_RIGHT;
+        case 6: return CHANNEL_FRONT_LEFT | CHANNEL_FRONT_RIGHT | CHANNEL_FRONT_CENTER |
+                       CHANNEL_LOW_FREQUENCY | CHANNEL_BACK_LEFT | CHANNEL_BACK_RIGHT;
+        case 8: return CHANNEL_FRONT_LEFT | CHANNEL_FRONT_RIGHT | CHANNEL_FRONT_CENTER |
+                       CHANNEL_LOW_FREQUENCY | CHANNEL_BACK_LEFT | CHANNEL_BACK_RIGHT |
+                       CHANNEL_SIDE_LEFT | CHANNEL_SIDE_RIGHT;
+        default: return 0;
+    }
+}
+
+}
+
+void LoudnessMeter::GatedHistogram::Init()
+{
+    counts.assign(HISTOGRAM_BINS, 0);
+    energies.assign(HISTOGRAM_BINS, 0.0);
+    total = 0;
+    totalEnergy = 0.0;
+}
+
+void LoudnessMeter::GatedHistogram::Clear()
+{
+    std::fill(counts.begin(), counts.end(), 0);
+    std::fill(energies.begin(), energies.end(), 0.0);
+    total = 0;
+    totalEnergy = 0.0;
+}
+
+void LoudnessMeter::GatedHistogram::Add(double energy)
+{
+    double loudness = EnergyToLoudness(energy);
+    if (loudness <= ABSOLUTE_GATE) return;
+
+    int bin = (int)((loudness - HISTOGRAM_MIN) * HISTOGRAM_BINS_PER_LU);
+    bin = std::clamp(bin, 0, HISTOGRAM_BINS - 1);
+    counts[bin]++;
+    energies[bin] += energy;
+    total++;
+    totalEnergy += energy;
+}
+
+int LoudnessMeter::GatedHistogram::FirstBinAtOrAbove(double loudness) const
+{
+    int bin = (int)floor((loudness - HISTOGRAM_MIN) * HISTOGRAM_BINS_PER_LU);
+    return std::clamp(bin, 0, HISTOGRAM_BINS);
+}
+
+LoudnessMeter::LoudnessMeter()
+    : m_momentary(-HUGE_VAL), m_shortTerm(-HUGE_VAL), m_integrated(-HUGE_VAL),
+      m_loudnessRange(0.0), m_truePeak(-HUGE_VAL)
+{
+    for (auto& peak : m_publishedPeaks) peak.store(0.0f, std::memory_order_relaxed);
+    m_momentaryHistogram.Init();
+    m_shortTermHistogram.Init();
+}
+
+bool LoudnessMeter::Configure(uint32_t sampleRate, uint32_t channels, uint32_t channelMask)
+{
+    if (sampleRate == 0 || channels == 0 || channels > MAX_CHANNELS) {
+        m_channels = 0;
+        return false;
+    }
+
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_subBlockFrames = (sampleRate + 5) / 10;
+
+    // Channel weights: walk the mask bits in order, one per channel
+    if (channelMask == 0) channelMask = DefaultChannelMask(channels);
+    uint32_t bit = 1;
+    for (uint32_t c = 0; c < channels; c++) {
+        while (channelMask && bit && !(channelMask & bit)) bit <<= 1;
+        uint32_t speaker = channelMask ? bit : 0;
+        bit <<= 1;
+
+        if (speaker == CHANNEL_LOW_FREQUENCY) {
+            m_weights[c] = 0.0;
+        } else if (speaker & (CHANNEL_BACK_LEFT | CHANNEL_BACK_RIGHT | CHANNEL_BACK_CENTER |
+                              CHANNEL_SIDE_LEFT | CHANNEL_SIDE_RIGHT)) {
+            m_weights[c] = SURROUND_WEIGHT;
+        } else {
+            m_weights[c] = 1.0;
+        }
+    }
+
+    // K-weighting stage 1: high shelf (BS.1770 pre-filter) for this rate
+    double f0 = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(PI * f0 / sampleRate);
+    double vh = pow(10.0, gain / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m_shelfB[0] = (vh + vb * k / q + k * k) / a0;
+    m_shelfB[1] = 2.0 * (k * k - vh) / a0;
+    m_shelfB[2] = (vh - vb * k / q + k * k) / a0;
+    m_shelfA[0] = 1.0;
+    m_shelfA[1] = 2.0 * (k * k - 1.0) / a0;
+    m_shelfA[2] = (1.0 - k / q + k * k) / a0;
+
+    // Stage 2: RLB high-pass
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(PI * f0 / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    m_highB[0] = 1.0;
+    m_highB[1] = -2.0;
+    m_highB[2] = 1.0;
+    m_highA[0] = 1.0;
+    m_highA[1] = 2.0 * (k * k - 1.0) / a0;
+    m_highA[2] = (1.0 - k / q + k * k) / a0;
+
+    Reset();
+    return true;
+}
+
+void LoudnessMeter::Reset()
+{
+    std::fill(std::begin(m_shelfZ1), std::end(m_shelfZ1), 0.0);
+    std::fill(std::begin(m_shelfZ2), std::end(m_shelfZ2), 0.0);
+    std::fill(std::begin(m_highZ1), std::end(m_highZ1), 0.0);
+    std::fill(std::begin(m_highZ2), std::end(m_highZ2), 0.0);
+    std::fill(std::begin(m_subBlockSum), std::end(m_subBlockSum), 0.0);
+    std::fill(std::begin(m_blockEnergies), std::end(m_blockEnergies), 0.0);
+    std::fill(std::begin(m_channelPeak), std::end(m_channelPeak), 0.0f);
+    for (auto& row : m_peakHistory) std::fill(std::begin(row), std::end(row), 0.0f);
+
+    m_subBlockFill = 0;
+    m_blockIndex = 0;
+    m_blockCount = 0;
+    m_momentarySum = 0.0;
+    m_shortTermSum = 0.0;
+    m_peakHistoryPos = 0;
+    m_momentaryHistogram.Clear();
+    m_shortTermHistogram.Clear();
+
+    m_momentary.store(-HUGE_VAL, std::memory_order_relaxed);
+    m_shortTerm.store(-HUGE_VAL, std::memory_order_relaxed);
+    m_integrated.store(-HUGE_VAL, std::memory_order_relaxed);
+    m_loudnessRange.store(0.0, std::memory_order_relaxed);
+    m_truePeak.store(-HUGE_VAL, std::memory_order_relaxed);
+    for (auto& peak : m_publishedPeaks) peak.store(0.0f, std::memory_order_relaxed);
+}
+
+void LoudnessMeter::Process(const float* interleaved, size_t frames)
+{
+    if (m_channels == 0) return;
+
+    const uint32_t channels = m_channels;
+    ProcessFrames(frames, [&](size_t frame, uint32_t channel) {
+        return interleaved[frame * channels + channel];
+    });
+}
+
+void LoudnessMeter::ProcessS16(const int16_t* interleaved, size_t frames)
+{
+    if (m_channels == 0) return;
+
+    const uint32_t channels = m_channels;
+    ProcessFrames(frames, [&](size_t frame, uint32_t channel) {
+        return interleaved[frame * channels + channel] / 32768.0f;
+    });
+}
+
+void LoudnessMeter::UpdateTruePeak(const float* frame)
+{
+    const uint32_t channels = m_channels;
+
+    m_peakHistoryPos = (m_peakHistoryPos + 1) % TRUE_PEAK_TAPS;
+    for (uint32_t c = 0; c < channels; c++) {
+        m_peakHistory[m_peakHistoryPos][c] = frame[c];
+    }
+
+    for (int phase = 0; phase < 4; phase++) {
+        float acc[MAX_CHANNELS] = {};
+        for (int tap = 0; tap < TRUE_PEAK_TAPS; tap++) {
+            const float coeff = TRUE_PEAK_COEFFS[phase][tap];
+            const float* history = m_peakHistory[(m_peakHistoryPos - tap + TRUE_PEAK_TAPS) % TRUE_PEAK_TAPS];
+            for (uint32_t c = 0; c < channels; c++) {
+                acc[c] += coeff * history[c];
+            }
+        }
+        for (uint32_t c = 0; c < channels; c++) {
+            m_channelPeak[c] = std::max(m_channelPeak[c], fabsf(acc[c]));
+        }
+    }
+}
+
+void LoudnessMeter::FinishSubBlock()
+{
+    double energy = 0.0;
+    for (uint32_t c = 0; c < m_channels; c++) {
+        energy += m_weights[c] * m_subBlockSum[c];
+        m_subBlockSum[c] = 0.0;
+    }
+    energy /= (double)m_subBlockFrames;
+    m_subBlockFill = 0;
+
+    // Slide both windows by one sub-block
+    int index = m_blockIndex;
+    int momentaryOldest = (index - MOMENTARY_BLOCKS + SHORT_TERM_BLOCKS) % SHORT_TERM_BLOCKS;
+    m_momentarySum += energy - m_blockEnergies[momentaryOldest];
+    m_shortTermSum += energy - m_blockEnergies[index];
+    m_blockEnergies[index] = energy;
+    m_blockIndex = (index + 1) % SHORT_TERM_BLOCKS;
+    m_blockCount++;
+
+    // Re-sum once per lap so rounding errors can't accumulate over days
+    if (m_blockIndex == 0) {
+        m_shortTermSum = 0.0;
+        for (double e : m_blockEnergies) m_shortTermSum += e;
+        m_momentarySum = 0.0;
+        for (int i = 0; i < MOMENTARY_BLOCKS; i++) {
+            m_momentarySum += m_blockEnergies[SHORT_TERM_BLOCKS - 1 - i];
+        }
+    }
+
+    if (m_blockCount >= MOMENTARY_BLOCKS) {
+        m_momentaryHistogram.Add(std::max(0.0, m_momentarySum) / MOMENTARY_BLOCKS);
+    }
+    if (m_blockCount >= SHORT_TERM_BLOCKS) {
+        m_shortTermHistogram.Add(std::max(0.0, m_shortTermSum) / SHORT_TERM_BLOCKS);
+    }
+
+    Publish();
+}
+
+void LoudnessMeter::Publish()
+{
+    if (m_blockCount >= MOMENTARY_BLOCKS) {
+        m_momentary.store(EnergyToLoudness(std::max(0.0, m_momentarySum) / MOMENTARY_BLOCKS), std::memory_order_relaxed);
+    }
+    if (m_blockCount >= SHORT_TERM_BLOCKS) {
+        m_shortTerm.store(EnergyToLoudness(std::max(0.0, m_shortTermSum) / SHORT_TERM_BLOCKS), std::memory_order_relaxed);
+    }
+
+    // Integrated: mean of blocks above the absolute gate and 10 LU below
+    // their own mean
+    const GatedHistogram& blocks = m_momentaryHistogram;
+    if (blocks.total > 0) {
+        double gate = EnergyToLoudness(blocks.totalEnergy / blocks.total) + INTEGRATED_RELATIVE_GATE;
+        uint64_t count = 0;
+        double sum = 0.0;
+        for (int bin = blocks.FirstBinAtOrAbove(gate); bin < HISTOGRAM_BINS; bin++) {
+            count += blocks.counts[bin];
+            sum += blocks.energies[bin];
+        }
+        if (count > 0) {
+            m_integrated.store(EnergyToLoudness(sum / count), std::memory_order_relaxed);
+        }
+    }
+
+    // Loudness range: 10th to 95th percentile of short-term values above
+    // the absolute gate and 20 LU below their mean
+    const GatedHistogram& shortTerm = m_shortTermHistogram;
+    if (shortTerm.total > 0) {
+        double gate = EnergyToLoudness(shortTerm.totalEnergy / shortTerm.total) + RANGE_RELATIVE_GATE;
+        int firstBin = shortTerm.FirstBinAtOrAbove(gate);
+        uint64_t count = 0;
+        for (int bin = firstBin; bin < HISTOGRAM_BINS; bin++) count += shortTerm.counts[bin];
+
+        if (count > 0) {
+            uint64_t lowRank = (uint64_t)(0.10 * (count - 1));
+            uint64_t highRank = (uint64_t)(0.95 * (count - 1));
+            double low = 0.0, high = 0.0;
+            uint64_t seen = 0;
+            for (int bin = firstBin; bin < HISTOGRAM_BINS; bin++) {
+                uint64_t binCount = shortTerm.counts[bin];
+                if (binCount == 0) continue;
+                double binLoudness = HISTOGRAM_MIN + (bin + 0.5) / HISTOGRAM_BINS_PER_LU;
+                if (seen <= lowRank && lowRank < seen + binCount) low = binLoudness;
+                if (seen <= highRank && highRank < seen + binCount) high = binLoudness;
+                seen += binCount;
+            }
+            m_loudnessRange.store(high - low, std::memory_order_relaxed);
+        }
+    }
+
+    float maxPeak = 0.0f;
+    for (uint32_t c = 0; c < m_channels; c++) {
+        m_publishedPeaks[c].store(m_channelPeak[c], std::memory_order_relaxed);
+        maxPeak = std::max(maxPeak, m_channelPeak[c]);
+    }
+    m_truePeak.store(maxPeak > 0.0f ? 20.0 * log10(maxPeak) : -HUGE_VAL, std::memory_order_relaxed);
+}
+
+double LoudnessMeter::GetChannelTruePeak(uint32_t channel) const
+{
+    if (channel >= MAX_CHANNELS) return -HUGE_VAL;
+    float peak = m_publishedPeaks[channel].load(std::memory_order_relaxed);
+    return peak > 0.0f ? 20.0 * log10(peak) : -HUGE_VAL;
+}
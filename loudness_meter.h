@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// EBU R128 / ITU-R BS.1770-4 loudness meter.
+// Feed interleaved audio with Process(); it K-weights every channel, keeps
+// 100 ms block energies for the momentary (400 ms) and short-term (3 s)
+// windows as running sums, and accumulates gated histograms for integrated
+// loudness and loudness range. True peak uses 4x polyphase oversampling.
+// Memory use is fixed after Configure(), so sessions can run indefinitely.
+//
+// Process() must be called from one thread at a time; the Get* results are
+// published atomically every 100 ms and may be read from any thread.
+class LoudnessMeter
+{
+public:
+    static const int MAX_CHANNELS = 8;
+
+    LoudnessMeter();
+
+    // channelMask uses the WAVEFORMATEXTENSIBLE speaker bits (0 = the usual
+    // layout for the channel count). LFE is excluded, surrounds get +1.5 dB.
+    bool Configure(uint32_t sampleRate, uint32_t channels, uint32_t channelMask = 0);
+
+    // Clear all measurements (keeps the configuration)
+    void Reset();
+
+    void Process(const float* interleaved, size_t frames);
+    void ProcessS16(const int16_t* interleaved, size_t frames);
+
+    // Results in LUFS / LU / dBTP; -HUGE_VAL until enough audio was measured
+    double GetMomentary() const { return m_momentary.load(std::memory_order_relaxed); }
+    double GetShortTerm() const { return m_shortTerm.load(std::memory_order_relaxed); }
+    double GetIntegrated() const { return m_integrated.load(std::memory_order_relaxed); }
+    double GetLoudnessRange() const { return m_loudnessRange.load(std::memory_order_relaxed); }
+    double GetTruePeak() const { return m_truePeak.load(std::memory_order_relaxed); }
+    double GetChannelTruePeak(uint32_t channel) const;
+
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint32_t GetChannels() const { return m_channels; }
+
+private:
+    // Histogram of gated block loudness, 0.01 LU bins from -70 to +5 LUFS.
+    // Each bin keeps the count and energy sum so gating stays exact enough
+    // without storing the block history.
+    struct GatedHistogram
+    {
+        std::vector<uint64_t> counts;
+        std::vector<double> energies;
+        uint64_t total = 0;
+        double totalEnergy = 0.0;
+
+        void Init();
+        void Clear();
+        void Add(double energy);
+        int FirstBinAtOrAbove(double loudness) const;
+    };
+
+    template <typename SampleFn>
+    void ProcessFrames(size_t frames, SampleFn sampleAt);
+
+    void FinishSubBlock();
+    void UpdateTruePeak(const float* frame);
+    void Publish();
+
+    uint32_t m_sampleRate = 0;
+    uint32_t m_channels = 0;
+    double m_weights[MAX_CHANNELS] = {};
+
+    // K-weighting: pre-filter shelf then RLB high-pass, transposed direct
+    // form II, state laid out per channel so the channel loop vectorizes
+    double m_shelfB[3] = {}, m_shelfA[3] = {};
+    double m_highB[3] = {}, m_highA[3] = {};
+    double m_shelfZ1[MAX_CHANNELS] = {}, m_shelfZ2[MAX_CHANNELS] = {};
+    double m_highZ1[MAX_CHANNELS] = {}, m_highZ2[MAX_CHANNELS] = {};
+
+    // Current 100 ms sub-block
+    size_t m_subBlockFrames = 0;
+    size_t m_subBlockFill = 0;
+    double m_subBlockSum[MAX_CHANNELS] = {};
+
+    // Last 30 sub-block energies (3 s) with running window sums
+    static const int SHORT_TERM_BLOCKS = 30;
+    static const int MOMENTARY_BLOCKS = 4;
+    double m_blockEnergies[SHORT_TERM_BLOCKS] = {};
+    int m_blockIndex = 0;
+    uint64_t m_blockCount = 0;
+    double m_momentarySum = 0.0;
+    double m_shortTermSum = 0.0;
+
+    GatedHistogram m_momentaryHistogram;   // Integrated loudness
+    GatedHistogram m_shortTermHistogram;   // Loudness range
+
+    // True peak: last 12 input frames per channel for the polyphase filter
+    static const int TRUE_PEAK_TAPS = 12;
+    float m_peakHistory[TRUE_PEAK_TAPS][MAX_CHANNELS] = {};
+    int m_peakHistoryPos = 0;
+    float m_channelPeak[MAX_CHANNELS] = {};
+
+    std::atomic<double> m_momentary;
+    std::atomic<double> m_shortTerm;
+    std::atomic<double> m_integrated;
+    std::atomic<double> m_loudnessRange;
+    std::atomic<double> m_truePeak;
+    std::atomic<float> m_publishedPeaks[MAX_CHANNELS];
+};
+
+template <typename SampleFn>
+void LoudnessMeter::ProcessFrames(size_t frames, SampleFn sampleAt)
+{
+    const uint32_t channels = m_channels;
+    float frame[MAX_CHANNELS];
+
+    for (size_t i = 0; i < frames; i++) {
+        for (uint32_t c = 0; c < channels; c++) {
+            frame[c] = sampleAt(i, c);
+        }
+
+        UpdateTruePeak(frame);
+
+        // Both biquads across all channels at once
+        for (uint32_t c = 0; c < channels; c++) {
+            double x = frame[c];
+            double y = m_shelfB[0] * x + m_shelfZ1[c];
+            m_shelfZ1[c] = m_shelfB[1] * x - m_shelfA[1] * y + m_shelfZ2[c];
+            m_shelfZ2[c] = m_shelfB[2] * x - m_shelfA[2] * y;
+
+            double z = m_highB[0] * y + m_highZ1[c];
+            m_highZ1[c] = m_highB[1] * y - m_highA[1] * z + m_highZ2[c];
+            m_highZ2[c] = m_highB[2] * y - m_highA[2] * z;
+
+            m_subBlockSum[c] += z * z;
+        }
+
+        if (++m_subBlockFill == m_subBlockFrames) {
+            FinishSubBlock();
+        }
+    }
+}
@@ -4,7 +4,11 @@
 #include <thread>
 #include <stdexcept>
 #include <vector>
+#include <cmath>
 #include "audio_capture.h"
+#include "waveform_renderer.h"
+#include "frame_pacer.h"
+#include "thread_scheduling.h"
 
 // Global variables
 HWND hwndMainWindow;
@@ -13,6 +17,8 @@ HWND hwndSampleCountLabel;
 HWND hwndStartButton;
 HWND hwndStopButton;
 HWND hwndWaveformCanvas;
+HWND hwndHistoryLabel;
+HWND hwndHistoryCanvas;
 HWND hwndDeviceLabel;
 HWND hwndDeviceCombo;
 HWND hwndCurrentDeviceLabel;
@@ -22,10 +28,50 @@ HWND hwndCaptureRadio;
 AudioCapture g_audioCapture;
 bool g_isRecording = false;
 int g_recordingCount = 0;
+int g_exitCode = 0;
+
+// Startup: the window shows first, audio comes up in the background and
+// reports back with this message (see AudioCapture::BeginInitialize)
+const UINT WM_AUDIO_READY = WM_APP + 1;
+bool g_audioReady = false;
+bool g_deviceLost = false;   // Shown in the status line while the capture loop reconnects
+
+// UI refresh pacing (timer runs on the UI thread)
+const UINT_PTR UI_TIMER_ID = 1;
+FramePacer g_framePacer;
+UINT g_uiTimerInterval = 0;
+uint64_t g_lastSampleCount = UINT64_MAX;
+
+// History overview (channel 0): follows the newest audio until the user
+// zooms or scrolls back. Positions are frames of the WaveformHistory; a span
+// of 0 shows everything held.
+const uint64_t HISTORY_ZOOM_FACTOR = 4;        // Per click
+const uint64_t HISTORY_SCROLL_DIVISOR = 8;     // Span scrolled per wheel notch
+bool g_historyFollow = true;
+uint64_t g_historyEnd = 0;
+uint64_t g_historySpan = 0;
+std::wstring g_historyText;
 
 // Forward declarations
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 LRESULT CALLBACK CanvasWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+LRESULT CALLBACK HistoryWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+// Value of a "--name=value" command-line option up to the next space (UTF-8)
+std::string GetOptionValue(const wchar_t* cmdLine, const wchar_t* name) {
+    const wchar_t* arg = wcsstr(cmdLine, name);
+    if (!arg) return std::string();
+
+    const wchar_t* value = arg + wcslen(name);
+    int length = 0;
+    while (value[length] && value[length] != L' ' && value[length] != L'\t') length++;
+    if (length == 0) return std::string();
+
+    int size = WideCharToMultiByte(CP_UTF8, 0, value, length, nullptr, 0, nullptr, nullptr);
+    std::string result(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, value, length, &result[0], size, nullptr, nullptr);
+    return result;
+}
 
 void StartRecording() {
     if (g_isRecording) return;
@@ -61,57 +107,74 @@ void ToggleRecording() {
     }
 }
 
-void RefreshDeviceList() {
-    // Clear existing items
+void FillDeviceCombo(const std::vector<AudioCapture::AudioDevice>& devices) {
     SendMessageW(hwndDeviceCombo, CB_RESETCONTENT, 0, 0);
 
-    // Stop recording and capturing before switching device types
-    bool wasRecording = g_isRecording;
-    bool wasCapturing = g_audioCapture.IsCapturing();
-    
-    if (wasRecording) {
-        StopRecording();
-        Sleep(100);
-    }
-    
-    if (wasCapturing) {
-        g_audioCapture.StopCapture();
-        Sleep(100);
-    }
-
-    // Determine device type
-    AudioCapture::DeviceType deviceType = AudioCapture::RenderDevices;
-    if (SendMessageW(hwndCaptureRadio, BM_GETCHECK, 0, 0) == BST_CHECKED) {
-        deviceType = AudioCapture::CaptureDevices;
-    }
-
-    // Get available devices
-    auto devices = g_audioCapture.EnumerateAudioDevices(deviceType);
-
-    // Add devices to combo box
+    // Add devices to combo box, selecting the default one
+    int selection = 0;
     for (const auto& device : devices) {
         std::wstring itemText = device.name;
         if (device.isDefault) {
             itemText += L" (Default)";
+            selection = device.index;
         }
         SendMessageW(hwndDeviceCombo, CB_ADDSTRING, 0, (LPARAM)itemText.c_str());
     }
 
-    // Select first device
     if (SendMessageW(hwndDeviceCombo, CB_GETCOUNT, 0, 0) > 0) {
-        SendMessageW(hwndDeviceCombo, CB_SETCURSEL, 0, 0);
+        SendMessageW(hwndDeviceCombo, CB_SETCURSEL, selection, 0);
     }
-    
-    // Resume capturing and recording if they were active
-    if (wasCapturing) {
-        if (!g_audioCapture.StartCapture()) {
-            MessageBoxW(hwndMainWindow, L"Failed to restart audio capture", L"Error", MB_OK | MB_ICONERROR);
-        }
+}
+
+void RefreshDeviceList() {
+    // Determine device type
+    AudioCapture::DeviceType deviceType = AudioCapture::RenderDevices;
+    if (SendMessageW(hwndCaptureRadio, BM_GETCHECK, 0, 0) == BST_CHECKED) {
+        deviceType = AudioCapture::CaptureDevices;
     }
-    
-    if (wasRecording && wasCapturing) {
-        StartRecording();
+
+    // Listing does not touch the running capture
+    FillDeviceCombo(g_audioCapture.EnumerateAudioDevices(deviceType));
+}
+
+void UpdateCurrentDeviceLabel() {
+    auto device = g_audioCapture.GetCurrentDevice();
+    std::wstring labelText = L"Current: ";
+    labelText += device.name;
+    labelText += (g_audioCapture.GetCurrentDeviceType() == AudioCapture::RenderDevices) ? L" (Playback)" : L" (Recording)";
+    SetWindowTextW(hwndCurrentDeviceLabel, labelText.c_str());
+}
+
+void EnableDeviceControls(bool enable) {
+    EnableWindow(hwndRenderRadio, enable);
+    EnableWindow(hwndCaptureRadio, enable);
+    EnableWindow(hwndDeviceCombo, enable);
+    EnableWindow(hwndStopButton, enable);
+}
+
+// Background startup finished: capture runs with the final device, the
+// device list is ready; nothing is restarted
+void OnAudioReady(bool started) {
+    std::vector<AudioCapture::AudioDevice> devices;
+    started = g_audioCapture.FinishInitialize(devices) && started;
+    if (!started) {
+        MessageBoxW(hwndMainWindow, L"Failed to start audio capture", L"Error", MB_OK | MB_ICONERROR);
+        g_exitCode = 1;
+        DestroyWindow(hwndMainWindow);
+        return;
     }
+
+    g_audioReady = true;
+    FillDeviceCombo(devices);
+    UpdateCurrentDeviceLabel();
+    EnableDeviceControls(true);
+
+    // Start recording automatically
+    StartRecording();
+
+    // Paint right away instead of on the next timer tick
+    g_framePacer.Invalidate();
+    InvalidateRect(hwndWaveformCanvas, nullptr, FALSE);
 }
 
 void SelectAudioDevice() {
@@ -132,23 +195,16 @@ void SelectAudioDevice() {
     
     if (wasRecording) {
         StopRecording();
-        Sleep(100);  // Give it time to stop
     }
     
     if (wasCapturing) {
         g_audioCapture.StopCapture();
-        Sleep(100);  // Give it time to stop
     }
 
     try {
         // Select the device
         if (g_audioCapture.SelectAudioDevice(selectedIndex, deviceType)) {
-            // Update current device label
-            auto device = g_audioCapture.GetCurrentDevice();
-            std::wstring labelText = L"Current: ";
-            labelText += device.name;
-            labelText += (deviceType == AudioCapture::RenderDevices) ? L" (Playback)" : L" (Recording)";
-            SetWindowTextW(hwndCurrentDeviceLabel, labelText.c_str());
+            UpdateCurrentDeviceLabel();
             
             // Resume capturing if it was active
             if (wasCapturing) {
@@ -178,161 +234,238 @@ void SelectAudioDevice() {
     }
 }
 
-void DrawAudioTrack(HDC hdc, float level, int width, int height) {
-    // Create memory DC for double buffering (prevents flickering)
-    HDC memDC = CreateCompatibleDC(hdc);
-    HBITMAP memBitmap = CreateCompatibleBitmap(hdc, width, height);
-    HBITMAP oldBitmap = (HBITMAP)SelectObject(memDC, memBitmap);
-    
-    // Clear background
-    HBRUSH bgBrush = CreateSolidBrush(RGB(30, 30, 30));
-    RECT rect = {0, 0, width, height};
-    FillRect(memDC, &rect, bgBrush);
-    DeleteObject(bgBrush);
-
-    // Draw volume bar at top (40 pixels high)
-    int barWidth = 50;
-    int barHeight = 30;
-    int barX = (width - barWidth) / 2;
-    int barY = 5;
-
-    // Background bar
-    HBRUSH barBgBrush = CreateSolidBrush(RGB(50, 50, 50));
-    RECT barRect = {barX, barY, barX + barWidth, barY + barHeight};
-    FillRect(memDC, &barRect, barBgBrush);
-    DeleteObject(barBgBrush);
-
-    // Level bar
-    int levelHeight = (int)(level * barHeight);
-    HBRUSH levelBrush = CreateSolidBrush(RGB(0, 255, 0));
-    RECT levelRect = {barX, barY + barHeight - levelHeight, barX + barWidth, barY + barHeight};
-    FillRect(memDC, &levelRect, levelBrush);
-    DeleteObject(levelBrush);
-
-    // Draw border
-    HPEN pen = CreatePen(PS_SOLID, 2, RGB(100, 100, 100));
-    HPEN oldPen = (HPEN)SelectObject(memDC, pen);
-    MoveToEx(memDC, barX, barY, nullptr);
-    LineTo(memDC, barX + barWidth, barY);
-    LineTo(memDC, barX + barWidth, barY + barHeight);
-    LineTo(memDC, barX, barY + barHeight);
-    LineTo(memDC, barX, barY);
-    SelectObject(memDC, oldPen);
-    DeleteObject(pen);
-
-    // Draw waveform at bottom (remaining height)
-    int waveformY = barY + barHeight + 5;
-    int waveformHeight = height - waveformY - 5;
-    
-    if (waveformHeight > 10) {
-        int pixelWidth = width - 20;
-        
-        // Quick copy of waveform data with minimal lock time
-        std::vector<float> waveformCopy;
-        int waveformPos = 0;
-        int bufferSize = 0;
-        {
-            std::lock_guard<std::mutex> lock(g_audioCapture.GetWaveformMutex());
-            const auto& waveformBuffer = g_audioCapture.GetWaveformBufferRef();
-            bufferSize = g_audioCapture.GetWaveformBufferSize();
-            waveformPos = g_audioCapture.GetWaveformPosition();
-            
-            // Copy only the data we need to display (much faster)
-            int samplesPerPixel = max(1, bufferSize / max(1, pixelWidth));
-            int totalSamplesToShow = min(pixelWidth * samplesPerPixel, bufferSize);
-            waveformCopy.reserve(totalSamplesToShow);
-            
-            int startPos = (waveformPos - totalSamplesToShow + bufferSize) % bufferSize;
-            for (int i = 0; i < totalSamplesToShow; i++) {
-                int idx = (startPos + i) % bufferSize;
-                waveformCopy.push_back(waveformBuffer[idx]);
-            }
+// Frames of the history shown in the overview
+void GetHistoryRange(uint64_t& start, uint64_t& end) {
+    const WaveformHistory& history = g_audioCapture.GetWaveformHistory();
+    uint64_t newest = history.GetFrameCount();
+    uint64_t oldest = history.GetOldestFrame();
+
+    end = (g_historyFollow || g_historyEnd > newest) ? newest : g_historyEnd;
+    if (g_historySpan == 0) {
+        start = oldest;
+    } else {
+        start = end > g_historySpan ? end - g_historySpan : 0;
+    }
+}
+
+// "H:MM:SS" of a frame count
+std::wstring FormatHistoryTime(uint64_t frames, uint32_t sampleRate) {
+    uint64_t seconds = sampleRate ? frames / sampleRate : 0;
+    wchar_t text[32];
+    swprintf_s(text, L"%llu:%02u:%02u", (unsigned long long)(seconds / 3600),
+        (unsigned)(seconds / 60 % 60), (unsigned)(seconds % 60));
+    return text;
+}
+
+void UpdateHistoryLabel() {
+    const WaveformHistory& history = g_audioCapture.GetWaveformHistory();
+    uint32_t sampleRate = history.GetSampleRate();
+    uint64_t start, end;
+    GetHistoryRange(start, end);
+    uint64_t newest = history.GetFrameCount();
+
+    std::wstring text = L"History: " + FormatHistoryTime(newest - start, sampleRate) + L" ago to ";
+    text += g_historyFollow ? std::wstring(L"now") : FormatHistoryTime(newest - end, sampleRate) + L" ago";
+    text += L"   (click: zoom in, right-click: zoom out, wheel: scroll)";
+
+    // Only changes once a second while following
+    if (text != g_historyText) {
+        SetWindowTextW(hwndHistoryLabel, text.c_str());
+        g_historyText = text;
+    }
+}
+
+// Zoom the overview in or out around column `x` of a canvas `width` wide
+void ZoomHistory(int x, int width, bool zoomIn) {
+    const WaveformHistory& history = g_audioCapture.GetWaveformHistory();
+    uint64_t newest = history.GetFrameCount();
+    uint64_t held = newest - history.GetOldestFrame();
+    uint64_t start, end;
+    GetHistoryRange(start, end);
+    if (width <= 0 || end <= start) return;
+
+    if (x < 0) x = 0;
+    if (x > width) x = width;
+    uint64_t span = end - start;
+    uint64_t center = start + span * (uint64_t)x / (uint64_t)width;
+    if (zoomIn) {
+        // Down to a second; the live view above shows finer detail
+        span /= HISTORY_ZOOM_FACTOR;
+        if (span < history.GetSampleRate()) span = history.GetSampleRate();
+    } else {
+        span *= HISTORY_ZOOM_FACTOR;
+        if (span >= held) {
+            g_historySpan = 0;
+            g_historyFollow = true;
+            return;
         }
-        // Lock released - now draw without blocking audio threads
-        
-        if (!waveformCopy.empty()) {
-            int centerY = waveformY + waveformHeight / 2;
-            int samplesPerPixel = max(1, (int)waveformCopy.size() / pixelWidth);
-            
-            // Create waveform pen once
-            HPEN waveformPen = CreatePen(PS_SOLID, 1, RGB(0, 200, 100));
-            HPEN oldWaveformPen = (HPEN)SelectObject(memDC, waveformPen);
-            
-            // Draw waveform lines (top half)
-            bool first = true;
-            for (int x = 0; x < pixelWidth && x < width - 10; x++) {
-                float maxSample = 0.0f;
-                int startIdx = x * samplesPerPixel;
-                int endIdx = min(startIdx + samplesPerPixel, (int)waveformCopy.size());
-                
-                for (int i = startIdx; i < endIdx; i++) {
-                    maxSample = max(maxSample, fabs(waveformCopy[i]));
-                }
-                
-                int barHeight = (int)(maxSample * (waveformHeight / 2 - 2));
-                barHeight = max(0, min(waveformHeight / 2 - 2, barHeight));
-                
-                if (first) {
-                    MoveToEx(memDC, x + 10, centerY - barHeight, nullptr);
-                    first = false;
-                } else {
-                    LineTo(memDC, x + 10, centerY - barHeight);
-                }
+    }
+
+    g_historySpan = span;
+    g_historyEnd = center + span / 2 > span ? center + span / 2 : span;
+    g_historyFollow = g_historyEnd >= newest;
+}
+
+// Scroll the overview by wheel `notches` (positive: back in time)
+void ScrollHistory(int notches) {
+    const WaveformHistory& history = g_audioCapture.GetWaveformHistory();
+    uint64_t newest = history.GetFrameCount();
+    uint64_t start, end;
+    GetHistoryRange(start, end);
+    if (g_historySpan == 0) return;
+
+    // Not back past the oldest frame held (unless already there)
+    int64_t target = (int64_t)end - (int64_t)(g_historySpan / HISTORY_SCROLL_DIVISOR) * notches;
+    int64_t earliest = (int64_t)(history.GetOldestFrame() + g_historySpan);
+    if (earliest > (int64_t)end) earliest = (int64_t)end;
+    g_historyEnd = (uint64_t)(target > earliest ? target : earliest);
+    g_historyFollow = g_historyEnd >= newest;
+}
+
+void UpdateFramePacerVisibility() {
+    FramePacer::Visibility visibility = FramePacer::Visible;
+    if (IsIconic(hwndMainWindow)) {
+        visibility = FramePacer::Minimized;
+    } else {
+        // A fully covered canvas has an empty clip region
+        HDC hdc = GetDC(hwndWaveformCanvas);
+        RECT clip;
+        if (hdc && GetClipBox(hdc, &clip) == NULLREGION) {
+            visibility = FramePacer::Occluded;
+        }
+        ReleaseDC(hwndWaveformCanvas, hdc);
+    }
+    g_framePacer.SetVisibility(visibility);
+}
+
+void ScheduleUiTimer(HWND hwnd) {
+    // SetTimer with the same ID replaces the running timer
+    UINT interval = g_framePacer.GetIntervalMs();
+    if (interval != g_uiTimerInterval) {
+        SetTimer(hwnd, UI_TIMER_ID, interval, nullptr);
+        g_uiTimerInterval = interval;
+    }
+}
+
+void OnUiTimer(HWND hwnd) {
+    if (!g_audioReady) {
+        return;
+    }
+    UpdateFramePacerVisibility();
+
+    bool deviceLost = g_audioCapture.IsDeviceLost();
+    if (deviceLost != g_deviceLost) {
+        g_deviceLost = deviceLost;
+        SetWindowTextW(hwndStatusLabel, deviceLost ? L"Status: Device lost, reconnecting..." :
+            g_isRecording ? L"Status: Recording..." : L"Status: Stopped");
+    }
+
+    // The first frame after the first packet is painted even if the packet
+    // was silent (and did not change the data generation)
+    StartupTimer& startup = g_audioCapture.GetStartupTimer();
+    if (!startup.IsMarked(StartupFirstFrame) && startup.IsMarked(StartupFirstPacket)) {
+        InvalidateRect(hwndWaveformCanvas, nullptr, FALSE);
+    }
+
+    if (g_framePacer.OnTick(g_audioCapture.GetDataGeneration())) {
+        // Label updates are coalesced to one per frame and skipped if unchanged
+        uint64_t samples = g_audioCapture.GetSampleCount();
+        if (samples != g_lastSampleCount) {
+            const LoudnessMeter& loudness = g_audioCapture.GetLoudnessMeter();
+            double momentary = loudness.GetMomentary();
+            double integrated = loudness.GetIntegrated();
+
+            wchar_t text[160];
+            int length;
+            if (std::isfinite(momentary) && std::isfinite(integrated)) {
+                length = swprintf_s(text, L"Samples: %llu   M: %.1f LUFS   I: %.1f LUFS", (unsigned long long)samples, momentary, integrated);
+            } else {
+                length = swprintf_s(text, L"Samples: %llu", (unsigned long long)samples);
             }
-            
-            // Draw bottom half
-            first = true;
-            for (int x = 0; x < pixelWidth && x < width - 10; x++) {
-                float maxSample = 0.0f;
-                int startIdx = x * samplesPerPixel;
-                int endIdx = min(startIdx + samplesPerPixel, (int)waveformCopy.size());
-                
-                for (int i = startIdx; i < endIdx; i++) {
-                    maxSample = max(maxSample, fabs(waveformCopy[i]));
-                }
-                
-                int barHeight = (int)(maxSample * (waveformHeight / 2 - 2));
-                barHeight = max(0, min(waveformHeight / 2 - 2, barHeight));
-                
-                if (first) {
-                    MoveToEx(memDC, x + 10, centerY + barHeight, nullptr);
-                    first = false;
-                } else {
-                    LineTo(memDC, x + 10, centerY + barHeight);
-                }
+            uint64_t events = g_audioCapture.GetEventDetector().GetTotalCount();
+            if (events > 0 && length > 0) {
+                length += swprintf_s(text + length, _countof(text) - length, L"   Events: %llu", (unsigned long long)events);
             }
-            
-            SelectObject(memDC, oldWaveformPen);
-            DeleteObject(waveformPen);
-            
-            // Draw waveform border
-            HPEN borderPen = CreatePen(PS_SOLID, 1, RGB(70, 70, 70));
-            HPEN oldBorderPen = (HPEN)SelectObject(memDC, borderPen);
-            MoveToEx(memDC, 10, waveformY, nullptr);
-            LineTo(memDC, width - 10, waveformY);
-            LineTo(memDC, width - 10, waveformY + waveformHeight);
-            LineTo(memDC, 10, waveformY + waveformHeight);
-            LineTo(memDC, 10, waveformY);
-            SelectObject(memDC, oldBorderPen);
-            DeleteObject(borderPen);
-            
-            // Draw center line
-            HPEN centerPen = CreatePen(PS_SOLID, 1, RGB(50, 50, 50));
-            HPEN oldCenterPen = (HPEN)SelectObject(memDC, centerPen);
-            MoveToEx(memDC, 10, centerY, nullptr);
-            LineTo(memDC, width - 10, centerY);
-            SelectObject(memDC, oldCenterPen);
-            DeleteObject(centerPen);
+            if (g_audioCapture.IsStreaming() && length > 0) {
+                const BatchedWriter& stream = g_audioCapture.GetStreamWriter();
+                swprintf_s(text + length, _countof(text) - length, L"   Stream: %.0f KB/s, %llu dropped",
+                    stream.GetThroughput() / 1024.0, (unsigned long long)stream.GetStats().blocksDropped.load());
+            }
+            SetWindowTextW(hwndSampleCountLabel, text);
+            g_lastSampleCount = samples;
         }
+
+        UpdateHistoryLabel();
+        InvalidateRect(hwndWaveformCanvas, nullptr, FALSE);
+        InvalidateRect(hwndHistoryCanvas, nullptr, FALSE);
     }
-    
-    // Copy mem DC to screen (fast blit, no flickering)
-    BitBlt(hdc, 0, 0, width, height, memDC, 0, 0, SRCCOPY);
-    
-    // Cleanup
-    SelectObject(memDC, oldBitmap);
-    DeleteObject(memBitmap);
-    DeleteDC(memDC);
+
+    ScheduleUiTimer(hwnd);
+}
+
+void PresentCanvas(HDC hdc, const WaveformRenderer& renderer, int width, int height);
+
+void DrawAudioTrack(HDC hdc, float level, int width, int height) {
+    // Persistent pixel buffer; only reallocated when the canvas grows
+    static WaveformRenderer renderer;
+    renderer.Resize(width, height);
+
+    // Reduce the most recent second of channel 0 to per-column min/max.
+    // The view points into the capture ring; retry if it was overwritten.
+    // Until audio is up the canvas shows an empty track.
+    const WaveformRing& ring = g_audioCapture.GetWaveformRing();
+    if (!g_audioReady) {
+        renderer.SetWaveform(nullptr, 0);
+    }
+    for (int attempt = 0; attempt < 3 && g_audioReady; attempt++) {
+        WaveformView view;
+        if (!ring.Snapshot(0, WAVEFORM_BUFFER_SIZE, view)) {
+            renderer.SetWaveform(nullptr, 0);
+            break;
+        }
+        renderer.SetWaveform(view.first.data(), view.first.size(),
+                             view.second.data(), view.second.size());
+        if (ring.IsValid(view)) break;
+    }
+    renderer.Render(level);
+    PresentCanvas(hdc, renderer, width, height);
+}
+
+void DrawHistory(HDC hdc, int width, int height) {
+    static WaveformRenderer renderer;
+    static std::vector<WaveformHistory::Summary> summaries;
+    renderer.Resize(width, height);
+
+    // One summary per column; retry if the capture thread overwrote what
+    // was read
+    size_t columns = renderer.GetColumnCount() > 0 ? (size_t)renderer.GetColumnCount() : 0;
+    if (summaries.size() < columns) summaries.resize(columns);
+    const WaveformHistory& history = g_audioCapture.GetWaveformHistory();
+    renderer.SetSummaries(nullptr, 0);
+    for (int attempt = 0; attempt < 3 && g_audioReady && columns > 0; attempt++) {
+        uint64_t start, end;
+        GetHistoryRange(start, end);
+        if (history.GetSummaries(0, start, end, columns, summaries.data())) {
+            renderer.SetSummaries(summaries.data(), columns);
+            break;
+        }
+    }
+    renderer.RenderOverview();
+    PresentCanvas(hdc, renderer, width, height);
+}
+
+void PresentCanvas(HDC hdc, const WaveformRenderer& renderer, int width, int height) {
+    // Present with a single blit (top-down 32-bit DIB)
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = renderer.GetStride();
+    bmi.bmiHeader.biHeight = -renderer.GetHeight();
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    StretchDIBits(hdc, 0, 0, width, height, 0, 0, width, height,
+        renderer.GetPixels(), &bmi, DIB_RGB_COLORS, SRCCOPY);
 }
 
 LRESULT CALLBACK CanvasWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
@@ -347,8 +480,14 @@ LRESULT CALLBACK CanvasWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
                 int width = rect.right - rect.left;
                 int height = rect.bottom - rect.top;
 
-                float level = g_audioCapture.GetCurrentLevel();
+                float level = g_audioReady ? g_audioCapture.GetCurrentLevel() : 0.0f;
                 DrawAudioTrack(hdc, level, width, height);
+
+                StartupTimer& startup = g_audioCapture.GetStartupTimer();
+                if (g_audioReady && startup.IsMarked(StartupFirstPacket) && !startup.IsMarked(StartupFirstFrame)) {
+                    startup.Mark(StartupFirstFrame);
+                    g_audioCapture.ReportStartup();
+                }
             }
             catch (...) {
                 // If drawing fails, just fill with black
@@ -366,6 +505,43 @@ LRESULT CALLBACK CanvasWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
     return DefWindowProcW(hwnd, msg, wParam, lParam);
 }
 
+LRESULT CALLBACK HistoryWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+        case WM_PAINT: {
+            PAINTSTRUCT ps;
+            HDC hdc = BeginPaint(hwnd, &ps);
+            RECT rect;
+            GetClientRect(hwnd, &rect);
+            DrawHistory(hdc, rect.right - rect.left, rect.bottom - rect.top);
+            EndPaint(hwnd, &ps);
+            return 0;
+        }
+
+        case WM_LBUTTONDOWN:
+        case WM_RBUTTONDOWN: {
+            // Columns start after the renderer's margin, as in the live view
+            RECT rect;
+            GetClientRect(hwnd, &rect);
+            int left = WaveformRenderer::GetColumnLeft();
+            ZoomHistory((short)LOWORD(lParam) - left, rect.right - rect.left - 2 * left, msg == WM_LBUTTONDOWN);
+
+            // The wheel goes to the focused window
+            SetFocus(hwnd);
+            UpdateHistoryLabel();
+            InvalidateRect(hwnd, nullptr, FALSE);
+            return 0;
+        }
+
+        case WM_MOUSEWHEEL: {
+            ScrollHistory(GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA);
+            UpdateHistoryLabel();
+            InvalidateRect(hwnd, nullptr, FALSE);
+            return 0;
+        }
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
 LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
         case WM_CREATE: {
@@ -374,7 +550,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 WS_CHILD | WS_VISIBLE, 10, 10, 400, 30, hwnd, nullptr, nullptr, nullptr);
 
             // Status label
-            hwndStatusLabel = CreateWindowW(L"STATIC", L"Status: Ready",
+            hwndStatusLabel = CreateWindowW(L"STATIC", L"Status: Starting audio...",
                 WS_CHILD | WS_VISIBLE, 10, 40, 400, 25, hwnd, nullptr, nullptr, nullptr);
 
             // Sample count label
@@ -415,11 +591,44 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             hwndWaveformCanvas = CreateWindowW(L"WaveformCanvas", nullptr,
                 WS_CHILD | WS_VISIBLE, 10, 210, 980, 300, hwnd, nullptr, nullptr, nullptr);
 
+            // History overview below the live view
+            hwndHistoryLabel = CreateWindowW(L"STATIC", L"History:",
+                WS_CHILD | WS_VISIBLE, 10, 520, 600, 20, hwnd, nullptr, nullptr, nullptr);
+
+            WNDCLASSW historyClass = {};
+            historyClass.lpfnWndProc = HistoryWndProc;
+            historyClass.lpszClassName = L"HistoryCanvas";
+            historyClass.hbrBackground = CreateSolidBrush(RGB(30, 30, 30));
+            RegisterClassW(&historyClass);
+
+            hwndHistoryCanvas = CreateWindowW(L"HistoryCanvas", nullptr,
+                WS_CHILD | WS_VISIBLE, 10, 545, 980, 110, hwnd, nullptr, nullptr, nullptr);
+
             // Stop/Resume button (centered)
             hwndStopButton = CreateWindowW(L"BUTTON", L"Stop Recording",
-                WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 440, 520, 120, 30,
+                WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON, 440, 665, 120, 30,
                 hwnd, (HMENU)2, nullptr, nullptr);
 
+            // Device controls wait for the background startup
+            EnableDeviceControls(false);
+
+            // Visualizer refresh runs on this thread
+            ScheduleUiTimer(hwnd);
+
+            return 0;
+        }
+
+        case WM_TIMER: {
+            if (wParam == UI_TIMER_ID) {
+                OnUiTimer(hwnd);
+            }
+            return 0;
+        }
+
+        case WM_SIZE: {
+            g_framePacer.SetVisibility(wParam == SIZE_MINIMIZED ? FramePacer::Minimized : FramePacer::Visible);
+            g_framePacer.Invalidate();
+            ScheduleUiTimer(hwnd);
             return 0;
         }
 
@@ -438,9 +647,7 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 case 7: // Capture devices radio button
                     if (code == BN_CLICKED) {
                         RefreshDeviceList();
-                        // Small delay to ensure list is populated
-                        Sleep(50);
-                        // Auto-select first device
+                        // Switch to the device selected in the new list
                         SelectAudioDevice();
                     }
                     break;
@@ -448,7 +655,17 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             return 0;
         }
 
+        case WM_AUDIO_READY: {
+            OnAudioReady(wParam != 0);
+            return 0;
+        }
+
         case WM_CLOSE: {
+            if (!g_audioReady) {
+                // Closed during startup: let it finish so capture can be stopped
+                std::vector<AudioCapture::AudioDevice> devices;
+                g_audioCapture.FinishInitialize(devices);
+            }
             StopRecording();
             g_audioCapture.StopCapture();
             DestroyWindow(hwnd);
@@ -456,7 +673,8 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
         }
 
         case WM_DESTROY:
-            PostQuitMessage(0);
+            KillTimer(hwnd, UI_TIMER_ID);
+            PostQuitMessage(g_exitCode);
             return 0;
     }
     return DefWindowProcW(hwnd, msg, wParam, lParam);
@@ -464,31 +682,110 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR pCmdLine, int nCmdShow) {
     try {
-    // Initialize audio capture
-    if (!g_audioCapture.Initialize()) {
-        MessageBoxW(nullptr, L"Failed to initialize audio capture", L"Error", MB_OK | MB_ICONERROR);
-        return 1;
+    // Thread scheduling, before any pipeline thread starts:
+    // --sched=off, --sched-capture=/--sched-writer=/--sched-background=CLASS[:PRIO][@MASK]
+    if (pCmdLine) {
+        if (GetOptionValue(pCmdLine, L"--sched=") == "off") {
+            ThreadScheduling::SetEnabled(false);
+        }
+        const struct { const wchar_t* option; ThreadScheduling::Role role; } schedOptions[] = {
+            { L"--sched-capture=", ThreadScheduling::Capture },
+            { L"--sched-writer=", ThreadScheduling::Writer },
+            { L"--sched-background=", ThreadScheduling::Background },
+        };
+        for (const auto& option : schedOptions) {
+            std::string value = GetOptionValue(pCmdLine, option.option);
+            ThreadScheduling::Policy policy;
+            if (!value.empty() && ThreadScheduling::ParsePolicy(value.c_str(), policy)) {
+                ThreadScheduling::SetPolicy(option.role, policy);
+            }
+        }
     }
+    ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Background);
+
+    // Capture trace for AudioReplay, before capture starts: --trace=PATH [--trace-payload]
+    // Recorded depth and requantization: --record-bits=16|24 --dither=off --noise-shaping
+    // Integrity manifest next to each recording: --manifest=off
+    // Event index next to each recording: --events=off
+    // Shared-memory ring for other processes: --shared-ring=NAME [--shared-ring-ms=N]
+    if (pCmdLine) {
+        if (GetOptionValue(pCmdLine, L"--record-bits=") == "24") {
+            g_audioCapture.SetRecordingBitDepth(24);
+        }
+        if (GetOptionValue(pCmdLine, L"--dither=") == "off") {
+            g_audioCapture.GetRequantizer().SetDither(false);
+        }
+        if (wcsstr(pCmdLine, L"--noise-shaping")) {
+            g_audioCapture.GetRequantizer().SetNoiseShaping(true);
+        }
+        if (GetOptionValue(pCmdLine, L"--manifest=") == "off") {
+            g_audioCapture.SetManifestEnabled(false);
+        }
+        if (GetOptionValue(pCmdLine, L"--events=") == "off") {
+            g_audioCapture.SetEventsEnabled(false);
+        }
 
-    // Start capturing for real-time visualization
-    if (!g_audioCapture.StartCapture()) {
-        MessageBoxW(nullptr, L"Failed to start audio capture", L"Error", MB_OK | MB_ICONERROR);
-        return 1;
+        const wchar_t* traceArg = wcsstr(pCmdLine, L"--trace=");
+        if (traceArg) {
+            const wchar_t* path = traceArg + wcslen(L"--trace=");
+            size_t length = wcscspn(path, L" \t");
+            if (length > 0) {
+                g_audioCapture.SetTraceTarget(std::wstring(path, length), wcsstr(pCmdLine, L"--trace-payload") != nullptr);
+            }
+        }
+
+        std::string ringName = GetOptionValue(pCmdLine, L"--shared-ring=");
+        if (!ringName.empty()) {
+            const wchar_t* historyArg = wcsstr(pCmdLine, L"--shared-ring-ms=");
+            int historyMs = historyArg ? _wtoi(historyArg + wcslen(L"--shared-ring-ms=")) : 0;
+            g_audioCapture.SetSharedRing(ringName, historyMs > 0 ? (uint32_t)historyMs : 2000);
+        }
     }
 
-    // Start UI update thread with higher frequency for smooth waveform
-    std::thread uiThread([]() {
-        while (true) {
-            int samples = g_audioCapture.GetSampleCount();
-            std::wstring text = L"Samples: ";
-            text += std::to_wstring(samples);
-            SetWindowTextW(hwndSampleCountLabel, text.c_str());
+    // Optional refresh cap: --max-fps=N
+    if (pCmdLine) {
+        const wchar_t* fpsArg = wcsstr(pCmdLine, L"--max-fps=");
+        if (fpsArg) {
+            g_framePacer.SetMaxFps(_wtoi(fpsArg + wcslen(L"--max-fps=")));
+        }
+
+        // Recording processing: --denoise[=dB] --gain=dB --dc-block --gate=dB --limit=dB
+        const wchar_t* denoiseArg = wcsstr(pCmdLine, L"--denoise");
+        if (denoiseArg) {
+            if (denoiseArg[wcslen(L"--denoise")] == L'=') {
+                g_audioCapture.GetNoiseSuppressor().SetReductionDb((float)_wtof(denoiseArg + wcslen(L"--denoise=")));
+            }
+            g_audioCapture.SetNoiseSuppression(true);
+        }
+        RecordingStages& stages = g_audioCapture.GetRecordingStages();
+        const wchar_t* gainArg = wcsstr(pCmdLine, L"--gain=");
+        if (gainArg) {
+            stages.Get<GainStage>().SetGainDb((float)_wtof(gainArg + wcslen(L"--gain=")));
+        }
+        if (wcsstr(pCmdLine, L"--dc-block")) {
+            stages.Get<DcBlockerStage>().SetEnabled(true);
+        }
+        const wchar_t* gateArg = wcsstr(pCmdLine, L"--gate=");
+        if (gateArg) {
+            stages.Get<NoiseGateStage>().SetThresholdDb((float)_wtof(gateArg + wcslen(L"--gate=")));
+            stages.Get<NoiseGateStage>().SetEnabled(true);
+        }
+        const wchar_t* limitArg = wcsstr(pCmdLine, L"--limit=");
+        if (limitArg) {
+            stages.Get<LimiterStage>().SetCeilingDb((float)_wtof(limitArg + wcslen(L"--limit=")));
+            stages.Get<LimiterStage>().SetEnabled(true);
+        }
 
-            InvalidateRect(hwndWaveformCanvas, nullptr, FALSE);
-            Sleep(33);  // ~30 FPS for smooth real-time visualization
+        // Live stream: --stream=TARGET [--stream-format=raw|wav] [--stream-policy=drop|block]
+        std::string streamTarget = GetOptionValue(pCmdLine, L"--stream=");
+        if (!streamTarget.empty()) {
+            StreamOutput::Format format = GetOptionValue(pCmdLine, L"--stream-format=") == "wav"
+                ? StreamOutput::Wave : StreamOutput::RawPcm;
+            BatchedWriter::OverflowPolicy policy = GetOptionValue(pCmdLine, L"--stream-policy=") == "block"
+                ? BatchedWriter::Block : BatchedWriter::DropNewest;
+            g_audioCapture.SetStreamTarget(streamTarget, format, policy);
         }
-    });
-    uiThread.detach();
+    }
 
     // Register window class
     WNDCLASSW wc = {};
@@ -508,7 +805,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR pCmdLin
         L"AudioCaptureWindow",
         L"Audio Capture - System Audio Recorder",
         WS_OVERLAPPEDWINDOW,
-        CW_USEDEFAULT, CW_USEDEFAULT, 1000, 600,
+        CW_USEDEFAULT, CW_USEDEFAULT, 1000, 750,
         nullptr, nullptr, hInstance, nullptr);
 
     if (!hwndMainWindow) {
@@ -518,20 +815,14 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR pCmdLin
 
     ShowWindow(hwndMainWindow, nCmdShow);
     UpdateWindow(hwndMainWindow);
+    g_audioCapture.GetStartupTimer().Mark(StartupWindowShown);
 
-    // Refresh device list
-    RefreshDeviceList();
-    
-    // Update current device label
-    auto currentDevice = g_audioCapture.GetCurrentDevice();
-    auto currentType = g_audioCapture.GetCurrentDeviceType();
-    std::wstring labelText = L"Current: ";
-    labelText += currentDevice.name;
-    labelText += (currentType == AudioCapture::RenderDevices) ? L" (Playback)" : L" (Recording)";
-    SetWindowTextW(hwndCurrentDeviceLabel, labelText.c_str());
-
-    // Start recording automatically
-    StartRecording();
+    // Device activation, capture start and the device list come up in the
+    // background; WM_AUDIO_READY finishes the startup on this thread
+    if (!g_audioCapture.BeginInitialize(hwndMainWindow, WM_AUDIO_READY, AudioCapture::RenderDevices)) {
+        MessageBoxW(hwndMainWindow, L"Failed to initialize audio capture", L"Error", MB_OK | MB_ICONERROR);
+        return 1;
+    }
 
     // Message loop
     MSG msg = {};
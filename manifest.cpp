@@ -0,0 +1,245 @@
+#include "manifest.h"
+#include "checksum.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const char MANIFEST_MAGIC[] = "AudioCapture manifest 1";
+
+// Block lines are short; buffered until each is flushed
+const size_t MANIFEST_FILE_BUFFER = 4096;
+
+bool Seek(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+uint64_t GetFileSize(FILE* file)
+{
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) return 0;
+    long long size = _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0) return 0;
+    off_t size = ftello(file);
+#endif
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+// Value of "key value" if `line` has that key
+const char* GetValue(const char* line, const char* key)
+{
+    size_t length = strlen(key);
+    if (strncmp(line, key, length) != 0 || line[length] != ' ') return nullptr;
+    return line + length + 1;
+}
+
+}
+
+// ManifestWriter
+
+ManifestWriter::~ManifestWriter()
+{
+    Close();
+}
+
+bool ManifestWriter::Open(FILE* manifest, const std::string& fileName, uint64_t streamOffset, uint64_t headerSize,
+                          uint32_t blockSize)
+{
+    Close();
+    if (!manifest) return false;
+    if (blockSize == 0 || fileName.empty()) {
+        fclose(manifest);
+        return false;
+    }
+
+    m_manifest = manifest;
+    m_manifestBuffer.assign(MANIFEST_FILE_BUFFER, 0);
+    setvbuf(m_manifest, m_manifestBuffer.data(), _IOFBF, m_manifestBuffer.size());
+
+    // Blocks the stream does not see completely, or that change after it,
+    // are hashed from the final file
+    uint64_t head = headerSize > streamOffset ? headerSize : streamOffset;
+    m_blockSize = blockSize;
+    m_headBlocks = (head + blockSize - 1) / blockSize;
+    m_offset = streamOffset;
+    m_blockCrc = 0;
+    m_bodyCrc = 0;
+    m_bodySize = 0;
+    m_blocks = 0;
+    m_hashNs = 0;
+    m_failed = false;
+
+    if (fprintf(m_manifest, "%s\nfile %s\nalgorithm crc32c\nblock-size %u\n", MANIFEST_MAGIC, fileName.c_str(),
+                blockSize) < 0 || fflush(m_manifest) != 0) {
+        m_failed = true;
+    }
+    return !m_failed;
+}
+
+void ManifestWriter::AddBytes(const uint8_t* data, size_t size)
+{
+    if (!m_manifest || m_failed) return;
+    auto start = std::chrono::steady_clock::now();
+
+    while (size > 0) {
+        uint64_t index = m_offset / m_blockSize;
+        uint64_t blockEnd = (index + 1) * m_blockSize;
+        size_t part = blockEnd - m_offset < size ? (size_t)(blockEnd - m_offset) : size;
+
+        if (index >= m_headBlocks) {
+            m_blockCrc = Crc32c(m_blockCrc, data, part);
+        }
+        data += part;
+        size -= part;
+        m_offset += part;
+
+        if (m_offset == blockEnd) {
+            if (index >= m_headBlocks) {
+                WriteBlock(index, m_blockCrc);
+                m_bodyCrc = Crc32cCombine(m_bodyCrc, m_blockCrc, m_blockSize);
+                m_bodySize += m_blockSize;
+            }
+            m_blockCrc = 0;
+        }
+    }
+
+    m_hashNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+bool ManifestWriter::WriteBlock(uint64_t index, uint32_t crc)
+{
+    // Flushed line by line so a recording cut off keeps its manifest
+    char line[48];
+    int length = snprintf(line, sizeof(line), "block %llu %08x\n", (unsigned long long)index, crc);
+    if (fwrite(line, 1, (size_t)length, m_manifest) != (size_t)length || fflush(m_manifest) != 0) {
+        m_failed = true;
+        return false;
+    }
+    m_blocks++;
+    return true;
+}
+
+bool ManifestWriter::Finish(FILE* file)
+{
+    if (!m_manifest) return false;
+    if (!file || m_failed) {
+        Close();
+        return false;
+    }
+
+    const uint64_t fileSize = GetFileSize(file);
+    const uint64_t bodyStart = m_headBlocks * m_blockSize;
+    const uint64_t tailStart = bodyStart + m_bodySize;
+    std::vector<uint8_t> buffer(m_blockSize);
+    uint32_t fileCrc = 0;
+
+    // Reads block `index` of the final file and lists it
+    auto hashBlock = [&](uint64_t index) {
+        uint64_t offset = index * m_blockSize;
+        size_t size = fileSize - offset < m_blockSize ? (size_t)(fileSize - offset) : m_blockSize;
+        if (!Seek(file, offset) || fread(buffer.data(), 1, size, file) != size) {
+            m_failed = true;
+            return;
+        }
+        uint32_t crc = Crc32c(0, buffer.data(), size);
+        WriteBlock(index, crc);
+        fileCrc = Crc32cCombine(fileCrc, crc, size);
+    };
+
+    for (uint64_t index = 0; index < m_headBlocks && index * m_blockSize < fileSize && !m_failed; index++) {
+        hashBlock(index);
+    }
+
+    // The streamed blocks must still be there; what follows them (the last
+    // partial block, chunks appended at the end) is read back
+    if (m_bodySize > 0) {
+        if (tailStart > fileSize) m_failed = true;
+        fileCrc = Crc32cCombine(fileCrc, m_bodyCrc, m_bodySize);
+    }
+    for (uint64_t index = tailStart / m_blockSize; index * m_blockSize < fileSize && !m_failed; index++) {
+        if (index >= m_headBlocks) hashBlock(index);
+    }
+
+    if (!m_failed && fprintf(m_manifest, "size %llu\ncrc32c %08x\ncomplete\n",
+                             (unsigned long long)fileSize, fileCrc) < 0) {
+        m_failed = true;
+    }
+    bool ok = !m_failed;
+    if (fclose(m_manifest) != 0) ok = false;
+    m_manifest = nullptr;
+    return ok;
+}
+
+void ManifestWriter::Close()
+{
+    if (!m_manifest) return;
+    fclose(m_manifest);
+    m_manifest = nullptr;
+}
+
+// Manifest
+
+bool Manifest::Load(const char* path)
+{
+    *this = Manifest();
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    char line[4096];
+    bool ok = fgets(line, sizeof(line), file) && strncmp(line, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC) - 1) == 0;
+    while (ok && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        const char* value;
+        if ((value = GetValue(line, "block")) != nullptr) {
+            char* end = nullptr;
+            Block block;
+            block.index = strtoull(value, &end, 10);
+            block.crc = (uint32_t)strtoul(end, &end, 16);
+            blocks.push_back(block);
+        } else if ((value = GetValue(line, "file")) != nullptr) {
+            fileName = value;
+        } else if ((value = GetValue(line, "algorithm")) != nullptr) {
+            ok = strcmp(value, "crc32c") == 0;
+        } else if ((value = GetValue(line, "block-size")) != nullptr) {
+            blockSize = (uint32_t)strtoul(value, nullptr, 10);
+        } else if ((value = GetValue(line, "size")) != nullptr) {
+            fileSize = strtoull(value, nullptr, 10);
+        } else if ((value = GetValue(line, "crc32c")) != nullptr) {
+            fileCrc = (uint32_t)strtoul(value, nullptr, 16);
+        } else if (strcmp(line, "complete") == 0) {
+            complete = true;
+        }
+    }
+    fclose(file);
+
+    std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.index < b.index; });
+    return ok && blockSize > 0 && !fileName.empty();
+}
+
+// ManifestOutput
+
+int64_t ManifestOutput::WriteGather(const IoSpan* spans, size_t count)
+{
+    int64_t written = m_output->WriteGather(spans, count);
+
+    // Hash exactly the bytes that reached the output, in order
+    if (written > 0 && m_manifest) {
+        uint64_t remaining = (uint64_t)written;
+        for (size_t i = 0; i < count && remaining > 0; i++) {
+            size_t part = spans[i].size < remaining ? spans[i].size : (size_t)remaining;
+            m_manifest->AddBytes(spans[i].data, part);
+            remaining -= part;
+        }
+    }
+    return written;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "batched_writer.h"
+
+// Integrity manifest ("recording_N.wav.manifest") with a CRC32C of every
+// fixed-size block of a file and of the whole file, so archives can be
+// checked without a separate hashing pass. Text, one item per line:
+//
+//   AudioCapture manifest 1
+//   file recording_1.wav
+//   algorithm crc32c
+//   block-size 1048576
+//   block 1 8a9136aa          (index, CRC; in any order)
+//   ...
+//   size 73400364
+//   crc32c 1f2e3d4c
+//   complete
+//
+// Blocks are listed as they are written, so a manifest cut off with its
+// recording still covers what was written; only a complete manifest has the
+// size and whole-file CRC.
+
+const uint32_t MANIFEST_BLOCK_SIZE = 1u << 20;
+
+// Builds a manifest from the bytes a writer thread writes. The writer may
+// start behind a header written separately, and the header may be rewritten
+// and chunks appended once the writer is done; Finish() hashes those parts
+// from the final file. AddBytes allocates nothing.
+class ManifestWriter
+{
+public:
+    ManifestWriter() = default;
+    ~ManifestWriter();
+
+    ManifestWriter(const ManifestWriter&) = delete;
+    ManifestWriter& operator=(const ManifestWriter&) = delete;
+
+    // Take ownership of `manifest` (opened for writing) for the file named
+    // `fileName` (stored as given, normally without a directory). The bytes
+    // passed to AddBytes start at `streamOffset` in the file; the first
+    // `headerSize` bytes are rewritten before Finish().
+    bool Open(FILE* manifest, const std::string& fileName, uint64_t streamOffset, uint64_t headerSize,
+              uint32_t blockSize = MANIFEST_BLOCK_SIZE);
+
+    // Hash the rewritten header and whatever follows the streamed bytes from
+    // the final `file` (opened for reading; left open), then complete and
+    // close the manifest
+    bool Finish(FILE* file);
+
+    // Close without completing
+    void Close();
+
+    bool IsOpen() const { return m_manifest != nullptr; }
+    uint64_t GetBlockCount() const { return m_blocks; }
+
+    // Writer-thread time spent hashing and writing block lines
+    uint64_t GetHashNs() const { return m_hashNs; }
+
+    void AddBytes(const uint8_t* data, size_t size);
+
+private:
+    bool WriteBlock(uint64_t index, uint32_t crc);
+
+    FILE* m_manifest = nullptr;
+    std::vector<char> m_manifestBuffer;
+    uint32_t m_blockSize = 0;
+    uint64_t m_headBlocks = 0;       // Blocks hashed again by Finish()
+    uint64_t m_offset = 0;           // File offset of the next streamed byte
+    uint32_t m_blockCrc = 0;         // Of the current block so far
+    uint32_t m_bodyCrc = 0;          // Of the complete streamed blocks after the head
+    uint64_t m_bodySize = 0;
+    uint64_t m_blocks = 0;
+    uint64_t m_hashNs = 0;
+    bool m_failed = false;
+};
+
+// Loaded manifest
+struct Manifest
+{
+    struct Block
+    {
+        uint64_t index = 0;
+        uint32_t crc = 0;
+    };
+
+    std::string fileName;
+    uint32_t blockSize = 0;
+    std::vector<Block> blocks;   // Sorted by index
+    bool complete = false;
+    uint64_t fileSize = 0;       // Complete manifests only
+    uint32_t fileCrc = 0;
+
+    bool Load(const char* path);
+};
+
+// ByteOutput that forwards to another output and feeds every byte written
+// to a ManifestWriter, so the checksums are computed on the writer thread
+// while the data is still in cache
+class ManifestOutput : public ByteOutput
+{
+public:
+    void SetOutput(ByteOutput* output, ManifestWriter* manifest) { m_output = output; m_manifest = manifest; }
+
+    bool Connect() override { return m_output->Connect(); }
+    void Disconnect() override { m_output->Disconnect(); }
+    int64_t WriteGather(const IoSpan* spans, size_t count) override;
+    void WaitWritable(uint32_t timeoutMs) override { m_output->WaitWritable(timeoutMs); }
+
+private:
+    ByteOutput* m_output = nullptr;
+    ManifestWriter* m_manifest = nullptr;
+};
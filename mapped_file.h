@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file for offline tools. The mapping is
+// set up for sequential access (readahead); Prefetch() asks the OS to start
+// reading a range that will be needed soon.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* path);
+    void Close();
+
+    bool IsOpen() const { return m_open; }
+    const uint8_t* GetData() const { return m_data; }
+    uint64_t GetSize() const { return m_size; }
+
+    void Prefetch(uint64_t offset, uint64_t size) const;
+
+private:
+    const uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+    bool m_open = false;
+
+    void* m_file = nullptr;      // Windows: file and mapping handles
+    void* m_mapping = nullptr;
+};
@@ -0,0 +1,201 @@
+#include "noise_suppressor.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// Frame length target; the FFT size is the next power of two
+const uint32_t FRAME_MS = 20;
+
+// Minimum statistics: power smoothing per frame, search window split into
+// sub-windows, and the factor from the minimum back to the mean noise power
+const float POWER_SMOOTHING = 0.85f;
+const uint32_t SEARCH_WINDOW_MS = 1500;
+const size_t SUBWINDOWS = 8;
+const float MINIMUM_BIAS = 1.5f;
+
+// Decision-directed a-priori SNR weight
+const float SNR_SMOOTHING = 0.98f;
+
+// Below this the bin is treated as digital silence
+const float MIN_NOISE_POWER = 1e-20f;
+
+// Smoothed power and its minimum in the current sub-window, per bin
+void TrackPower(const float* __restrict real, const float* __restrict imag, float* __restrict power,
+                float* __restrict smoothed, float* __restrict subwindowMin, size_t bins, bool first)
+{
+    const float keep = first ? 0.0f : POWER_SMOOTHING;
+    for (size_t k = 0; k < bins; k++) {
+        float p = real[k] * real[k] + imag[k] * imag[k];
+        float s = keep * smoothed[k] + (1.0f - keep) * p;
+        power[k] = p;
+        smoothed[k] = s;
+        subwindowMin[k] = fminf(subwindowMin[k], s);
+    }
+}
+
+// Wiener gain from the decision-directed SNR, limited to the floor
+void ComputeGains(const float* __restrict power, const float* __restrict subwindowMin,
+                  const float* __restrict windowMin, float* __restrict cleanPower, float* __restrict gain,
+                  size_t bins, float floor)
+{
+    for (size_t k = 0; k < bins; k++) {
+        float noise = MINIMUM_BIAS * fminf(subwindowMin[k], windowMin[k]);
+        float inverseNoise = 1.0f / fmaxf(noise, MIN_NOISE_POWER);
+        float posterior = power[k] * inverseNoise;
+        float prior = SNR_SMOOTHING * cleanPower[k] * inverseNoise +
+                      (1.0f - SNR_SMOOTHING) * fmaxf(posterior - 1.0f, 0.0f);
+        float g = fmaxf(prior / (1.0f + prior), floor);
+        gain[k] = g;
+        cleanPower[k] = g * g * power[k];
+    }
+}
+
+void ApplyGains(float* __restrict real, float* __restrict imag, const float* __restrict gain, size_t bins)
+{
+    for (size_t k = 0; k < bins; k++) {
+        real[k] *= gain[k];
+        imag[k] *= gain[k];
+    }
+}
+
+}
+
+void NoiseSuppressor::Prepare(uint32_t sampleRate, uint32_t channels, size_t)
+{
+    m_active = m_enabled.load(std::memory_order_relaxed) && sampleRate > 0 && channels > 0;
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    if (!m_active) return;
+
+    size_t target = (size_t)sampleRate * FRAME_MS / 1000;
+    m_frameSize = 16;
+    while (m_frameSize < target) m_frameSize *= 2;
+    m_hop = m_frameSize / 2;
+    m_fft.Configure(m_frameSize);
+    m_bins = m_fft.GetBinCount();
+
+    size_t windowFrames = (size_t)sampleRate * SEARCH_WINDOW_MS / 1000 / m_hop;
+    m_subwindowFrames = (uint32_t)std::max<size_t>(windowFrames / SUBWINDOWS, 1);
+
+    // Periodic window: the squares of overlapping halves add up to one
+    m_window.resize(m_frameSize);
+    for (size_t n = 0; n < m_frameSize; n++) {
+        m_window[n] = (float)sqrt(0.5 - 0.5 * cos(2.0 * PI * (double)n / (double)m_frameSize));
+    }
+
+    m_input.resize((size_t)channels * m_frameSize);
+    m_overlap.resize((size_t)channels * m_frameSize);
+    m_ready.resize((size_t)channels * m_hop);
+    m_smoothed.resize((size_t)channels * m_bins);
+    m_subwindowMin.resize((size_t)channels * m_bins);
+    m_windowMins.resize((size_t)channels * SUBWINDOWS * m_bins);
+    m_windowMin.resize((size_t)channels * m_bins);
+    m_cleanPower.resize((size_t)channels * m_bins);
+
+    m_frame.assign(m_frameSize, 0.0f);
+    m_real.assign(m_bins, 0.0f);
+    m_imag.assign(m_bins, 0.0f);
+    m_gain.assign(m_bins, 0.0f);
+
+    Reset();
+}
+
+void NoiseSuppressor::Reset()
+{
+    std::fill(m_input.begin(), m_input.end(), 0.0f);
+    std::fill(m_overlap.begin(), m_overlap.end(), 0.0f);
+    std::fill(m_ready.begin(), m_ready.end(), 0.0f);
+    std::fill(m_smoothed.begin(), m_smoothed.end(), 0.0f);
+    std::fill(m_subwindowMin.begin(), m_subwindowMin.end(), FLT_MAX);
+    std::fill(m_windowMins.begin(), m_windowMins.end(), FLT_MAX);
+    std::fill(m_windowMin.begin(), m_windowMin.end(), FLT_MAX);
+    std::fill(m_cleanPower.begin(), m_cleanPower.end(), 0.0f);
+    m_fill = 0;
+    m_frameCount = 0;
+    m_windowSlot = 0;
+}
+
+void NoiseSuppressor::Process(AudioBlock& block)
+{
+    if (!m_active) return;
+
+    const float floor = powf(10.0f, -fmaxf(m_reductionDb.load(std::memory_order_relaxed), 0.0f) / 20.0f);
+
+    // The newest hop of input goes into the frame, the finished hop of
+    // output comes out in its place; a full hop runs the frame
+    size_t position = 0;
+    while (position < block.frames) {
+        size_t count = std::min(block.frames - position, m_hop - m_fill);
+        for (uint32_t c = 0; c < block.channelCount && c < m_channels; c++) {
+            float* samples = block.channels[c] + position;
+            memcpy(m_input.data() + (size_t)c * m_frameSize + m_hop + m_fill, samples, count * sizeof(float));
+            memcpy(samples, m_ready.data() + (size_t)c * m_hop + m_fill, count * sizeof(float));
+        }
+        m_fill += count;
+        position += count;
+
+        if (m_fill == m_hop) {
+            for (uint32_t c = 0; c < m_channels; c++) {
+                ProcessFrame(c, floor);
+            }
+            m_fill = 0;
+            m_frameCount++;
+
+            // Close the sub-window: its minimum replaces the oldest one
+            if (m_frameCount % m_subwindowFrames == 0) {
+                for (uint32_t c = 0; c < m_channels; c++) {
+                    float* subwindowMin = m_subwindowMin.data() + (size_t)c * m_bins;
+                    float* windowMins = m_windowMins.data() + (size_t)c * SUBWINDOWS * m_bins;
+                    float* windowMin = m_windowMin.data() + (size_t)c * m_bins;
+                    const float* smoothed = m_smoothed.data() + (size_t)c * m_bins;
+
+                    memcpy(windowMins + m_windowSlot * m_bins, subwindowMin, m_bins * sizeof(float));
+                    memcpy(windowMin, windowMins, m_bins * sizeof(float));
+                    for (size_t w = 1; w < SUBWINDOWS; w++) {
+                        const float* mins = windowMins + w * m_bins;
+                        for (size_t k = 0; k < m_bins; k++) windowMin[k] = fminf(windowMin[k], mins[k]);
+                    }
+                    memcpy(subwindowMin, smoothed, m_bins * sizeof(float));
+                }
+                m_windowSlot = (m_windowSlot + 1) % SUBWINDOWS;
+            }
+        }
+    }
+}
+
+void NoiseSuppressor::ProcessFrame(uint32_t channel, float floor)
+{
+    float* input = m_input.data() + (size_t)channel * m_frameSize;
+    float* overlap = m_overlap.data() + (size_t)channel * m_frameSize;
+    float* ready = m_ready.data() + (size_t)channel * m_hop;
+    const size_t bins = m_bins;
+
+    for (size_t n = 0; n < m_frameSize; n++) {
+        m_frame[n] = input[n] * m_window[n];
+    }
+    m_fft.Forward(m_frame.data(), m_real.data(), m_imag.data());
+
+    // m_frame holds the power spectrum until the inverse transform
+    TrackPower(m_real.data(), m_imag.data(), m_frame.data(), m_smoothed.data() + (size_t)channel * bins,
+               m_subwindowMin.data() + (size_t)channel * bins, bins, m_frameCount == 0);
+    ComputeGains(m_frame.data(), m_subwindowMin.data() + (size_t)channel * bins,
+                 m_windowMin.data() + (size_t)channel * bins, m_cleanPower.data() + (size_t)channel * bins,
+                 m_gain.data(), bins, floor);
+    ApplyGains(m_real.data(), m_imag.data(), m_gain.data(), bins);
+
+    m_fft.Inverse(m_real.data(), m_imag.data(), m_frame.data());
+    for (size_t n = 0; n < m_frameSize; n++) {
+        overlap[n] += m_frame[n] * m_window[n];
+    }
+
+    // The first half is complete; shift both frames by a hop
+    memcpy(ready, overlap, m_hop * sizeof(float));
+    memmove(overlap, overlap + m_hop, m_hop * sizeof(float));
+    memset(overlap + m_hop, 0, m_hop * sizeof(float));
+    memmove(input, input + m_hop, m_hop * sizeof(float));
+}
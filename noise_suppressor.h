@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "dsp_graph.h"
+#include "fft.h"
+
+// Spectral noise suppression for stationary noise (fans, air conditioning,
+// hum) in microphone recordings. Each channel is cut into frames of about
+// 20 ms (power-of-two FFT, 50% overlap, square-root Hann windows for
+// analysis and synthesis). The noise power per bin is tracked with minimum
+// statistics: the minimum of the smoothed power over the last ~1.5 s,
+// kept in eight sub-windows so speech never has to pause for long. Bins
+// are weighted with a Wiener gain from a decision-directed SNR estimate,
+// limited to the reduction floor, and overlap-added back.
+// The delay is one frame (GetLatency()), fixed when the node is prepared;
+// a disabled node adds no delay and costs nothing. Frame buffers, FFT
+// tables and tracking state are allocated in Prepare().
+class NoiseSuppressor : public DspNode
+{
+public:
+    // Takes effect on Prepare (changes the latency)
+    void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Largest attenuation of a noise-only bin, in dB (default 15)
+    void SetReductionDb(float db) { m_reductionDb.store(db, std::memory_order_relaxed); }
+
+    void Prepare(uint32_t sampleRate, uint32_t channels, size_t maxFrames) override;
+    void Process(AudioBlock& block) override;
+    void Reset() override;
+    size_t GetLatency() const override { return m_active ? m_frameSize : 0; }
+    bool IsActive() const override { return m_active; }
+    const char* GetName() const override { return "NoiseSuppressor"; }
+
+    size_t GetFrameSize() const { return m_frameSize; }
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+
+private:
+    void ProcessFrame(uint32_t channel, float floor);
+
+    std::atomic<bool> m_enabled{ false };
+    std::atomic<float> m_reductionDb{ 15.0f };
+    bool m_active = false;
+
+    uint32_t m_sampleRate = 0;
+    uint32_t m_channels = 0;
+    size_t m_frameSize = 0;
+    size_t m_hop = 0;
+    size_t m_bins = 0;
+    uint32_t m_subwindowFrames = 0;
+
+    RealFft m_fft;
+    std::vector<float> m_window;       // Square-root Hann, analysis and synthesis
+
+    // Per channel, channel c at c * size
+    std::vector<float> m_input;        // Last frame of input
+    std::vector<float> m_overlap;      // Overlap-add accumulator
+    std::vector<float> m_ready;        // Finished output of the last hop
+    std::vector<float> m_smoothed;     // Smoothed power per bin
+    std::vector<float> m_subwindowMin; // Minimum in the current sub-window
+    std::vector<float> m_windowMins;   // Minimum of each finished sub-window
+    std::vector<float> m_windowMin;    // Minimum over the finished sub-windows
+    std::vector<float> m_cleanPower;   // Estimated speech power of the last frame
+
+    // Shared scratch
+    std::vector<float> m_frame;
+    std::vector<float> m_real;
+    std::vector<float> m_imag;
+    std::vector<float> m_gain;
+
+    size_t m_fill = 0;                 // Samples of the current hop, all channels
+    uint64_t m_frameCount = 0;
+    size_t m_windowSlot = 0;
+};
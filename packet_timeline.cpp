@@ -0,0 +1,155 @@
+#include "packet_timeline.h"
+
+namespace {
+
+// PacketInfo::timestamp is in 100 ns units
+const uint64_t TIMESTAMP_UNITS_PER_SECOND = 10000000;
+
+}
+
+void PacketTimeline::Reset(uint32_t sampleRate, uint64_t maxGapFrames, size_t maxGaps)
+{
+    m_sampleRate = sampleRate;
+    m_maxGapFrames = maxGapFrames;
+    m_maxGaps = maxGaps;
+
+    m_started = false;
+    m_startPosition = 0;
+    m_startTimestamp = 0;
+    m_expectedPosition = 0;
+    m_outputFrames = 0;
+    m_positionOffset = 0;
+    m_lastPosition = 0;
+    m_lastTimestamp = 0;
+    m_lastFrames = 0;
+
+    m_gaps.clear();
+    m_gaps.reserve(maxGaps);
+    m_gapCount = 0;
+    m_silenceFrames = 0;
+    m_lostFrames = 0;
+    m_overlapFrames = 0;
+    m_resyncCount = 0;
+    m_timestampErrors = 0;
+    m_reacquireCount = 0;
+}
+
+PacketTimeline::Placement PacketTimeline::Place(const PacketInfo& packet)
+{
+    Placement placement;
+
+    if ((packet.flags & PacketInfo::Reacquired) && m_started) {
+        // New device epoch: map its positions to continue after the outage
+        m_reacquireCount++;
+        uint64_t outage = GetOutageFrames(packet);
+        if (outage <= m_maxGapFrames) {
+            m_positionOffset = m_expectedPosition + outage - packet.devicePosition;
+        } else {
+            // Too long to fill: continue right after the last packet
+            m_resyncCount++;
+            RecordGap(packet, 0);
+            m_positionOffset = m_expectedPosition - packet.devicePosition;
+        }
+    }
+
+    uint64_t position = packet.devicePosition + m_positionOffset;
+    if (packet.flags & PacketInfo::TimestampError) {
+        // Position cannot be trusted; assume the packet is contiguous
+        m_timestampErrors++;
+        position = m_started ? m_expectedPosition : 0;
+    }
+
+    if (!m_started) {
+        m_started = true;
+        m_startPosition = position;
+        m_startTimestamp = packet.timestamp;
+        m_expectedPosition = position;
+    }
+
+    if (position > m_expectedPosition) {
+        uint64_t missing = position - m_expectedPosition;
+        if (missing <= m_maxGapFrames) {
+            placement.gapFrames = missing;
+            m_silenceFrames += missing;
+            RecordGap(packet, missing);
+        } else {
+            // Implausible jump (device clock reset): continue from here
+            m_resyncCount++;
+            RecordGap(packet, 0);
+        }
+        m_expectedPosition = position;
+    } else if (position < m_expectedPosition) {
+        uint64_t overlap = m_expectedPosition - position;
+        if (overlap <= m_maxGapFrames) {
+            placement.skipFrames = overlap < packet.frames ? (uint32_t)overlap : packet.frames;
+            m_overlapFrames += placement.skipFrames;
+        } else {
+            // Clock went far backwards: continue from here
+            m_resyncCount++;
+            RecordGap(packet, 0);
+            m_expectedPosition = position;
+        }
+    } else if (packet.flags & PacketInfo::Discontinuity) {
+        // Glitch reported without a position jump; keep it in the index
+        RecordGap(packet, 0);
+    }
+
+    m_outputFrames += placement.gapFrames + (packet.frames - placement.skipFrames);
+    m_lastPosition = packet.devicePosition;
+    m_lastTimestamp = packet.timestamp;
+    m_lastFrames = packet.frames;
+
+    uint64_t end = position + packet.frames;
+    if (end > m_expectedPosition) {
+        m_expectedPosition = end;
+    }
+    return placement;
+}
+
+void PacketTimeline::RecordLoss(uint64_t outputFrame, uint64_t frames)
+{
+    m_lostFrames += frames;
+
+    // An overflow usually loses several blocks in a row; list them as one
+    if (!m_gaps.empty() && m_gaps.back().lost && m_gaps.back().outputFrame + m_gaps.back().frames == outputFrame) {
+        m_gaps.back().frames += frames;
+        return;
+    }
+
+    m_gapCount++;
+    if (m_gaps.size() >= m_maxGaps) return;
+
+    Gap gap;
+    gap.outputFrame = outputFrame;
+    gap.devicePosition = m_lastPosition;
+    gap.timestamp = m_lastTimestamp;
+    gap.frames = frames;
+    gap.lost = true;
+    m_gaps.push_back(gap);
+}
+
+uint64_t PacketTimeline::GetOutageFrames(const PacketInfo& packet) const
+{
+    // Time from the end of the last packet to this one, in frames
+    if (m_sampleRate == 0) return 0;
+    uint64_t lastEnd = m_lastTimestamp + (uint64_t)m_lastFrames * TIMESTAMP_UNITS_PER_SECOND / m_sampleRate;
+    if (packet.timestamp <= lastEnd) return 0;
+
+    uint64_t elapsed = packet.timestamp - lastEnd;
+    return elapsed / TIMESTAMP_UNITS_PER_SECOND * m_sampleRate +
+           elapsed % TIMESTAMP_UNITS_PER_SECOND * m_sampleRate / TIMESTAMP_UNITS_PER_SECOND;
+}
+
+void PacketTimeline::RecordGap(const PacketInfo& packet, uint64_t frames)
+{
+    m_gapCount++;
+    if (m_gaps.size() >= m_maxGaps) return;
+
+    Gap gap;
+    gap.outputFrame = m_outputFrames;
+    gap.devicePosition = packet.devicePosition;
+    gap.timestamp = packet.timestamp;
+    gap.frames = frames;
+    gap.flags = packet.flags;
+    m_gaps.push_back(gap);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Metadata of one captured packet
+struct PacketInfo
+{
+    enum Flags : uint32_t {
+        Silent = 1,           // Payload is silence (AUDCLNT_BUFFERFLAGS_SILENT)
+        Discontinuity = 2,    // Device reported a glitch before this packet
+        TimestampError = 4,   // Device position/timestamp are unreliable
+        Reacquired = 8        // First packet after the device was re-acquired
+    };
+
+    uint64_t devicePosition = 0;   // Device frame position of the first frame
+    uint64_t timestamp = 0;        // Monotonic time of the first frame, 100 ns units
+    uint32_t frames = 0;
+    uint32_t flags = 0;
+};
+
+// Places captured packets on the device's sample clock so the output always
+// spans the elapsed device time. A packet that starts past the expected
+// position follows a gap (stall, dropped packets, discontinuity): the caller
+// inserts exactly that much silence. A packet that starts before it overlaps
+// audio already written: the overlapping frames are skipped.
+// After a device loss the re-acquired device counts positions from scratch;
+// its first packet (PacketInfo::Reacquired) is placed by its timestamp
+// instead, so the outage becomes a gap like any other. Timestamps must come
+// from one clock across the loss (QPC, or GetSharedRingTime()).
+//
+// Place() is called from the capture thread only and does not allocate; the
+// gap list is reserved by Reset().
+class PacketTimeline
+{
+public:
+    struct Placement
+    {
+        uint64_t gapFrames = 0;   // Silence to insert before the packet
+        uint32_t skipFrames = 0;  // Leading frames of the packet to drop
+    };
+
+    struct Gap
+    {
+        uint64_t outputFrame = 0;     // Output position where the silence starts
+        uint64_t devicePosition = 0;  // Device position of the packet after the gap
+        uint64_t timestamp = 0;       // Timestamp of that packet
+        uint64_t frames = 0;          // Silence written (0 for a resync or a bare discontinuity)
+        uint32_t flags = 0;           // PacketInfo flags of that packet
+        bool lost = false;            // Placed audio that was not recorded; silence stands in
+    };
+
+    // Start a new timeline. Jumps over maxGapFrames are treated as a clock
+    // reset (no silence is inserted); at most maxGaps gaps are recorded.
+    void Reset(uint32_t sampleRate, uint64_t maxGapFrames, size_t maxGaps);
+
+    Placement Place(const PacketInfo& packet);
+
+    // Placed frames starting at outputFrame that could not be recorded and
+    // were written as silence instead (pool or writer overflow). Listed
+    // with the gaps, at the device position of the last placed packet.
+    void RecordLoss(uint64_t outputFrame, uint64_t frames);
+
+    bool HasStarted() const { return m_started; }
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint64_t GetStartDevicePosition() const { return m_startPosition; }
+    uint64_t GetStartTimestamp() const { return m_startTimestamp; }
+
+    // Frames placed so far, silence included
+    uint64_t GetOutputFrames() const { return m_outputFrames; }
+
+    const std::vector<Gap>& GetGaps() const { return m_gaps; }
+    uint64_t GetGapCount() const { return m_gapCount; }          // Including unrecorded ones
+    uint64_t GetSilenceFrames() const { return m_silenceFrames; }
+    uint64_t GetLostFrames() const { return m_lostFrames; }
+    uint64_t GetOverlapFrames() const { return m_overlapFrames; }
+    uint64_t GetResyncCount() const { return m_resyncCount; }
+    uint64_t GetTimestampErrors() const { return m_timestampErrors; }
+    uint64_t GetReacquireCount() const { return m_reacquireCount; }
+
+private:
+    void RecordGap(const PacketInfo& packet, uint64_t frames);
+    uint64_t GetOutageFrames(const PacketInfo& packet) const;
+
+    uint32_t m_sampleRate = 0;
+    uint64_t m_maxGapFrames = 0;
+    size_t m_maxGaps = 0;
+
+    bool m_started = false;
+    uint64_t m_startPosition = 0;
+    uint64_t m_startTimestamp = 0;
+    uint64_t m_expectedPosition = 0;
+    uint64_t m_outputFrames = 0;
+    uint64_t m_positionOffset = 0;   // Added to device positions since the last re-acquisition
+    uint64_t m_lastPosition = 0;     // Of the last placed packet
+    uint64_t m_lastTimestamp = 0;
+    uint32_t m_lastFrames = 0;
+
+    std::vector<Gap> m_gaps;
+    uint64_t m_gapCount = 0;
+    uint64_t m_silenceFrames = 0;
+    uint64_t m_lostFrames = 0;
+    uint64_t m_overlapFrames = 0;
+    uint64_t m_resyncCount = 0;
+    uint64_t m_timestampErrors = 0;
+    uint64_t m_reacquireCount = 0;
+};
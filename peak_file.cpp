@@ -0,0 +1,520 @@
+#include "peak_file.h"
+#include <cstring>
+
+namespace {
+
+const char PEAK_MAGIC[4] = { 'A', 'C', 'P', 'K' };
+const uint16_t PEAK_VERSION = 1;
+const uint32_t PEAK_COMPLETE = 1;
+
+// Encoded entries buffered between writes
+const size_t PEAK_BUFFER_ENTRIES = 512;
+
+// Factor between derived in-memory levels
+const uint32_t PEAK_LEVEL_FACTOR = PEAK_COARSE_FRAMES / PEAK_FINE_FRAMES;
+
+void PutU16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+void PutU32(uint8_t* p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+void PutU64(uint8_t* p, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+uint16_t GetU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t GetU32(const uint8_t* p)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+uint64_t GetU64(const uint8_t* p)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+bool Seek(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+uint64_t GetFileSize(FILE* file)
+{
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) return 0;
+    long long size = _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0) return 0;
+    off_t size = ftello(file);
+#endif
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+// 8-bit peaks keep the envelope: min rounds down, max rounds up
+int8_t ToPeak8Min(int16_t value) { return (int8_t)(value >> 8); }
+
+int8_t ToPeak8Max(int16_t value)
+{
+    int result = ((int)value + 255) >> 8;
+    return (int8_t)(result > 127 ? 127 : result);
+}
+
+}
+
+size_t ComputePeaks(const int16_t* samples, size_t frames, uint16_t channels,
+                    uint32_t framesPerPeak, int16_t* minMax)
+{
+    size_t count = 0;
+    for (size_t start = 0; start < frames; start += framesPerPeak) {
+        size_t end = start + framesPerPeak < frames ? start + framesPerPeak : frames;
+        int16_t* peak = minMax + count * channels * 2;
+
+        for (uint16_t ch = 0; ch < channels; ch++) {
+            int16_t low = 32767, high = -32768;
+            const int16_t* sample = samples + start * channels + ch;
+            for (size_t i = start; i < end; i++, sample += channels) {
+                if (*sample < low) low = *sample;
+                if (*sample > high) high = *sample;
+            }
+            peak[ch * 2] = low;
+            peak[ch * 2 + 1] = high;
+        }
+        count++;
+    }
+    return count;
+}
+
+// PeakFileWriter
+
+PeakFileWriter::~PeakFileWriter()
+{
+    Close();
+}
+
+bool PeakFileWriter::Open(FILE* file, uint16_t channels, uint32_t sampleRate, int peakBits)
+{
+    Close();
+    if (!file) return false;
+    if (channels == 0 || (peakBits != 8 && peakBits != 16)) {
+        fclose(file);
+        return false;
+    }
+
+    m_file = file;
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+    m_peakBits = peakBits;
+    m_entrySize = (size_t)channels * 2 * (peakBits / 8);
+
+    // Everything the pipeline thread touches is allocated here; the file
+    // itself is unbuffered since entries are batched in m_buffer
+    setvbuf(m_file, nullptr, _IONBF, 0);
+    m_current.assign((size_t)channels * 2, 0);
+    m_currentFrames = 0;
+    m_carry.assign((size_t)channels * sizeof(int16_t), 0);
+    m_carryUsed = 0;
+    m_buffer.assign(m_entrySize * PEAK_BUFFER_ENTRIES, 0);
+    m_bufferUsed = 0;
+    m_frames = 0;
+    m_fineCount = 0;
+    m_failed = false;
+
+    WriteHeader(false, 0, 0, 0);
+    return !m_failed;
+}
+
+void PeakFileWriter::Close()
+{
+    if (!m_file) return;
+    FlushBuffer();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void PeakFileWriter::AddBytes(const uint8_t* data, size_t size)
+{
+    if (!m_file) return;
+
+    const size_t frameSize = m_carry.size();
+
+    // Complete a frame left over from the previous call
+    if (m_carryUsed > 0) {
+        size_t part = frameSize - m_carryUsed;
+        if (part > size) part = size;
+        memcpy(m_carry.data() + m_carryUsed, data, part);
+        m_carryUsed += part;
+        data += part;
+        size -= part;
+        if (m_carryUsed < frameSize) return;
+
+        AddSamples((const int16_t*)m_carry.data(), 1);
+        m_carryUsed = 0;
+    }
+
+    size_t frames = size / frameSize;
+    if (frames > 0) {
+        // Writer blocks come from the pool and are 16-bit aligned; fall back
+        // to the carry buffer for odd offsets
+        if (((uintptr_t)data & 1) == 0) {
+            AddSamples((const int16_t*)data, frames);
+        } else {
+            for (size_t i = 0; i < frames; i++) {
+                memcpy(m_carry.data(), data + i * frameSize, frameSize);
+                AddSamples((const int16_t*)m_carry.data(), 1);
+            }
+        }
+    }
+
+    size_t rest = size - frames * frameSize;
+    if (rest > 0) {
+        memcpy(m_carry.data(), data + frames * frameSize, rest);
+        m_carryUsed = rest;
+    }
+}
+
+void PeakFileWriter::AddSamples(const int16_t* samples, size_t frames)
+{
+    if (!m_file) return;
+
+    while (frames > 0) {
+        if (m_currentFrames == 0) {
+            for (uint16_t ch = 0; ch < m_channels; ch++) {
+                m_current[ch * 2] = 32767;
+                m_current[ch * 2 + 1] = -32768;
+            }
+        }
+
+        size_t take = PEAK_FINE_FRAMES - m_currentFrames;
+        if (take > frames) take = frames;
+
+        for (uint16_t ch = 0; ch < m_channels; ch++) {
+            int16_t low = m_current[ch * 2], high = m_current[ch * 2 + 1];
+            const int16_t* sample = samples + ch;
+            for (size_t i = 0; i < take; i++, sample += m_channels) {
+                if (*sample < low) low = *sample;
+                if (*sample > high) high = *sample;
+            }
+            m_current[ch * 2] = low;
+            m_current[ch * 2 + 1] = high;
+        }
+
+        samples += take * m_channels;
+        frames -= take;
+        m_frames += take;
+        m_currentFrames += (uint32_t)take;
+
+        if (m_currentFrames == PEAK_FINE_FRAMES) {
+            EmitPeak(m_current.data());
+            m_currentFrames = 0;
+        }
+    }
+}
+
+void PeakFileWriter::AddPeaks(const int16_t* minMax, size_t count, uint64_t frames)
+{
+    if (!m_file) return;
+
+    for (size_t i = 0; i < count; i++) {
+        EmitPeak(minMax + i * m_channels * 2);
+    }
+    m_frames += frames;
+}
+
+void PeakFileWriter::EmitPeak(const int16_t* minMax)
+{
+    uint8_t* entry = m_buffer.data() + m_bufferUsed;
+    if (m_peakBits == 16) {
+        memcpy(entry, minMax, m_entrySize);
+    } else {
+        for (uint16_t ch = 0; ch < m_channels; ch++) {
+            entry[ch * 2] = (uint8_t)ToPeak8Min(minMax[ch * 2]);
+            entry[ch * 2 + 1] = (uint8_t)ToPeak8Max(minMax[ch * 2 + 1]);
+        }
+    }
+
+    m_bufferUsed += m_entrySize;
+    m_fineCount++;
+    if (m_bufferUsed == m_buffer.size()) {
+        FlushBuffer();
+    }
+}
+
+void PeakFileWriter::FlushBuffer()
+{
+    if (m_bufferUsed == 0) return;
+    if (fwrite(m_buffer.data(), 1, m_bufferUsed, m_file) != m_bufferUsed) {
+        m_failed = true;
+    }
+    m_bufferUsed = 0;
+}
+
+void PeakFileWriter::WriteHeader(bool complete, uint64_t coarseCount, uint64_t sourceDataSize, uint64_t sourceFileSize)
+{
+    uint8_t header[PEAK_HEADER_SIZE] = {};
+    memcpy(header, PEAK_MAGIC, 4);
+    PutU16(header + 4, PEAK_VERSION);
+    PutU16(header + 6, (uint16_t)PEAK_HEADER_SIZE);
+    PutU16(header + 8, m_channels);
+    PutU16(header + 10, (uint16_t)m_peakBits);
+    PutU32(header + 12, m_sampleRate);
+    PutU32(header + 16, complete ? PEAK_COMPLETE : 0);
+    PutU32(header + 20, 2);   // Levels
+    PutU32(header + 24, PEAK_FINE_FRAMES);
+    PutU32(header + 28, PEAK_COARSE_FRAMES);
+    PutU64(header + 32, complete ? m_fineCount : 0);
+    PutU64(header + 40, coarseCount);
+    PutU64(header + 48, PEAK_HEADER_SIZE);
+    PutU64(header + 56, PEAK_HEADER_SIZE + m_fineCount * m_entrySize);
+    PutU64(header + 64, m_frames);
+    PutU64(header + 72, sourceDataSize);
+    PutU64(header + 80, sourceFileSize);
+
+    if (!Seek(m_file, 0) || fwrite(header, 1, sizeof(header), m_file) != sizeof(header)) {
+        m_failed = true;
+    }
+}
+
+bool PeakFileWriter::Finish(uint64_t sourceDataSize, uint64_t sourceFileSize)
+{
+    if (!m_file) return false;
+
+    if (m_currentFrames > 0) {
+        EmitPeak(m_current.data());
+        m_currentFrames = 0;
+    }
+    FlushBuffer();
+
+    // The coarse level is the fine level folded by 16; read it back in
+    // groups instead of keeping a second stream during recording
+    uint64_t coarseCount = (m_fineCount + PEAK_LEVEL_FACTOR - 1) / PEAK_LEVEL_FACTOR;
+    std::vector<uint8_t> fine(m_entrySize * PEAK_LEVEL_FACTOR);
+    std::vector<uint8_t> coarse(m_entrySize * (size_t)coarseCount);
+    const size_t values = (size_t)m_channels * 2;
+
+    for (uint64_t group = 0; group < coarseCount && !m_failed; group++) {
+        uint64_t first = group * PEAK_LEVEL_FACTOR;
+        size_t count = (size_t)(m_fineCount - first < PEAK_LEVEL_FACTOR ? m_fineCount - first : PEAK_LEVEL_FACTOR);
+        if (!Seek(m_file, PEAK_HEADER_SIZE + first * m_entrySize) ||
+            fread(fine.data(), m_entrySize, count, m_file) != count) {
+            m_failed = true;
+            break;
+        }
+
+        uint8_t* out = coarse.data() + group * m_entrySize;
+        memcpy(out, fine.data(), m_entrySize);
+        for (size_t i = 1; i < count; i++) {
+            const uint8_t* entry = fine.data() + i * m_entrySize;
+            for (size_t v = 0; v < values; v++) {
+                bool isMax = (v & 1) != 0;
+                if (m_peakBits == 16) {
+                    int16_t a, b;
+                    memcpy(&a, out + v * 2, 2);
+                    memcpy(&b, entry + v * 2, 2);
+                    if (isMax ? b > a : b < a) memcpy(out + v * 2, &b, 2);
+                } else {
+                    int8_t a = (int8_t)out[v], b = (int8_t)entry[v];
+                    if (isMax ? b > a : b < a) out[v] = (uint8_t)b;
+                }
+            }
+        }
+    }
+
+    if (!m_failed) {
+        if (!Seek(m_file, PEAK_HEADER_SIZE + m_fineCount * m_entrySize) ||
+            fwrite(coarse.data(), 1, coarse.size(), m_file) != coarse.size()) {
+            m_failed = true;
+        }
+    }
+    if (!m_failed) {
+        WriteHeader(true, coarseCount, sourceDataSize, sourceFileSize);
+    }
+
+    bool ok = !m_failed;
+    fclose(m_file);
+    m_file = nullptr;
+    return ok;
+}
+
+// PeakFile
+
+bool PeakFile::Load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    bool ok = Load(file);
+    fclose(file);
+    return ok;
+}
+
+bool PeakFile::Load(FILE* file)
+{
+    m_levels.clear();
+
+    uint8_t header[PEAK_HEADER_SIZE];
+    if (!Seek(file, 0) || fread(header, 1, sizeof(header), file) != sizeof(header)) return false;
+    if (memcmp(header, PEAK_MAGIC, 4) != 0 || GetU16(header + 4) != PEAK_VERSION) return false;
+
+    uint16_t headerSize = GetU16(header + 6);
+    m_channels = GetU16(header + 8);
+    m_peakBits = GetU16(header + 10);
+    m_sampleRate = GetU32(header + 12);
+    m_complete = (GetU32(header + 16) & PEAK_COMPLETE) != 0;
+    if (m_channels == 0 || (m_peakBits != 8 && m_peakBits != 16) || headerSize < PEAK_HEADER_SIZE) return false;
+    if (GetU32(header + 24) != PEAK_FINE_FRAMES) return false;
+
+    const uint64_t entrySize = (uint64_t)m_channels * 2 * (m_peakBits / 8);
+    if (m_complete) {
+        uint64_t fineCount = GetU64(header + 32);
+        uint64_t coarseCount = GetU64(header + 40);
+        m_frames = GetU64(header + 64);
+        m_sourceDataSize = GetU64(header + 72);
+        m_sourceFileSize = GetU64(header + 80);
+
+        if (!ReadLevel(file, GetU64(header + 48), fineCount, PEAK_FINE_FRAMES)) return false;
+        if (GetU32(header + 28) == PEAK_COARSE_FRAMES) {
+            if (!ReadLevel(file, GetU64(header + 56), coarseCount, PEAK_COARSE_FRAMES)) return false;
+        } else {
+            DeriveLevel(m_levels.back(), PEAK_LEVEL_FACTOR);
+        }
+    } else {
+        // Still recording: as many fine entries as have reached the disk
+        uint64_t size = GetFileSize(file);
+        uint64_t fineCount = size > headerSize ? (size - headerSize) / entrySize : 0;
+        m_frames = fineCount * PEAK_FINE_FRAMES;
+        m_sourceDataSize = 0;
+        m_sourceFileSize = 0;
+
+        if (!ReadLevel(file, headerSize, fineCount, PEAK_FINE_FRAMES)) return false;
+        DeriveLevel(m_levels.back(), PEAK_LEVEL_FACTOR);
+    }
+
+    while (m_levels.back().count > PEAK_LEVEL_FACTOR) {
+        DeriveLevel(m_levels.back(), PEAK_LEVEL_FACTOR);
+    }
+    return true;
+}
+
+bool PeakFile::ReadLevel(FILE* file, uint64_t offset, uint64_t count, uint64_t framesPerPeak)
+{
+    const size_t values = (size_t)m_channels * 2;
+
+    Level level;
+    level.framesPerPeak = framesPerPeak;
+    level.count = count;
+    level.minMax.resize((size_t)count * values);
+
+    if (count > 0 && !Seek(file, offset)) return false;
+    if (m_peakBits == 16) {
+        if (fread(level.minMax.data(), sizeof(int16_t), level.minMax.size(), file) != level.minMax.size()) return false;
+    } else {
+        std::vector<int8_t> raw(level.minMax.size());
+        if (fread(raw.data(), 1, raw.size(), file) != raw.size()) return false;
+        // Back to the 16-bit scale, keeping the envelope
+        for (size_t i = 0; i < raw.size(); i++) {
+            level.minMax[i] = (i & 1) ? (int16_t)(raw[i] * 256 + 255) : (int16_t)(raw[i] * 256);
+        }
+    }
+
+    m_levels.push_back(std::move(level));
+    return true;
+}
+
+void PeakFile::DeriveLevel(const Level& source, uint32_t factor)
+{
+    const size_t values = (size_t)m_channels * 2;
+
+    Level level;
+    level.framesPerPeak = source.framesPerPeak * factor;
+    level.count = (source.count + factor - 1) / factor;
+    level.minMax.resize((size_t)level.count * values);
+
+    for (uint64_t i = 0; i < level.count; i++) {
+        uint64_t first = i * factor;
+        uint64_t last = first + factor < source.count ? first + factor : source.count;
+        int16_t* out = level.minMax.data() + i * values;
+        memcpy(out, source.minMax.data() + first * values, values * sizeof(int16_t));
+        for (uint64_t j = first + 1; j < last; j++) {
+            const int16_t* entry = source.minMax.data() + j * values;
+            for (size_t v = 0; v < values; v += 2) {
+                if (entry[v] < out[v]) out[v] = entry[v];
+                if (entry[v + 1] > out[v + 1]) out[v + 1] = entry[v + 1];
+            }
+        }
+    }
+
+    m_levels.push_back(std::move(level));
+}
+
+void PeakFile::GetPeaks(uint16_t channel, uint64_t startFrame, uint64_t endFrame, size_t pixels, Range* out) const
+{
+    for (size_t p = 0; p < pixels; p++) out[p] = Range();
+    if (pixels == 0 || endFrame <= startFrame || channel >= m_channels || m_levels.empty()) return;
+
+    // Coarsest level that still has at least one peak per pixel; every
+    // pixel then folds a bounded number of entries
+    const uint64_t span = endFrame - startFrame;
+    const uint64_t framesPerPixel = span / pixels;
+    size_t levelIndex = 0;
+    for (size_t i = 1; i < m_levels.size(); i++) {
+        if (m_levels[i].framesPerPeak <= framesPerPixel) levelIndex = i;
+    }
+    const Level& level = m_levels[levelIndex];
+    const size_t values = (size_t)m_channels * 2;
+
+    for (size_t p = 0; p < pixels; p++) {
+        uint64_t first = startFrame + span * p / pixels;
+        uint64_t last = startFrame + span * (p + 1) / pixels;
+        if (last <= first) last = first + 1;
+
+        uint64_t i0 = first / level.framesPerPeak;
+        uint64_t i1 = (last + level.framesPerPeak - 1) / level.framesPerPeak;
+        if (i1 > level.count) i1 = level.count;
+        if (i0 >= i1) continue;
+
+        int16_t low = 32767, high = -32768;
+        const int16_t* entry = level.minMax.data() + i0 * values + channel * 2;
+        for (uint64_t i = i0; i < i1; i++, entry += values) {
+            if (entry[0] < low) low = entry[0];
+            if (entry[1] > high) high = entry[1];
+        }
+        out[p].min = low / 32768.0f;
+        out[p].max = high / 32768.0f;
+    }
+}
+
+// PeakOutput
+
+int64_t PeakOutput::WriteGather(const IoSpan* spans, size_t count)
+{
+    int64_t written = m_output->WriteGather(spans, count);
+
+    // Feed exactly the bytes that reached the output, in order
+    if (written > 0 && m_peaks) {
+        uint64_t remaining = (uint64_t)written;
+        for (size_t i = 0; i < count && remaining > 0; i++) {
+            size_t part = spans[i].size < remaining ? spans[i].size : (size_t)remaining;
+            m_peaks->AddBytes(spans[i].data, part);
+            remaining -= part;
+        }
+    }
+    return written;
+}
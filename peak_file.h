@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "batched_writer.h"
+
+// Peak sidecar ("recording_N.wav.peaks") for drawing the overview of a long
+// recording without reading it. Little-endian, 96-byte header followed by
+// two levels of min/max pairs: one entry per 256 frames, then one per 4096.
+// An entry holds min and max for every channel (int16, or int8 for half the
+// size). The fine level is appended while recording; the coarse level and
+// the final header are written by Finish(). A file without the complete flag
+// is still being recorded (or was cut off) and only has the fine level.
+
+const uint32_t PEAK_FINE_FRAMES = 256;
+const uint32_t PEAK_COARSE_FRAMES = 4096;
+const size_t PEAK_HEADER_SIZE = 96;
+
+// Min/max of each run of `framesPerPeak` frames of interleaved 16-bit
+// samples into `minMax` (channels * 2 values per peak, the last peak may
+// cover fewer frames). Returns the number of peaks.
+size_t ComputePeaks(const int16_t* samples, size_t frames, uint16_t channels,
+                    uint32_t framesPerPeak, int16_t* minMax);
+
+// Builds a peak file incrementally. AddBytes/AddSamples allocate nothing, so
+// they can run on a pipeline thread.
+class PeakFileWriter
+{
+public:
+    PeakFileWriter() = default;
+    ~PeakFileWriter();
+
+    PeakFileWriter(const PeakFileWriter&) = delete;
+    PeakFileWriter& operator=(const PeakFileWriter&) = delete;
+
+    // Take ownership of `file` (opened for reading and writing, e.g. "w+b")
+    // and write a placeholder header. peakBits is 16 or 8.
+    bool Open(FILE* file, uint16_t channels, uint32_t sampleRate, int peakBits = 16);
+
+    // Finish the file for a WAV of `sourceDataSize` sample bytes and
+    // `sourceFileSize` bytes in total, and close it
+    bool Finish(uint64_t sourceDataSize, uint64_t sourceFileSize);
+
+    // Close without finishing (the file stays readable as incomplete)
+    void Close();
+
+    bool IsOpen() const { return m_file != nullptr; }
+    uint64_t GetFrames() const { return m_frames; }
+
+    // Interleaved 16-bit PCM as written to the WAV; frames may be split
+    // across calls at any byte
+    void AddBytes(const uint8_t* data, size_t size);
+    void AddSamples(const int16_t* samples, size_t frames);
+
+    // Fine-level peaks from ComputePeaks covering `frames` frames. Only the
+    // last call may end with a partial peak.
+    void AddPeaks(const int16_t* minMax, size_t count, uint64_t frames);
+
+private:
+    void EmitPeak(const int16_t* minMax);
+    void FlushBuffer();
+    void WriteHeader(bool complete, uint64_t coarseCount, uint64_t sourceDataSize, uint64_t sourceFileSize);
+
+    FILE* m_file = nullptr;
+    uint16_t m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    int m_peakBits = 16;
+    size_t m_entrySize = 0;
+
+    std::vector<int16_t> m_current;   // Running min/max of the open peak
+    uint32_t m_currentFrames = 0;
+    std::vector<uint8_t> m_carry;     // Bytes of a frame split across AddBytes calls
+    size_t m_carryUsed = 0;
+
+    std::vector<uint8_t> m_buffer;    // Encoded entries not yet written
+    size_t m_bufferUsed = 0;
+
+    uint64_t m_frames = 0;
+    uint64_t m_fineCount = 0;
+    bool m_failed = false;
+};
+
+// Loaded peak file. Coarser levels are derived in memory on load so a view
+// of any range costs O(pixels).
+class PeakFile
+{
+public:
+    struct Range
+    {
+        float min = 0.0f;   // -1..1
+        float max = 0.0f;
+    };
+
+    bool Load(const char* path);
+    bool Load(FILE* file);
+
+    bool IsComplete() const { return m_complete; }
+    uint16_t GetChannels() const { return m_channels; }
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint64_t GetFrames() const { return m_frames; }
+    uint64_t GetSourceDataSize() const { return m_sourceDataSize; }
+    uint64_t GetSourceFileSize() const { return m_sourceFileSize; }
+
+    // Whether the file describes a WAV of this size (stale otherwise)
+    bool Matches(uint64_t wavFileSize) const { return m_complete && m_sourceFileSize == wavFileSize; }
+
+    // Min/max of `channel` for each of `pixels` equal slices of
+    // [startFrame, endFrame). Slices past the end are silent.
+    void GetPeaks(uint16_t channel, uint64_t startFrame, uint64_t endFrame, size_t pixels, Range* out) const;
+
+private:
+    struct Level
+    {
+        uint64_t framesPerPeak = 0;
+        uint64_t count = 0;
+        std::vector<int16_t> minMax;   // count * channels * 2, 16-bit scale
+    };
+
+    bool ReadLevel(FILE* file, uint64_t offset, uint64_t count, uint64_t framesPerPeak);
+    void DeriveLevel(const Level& source, uint32_t factor);
+
+    bool m_complete = false;
+    uint16_t m_channels = 0;
+    uint32_t m_sampleRate = 0;
+    int m_peakBits = 16;
+    uint64_t m_frames = 0;
+    uint64_t m_sourceDataSize = 0;
+    uint64_t m_sourceFileSize = 0;
+    std::vector<Level> m_levels;   // Finest first
+};
+
+// ByteOutput that forwards to another output and feeds every byte written
+// to a PeakFileWriter, so peaks are built on the writer thread
+class PeakOutput : public ByteOutput
+{
+public:
+    void SetOutput(ByteOutput* output, PeakFileWriter* peaks) { m_output = output; m_peaks = peaks; }
+
+    bool Connect() override { return m_output->Connect(); }
+    void Disconnect() override { m_output->Disconnect(); }
+    int64_t WriteGather(const IoSpan* spans, size_t count) override;
+    void WaitWritable(uint32_t timeoutMs) override { m_output->WaitWritable(timeoutMs); }
+
+private:
+    ByteOutput* m_output = nullptr;
+    PeakFileWriter* m_peaks = nullptr;
+};
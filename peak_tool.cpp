@@ -0,0 +1,207 @@
+// AudioPeaks: builds peak sidecar files for existing recordings.
+//
+//   AudioPeaks [--threads=N] [--bits=8|16] [--force] recording_1.wav ...
+//
+// Each WAV is split into chunks that worker threads read and reduce in
+// parallel; up-to-date sidecars are skipped unless --force is given.
+
+#include "peak_file.h"
+#include "wave_format.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Frames per work item; a multiple of the coarse level so chunks never
+// share a peak
+const uint64_t CHUNK_FRAMES = (uint64_t)PEAK_COARSE_FRAMES * 1024;
+
+// Enough to reach the data chunk of our own and most other WAV files
+const size_t HEADER_PROBE_SIZE = 64 * 1024;
+
+struct Options
+{
+    unsigned threads = 0;
+    int peakBits = 16;
+    bool force = false;
+};
+
+bool SeekTo(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+uint64_t GetSize(FILE* file)
+{
+#ifdef _WIN32
+    if (_fseeki64(file, 0, SEEK_END) != 0) return 0;
+    long long size = _ftelli64(file);
+#else
+    if (fseeko(file, 0, SEEK_END) != 0) return 0;
+    off_t size = ftello(file);
+#endif
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+// Returns the bytes of sample data processed, or -1 on failure
+int64_t BuildPeaks(const std::string& path, const Options& options)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        fprintf(stderr, "%s: cannot open\n", path.c_str());
+        return -1;
+    }
+
+    std::vector<uint8_t> probe(HEADER_PROBE_SIZE);
+    size_t probed = fread(probe.data(), 1, probe.size(), file);
+    uint64_t fileSize = GetSize(file);
+    fclose(file);
+
+    WaveInfo info;
+    if (!ParseWaveHeader(probe.data(), probed, info)) {
+        fprintf(stderr, "%s: not a WAV file\n", path.c_str());
+        return -1;
+    }
+    if (info.formatTag != 1 || info.bitsPerSample != 16 || info.blockAlign != info.channels * 2) {
+        fprintf(stderr, "%s: only 16-bit PCM is supported\n", path.c_str());
+        return -1;
+    }
+
+    // Open-ended or truncated data chunks end at the end of the file
+    uint64_t dataSize = info.dataSize;
+    if (dataSize == WAVE_SIZE_UNKNOWN || info.dataOffset + dataSize > fileSize) {
+        dataSize = fileSize > info.dataOffset ? fileSize - info.dataOffset : 0;
+    }
+    const uint64_t frames = dataSize / info.blockAlign;
+
+    std::string peakPath = path + ".peaks";
+    if (!options.force) {
+        PeakFile existing;
+        if (existing.Load(peakPath.c_str()) && existing.Matches(fileSize)) {
+            printf("%s: up to date\n", path.c_str());
+            return 0;
+        }
+    }
+
+    const size_t values = (size_t)info.channels * 2;
+    const uint64_t chunkCount = (frames + CHUNK_FRAMES - 1) / CHUNK_FRAMES;
+    const uint64_t peakCount = (frames + PEAK_FINE_FRAMES - 1) / PEAK_FINE_FRAMES;
+    std::vector<int16_t> peaks((size_t)peakCount * values);
+
+    // Workers pull chunks and read them through their own file handle
+    std::atomic<uint64_t> nextChunk{ 0 };
+    std::atomic<bool> failed{ false };
+    auto worker = [&]() {
+        FILE* input = fopen(path.c_str(), "rb");
+        if (!input) {
+            failed = true;
+            return;
+        }
+        std::vector<int16_t> samples((size_t)CHUNK_FRAMES * info.channels);
+
+        for (;;) {
+            uint64_t chunk = nextChunk.fetch_add(1);
+            if (chunk >= chunkCount || failed) break;
+
+            uint64_t first = chunk * CHUNK_FRAMES;
+            size_t count = (size_t)(frames - first < CHUNK_FRAMES ? frames - first : CHUNK_FRAMES);
+            if (!SeekTo(input, info.dataOffset + first * info.blockAlign) ||
+                fread(samples.data(), info.blockAlign, count, input) != count) {
+                failed = true;
+                break;
+            }
+            ComputePeaks(samples.data(), count, info.channels, PEAK_FINE_FRAMES,
+                peaks.data() + (size_t)(first / PEAK_FINE_FRAMES) * values);
+        }
+        fclose(input);
+    };
+
+    unsigned threadCount = options.threads;
+    if (threadCount > chunkCount) threadCount = (unsigned)(chunkCount > 0 ? chunkCount : 1);
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        fprintf(stderr, "%s: read error\n", path.c_str());
+        return -1;
+    }
+
+    PeakFileWriter writer;
+    if (!writer.Open(fopen(peakPath.c_str(), "w+b"), info.channels, info.sampleRate, options.peakBits)) {
+        fprintf(stderr, "%s: cannot create\n", peakPath.c_str());
+        return -1;
+    }
+    writer.AddPeaks(peaks.data(), (size_t)peakCount, frames);
+    if (!writer.Finish(dataSize, fileSize)) {
+        fprintf(stderr, "%s: write error\n", peakPath.c_str());
+        return -1;
+    }
+
+    printf("%s: %llu frames, %llu peaks\n", path.c_str(), (unsigned long long)frames, (unsigned long long)peakCount);
+    return (int64_t)dataSize;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--threads=", 10) == 0) {
+            options.threads = (unsigned)atoi(arg + 10);
+        } else if (strncmp(arg, "--bits=", 7) == 0) {
+            options.peakBits = atoi(arg + 7);
+        } else if (strcmp(arg, "--force") == 0) {
+            options.force = true;
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty() || (options.peakBits != 8 && options.peakBits != 16)) {
+        fprintf(stderr, "Usage: AudioPeaks [--threads=N] [--bits=8|16] [--force] file.wav...\n");
+        return 2;
+    }
+    if (options.threads == 0) {
+        options.threads = std::thread::hardware_concurrency();
+        if (options.threads == 0) options.threads = 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t totalBytes = 0;
+    int failures = 0;
+    for (const std::string& file : files) {
+        int64_t bytes = BuildPeaks(file, options);
+        if (bytes < 0) {
+            failures++;
+        } else {
+            totalBytes += (uint64_t)bytes;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu files, %.1f MB in %.2f s (%.1f MB/s, %u threads)\n", files.size(), totalBytes / 1048576.0,
+        seconds, seconds > 0.0 ? totalBytes / 1048576.0 / seconds : 0.0, options.threads);
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+#include "recording_pipeline.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+RecordingPipeline::RecordingPipeline()
+{
+    // Default recording chain; all stages start neutral/disabled. Noise is
+    // suppressed first so the gate and limiter see the cleaned signal.
+    m_suppressor = m_chain.Add(std::make_unique<NoiseSuppressor>());
+    m_stages = m_chain.Add(std::make_unique<RecordingStages>());
+}
+
+bool RecordingPipeline::Configure(uint32_t sampleRate, uint16_t channels, SampleType inputType, uint16_t outputBits,
+                                  uint32_t maxPacketFrames, size_t poolBlocks)
+{
+    m_kernels = GetPacketKernels(inputType, channels);
+    if (!m_kernels || !m_requantizer.Configure(channels, outputBits)) return false;
+
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_inputType = inputType;
+    m_outputBits = outputBits;
+    m_inputBlockAlign = (size_t)channels * GetSampleSize(inputType);
+    m_blockAlign = (size_t)channels * outputBits / 8;
+    m_maxPacketFrames = maxPacketFrames;
+
+    m_requantize = !(inputType == SampleS16 && outputBits == 16);
+    m_floatBuffer.assign(m_requantize ? (size_t)maxPacketFrames * channels : 0, 0.0f);
+
+    // No packet exceeds the device buffer
+    return m_pool.Configure((size_t)maxPacketFrames * m_blockAlign, poolBlocks);
+}
+
+void RecordingPipeline::Begin(BatchedWriter* fileWriter, BatchedWriter* streamWriter, uint32_t maxGapSeconds, size_t maxGaps)
+{
+    m_fileWriter = fileWriter;
+    m_streamWriter = streamWriter;
+    m_lostPackets = 0;
+    m_submittedFrames = 0;
+    m_timeline.Reset(m_sampleRate, (uint64_t)maxGapSeconds * m_sampleRate, maxGaps);
+
+    // Prepare the processing chain; its look-ahead is trimmed from the start
+    // of the file and flushed at the end so the recording stays aligned
+    m_requantizer.Reset();
+    m_chain.Prepare(m_sampleRate, m_channels, m_maxPacketFrames);
+    m_latencyToSkip = m_chain.GetLatency();
+    m_dspActive = m_chain.IsActive();
+}
+
+void RecordingPipeline::End()
+{
+    // Block by block in case the look-ahead exceeds a packet
+    m_dspActive = m_chain.IsActive();
+    size_t latency = m_chain.GetLatency();
+    while (latency > 0) {
+        uint32_t count = (uint32_t)(latency < m_maxPacketFrames ? latency : m_maxPacketFrames);
+        uint8_t* block = m_pool.Acquire();
+        if (!block) return;
+
+        if (m_requantize) {
+            Requantize(nullptr, count, block);
+        } else {
+            m_chain.ProcessSilenceS16((int16_t*)block, count);
+        }
+        SubmitFrames(block, count);
+        latency -= count;
+    }
+}
+
+void RecordingPipeline::Record(const uint8_t* data, const PacketInfo& packet)
+{
+    // Stages can be switched while recording; with all of them neutral (and
+    // no look-ahead) the chain is skipped and packets are copied
+    m_dspActive = m_chain.IsActive();
+
+    PacketTimeline::Placement placement = m_timeline.Place(packet);
+    if (placement.gapFrames > 0) {
+        SubmitSilence(placement.gapFrames);
+    }
+
+    uint32_t frames = packet.frames - placement.skipFrames;
+    if (frames == 0) return;
+    if (data) data += (size_t)placement.skipFrames * m_inputBlockAlign;
+
+    // Hand the packet to the writers in a pool block; the processing chain
+    // writes its output straight into the block
+    uint8_t* block = m_pool.Acquire();
+    if (!block) {
+        // Silence of the packet's length keeps the file on device time; the
+        // timeline lists it so cues and the gap index stay on the right sample
+        m_lostPackets++;
+        uint64_t position = m_submittedFrames;
+        SubmitZeros(frames);
+        m_timeline.RecordLoss(position, frames);
+        return;
+    }
+
+    bool silent = (packet.flags & PacketInfo::Silent) != 0 || !data;
+    size_t bytes = (size_t)frames * m_blockAlign;
+    if (m_requantize && (!silent || m_dspActive)) {
+        Requantize(silent ? nullptr : data, frames, block);
+    } else if (m_dspActive) {
+        if (silent) {
+            m_chain.ProcessSilenceS16((int16_t*)block, frames);
+        } else {
+            m_chain.ProcessS16((const int16_t*)data, (int16_t*)block, frames);
+        }
+    } else if (silent) {
+        memset(block, 0, bytes);
+    } else {
+        memcpy(block, data, bytes);
+    }
+    SubmitFrames(block, frames);
+}
+
+void RecordingPipeline::SubmitSilence(uint64_t frames)
+{
+    // With a stage active, one block of the gap runs through the chain so
+    // its look-ahead and filter tails come out where they belong. The rest
+    // is written from the pool's zero block: a gap of any length takes no
+    // pool block, and the file keeps every frame the timeline placed.
+    if (m_dspActive) {
+        uint8_t* block = m_pool.Acquire();
+        if (block) {
+            uint32_t count = (uint32_t)(frames < m_maxPacketFrames ? frames : m_maxPacketFrames);
+            if (m_requantize) {
+                Requantize(nullptr, count, block);
+            } else {
+                m_chain.ProcessSilenceS16((int16_t*)block, count);
+            }
+            SubmitFrames(block, count);
+            frames -= count;
+        }
+    }
+    if (frames > 0) {
+        SubmitZeros(frames);
+    }
+}
+
+void RecordingPipeline::SubmitZeros(uint64_t frames)
+{
+    uint64_t skip = frames < m_latencyToSkip ? frames : m_latencyToSkip;
+    m_latencyToSkip -= (size_t)skip;
+
+    size_t size = (size_t)(frames - skip) * m_blockAlign;
+    if (size == 0) return;
+
+    if (m_streamWriter && m_streamWriter->IsRunning()) {
+        m_streamWriter->SubmitSilence(size);
+    }
+    m_fileWriter->SubmitSilence(size);
+    m_submittedFrames += frames - skip;
+}
+
+void RecordingPipeline::Requantize(const uint8_t* data, uint32_t frames, uint8_t* block)
+{
+    // Null data is silence; it still runs through the chain to keep its state
+    float* samples = m_floatBuffer.data();
+    if (data) {
+        m_kernels->toFloat(data, frames, m_channels, samples);
+    }
+    if (m_dspActive) {
+        m_chain.ProcessF32(data ? samples : nullptr, samples, frames);
+    } else if (!data) {
+        std::fill(samples, samples + (size_t)frames * m_channels, 0.0f);
+    }
+    m_requantizer.Process(samples, frames, block);
+}
+
+void RecordingPipeline::SubmitFrames(uint8_t* block, uint32_t frames)
+{
+    // Drop the chain's start-up latency so output lines up with the input
+    uint32_t skip = (uint32_t)(frames < m_latencyToSkip ? frames : m_latencyToSkip);
+    m_latencyToSkip -= skip;
+
+    size_t offset = (size_t)skip * m_blockAlign;
+    size_t size = (size_t)(frames - skip) * m_blockAlign;
+    if (size == 0) {
+        m_pool.Release(block);
+        return;
+    }
+
+    // Both writers share the block; each releases its own reference
+    if (m_streamWriter && m_streamWriter->IsRunning()) {
+        m_pool.AddRef(block);
+        m_streamWriter->Submit(block, offset, size);
+    }
+
+    // A block the file writer could not queue was written as silence; the
+    // timeline lists it so cues and the gap index stay on the right sample
+    uint64_t position = m_submittedFrames;
+    m_submittedFrames += frames - skip;
+    if (!m_fileWriter->Submit(block, offset, size)) {
+        m_timeline.RecordLoss(position, frames - skip);
+    }
+}
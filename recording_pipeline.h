@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "batched_writer.h"
+#include "block_pool.h"
+#include "dsp_nodes.h"
+#include "noise_suppressor.h"
+#include "packet_timeline.h"
+#include "requantizer.h"
+#include "sample_kernels.h"
+
+// Recording path shared by live capture and trace replay. Each packet is
+// placed on the device timeline (gaps become silence, overlaps are trimmed),
+// runs through the recording DSP chain into a pool block and is handed to
+// the file writer and, if it is running, the stream writer. 16-bit input
+// recorded at 16 bits is written as is; anything else is converted to
+// float and requantized to the output depth with dither.
+// Gaps are written from the pool's shared zero block and take no pool
+// blocks, however long. Record() is called from one thread (the capture
+// thread) and does not allocate. It does not wait either, provided the file
+// writer runs the FillSilence policy: a block that finds the writer's queue
+// full is then written as silence and listed in the timeline as lost, so
+// the file keeps the length of device time. A stream writer with the Block
+// policy does wait, up to its block timeout. A packet that finds the pool
+// empty is likewise written as silence and listed as lost. Everything else
+// happens while no packet is being recorded.
+class RecordingPipeline
+{
+public:
+    RecordingPipeline();
+
+    RecordingPipeline(const RecordingPipeline&) = delete;
+    RecordingPipeline& operator=(const RecordingPipeline&) = delete;
+
+    // Format of the captured packets, depth of the recorded stream (16 or
+    // 24) and the largest packet; (re)allocates poolBlocks packet buffers
+    bool Configure(uint32_t sampleRate, uint16_t channels, SampleType inputType, uint16_t outputBits,
+                   uint32_t maxPacketFrames, size_t poolBlocks);
+
+    // Start a recording. Both writers take blocks from GetPool(); the file
+    // writer should run FillSilence. streamWriter may be null.
+    void Begin(BatchedWriter* fileWriter, BatchedWriter* streamWriter, uint32_t maxGapSeconds, size_t maxGaps);
+
+    void Record(const uint8_t* data, const PacketInfo& packet);
+
+    // Flush the samples held back by the chain's look-ahead
+    void End();
+
+    BlockPool& GetPool() { return m_pool; }
+    DspChain& GetChain() { return m_chain; }
+    RecordingStages& GetStages() { return *m_stages; }
+    NoiseSuppressor& GetNoiseSuppressor() { return *m_suppressor; }
+    Requantizer& GetRequantizer() { return m_requantizer; }
+    const Requantizer& GetRequantizer() const { return m_requantizer; }
+    const PacketTimeline& GetTimeline() const { return m_timeline; }
+
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint16_t GetChannels() const { return m_channels; }
+    uint16_t GetOutputBits() const { return m_outputBits; }
+    size_t GetBlockAlign() const { return m_blockAlign; }   // Of the recorded stream
+
+    // Whether packets go through float and the requantizer
+    bool IsRequantizing() const { return m_requantize; }
+
+    // Packets written as silence because the pool ran dry
+    uint64_t GetLostPackets() const { return m_lostPackets; }
+
+private:
+    void SubmitSilence(uint64_t frames);
+    void SubmitZeros(uint64_t frames);
+    void SubmitFrames(uint8_t* block, uint32_t frames);
+    void Requantize(const uint8_t* data, uint32_t frames, uint8_t* block);
+
+    uint32_t m_sampleRate = 0;
+    uint16_t m_channels = 0;
+    SampleType m_inputType = SampleUnknown;
+    uint16_t m_outputBits = 0;
+    size_t m_inputBlockAlign = 0;
+    size_t m_blockAlign = 0;
+    uint32_t m_maxPacketFrames = 0;
+
+    // Input to float, chain in float, then dither down to the output depth
+    bool m_requantize = false;
+    const PacketKernels* m_kernels = nullptr;
+    std::vector<float> m_floatBuffer;
+    Requantizer m_requantizer;
+
+    BlockPool m_pool;
+    PacketTimeline m_timeline;
+    BatchedWriter* m_fileWriter = nullptr;
+    BatchedWriter* m_streamWriter = nullptr;
+    uint64_t m_lostPackets = 0;
+
+    // Recording DSP (planar float, in place)
+    DspChain m_chain;
+    NoiseSuppressor* m_suppressor = nullptr;
+    RecordingStages* m_stages = nullptr;
+    bool m_dspActive = false;    // Latched per packet; false bypasses the chain
+    size_t m_latencyToSkip = 0;  // Frames of chain latency still to drop
+    uint64_t m_submittedFrames = 0;  // Frames handed to the file writer
+};
@@ -0,0 +1,232 @@
+// AudioRender: golden-image check and frame timing of the waveform renderer.
+//
+//   AudioRender [--frames=N] [--print]
+//
+// Renders fixed scenes from synthetic data exactly as the UI does: the live
+// view from a WaveformRing that has wrapped (so the snapshot comes in two
+// ranges), the same view on a canvas shrunk below its allocation (stride
+// wider than the visible rows), an empty track, and the history overview of
+// a WaveformHistory with a silent gap. Each scene is drawn --frames times
+// and the per-frame cost, reduction included, is reported. The checksum of
+// the last frame is compared with the golden value; the exit code is 1 on a
+// mismatch. The signals use integer arithmetic only, so the pixels do not
+// depend on the math library. After an intended change to the drawing, run
+// with --print and paste the new values into GOLDEN_SCENES.
+
+#include "waveform_history.h"
+#include "waveform_renderer.h"
+#include "waveform_ring.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const uint32_t SAMPLE_RATE = 48000;
+const size_t PACKET_FRAMES = 480;
+
+// As the live view: one second of channel 0 from a ring holding more
+const size_t LIVE_VIEW_FRAMES = 48000;
+const size_t RING_CAPACITY_FRAMES = 65536;
+const size_t RING_WRITTEN_FRAMES = 150000;
+
+// History: 3 min of signal, 40 s of silence, 1 min of signal
+const size_t HISTORY_BUDGET_BYTES = 4 * 1024 * 1024;
+const uint32_t HISTORY_SECONDS = 3600;
+const size_t HISTORY_SIGNAL_FRAMES = 180 * SAMPLE_RATE;
+const size_t HISTORY_SILENCE_FRAMES = 40 * SAMPLE_RATE;
+const size_t HISTORY_TAIL_FRAMES = 60 * SAMPLE_RATE;
+
+struct Scene
+{
+    const char* name;
+    uint32_t golden;
+};
+
+// Checksums of the last frame of each scene, in the order they are drawn
+const Scene GOLDEN_SCENES[] = {
+    { "live", 0x87491e3fu },
+    { "live-shrunk", 0x1b8251ffu },
+    { "empty", 0x7cd8c2e5u },
+    { "overview", 0x9bb94d8fu },
+};
+
+struct Options
+{
+    int frames = 500;
+    bool print = false;
+};
+
+// Deterministic test signal: a triangle tone under a slow triangle envelope
+// with a little noise, clipping at full scale now and then
+class TestSignal
+{
+public:
+    float Next()
+    {
+        m_state = m_state * 6364136223846793005ull + 1442695040888963407ull;
+        int32_t noise = (int32_t)(m_state >> 52) - 2048;            // +-2048
+
+        uint32_t tone = (uint32_t)(m_position % 480);                 // 100 Hz
+        int32_t triangle = tone < 240 ? (int32_t)tone * 2 - 240 : 720 - (int32_t)tone * 2;  // +-240
+        uint32_t slow = (uint32_t)(m_position % 96000);               // 2 s
+        int32_t envelope = slow < 48000 ? (int32_t)slow : 96000 - (int32_t)slow;          // 0..48000
+        m_position++;
+
+        float x = (float)triangle / 240.0f * ((float)envelope / 40000.0f) + (float)noise / 65536.0f;
+        return x > 1.0f ? 1.0f : (x < -1.0f ? -1.0f : x);
+    }
+
+private:
+    uint64_t m_state = 1;
+    uint64_t m_position = 0;
+};
+
+void FillPacket(TestSignal& signal, std::vector<float>& packet, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++) {
+        packet[i] = signal.Next();
+    }
+}
+
+struct Timing
+{
+    std::vector<double> microseconds;
+
+    void Report(const char* name, uint32_t checksum, uint32_t golden) const
+    {
+        std::vector<double> sorted = microseconds;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (double us : sorted) sum += us;
+        size_t p99 = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+        printf("%-12s %08x  %s  mean %7.1f us, p99 %7.1f us, max %7.1f us\n", name, checksum,
+            checksum == golden ? "ok      " : "MISMATCH", sum / sorted.size(), sorted[p99], sorted.back());
+    }
+};
+
+template <typename DrawFn>
+uint32_t TimeScene(const WaveformRenderer& renderer, int frames, Timing& timing, DrawFn draw)
+{
+    timing.microseconds.clear();
+    for (int i = 0; i < frames; i++) {
+        auto start = std::chrono::steady_clock::now();
+        draw();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        timing.microseconds.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    return renderer.Checksum();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--frames=", 9) == 0) {
+            options.frames = atoi(arg + 9);
+        } else if (strcmp(arg, "--print") == 0) {
+            options.print = true;
+        } else {
+            fprintf(stderr, "Usage: AudioRender [--frames=N] [--print]\n");
+            return 2;
+        }
+    }
+    if (options.frames <= 0) {
+        fprintf(stderr, "Invalid frame count\n");
+        return 2;
+    }
+
+    // Live ring, wrapped so snapshots come in two ranges
+    WaveformRing ring(1, RING_CAPACITY_FRAMES);
+    ring.Reset(1);
+    TestSignal signal;
+    std::vector<float> packet(PACKET_FRAMES);
+    const float* planes[1] = { packet.data() };
+    for (size_t written = 0; written < RING_WRITTEN_FRAMES; written += PACKET_FRAMES) {
+        FillPacket(signal, packet, PACKET_FRAMES);
+        ring.WritePlanar(planes, PACKET_FRAMES);
+    }
+    WaveformView view;
+    if (!ring.Snapshot(0, LIVE_VIEW_FRAMES, view) || view.second.empty()) {
+        fprintf(stderr, "Ring snapshot did not wrap\n");
+        return 1;
+    }
+
+    // History with a silent gap
+    WaveformHistory history(1, HISTORY_BUDGET_BYTES);
+    if (!history.Reset(1, SAMPLE_RATE, HISTORY_SECONDS)) {
+        fprintf(stderr, "Cannot lay out the history\n");
+        return 1;
+    }
+    TestSignal historySignal;
+    for (size_t added = 0; added < HISTORY_SIGNAL_FRAMES; added += PACKET_FRAMES) {
+        FillPacket(historySignal, packet, PACKET_FRAMES);
+        history.AddPlanar(planes, PACKET_FRAMES);
+    }
+    history.AddSilence(HISTORY_SILENCE_FRAMES);
+    for (size_t added = 0; added < HISTORY_TAIL_FRAMES; added += PACKET_FRAMES) {
+        FillPacket(historySignal, packet, PACKET_FRAMES);
+        history.AddPlanar(planes, PACKET_FRAMES);
+    }
+
+    std::vector<uint32_t> checksums;
+    std::vector<Timing> timings(sizeof(GOLDEN_SCENES) / sizeof(GOLDEN_SCENES[0]));
+    WaveformRenderer renderer;
+
+    auto drawLive = [&]() {
+        renderer.SetWaveform(view.first.data(), view.first.size(), view.second.data(), view.second.size());
+        renderer.Render(0.42f);
+    };
+
+    renderer.Resize(800, 240);
+    checksums.push_back(TimeScene(renderer, options.frames, timings[0], drawLive));
+
+    renderer.Resize(1024, 320);
+    renderer.Resize(640, 200);
+    checksums.push_back(TimeScene(renderer, options.frames, timings[1], drawLive));
+
+    renderer.Resize(800, 240);
+    checksums.push_back(TimeScene(renderer, options.frames, timings[2], [&]() {
+        renderer.SetWaveform(nullptr, 0);
+        renderer.Render(0.0f);
+    }));
+
+    renderer.Resize(800, 160);
+    std::vector<WaveformHistory::Summary> summaries((size_t)renderer.GetColumnCount());
+    bool summarized = true;
+    checksums.push_back(TimeScene(renderer, options.frames, timings[3], [&]() {
+        summarized = summarized &&
+            history.GetSummaries(0, history.GetOldestFrame(), history.GetFrameCount(), summaries.size(), summaries.data());
+        renderer.SetSummaries(summaries.data(), summaries.size());
+        renderer.RenderOverview();
+    }));
+    if (!summarized) {
+        fprintf(stderr, "History query failed\n");
+        return 1;
+    }
+
+    if (options.print) {
+        for (size_t i = 0; i < checksums.size(); i++) {
+            printf("    { \"%s\", 0x%08xu },\n", GOLDEN_SCENES[i].name, checksums[i]);
+        }
+        return 0;
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < checksums.size(); i++) {
+        timings[i].Report(GOLDEN_SCENES[i].name, checksums[i], GOLDEN_SCENES[i].golden);
+        if (checksums[i] != GOLDEN_SCENES[i].golden) failures++;
+    }
+    if (failures > 0) {
+        printf("%d of %zu scenes differ from the golden checksums\n", failures, checksums.size());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,539 @@
+// AudioReplay: runs a capture trace through the recording pipeline.
+//
+//   AudioReplay [--realtime] [--out=FILE.wav] [--manifest] [--bits=16|24]
+//               [--dither=off] [--noise-shaping] [--denoise[=dB]] [--gain=dB]
+//               [--dc-block] [--gate=dB] [--limit=dB] trace.bin
+//   AudioReplay --stress[=CYCLES] [--stress-ms=N] --out=FILE.wav [--bits=16|24] trace.bin
+//   AudioReplay --bench=kernels
+//   AudioReplay --bench=requantizer [--budget=PERCENT]
+//
+// Traces come from AudioCaptureCpp --trace=PATH. Packets are placed,
+// processed and written exactly as during a live recording, so a timing
+// problem seen on one machine can be reproduced and debugged on any other.
+// Without --realtime the trace is replayed as fast as possible, which makes
+// the tool a throughput benchmark of the recording path; the exit code is 1
+// if anything was lost on the way, or (Debug builds) if a warmed-up pump or
+// writer thread allocated. --manifest writes FILE.wav.manifest on
+// the writer thread as a recording does and reports what hashing cost.
+// --stress starts and stops a recording of the trace (paced as captured,
+// through an AudioSession) CYCLES times, each running --stress-ms, and
+// reports start and stop latency percentiles. After every stop the pump
+// must be joined and FILE.wav must have a final header holding exactly the
+// frames the timeline placed; the exit code is 1 if any cycle fails.
+// --bench=kernels times the packet-to-planar conversion of every sample type
+// at 1, 2, 6 and 8 channels with the kernel GetPacketKernels picks against
+// the generic one, and checks that both produce the same planes.
+// --bench=requantizer times Requantizer::Process on 8 channels at 192 kHz
+// for each output depth with and without noise shaping; the exit code is 1
+// if any of them needs more than --budget percent of a core (default 5).
+
+#include "alloc_tracker.h"
+#include "audio_session.h"
+#include "checksum.h"
+#include "manifest.h"
+#include "recording_pipeline.h"
+#include "stream_output.h"
+#include "trace_replay.h"
+#include "wave_format.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Same buffering as a live recording
+const size_t REPLAY_POOL_BLOCKS = 40;
+const size_t REPLAY_QUEUE_BLOCKS = 16;
+const uint32_t REPLAY_MAX_GAP_SECONDS = 10;
+const size_t REPLAY_MAX_GAPS = 10000;
+
+const uint32_t DEFAULT_STRESS_CYCLES = 2000;
+
+// Kernel bench: device-sized packets (10 ms at 48 kHz), samples converted
+// per round whatever the channel count, best round reported
+const size_t BENCH_PACKET_FRAMES = 480;
+const size_t BENCH_ROUND_SAMPLES = 4 * 1024 * 1024;
+const int BENCH_ROUNDS = 7;
+const SampleType BENCH_TYPES[] = { SampleS16, SampleS24, SampleS32, SampleF32 };
+const uint32_t BENCH_CHANNELS[] = { 1, 2, 6, 8 };
+
+// Requantizer bench: the widest format a device offers, 10 ms packets
+// cycling through one second of input, the fastest of a few runs counted
+const uint32_t REQUANTIZE_RATE = 192000;
+const uint32_t REQUANTIZE_CHANNELS = 8;
+const size_t REQUANTIZE_PACKET_FRAMES = REQUANTIZE_RATE / 100;
+const uint32_t REQUANTIZE_SECONDS = 10;
+const int REQUANTIZE_RUNS = 3;
+const double DEFAULT_REQUANTIZE_BUDGET_PERCENT = 5.0;
+
+struct Options
+{
+    bool realtime = false;
+    bool manifest = false;
+    uint32_t stressCycles = 0;
+    uint32_t stressMs = 20;
+    std::string bench;
+    double budgetPercent = DEFAULT_REQUANTIZE_BUDGET_PERCENT;
+    uint16_t bits = 16;
+    std::string outPath;
+    std::string tracePath;
+};
+
+// Discards everything; measures the pipeline without disk I/O
+class NullOutput : public ByteOutput
+{
+public:
+    int64_t WriteGather(const IoSpan* spans, size_t count) override
+    {
+        int64_t total = 0;
+        for (size_t i = 0; i < count; i++) total += (int64_t)spans[i].size;
+        return total;
+    }
+};
+
+// The header of a stopped recording must state exactly what the file holds
+bool CheckFinalizedRecording(const std::string& path, uint64_t expectedFrames, std::string& error)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open the recording";
+        return false;
+    }
+    uint8_t header[WAVE_HEADER_SIZE];
+    bool read = fread(header, 1, sizeof(header), file) == sizeof(header);
+    fseek(file, 0, SEEK_END);
+    uint64_t fileSize = (uint64_t)ftell(file);
+    fclose(file);
+
+    WaveInfo info;
+    if (!read || !ParseWaveHeader(header, sizeof(header), info)) {
+        error = "no valid WAV header";
+        return false;
+    }
+    uint32_t riffSize = (uint32_t)header[4] | ((uint32_t)header[5] << 8) | ((uint32_t)header[6] << 16) |
+        ((uint32_t)header[7] << 24);
+    if (info.dataSize == WAVE_SIZE_UNKNOWN || info.dataSize != fileSize - info.dataOffset || riffSize != fileSize - 8) {
+        error = "header sizes do not match the file (not finalized)";
+        return false;
+    }
+    if (info.dataSize != expectedFrames * info.blockAlign) {
+        error = "file holds other than the frames the timeline placed";
+        return false;
+    }
+    return true;
+}
+
+// Debug builds: heap allocations made by warmed-up pipeline threads fail the
+// check. Returns false (after printing them) if there were any.
+bool CheckRealtimeAllocations()
+{
+    if (AllocTracker::GetViolationCount() == 0) return true;
+    printf("Heap allocations after warm-up: %llu, the last %zu bytes on the %s thread\n",
+        (unsigned long long)AllocTracker::GetViolationCount(), AllocTracker::GetLastViolationSize(),
+        AllocTracker::GetLastViolationThread());
+    return false;
+}
+
+void PrintLatency(const char* name, std::vector<double>& microseconds)
+{
+    std::sort(microseconds.begin(), microseconds.end());
+    auto at = [&](double fraction) { return microseconds[std::min(microseconds.size() - 1, (size_t)(fraction * microseconds.size()))]; };
+    printf("%s: p50 %.0f us, p90 %.0f us, p99 %.0f us, max %.0f us\n", name, at(0.5), at(0.9), at(0.99),
+        microseconds.back());
+}
+
+// Start and stop a paced recording of the trace over and over
+int RunStress(const Options& options, uint16_t channels, uint32_t sampleRate, uint32_t bufferFrames)
+{
+    AudioSession session;
+    if (!session.SetTraceSource(options.tracePath, true) || !session.SetRecording(options.outPath, options.bits)) {
+        fprintf(stderr, "%s: cannot record this trace\n", options.tracePath.c_str());
+        return 2;
+    }
+
+    const double bufferUs = 1e6 * bufferFrames / sampleRate;
+    std::vector<double> startUs, stopUs;
+    uint64_t frames = 0;
+    uint32_t slowStops = 0;
+    printf("Stress: %u start/stop cycles of %u ms, %u channels at %u Hz, device buffer %.1f ms\n",
+        options.stressCycles, options.stressMs, (unsigned)channels, sampleRate, bufferUs / 1000.0);
+
+    for (uint32_t cycle = 0; cycle < options.stressCycles; cycle++) {
+        auto t0 = std::chrono::steady_clock::now();
+        bool started = session.Start();
+        auto t1 = std::chrono::steady_clock::now();
+        if (!started) {
+            printf("Cycle %u: recording did not start\n", cycle);
+            return 1;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.stressMs));
+
+        auto t2 = std::chrono::steady_clock::now();
+        session.Stop();
+        auto t3 = std::chrono::steady_clock::now();
+
+        startUs.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        stopUs.push_back(std::chrono::duration<double, std::micro>(t3 - t2).count());
+        if (stopUs.back() > bufferUs) slowStops++;
+
+        std::string error;
+        uint64_t recorded = session.GetStats().recordedFrames.load();
+        if (session.IsStarted()) {
+            error = "pump thread still running after Stop()";
+        } else if (recorded != session.GetRecordingTimeline().GetOutputFrames()) {
+            error = "recording lost frames";
+        } else {
+            CheckFinalizedRecording(options.outPath, recorded, error);
+        }
+        if (!error.empty()) {
+            printf("Cycle %u: %s\n", cycle, error.c_str());
+            return 1;
+        }
+        frames += recorded;
+    }
+
+    PrintLatency("Start", startUs);
+    PrintLatency("Stop", stopUs);
+    printf("%llu frames recorded, %u stops took longer than the device buffer; "
+        "every stop joined the pump and finalized the header\n", (unsigned long long)frames, slowStops);
+    return CheckRealtimeAllocations() ? 0 : 1;
+}
+
+// A full-scale sawtooth per channel, each at its own rate, encoded as the
+// device would deliver it
+void FillBenchPacket(SampleType type, uint32_t channels, std::vector<uint8_t>& packet)
+{
+    const size_t size = GetSampleSize(type);
+    packet.resize(BENCH_PACKET_FRAMES * channels * size);
+    for (size_t i = 0; i < BENCH_PACKET_FRAMES * channels; i++) {
+        uint32_t channel = (uint32_t)(i % channels);
+        uint32_t value = (uint32_t)(i / channels) * (0x01000193u * (channel + 1));
+        uint8_t* sample = packet.data() + i * size;
+        if (type == SampleF32) {
+            float x = (float)(int32_t)value * (1.0f / 2147483648.0f);
+            memcpy(sample, &x, sizeof(x));
+        } else {
+            // Little-endian, most significant bytes of the 32-bit value
+            for (size_t b = 0; b < size; b++) {
+                sample[b] = (uint8_t)(value >> (8 * (4 - size + b)));
+            }
+        }
+    }
+}
+
+// Best nanoseconds per sample over BENCH_ROUNDS rounds
+double TimeToPlanar(const PacketKernels* kernels, const std::vector<uint8_t>& packet, uint32_t channels,
+                    float* const* planes)
+{
+    const size_t packets = BENCH_ROUND_SAMPLES / (BENCH_PACKET_FRAMES * channels) + 1;
+    double best = 0.0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < packets; i++) {
+            kernels->toPlanar(packet.data(), BENCH_PACKET_FRAMES, channels, planes);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+            ((double)packets * BENCH_PACKET_FRAMES * channels);
+        if (round == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+int RunKernelBench()
+{
+    printf("Packet to planar float, %zu-frame packets, best of %d rounds, ns/sample\n",
+        BENCH_PACKET_FRAMES, BENCH_ROUNDS);
+    printf("type  channels  picked   generic  speedup\n");
+
+    int mismatches = 0;
+    for (SampleType type : BENCH_TYPES) {
+        for (uint32_t channels : BENCH_CHANNELS) {
+            std::vector<uint8_t> packet;
+            FillBenchPacket(type, channels, packet);
+
+            std::vector<float> picked(BENCH_PACKET_FRAMES * channels), generic(BENCH_PACKET_FRAMES * channels);
+            std::vector<float*> pickedPlanes, genericPlanes;
+            for (uint32_t c = 0; c < channels; c++) {
+                pickedPlanes.push_back(picked.data() + c * BENCH_PACKET_FRAMES);
+                genericPlanes.push_back(generic.data() + c * BENCH_PACKET_FRAMES);
+            }
+
+            const PacketKernels* kernels = GetPacketKernels(type, channels);
+            const PacketKernels* fallback = GetGenericPacketKernels(type);
+            double pickedNs = TimeToPlanar(kernels, packet, channels, pickedPlanes.data());
+            double genericNs = TimeToPlanar(fallback, packet, channels, genericPlanes.data());
+            bool same = memcmp(picked.data(), generic.data(), picked.size() * sizeof(float)) == 0;
+            if (!same) mismatches++;
+
+            if (!same) {
+                printf("%-4s  %8u  output differs from the generic kernel\n", GetSampleTypeName(type), channels);
+            } else if (kernels->specialized) {
+                printf("%-4s  %8u  %6.3f   %7.3f  %6.2fx\n", GetSampleTypeName(type), channels, pickedNs, genericNs,
+                    genericNs / pickedNs);
+            } else {
+                printf("%-4s  %8u  %6.3f   %7.3f  (generic)\n", GetSampleTypeName(type), channels, pickedNs, genericNs);
+            }
+        }
+    }
+    return mismatches > 0 ? 1 : 0;
+}
+
+// Share of one core Process() needs to keep up with the audio, in percent
+double TimeRequantizer(uint16_t bits, bool noiseShaping, const std::vector<float>& input, uint64_t& clipped)
+{
+    Requantizer requantizer;
+    requantizer.Configure(REQUANTIZE_CHANNELS, bits);
+    requantizer.SetNoiseShaping(noiseShaping);
+    std::vector<uint8_t> output(REQUANTIZE_PACKET_FRAMES * requantizer.GetOutputBlockAlign());
+
+    const size_t packetSamples = REQUANTIZE_PACKET_FRAMES * REQUANTIZE_CHANNELS;
+    const size_t inputPackets = input.size() / packetSamples;
+    const size_t packets = (size_t)REQUANTIZE_SECONDS * REQUANTIZE_RATE / REQUANTIZE_PACKET_FRAMES;
+    double best = 0.0;
+    for (int run = 0; run < REQUANTIZE_RUNS; run++) {
+        requantizer.Reset();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < packets; i++) {
+            requantizer.Process(input.data() + (i % inputPackets) * packetSamples, REQUANTIZE_PACKET_FRAMES,
+                output.data());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || seconds < best) best = seconds;
+    }
+    clipped = requantizer.GetClippedSamples();
+    return 100.0 * best / REQUANTIZE_SECONDS;
+}
+
+int RunRequantizerBench(double budgetPercent)
+{
+    // A tone per channel at -6 dBFS over noise, peaking past full scale
+    // now and then so the clipping path is taken as well
+    std::vector<float> input((size_t)REQUANTIZE_RATE * REQUANTIZE_CHANNELS);
+    uint32_t noise = 1;
+    for (size_t i = 0; i < input.size(); i++) {
+        size_t frame = i / REQUANTIZE_CHANNELS;
+        double frequency = 220.0 * (double)(i % REQUANTIZE_CHANNELS + 1);
+        noise = noise * 1664525u + 1013904223u;
+        double tone = 0.5 * sin(2.0 * 3.14159265358979 * frequency * (double)frame / REQUANTIZE_RATE);
+        double swell = frame % (REQUANTIZE_RATE / 4) < 64 ? 2.5 : 1.0;
+        input[i] = (float)(tone * swell + ((double)(noise >> 8) / 16777216.0 - 0.5) * 0.01);
+    }
+
+    printf("Requantizer, %u channels at %u Hz, %zu-frame packets, %u s of audio, best of %d runs\n",
+        REQUANTIZE_CHANNELS, REQUANTIZE_RATE, REQUANTIZE_PACKET_FRAMES, REQUANTIZE_SECONDS, REQUANTIZE_RUNS);
+
+    int overBudget = 0;
+    for (uint16_t bits : { (uint16_t)24, (uint16_t)16 }) {
+        for (bool noiseShaping : { false, true }) {
+            uint64_t clipped = 0;
+            double percent = TimeRequantizer(bits, noiseShaping, input, clipped);
+            bool over = percent > budgetPercent;
+            if (over) overBudget++;
+            printf("%u-bit, dither%-15s %5.2f%% of a core, %llu samples clipped%s\n", (unsigned)bits,
+                noiseShaping ? ", noise shaping" : "", percent, (unsigned long long)clipped,
+                over ? "  OVER BUDGET" : "");
+        }
+    }
+    printf("Budget %.2f%% of a core: %s\n", budgetPercent, overBudget > 0 ? "exceeded" : "met");
+    return overBudget > 0 ? 1 : 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    RecordingPipeline pipeline;
+    RecordingStages& stages = pipeline.GetStages();
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--realtime") == 0) {
+            options.realtime = true;
+        } else if (strncmp(arg, "--out=", 6) == 0) {
+            options.outPath = arg + 6;
+        } else if (strcmp(arg, "--manifest") == 0) {
+            options.manifest = true;
+        } else if (strncmp(arg, "--stress", 8) == 0 && (arg[8] == '\0' || arg[8] == '=')) {
+            options.stressCycles = arg[8] == '=' ? (uint32_t)atoi(arg + 9) : DEFAULT_STRESS_CYCLES;
+        } else if (strncmp(arg, "--stress-ms=", 12) == 0) {
+            options.stressMs = (uint32_t)atoi(arg + 12);
+        } else if (strncmp(arg, "--bench=", 8) == 0) {
+            options.bench = arg + 8;
+        } else if (strncmp(arg, "--budget=", 9) == 0) {
+            options.budgetPercent = atof(arg + 9);
+        } else if (strncmp(arg, "--bits=", 7) == 0) {
+            options.bits = (uint16_t)atoi(arg + 7);
+        } else if (strcmp(arg, "--dither=off") == 0) {
+            pipeline.GetRequantizer().SetDither(false);
+        } else if (strcmp(arg, "--noise-shaping") == 0) {
+            pipeline.GetRequantizer().SetNoiseShaping(true);
+        } else if (strncmp(arg, "--denoise", 9) == 0 && (arg[9] == '\0' || arg[9] == '=')) {
+            if (arg[9] == '=') pipeline.GetNoiseSuppressor().SetReductionDb((float)atof(arg + 10));
+            pipeline.GetNoiseSuppressor().SetEnabled(true);
+        } else if (strncmp(arg, "--gain=", 7) == 0) {
+            stages.Get<GainStage>().SetGainDb((float)atof(arg + 7));
+        } else if (strcmp(arg, "--dc-block") == 0) {
+            stages.Get<DcBlockerStage>().SetEnabled(true);
+        } else if (strncmp(arg, "--gate=", 7) == 0) {
+            stages.Get<NoiseGateStage>().SetThresholdDb((float)atof(arg + 7));
+            stages.Get<NoiseGateStage>().SetEnabled(true);
+        } else if (strncmp(arg, "--limit=", 8) == 0) {
+            stages.Get<LimiterStage>().SetCeilingDb((float)atof(arg + 8));
+            stages.Get<LimiterStage>().SetEnabled(true);
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        } else {
+            options.tracePath = arg;
+        }
+    }
+
+    if (options.bench == "kernels") {
+        return RunKernelBench();
+    }
+    if (options.bench == "requantizer" && options.budgetPercent > 0.0) {
+        return RunRequantizerBench(options.budgetPercent);
+    }
+    if (!options.bench.empty() || options.tracePath.empty() || (options.bits != 16 && options.bits != 24) ||
+        ((options.manifest || options.stressCycles > 0) && options.outPath.empty())) {
+        fprintf(stderr, "Usage: AudioReplay [--realtime] [--out=FILE.wav] [--manifest] [--bits=16|24] [--dither=off] [--noise-shaping] "
+            "[--denoise[=dB]] [--gain=dB] [--dc-block] [--gate=dB] [--limit=dB] trace.bin\n"
+            "       AudioReplay --stress[=CYCLES] [--stress-ms=N] --out=FILE.wav [--bits=16|24] trace.bin\n"
+            "       AudioReplay --bench=kernels\n"
+            "       AudioReplay --bench=requantizer [--budget=PERCENT]\n");
+        return 2;
+    }
+
+    TraceReplay replay;
+    if (!replay.Open(options.tracePath.c_str())) {
+        fprintf(stderr, "%s: not a capture trace\n", options.tracePath.c_str());
+        return 2;
+    }
+    const TraceFormat& format = replay.GetFormat();
+    SampleType sampleType = GetSampleType(format.isFloat, format.bitsPerSample);
+    if (!pipeline.Configure(format.sampleRate, format.channels, sampleType, options.bits,
+                            format.bufferFrames, REPLAY_POOL_BLOCKS)) {
+        fprintf(stderr, "%s: unsupported format\n", options.tracePath.c_str());
+        return 2;
+    }
+    if (options.stressCycles > 0) {
+        return RunStress(options, format.channels, format.sampleRate, format.bufferFrames);
+    }
+
+    FILE* outFile = nullptr;
+    if (!options.outPath.empty()) {
+        outFile = fopen(options.outPath.c_str(), "w+b");
+        if (!outFile) {
+            fprintf(stderr, "%s: cannot create\n", options.outPath.c_str());
+            return 2;
+        }
+    }
+    StdioOutput fileOutput(outFile);
+    NullOutput nullOutput;
+    ByteOutput* output = outFile ? (ByteOutput*)&fileOutput : &nullOutput;
+
+    // Checksums of everything the writer writes; the header is rewritten
+    ManifestWriter manifest;
+    ManifestOutput manifestOutput;
+    if (options.manifest) {
+        size_t slash = options.outPath.find_last_of("/\\");
+        std::string fileName = slash == std::string::npos ? options.outPath : options.outPath.substr(slash + 1);
+        std::string manifestPath = options.outPath + ".manifest";
+        if (!manifest.Open(fopen(manifestPath.c_str(), "wb"), fileName, 0, WAVE_HEADER_SIZE)) {
+            fprintf(stderr, "%s: cannot create\n", manifestPath.c_str());
+            return 2;
+        }
+        manifestOutput.SetOutput(output, &manifest);
+        output = &manifestOutput;
+    }
+
+    // The header is rewritten with the final size once the writer stopped
+    BatchedWriter writer;
+    uint8_t header[WAVE_HEADER_SIZE];
+    if (outFile) {
+        BuildWaveHeader(header, format.sampleRate, format.channels, options.bits, 0);
+        writer.SetPreamble(header, sizeof(header));
+    }
+    writer.SetQueueDepth(REPLAY_QUEUE_BLOCKS);
+    // Paced like the device, a full queue is handled as during capture;
+    // unpaced there is no deadline to keep and the replay waits for the disk
+    writer.SetPolicy(options.realtime ? BatchedWriter::FillSilence : BatchedWriter::Block);
+    if (!writer.Start(output, &pipeline.GetPool(), "replay writer")) {
+        fprintf(stderr, "Cannot start the writer\n");
+        return 2;
+    }
+
+    pipeline.Begin(&writer, nullptr, REPLAY_MAX_GAP_SECONDS, REPLAY_MAX_GAPS);
+    bool complete = replay.Run(options.realtime ? TraceReplay::OriginalTiming : TraceReplay::AsFastAsPossible,
+        [&](const uint8_t* data, const PacketInfo& packet) { pipeline.Record(data, packet); });
+    pipeline.End();
+    writer.Stop();
+
+    const WriterStats& stats = writer.GetStats();
+    uint64_t dataBytes = stats.bytesWritten.load() - (outFile ? WAVE_HEADER_SIZE : 0);
+    if (outFile) {
+        BuildWaveHeader(header, format.sampleRate, format.channels, options.bits,
+            GetWaveDataSize(dataBytes, WAVE_HEADER_SIZE));
+        fseek(outFile, 0, SEEK_SET);
+        fwrite(header, 1, sizeof(header), outFile);
+        fflush(outFile);
+        if (options.manifest && !manifest.Finish(outFile)) {
+            fprintf(stderr, "%s.manifest: cannot write\n", options.outPath.c_str());
+        }
+        fclose(outFile);
+    }
+
+    const PacketTimeline& timeline = pipeline.GetTimeline();
+    double elapsed = replay.GetElapsedSeconds();
+    double audioSeconds = (double)timeline.GetOutputFrames() / format.sampleRate;
+    printf("%llu packets, %llu frames (%.2f s of audio, trace %.2f s)%s\n",
+        (unsigned long long)replay.GetPackets(), (unsigned long long)replay.GetFrames(),
+        audioSeconds, replay.GetTraceSeconds(), complete ? "" : ", trace truncated");
+    printf("Timeline: %llu gaps, %llu silence frames, %llu lost frames, %llu overlap frames, %llu resyncs, %llu timestamp errors\n",
+        (unsigned long long)timeline.GetGapCount(), (unsigned long long)timeline.GetSilenceFrames(),
+        (unsigned long long)timeline.GetLostFrames(),
+        (unsigned long long)timeline.GetOverlapFrames(), (unsigned long long)timeline.GetResyncCount(),
+        (unsigned long long)timeline.GetTimestampErrors());
+    printf("Lost: %llu trace records, %llu packets (pool), %llu blocks (writer)\n",
+        (unsigned long long)replay.GetLostRecords(), (unsigned long long)pipeline.GetLostPackets(),
+        (unsigned long long)stats.blocksDropped.load());
+    if (pipeline.IsRequantizing()) {
+        printf("Requantized %s to %u-bit (dither %s, noise shaping %s), %llu samples clipped\n",
+            GetSampleTypeName(sampleType), (unsigned)options.bits,
+            pipeline.GetRequantizer().IsDitherEnabled() ? "on" : "off",
+            pipeline.GetRequantizer().IsNoiseShapingEnabled() ? "on" : "off",
+            (unsigned long long)pipeline.GetRequantizer().GetClippedSamples());
+    }
+    printf("%.3f s wall, %.1fx realtime, %.1f MB/s\n", elapsed,
+        elapsed > 0.0 ? audioSeconds / elapsed : 0.0,
+        elapsed > 0.0 ? dataBytes / 1048576.0 / elapsed : 0.0);
+
+    if (options.manifest) {
+        // Hashing runs on the writer thread; its share of the replay is the
+        // throughput the writer gives up
+        double hashSeconds = manifest.GetHashNs() / 1e9;
+        printf("Manifest: crc32c (%s) of %llu blocks, %.2f ms hashing on the writer thread = %.2f%% of the replay, %.2f GB/s\n",
+            GetCrc32cImplementation(), (unsigned long long)manifest.GetBlockCount(), hashSeconds * 1000.0,
+            elapsed > 0.0 ? 100.0 * hashSeconds / elapsed : 0.0,
+            hashSeconds > 0.0 ? stats.bytesWritten.load() / hashSeconds / 1e9 : 0.0);
+    }
+
+    if (options.realtime) {
+        const WakeJitterMeter& lateness = replay.GetLateness();
+        printf("Delivery lateness: p50 %lld us, p99 %lld us, max %lld us\n",
+            (long long)lateness.GetPercentile(0.5), (long long)lateness.GetPercentile(0.99),
+            (long long)lateness.GetMax());
+    }
+
+    bool lost = replay.GetLostRecords() > 0 || pipeline.GetLostPackets() > 0 || stats.blocksDropped.load() > 0;
+    bool allocated = !CheckRealtimeAllocations();
+    return complete && !lost && !allocated ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+#include "requantizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Fixed seeds keep recordings of the same input reproducible
+const uint32_t LANE_SEEDS[8] = {
+    0x9E3779B9u, 0x7F4A7C15u, 0xF39CC060u, 0x5CEDC834u,
+    0x2545F491u, 0x4F6CDD1Du, 0x1B873593u, 0xCC9E2D51u
+};
+
+// Two 16-bit uniforms per generator output, differenced: triangular in (-1, 1)
+const float DITHER_SCALE = 1.0f / 65536.0f;
+
+// Shaping error is capped so a clipped sample cannot make the loop ring
+const float ERROR_LIMIT = 2.0f;
+
+}
+
+bool Requantizer::Configure(uint32_t channels, uint16_t outputBits)
+{
+    if (channels == 0 || (outputBits != 16 && outputBits != 24)) return false;
+
+    m_channels = channels;
+    m_outputBits = outputBits;
+    m_scale = outputBits == 16 ? 32768.0f : 8388608.0f;
+    m_error.assign(channels, 0.0f);
+    Reset();
+    return true;
+}
+
+void Requantizer::Reset()
+{
+    std::copy(LANE_SEEDS, LANE_SEEDS + LANES, m_lanes);
+    std::fill(m_error.begin(), m_error.end(), 0.0f);
+    m_clipped.store(0, std::memory_order_relaxed);
+}
+
+void Requantizer::FillDither(float* dither)
+{
+    // xorshift32 on all lanes at once, CHUNK / LANES rounds
+    for (size_t round = 0; round < CHUNK; round += LANES) {
+        for (size_t lane = 0; lane < LANES; lane++) {
+            uint32_t x = m_lanes[lane];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            m_lanes[lane] = x;
+            dither[round + lane] = ((int32_t)(x & 0xFFFF) - (int32_t)(x >> 16)) * DITHER_SCALE;
+        }
+    }
+}
+
+void Requantizer::Process(const float* input, size_t frames, uint8_t* output)
+{
+    const size_t samples = frames * m_channels;
+    const float maxValue = m_scale - 1.0f;
+    const float minValue = -m_scale;
+    const size_t sampleBytes = m_outputBits / 8;
+
+    float dither[CHUNK] = {};
+    float values[CHUNK];
+    int32_t quantized[CHUNK];
+    uint32_t channel = 0;
+    uint64_t clipped = 0;
+
+    for (size_t start = 0; start < samples; start += CHUNK) {
+        const size_t count = std::min(CHUNK, samples - start);
+        const float* in = input + start;
+        if (m_dither) {
+            FillDither(dither);
+        }
+
+        if (m_noiseShaping) {
+            // Feedback runs sample by sample within each channel
+            for (size_t i = 0; i < count; i++) {
+                float wanted = in[i] * m_scale - m_error[channel];
+                float value = std::clamp(wanted + dither[i], minValue, maxValue);
+                clipped += (wanted + dither[i] != value);
+                float rounded = nearbyintf(value);
+                m_error[channel] = std::clamp(rounded - wanted, -ERROR_LIMIT, ERROR_LIMIT);
+                quantized[i] = (int32_t)rounded;
+                if (++channel == m_channels) channel = 0;
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                values[i] = in[i] * m_scale + dither[i];
+            }
+            for (size_t i = 0; i < count; i++) {
+                float value = std::clamp(values[i], minValue, maxValue);
+                clipped += (value != values[i]);
+                quantized[i] = (int32_t)lrintf(value);
+            }
+        }
+
+        uint8_t* out = output + start * sampleBytes;
+        if (sampleBytes == 2) {
+            int16_t narrowed[CHUNK];
+            for (size_t i = 0; i < count; i++) narrowed[i] = (int16_t)quantized[i];
+            memcpy(out, narrowed, count * sizeof(int16_t));
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                uint32_t value = (uint32_t)quantized[i];
+                out[i * 3] = (uint8_t)value;
+                out[i * 3 + 1] = (uint8_t)(value >> 8);
+                out[i * 3 + 2] = (uint8_t)(value >> 16);
+            }
+        }
+    }
+
+    if (clipped > 0) {
+        m_clipped.fetch_add(clipped, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Float to 16- or 24-bit PCM for the recorded file. Adds TPDF dither
+// (±1 LSB, from eight xorshift generators stepped side by side so the
+// loops vectorize), optionally shapes the requantization noise with
+// first-order error feedback per channel, and saturates out-of-range
+// samples, counting them.
+// Process() is called from one thread and allocates nothing; change the
+// settings only while it is not running.
+class Requantizer
+{
+public:
+    // Channel count and output depth (16 or 24); clears all state
+    bool Configure(uint32_t channels, uint16_t outputBits);
+
+    void SetDither(bool enabled) { m_dither = enabled; }
+    void SetNoiseShaping(bool enabled) { m_noiseShaping = enabled; }
+    bool IsDitherEnabled() const { return m_dither; }
+    bool IsNoiseShapingEnabled() const { return m_noiseShaping; }
+
+    // Clear the noise-shaping state, restart the generators and the clip count
+    void Reset();
+
+    // Interleaved float in [-1, 1) to interleaved little-endian PCM
+    void Process(const float* input, size_t frames, uint8_t* output);
+
+    uint16_t GetOutputBits() const { return m_outputBits; }
+    size_t GetOutputBlockAlign() const { return (size_t)m_channels * m_outputBits / 8; }
+
+    // Samples clipped since Reset(); readable from any thread
+    uint64_t GetClippedSamples() const { return m_clipped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t LANES = 8;
+    static constexpr size_t CHUNK = 64;   // Samples per pass, a multiple of LANES
+
+    void FillDither(float* dither);
+
+    uint32_t m_channels = 0;
+    uint16_t m_outputBits = 16;
+    float m_scale = 32768.0f;      // Full scale in output LSBs
+    bool m_dither = true;
+    bool m_noiseShaping = false;
+
+    uint32_t m_lanes[LANES] = {};
+    std::vector<float> m_error;    // Shaping error per channel, in LSBs
+    std::atomic<uint64_t> m_clipped{ 0 };
+};
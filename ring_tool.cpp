@@ -0,0 +1,191 @@
+// AudioRing: publishes to or monitors a shared-memory capture ring.
+//
+//   AudioRing monitor [--seconds=N] [--oldest] [--poll-us=N] NAME
+//   AudioRing publish [--seconds=N] [--rate=HZ] [--channels=N] [--packet-ms=N]
+//                     [--capacity-ms=N] NAME
+//
+// `monitor` attaches to the ring of AudioCaptureCpp --shared-ring=NAME (or
+// of `publish`) and reports level, lost frames and the latency from the
+// publisher's commit to the read every second; the exit code is 1 if the
+// reader lost frames. `publish` feeds a ring with a 997 Hz tone paced like a
+// capture device, so readers can be developed and load-tested without
+// audio hardware; start several monitors against it.
+
+#include "shared_ring.h"
+#include "synthetic_source.h"
+#include "thread_scheduling.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options
+{
+    bool publish = false;
+    double seconds = 0.0;        // 0 = until the ring closes / forever
+    bool oldest = false;
+    uint32_t pollMicroseconds = 500;
+    uint32_t sampleRate = 48000;
+    uint32_t channels = 2;
+    uint32_t packetMs = 10;
+    uint32_t capacityMs = 2000;
+    std::string name;
+};
+
+int Publish(const Options& options)
+{
+    SharedRingPublisher publisher;
+    uint32_t capacityFrames = (uint32_t)((uint64_t)options.sampleRate * options.capacityMs / 1000);
+    if (!publisher.Create(options.name, options.sampleRate, options.channels, capacityFrames)) {
+        fprintf(stderr, "%s: cannot create the ring\n", options.name.c_str());
+        return 2;
+    }
+
+    SyntheticSource source(options.sampleRate, options.channels);
+    source.AddSine(997.0, -20.0, 1.0);
+    source.SetLooping(true);
+
+    const size_t packetFrames = (size_t)options.sampleRate * options.packetMs / 1000;
+    std::vector<float> packet(packetFrames * options.channels);
+    const auto period = std::chrono::microseconds((int64_t)options.packetMs * 1000);
+    const auto start = std::chrono::steady_clock::now();
+    auto next = start;
+
+    printf("Publishing %u Hz, %u channels to %s, %u ms packets\n", options.sampleRate, options.channels,
+        options.name.c_str(), options.packetMs);
+    uint64_t packets = 0;
+    for (;;) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (options.seconds > 0.0 && elapsed >= options.seconds) break;
+
+        source.Read(packet.data(), packetFrames);
+        publisher.Publish(packet.data(), packetFrames);
+        packets++;
+
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+
+    printf("%llu packets, %llu frames published\n", (unsigned long long)packets,
+        (unsigned long long)publisher.GetPublishedFrames());
+    publisher.Close();
+    return 0;
+}
+
+int Monitor(const Options& options)
+{
+    SharedRingReader reader;
+    if (!reader.Open(options.name)) {
+        fprintf(stderr, "%s: no ring published under this name\n", options.name.c_str());
+        return 2;
+    }
+    if (options.oldest) reader.SeekToOldest();
+
+    const uint32_t channels = reader.GetChannels();
+    printf("%s: %u Hz, %u channels, %u frames of history\n", options.name.c_str(), reader.GetSampleRate(),
+        channels, reader.GetCapacityFrames());
+
+    std::vector<float> buffer((size_t)reader.GetCapacityFrames() * channels);
+    WakeJitterMeter latency;       // Commit to read, in microseconds
+    WakeJitterMeter total;
+    double sumSquares = 0.0;
+    uint64_t intervalFrames = 0;
+    uint64_t frames = 0;
+    bool closed = false;
+
+    const auto start = std::chrono::steady_clock::now();
+    auto nextReport = start + std::chrono::seconds(1);
+    for (;;) {
+        auto now = std::chrono::steady_clock::now();
+        if (options.seconds > 0.0 && std::chrono::duration<double>(now - start).count() >= options.seconds) break;
+
+        if (!reader.WaitForData(100, options.pollMicroseconds) && !reader.IsActive()) {
+            closed = true;
+            break;
+        }
+
+        size_t count = 0;
+        if (!reader.Read(buffer.data(), reader.GetCapacityFrames(), count)) {
+            closed = true;
+            break;
+        }
+        if (count > 0) {
+            int64_t age = (int64_t)(GetSharedRingTime() - reader.GetCommitTime()) / 1000;
+            latency.Record(age);
+            total.Record(age);
+            for (size_t i = 0; i < count * channels; i++) sumSquares += (double)buffer[i] * buffer[i];
+            intervalFrames += count;
+            frames += count;
+        }
+
+        if (std::chrono::steady_clock::now() >= nextReport) {
+            double rms = intervalFrames > 0 ? sqrt(sumSquares / ((double)intervalFrames * channels)) : 0.0;
+            printf("%8llu frames  %6.1f dBFS  lost %llu  latency p50 %lld us, p99 %lld us, max %lld us\n",
+                (unsigned long long)intervalFrames, rms > 0.0 ? 20.0 * log10(rms) : -120.0,
+                (unsigned long long)reader.GetLostFrames(), (long long)latency.GetPercentile(0.5),
+                (long long)latency.GetPercentile(0.99), (long long)latency.GetMax());
+            fflush(stdout);
+            latency.Reset();
+            sumSquares = 0.0;
+            intervalFrames = 0;
+            nextReport += std::chrono::seconds(1);
+        }
+    }
+
+    printf("%s%llu frames read, %llu lost in %llu overruns, %llu discontinuities; "
+        "latency p50 %lld us, p99 %lld us, max %lld us\n", closed ? "Ring closed. " : "",
+        (unsigned long long)frames, (unsigned long long)reader.GetLostFrames(),
+        (unsigned long long)reader.GetOverruns(), (unsigned long long)reader.GetDiscontinuities(),
+        (long long)total.GetPercentile(0.5), (long long)total.GetPercentile(0.99), (long long)total.GetMax());
+    return reader.GetLostFrames() > 0 ? 1 : 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    bool haveCommand = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (!haveCommand && (strcmp(arg, "publish") == 0 || strcmp(arg, "monitor") == 0)) {
+            options.publish = strcmp(arg, "publish") == 0;
+            haveCommand = true;
+        } else if (strncmp(arg, "--seconds=", 10) == 0) {
+            options.seconds = atof(arg + 10);
+        } else if (strcmp(arg, "--oldest") == 0) {
+            options.oldest = true;
+        } else if (strncmp(arg, "--poll-us=", 10) == 0) {
+            options.pollMicroseconds = (uint32_t)atoi(arg + 10);
+        } else if (strncmp(arg, "--rate=", 7) == 0) {
+            options.sampleRate = (uint32_t)atoi(arg + 7);
+        } else if (strncmp(arg, "--channels=", 11) == 0) {
+            options.channels = (uint32_t)atoi(arg + 11);
+        } else if (strncmp(arg, "--packet-ms=", 12) == 0) {
+            options.packetMs = (uint32_t)atoi(arg + 12);
+        } else if (strncmp(arg, "--capacity-ms=", 14) == 0) {
+            options.capacityMs = (uint32_t)atoi(arg + 14);
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        } else {
+            options.name = arg;
+        }
+    }
+
+    if (!haveCommand || options.name.empty() || options.sampleRate == 0 || options.channels == 0 ||
+        options.packetMs == 0 || options.capacityMs == 0) {
+        fprintf(stderr, "Usage: AudioRing monitor [--seconds=N] [--oldest] [--poll-us=N] NAME\n"
+            "       AudioRing publish [--seconds=N] [--rate=HZ] [--channels=N] [--packet-ms=N] [--capacity-ms=N] NAME\n");
+        return 2;
+    }
+
+    return options.publish ? Publish(options) : Monitor(options);
+}
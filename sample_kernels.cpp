@@ -0,0 +1,173 @@
+#include "sample_kernels.h"
+#include <cstring>
+
+namespace {
+
+// Loading one sample as float; `p` points at the sample's first byte
+struct S16Traits
+{
+    static const SampleType TYPE = SampleS16;
+    static const size_t SIZE = 2;
+    static const bool FIXED_CHANNELS = true;
+    static float Load(const uint8_t* p)
+    {
+        int16_t value;
+        memcpy(&value, p, sizeof(value));
+        return value * (1.0f / 32768.0f);
+    }
+};
+
+struct S24Traits
+{
+    static const SampleType TYPE = SampleS24;
+    static const size_t SIZE = 3;
+    static const bool FIXED_CHANNELS = false;  // Packed loads gain nothing from a fixed stride
+    static float Load(const uint8_t* p)
+    {
+        // Into the top of an int32 so the sign comes for free
+        int32_t value = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+        return value * (1.0f / 2147483648.0f);
+    }
+};
+
+struct S32Traits
+{
+    static const SampleType TYPE = SampleS32;
+    static const size_t SIZE = 4;
+    static const bool FIXED_CHANNELS = true;
+    static float Load(const uint8_t* p)
+    {
+        int32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value * (1.0f / 2147483648.0f);
+    }
+};
+
+struct F32Traits
+{
+    static const SampleType TYPE = SampleF32;
+    static const size_t SIZE = 4;
+    static const bool FIXED_CHANNELS = true;
+    static float Load(const uint8_t* p)
+    {
+        float value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+};
+
+// Interleaved to interleaved is one flat loop whatever the channel count.
+// Outputs never overlap the packet; __restrict lets the loops vectorize
+// although the input is read through a byte pointer.
+template <typename Traits>
+void ToFloat(const uint8_t* __restrict data, size_t frames, uint32_t channels, float* __restrict output)
+{
+    const size_t samples = frames * channels;
+    for (size_t i = 0; i < samples; i++) {
+        output[i] = Traits::Load(data + i * Traits::SIZE);
+    }
+}
+
+// CHANNELS == 0 takes the channel count at run time. With a fixed count the
+// frame stride is a constant, which lets the compiler unroll the channel
+// loop and vectorize the strided loads.
+template <typename Traits, uint32_t CHANNELS>
+void ToPlanar(const uint8_t* data, size_t frames, uint32_t channels, float* const* planes)
+{
+    if constexpr (CHANNELS == 1) {
+        ToFloat<Traits>(data, frames, 1, planes[0]);
+        return;
+    }
+
+    const uint32_t count = CHANNELS ? CHANNELS : channels;
+    const size_t frameSize = count * Traits::SIZE;
+
+    // Channel by channel keeps the stores sequential
+    for (uint32_t c = 0; c < count; c++) {
+        float* __restrict out = planes[c];
+        const uint8_t* __restrict sample = data + c * Traits::SIZE;
+        for (size_t i = 0; i < frames; i++) {
+            out[i] = Traits::Load(sample + i * frameSize);
+        }
+    }
+}
+
+template <typename Traits, uint32_t CHANNELS>
+constexpr PacketKernels MakeKernels()
+{
+    return PacketKernels{ &ToFloat<Traits>, &ToPlanar<Traits, CHANNELS>, Traits::TYPE, CHANNELS != 0 };
+}
+
+// Rows are indexed by channel count; slot 0 is the generic kernel. Fixed
+// channel counts only pay off for mono and stereo of types whose traits ask
+// for them: at 6 and 8 channels, and for packed s24, they were no faster or
+// slower than the generic kernel (AudioReplay --bench=kernels).
+const size_t MAX_FIXED_CHANNELS = 2;
+
+template <typename Traits>
+constexpr PacketKernels KERNELS_FOR[MAX_FIXED_CHANNELS + 1] = {
+    MakeKernels<Traits, 0>(),
+    MakeKernels<Traits, Traits::FIXED_CHANNELS ? 1 : 0>(),
+    MakeKernels<Traits, Traits::FIXED_CHANNELS ? 2 : 0>(),
+};
+
+const PacketKernels* GetKernelRow(SampleType type)
+{
+    switch (type) {
+    case SampleS16: return KERNELS_FOR<S16Traits>;
+    case SampleS24: return KERNELS_FOR<S24Traits>;
+    case SampleS32: return KERNELS_FOR<S32Traits>;
+    case SampleF32: return KERNELS_FOR<F32Traits>;
+    default: return nullptr;
+    }
+}
+
+}
+
+SampleType GetSampleType(bool isFloat, uint16_t bitsPerSample)
+{
+    if (isFloat) return bitsPerSample == 32 ? SampleF32 : SampleUnknown;
+
+    switch (bitsPerSample) {
+    case 16: return SampleS16;
+    case 24: return SampleS24;
+    case 32: return SampleS32;
+    default: return SampleUnknown;
+    }
+}
+
+const char* GetSampleTypeName(SampleType type)
+{
+    switch (type) {
+    case SampleS16: return "s16";
+    case SampleS24: return "s24";
+    case SampleS32: return "s32";
+    case SampleF32: return "f32";
+    default: return "unknown";
+    }
+}
+
+size_t GetSampleSize(SampleType type)
+{
+    switch (type) {
+    case SampleS16: return 2;
+    case SampleS24: return 3;
+    case SampleS32:
+    case SampleF32: return 4;
+    default: return 0;
+    }
+}
+
+const PacketKernels* GetPacketKernels(SampleType type, uint32_t channels)
+{
+    const PacketKernels* row = GetKernelRow(type);
+    if (!row || channels == 0) return nullptr;
+
+    return &row[channels <= MAX_FIXED_CHANNELS ? channels : 0];
+}
+
+const PacketKernels* GetGenericPacketKernels(SampleType type)
+{
+    const PacketKernels* row = GetKernelRow(type);
+    return row ? &row[0] : nullptr;
+}
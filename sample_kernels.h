@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Sample encodings a capture device can deliver (little-endian, interleaved)
+enum SampleType {
+    SampleUnknown,
+    SampleS16,      // 16-bit PCM
+    SampleS24,      // 24-bit PCM packed in 3 bytes
+    SampleS32,      // 32-bit PCM, also 24-in-32 containers (left-justified)
+    SampleF32       // 32-bit IEEE float
+};
+
+// Sample type of a negotiated format; SampleUnknown if it is not supported
+SampleType GetSampleType(bool isFloat, uint16_t bitsPerSample);
+
+const char* GetSampleTypeName(SampleType type);
+size_t GetSampleSize(SampleType type);
+
+// Conversion kernels for one (sample type, channel count) pair, looked up
+// once when the format is negotiated. Mono and stereo of s16, s32 and f32
+// get kernels with the channel count fixed at compile time, so per-frame
+// loops are fully unrolled; everything else uses a generic kernel. No
+// kernel allocates.
+struct PacketKernels
+{
+    // Interleaved device samples to interleaved float in [-1, 1)
+    void (*toFloat)(const uint8_t* data, size_t frames, uint32_t channels, float* output);
+
+    // Interleaved device samples to one float plane per channel; plane c
+    // receives frames at planes[c][0..frames)
+    void (*toPlanar)(const uint8_t* data, size_t frames, uint32_t channels, float* const* planes);
+
+    SampleType type;
+    bool specialized;   // Channel count fixed at compile time
+};
+
+// Kernels for the format; null for SampleUnknown or zero channels
+const PacketKernels* GetPacketKernels(SampleType type, uint32_t channels);
+
+// The generic (runtime channel count) kernels, e.g. to compare against
+const PacketKernels* GetGenericPacketKernels(SampleType type);
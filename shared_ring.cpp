@@ -0,0 +1,412 @@
+#include "shared_ring.h"
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t HEADER_SIZE = (sizeof(SharedRingHeader) + 63) & ~(size_t)63;
+
+bool IsValidName(const std::string& name)
+{
+    if (name.empty() || name.size() > 64) return false;
+    for (char c : name) {
+        bool ok = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '_' || c == '.' || c == '-';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+std::wstring GetObjectName(const std::string& name)
+{
+    // Validated as ASCII, so widening byte by byte is exact
+    std::string full = "Local\\AudioCapture.Ring." + name;
+    return std::wstring(full.begin(), full.end());
+}
+#else
+std::string GetObjectName(const std::string& name)
+{
+    return "/AudioCapture.Ring." + name;
+}
+#endif
+
+uint32_t RoundUpToPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result < value && result < 0x80000000u) result <<= 1;
+    return result;
+}
+
+}
+
+uint64_t GetSharedRingTime()
+{
+#ifdef _WIN32
+    static const uint64_t frequency = [] {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return (uint64_t)value.QuadPart;
+    }();
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    uint64_t ticks = (uint64_t)counter.QuadPart;
+    return ticks / frequency * 1000000000ull + ticks % frequency * 1000000000ull / frequency;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// SharedRingPublisher
+
+SharedRingPublisher::~SharedRingPublisher()
+{
+    Close();
+}
+
+bool SharedRingPublisher::Create(const std::string& name, uint32_t sampleRate, uint32_t channels, uint32_t capacityFrames)
+{
+    Close();
+    if (!IsValidName(name) || sampleRate == 0 || channels == 0 || channels > 0xFFFF || capacityFrames == 0) return false;
+
+    uint32_t capacity = RoundUpToPowerOfTwo(capacityFrames);
+    size_t size = HEADER_SIZE + (size_t)capacity * channels * sizeof(float);
+    void* view = nullptr;
+
+#ifdef _WIN32
+    std::wstring objectName = GetObjectName(name);
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)size, objectName.c_str());
+    if (!mapping) return false;
+    bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+    view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    // Readers still hold the ring of an earlier session; it keeps its
+    // original size, so it can only be reused if the new format fits
+    if (existed) {
+        MEMORY_BASIC_INFORMATION info = {};
+        if (VirtualQuery(view, &info, sizeof(info)) == 0 || info.RegionSize < size) {
+            UnmapViewOfFile(view);
+            CloseHandle(mapping);
+            return false;
+        }
+        SharedRingHeader* previous = (SharedRingHeader*)view;
+        previous->state.store(SharedRingClosed, std::memory_order_release);
+    }
+    m_mapping = mapping;
+#else
+    // A ring left behind by a publisher that crashed is replaced; readers
+    // still mapping it see it closed once they check the state
+    std::string objectName = GetObjectName(name);
+    shm_unlink(objectName.c_str());
+    int fd = shm_open(objectName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(objectName.c_str());
+        return false;
+    }
+    view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        shm_unlink(objectName.c_str());
+        return false;
+    }
+#endif
+
+    m_name = name;
+    m_header = (SharedRingHeader*)view;
+    m_samples = (float*)((uint8_t*)view + HEADER_SIZE);
+    m_mappedSize = size;
+    m_channels = channels;
+    m_mask = capacity - 1;
+
+    // Readers check the magic first, so it is written last
+    SharedRingHeader* header = m_header;
+    header->magic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->version = SHARED_RING_VERSION;
+    header->headerSize = (uint16_t)HEADER_SIZE;
+    header->sampleRate = sampleRate;
+    header->channels = (uint16_t)channels;
+    header->sampleFormat = SHARED_RING_FLOAT32;
+    header->capacityFrames = capacity;
+    header->reserved0 = 0;
+    header->sessionId = GetSharedRingTime();
+    header->reserved.store(0, std::memory_order_relaxed);
+    header->committed.store(0, std::memory_order_relaxed);
+    header->sequence.store(0, std::memory_order_relaxed);
+    header->commitTime.store(0, std::memory_order_relaxed);
+    header->discontinuities.store(0, std::memory_order_relaxed);
+    header->state.store(SharedRingActive, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_RING_MAGIC;
+    return true;
+}
+
+void SharedRingPublisher::Close()
+{
+    if (!m_header) return;
+
+    m_header->state.store(SharedRingClosed, std::memory_order_release);
+#ifdef _WIN32
+    UnmapViewOfFile(m_header);
+    CloseHandle((HANDLE)m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap(m_header, m_mappedSize);
+    shm_unlink(GetObjectName(m_name).c_str());
+#endif
+    m_header = nullptr;
+    m_samples = nullptr;
+    m_mappedSize = 0;
+}
+
+void SharedRingPublisher::Publish(const float* samples, size_t frames)
+{
+    if (!m_header || frames == 0) return;
+
+    const uint64_t capacity = m_mask + 1;
+    uint64_t start = m_header->committed.load(std::memory_order_relaxed);
+
+    // Announce the slots about to be overwritten before touching them
+    m_header->reserved.store(start + frames, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t skip = frames > capacity ? (size_t)(frames - capacity) : 0;
+    uint64_t position = start + skip;
+    size_t remaining = frames - skip;
+    const float* source = samples ? samples + skip * m_channels : nullptr;
+    while (remaining > 0) {
+        size_t offset = (size_t)(position & m_mask);
+        size_t room = (size_t)(capacity - offset);
+        size_t count = remaining < room ? remaining : room;
+        float* target = m_samples + offset * m_channels;
+        if (source) {
+            memcpy(target, source, count * m_channels * sizeof(float));
+            source += count * m_channels;
+        } else {
+            memset(target, 0, count * m_channels * sizeof(float));
+        }
+        position += count;
+        remaining -= count;
+    }
+
+    // Only this thread writes the counters
+    m_header->sequence.store(m_header->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_header->commitTime.store(GetSharedRingTime(), std::memory_order_relaxed);
+    m_header->committed.store(start + frames, std::memory_order_release);
+}
+
+void SharedRingPublisher::MarkDiscontinuity()
+{
+    if (!m_header) return;
+    m_header->discontinuities.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t SharedRingPublisher::GetPublishedFrames() const
+{
+    return m_header ? m_header->committed.load(std::memory_order_relaxed) : 0;
+}
+
+// SharedRingReader
+
+SharedRingReader::~SharedRingReader()
+{
+    Close();
+}
+
+bool SharedRingReader::Open(const std::string& name)
+{
+    Close();
+    if (!IsValidName(name)) return false;
+
+    const void* view = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, GetObjectName(name).c_str());
+    if (!mapping) return false;
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info = {};
+    if (!view || VirtualQuery(view, &info, sizeof(info)) == 0) {
+        if (view) UnmapViewOfFile(view);
+        CloseHandle(mapping);
+        return false;
+    }
+    size = info.RegionSize;
+    m_mapping = mapping;
+#else
+    int fd = shm_open(GetObjectName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SharedRingHeader)) {
+        close(fd);
+        return false;
+    }
+    size = (size_t)info.st_size;
+    view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+#endif
+
+    m_header = (const SharedRingHeader*)view;
+    m_mappedSize = size;
+
+    const SharedRingHeader* header = m_header;
+    bool valid = header->magic == SHARED_RING_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && header->version == SHARED_RING_VERSION && header->headerSize >= HEADER_SIZE &&
+        header->sampleFormat == SHARED_RING_FLOAT32 && header->channels > 0 && header->capacityFrames > 0 &&
+        (header->capacityFrames & (header->capacityFrames - 1)) == 0 &&
+        header->headerSize + (size_t)header->capacityFrames * header->channels * sizeof(float) <= size &&
+        header->state.load(std::memory_order_acquire) == SharedRingActive;
+    if (!valid) {
+        Close();
+        return false;
+    }
+
+    m_sessionId = header->sessionId;
+    m_sampleRate = header->sampleRate;
+    m_channels = header->channels;
+    m_capacity = header->capacityFrames;
+    m_mask = m_capacity - 1;
+    m_samples = (const float*)((const uint8_t*)view + header->headerSize);
+    m_lostFrames = 0;
+    m_overruns = 0;
+    SeekToNewest();
+    return true;
+}
+
+void SharedRingReader::Close()
+{
+    if (!m_header) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_header);
+    CloseHandle((HANDLE)m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap((void*)m_header, m_mappedSize);
+#endif
+    m_header = nullptr;
+    m_samples = nullptr;
+    m_mappedSize = 0;
+}
+
+bool SharedRingReader::IsActive() const
+{
+    return m_header && m_header->state.load(std::memory_order_acquire) == SharedRingActive &&
+        m_header->sessionId == m_sessionId;
+}
+
+void SharedRingReader::SeekToNewest()
+{
+    if (m_header) m_cursor = m_header->committed.load(std::memory_order_acquire);
+}
+
+void SharedRingReader::SeekToOldest()
+{
+    if (!m_header) return;
+    uint64_t committed = m_header->committed.load(std::memory_order_acquire);
+    m_cursor = committed > m_capacity ? committed - m_capacity : 0;
+}
+
+uint64_t SharedRingReader::GetAvailableFrames() const
+{
+    if (!m_header) return 0;
+    uint64_t committed = m_header->committed.load(std::memory_order_acquire);
+    return committed > m_cursor ? committed - m_cursor : 0;
+}
+
+bool SharedRingReader::Read(float* output, size_t maxFrames, size_t& frames)
+{
+    frames = 0;
+    if (!IsActive()) return false;
+
+    uint64_t committed = m_header->committed.load(std::memory_order_acquire);
+    uint64_t oldest = committed > m_capacity ? committed - m_capacity : 0;
+    if (m_cursor < oldest) {
+        m_lostFrames += oldest - m_cursor;
+        m_overruns++;
+        m_cursor = oldest;
+    } else if (m_cursor > committed) {
+        m_cursor = committed;
+    }
+
+    uint64_t available = committed - m_cursor;
+    size_t count = available < maxFrames ? (size_t)available : maxFrames;
+    uint64_t position = m_cursor;
+    size_t copied = 0;
+    while (copied < count) {
+        size_t offset = (size_t)(position & m_mask);
+        size_t room = m_capacity - offset;
+        size_t chunk = count - copied < room ? count - copied : room;
+        memcpy(output + copied * m_channels, m_samples + offset * m_channels, chunk * m_channels * sizeof(float));
+        position += chunk;
+        copied += chunk;
+    }
+
+    // Frames the publisher started overwriting during the copy are dropped
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t reserved = m_header->reserved.load(std::memory_order_relaxed);
+    uint64_t safeStart = reserved > m_capacity ? reserved - m_capacity : 0;
+    if (safeStart > m_cursor) {
+        uint64_t behind = safeStart - m_cursor;
+        size_t overwritten = behind < count ? (size_t)behind : count;
+        memmove(output, output + overwritten * m_channels, (count - overwritten) * m_channels * sizeof(float));
+        count -= overwritten;
+        m_lostFrames += overwritten;
+        m_overruns++;
+        m_cursor += overwritten;
+    }
+    if (!IsActive()) return false;
+
+    m_cursor += count;
+    frames = count;
+    return true;
+}
+
+bool SharedRingReader::WaitForData(uint32_t timeoutMs, uint32_t pollMicroseconds)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        if (!IsActive()) return false;
+        if (GetAvailableFrames() > 0) return true;
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(pollMicroseconds));
+    }
+}
+
+uint64_t SharedRingReader::GetCommitTime() const
+{
+    return m_header ? m_header->commitTime.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t SharedRingReader::GetSequence() const
+{
+    return m_header ? m_header->sequence.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t SharedRingReader::GetDiscontinuities() const
+{
+    return m_header ? m_header->discontinuities.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Named shared-memory ring of the captured stream for other processes
+// (monitoring, classifiers), so they do not need a loopback client of their
+// own. One publisher writes interleaved float frames; any number of readers
+// map the ring read-only and never write to it, so they neither register nor
+// slow the publisher down.
+//
+// Shared memory: file mapping "Local\AudioCapture.Ring.NAME" on Windows,
+// shm_open("/AudioCapture.Ring.NAME") elsewhere. NAME is [A-Za-z0-9_.-].
+//
+// Overrun contract: each reader keeps its own absolute frame cursor. Frames
+// older than `committed - capacityFrames` are gone; a reader that falls that
+// far behind skips ahead to the oldest frame still held and the skipped
+// frames are reported as lost. Frames are copied out first and validated
+// against `reserved` afterwards, so a copy raced by the publisher is never
+// returned as audio.
+
+const uint32_t SHARED_RING_MAGIC = 0x47524341;   // "ACRG"
+const uint16_t SHARED_RING_VERSION = 1;
+const uint16_t SHARED_RING_FLOAT32 = 3;          // WAVE_FORMAT_IEEE_FLOAT
+
+enum SharedRingState : uint32_t {
+    SharedRingActive = 1,
+    SharedRingClosed = 2     // Publisher gone or restarted; reopen by name
+};
+
+// Layout at the start of the mapping; samples follow at headerSize. Fields
+// are only ever appended, readers accept any headerSize >= their own.
+struct SharedRingHeader
+{
+    // Fixed while the ring is active
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t sampleRate;
+    uint16_t channels;
+    uint16_t sampleFormat;        // SHARED_RING_FLOAT32
+    uint32_t capacityFrames;      // Power of two
+    uint32_t reserved0;
+    uint64_t sessionId;           // New for every publisher start
+
+    // Publisher cursors, absolute frame counts since the session started.
+    // `reserved` is raised before frames are overwritten, `committed` after
+    // they are complete.
+    alignas(64) std::atomic<uint64_t> reserved;
+    std::atomic<uint64_t> committed;
+    std::atomic<uint64_t> sequence;          // Packets published
+    std::atomic<uint64_t> commitTime;        // GetSharedRingTime() of the last commit
+    std::atomic<uint64_t> discontinuities;   // Device gaps the stream skipped over
+    std::atomic<uint32_t> state;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring cursors must be lock-free across processes");
+
+// Clock shared by all processes on the machine (QPC / CLOCK_MONOTONIC), in
+// nanoseconds; commitTime uses it so readers can measure their latency
+uint64_t GetSharedRingTime();
+
+// Owner of the ring, fed by the capture thread
+class SharedRingPublisher
+{
+public:
+    SharedRingPublisher() = default;
+    ~SharedRingPublisher();
+
+    SharedRingPublisher(const SharedRingPublisher&) = delete;
+    SharedRingPublisher& operator=(const SharedRingPublisher&) = delete;
+
+    // Create (or take over) the named ring; capacityFrames is rounded up to
+    // a power of two
+    bool Create(const std::string& name, uint32_t sampleRate, uint32_t channels, uint32_t capacityFrames);
+
+    // Mark the ring closed for readers and release it
+    void Close();
+
+    bool IsOpen() const { return m_header != nullptr; }
+    const std::string& GetName() const { return m_name; }
+
+    // Append interleaved frames; null samples publish silence. Does not
+    // allocate or block. Frames beyond the capacity keep only the newest.
+    void Publish(const float* samples, size_t frames);
+
+    // The next frames do not follow the previous ones on the device clock
+    void MarkDiscontinuity();
+
+    uint64_t GetPublishedFrames() const;
+
+private:
+    std::string m_name;
+    SharedRingHeader* m_header = nullptr;
+    float* m_samples = nullptr;
+    size_t m_mappedSize = 0;
+    uint32_t m_channels = 0;
+    uint64_t m_mask = 0;
+
+    void* m_mapping = nullptr;   // Windows mapping handle
+};
+
+// Read side; small enough to be copied into other tools (AudioSharedRing
+// library). A reader is used by one thread.
+class SharedRingReader
+{
+public:
+    SharedRingReader() = default;
+    ~SharedRingReader();
+
+    SharedRingReader(const SharedRingReader&) = delete;
+    SharedRingReader& operator=(const SharedRingReader&) = delete;
+
+    // Map an existing ring; false if there is none or it has another version.
+    // The cursor starts at the newest frame.
+    bool Open(const std::string& name);
+    void Close();
+
+    bool IsOpen() const { return m_header != nullptr; }
+
+    // False once the publisher closed or restarted the ring
+    bool IsActive() const;
+
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint32_t GetChannels() const { return m_channels; }
+    uint32_t GetCapacityFrames() const { return m_capacity; }
+
+    // Jump to the newest frame (live) or the oldest one still held
+    void SeekToNewest();
+    void SeekToOldest();
+    uint64_t GetCursor() const { return m_cursor; }
+
+    // Frames between the cursor and the publisher (may exceed the capacity)
+    uint64_t GetAvailableFrames() const;
+
+    // Copy up to maxFrames interleaved frames from the cursor into output and
+    // advance it; `frames` receives the count. Returns false once the
+    // publisher closed or restarted the ring: Close() and Open() again.
+    bool Read(float* output, size_t maxFrames, size_t& frames);
+
+    // Poll until frames are available, the ring closes or the timeout passes
+    bool WaitForData(uint32_t timeoutMs, uint32_t pollMicroseconds = 500);
+
+    // Frames skipped because this reader fell behind, since Open()
+    uint64_t GetLostFrames() const { return m_lostFrames; }
+    uint64_t GetOverruns() const { return m_overruns; }
+
+    // Publisher's clock at its latest commit and counters, for latency and
+    // continuity checks
+    uint64_t GetCommitTime() const;
+    uint64_t GetSequence() const;
+    uint64_t GetDiscontinuities() const;
+
+private:
+    const SharedRingHeader* m_header = nullptr;
+    const float* m_samples = nullptr;
+    size_t m_mappedSize = 0;
+    uint64_t m_sessionId = 0;
+    uint32_t m_sampleRate = 0;
+    uint32_t m_channels = 0;
+    uint32_t m_capacity = 0;
+    uint64_t m_mask = 0;
+
+    uint64_t m_cursor = 0;
+    uint64_t m_lostFrames = 0;
+    uint64_t m_overruns = 0;
+
+    void* m_mapping = nullptr;   // Windows mapping handle
+};
@@ -0,0 +1,679 @@
+// AudioSinks: fans one realtime capture stream out to many sinks and
+// compares thread-per-stage sinks with coroutine sinks.
+//
+//   AudioSinks [--sinks=N] [--seconds=N] [--mode=threads|coroutines|both]
+//              [--workers=N] [--rate=HZ] [--channels=N] [--packet-ms=N] [--out=DIR]
+//
+// Every sink has a DSP stage (the recording chain, then requantization to
+// 16 bits) and a writer stage batching the result to DIR/sink_N.wav, or
+// without --out to a null output that only counts and checksums the bytes.
+// "threads" runs the stages like the live pipeline: a consumer thread and a
+// BatchedWriter thread per sink. "coroutines" writes both stages as
+// coroutines on a fixed CoroScheduler pool. The pump is the same in both: a
+// realtime-paced thread of its own that never blocks on a sink. Reported
+// per mode: threads, context switches, CPU time and drops; every sink's
+// output must be identical in both modes and, in Debug builds, the pump and
+// writer threads must not allocate once warmed up (exit code 1 otherwise).
+
+#include "alloc_tracker.h"
+#include "batched_writer.h"
+#include "block_pool.h"
+#include "checksum.h"
+#include "coro_runtime.h"
+#include "dsp_graph.h"
+#include "dsp_nodes.h"
+#include "requantizer.h"
+#include "stream_output.h"
+#include "synthetic_source.h"
+#include "thread_scheduling.h"
+#include "wave_format.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <tlhelp32.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Packets a sink may lag behind the pump before they are dropped
+const size_t INPUT_QUEUE_PACKETS = 8;
+
+// Converted blocks between the stages of a sink, as for a live recording
+const size_t OUTPUT_QUEUE_BLOCKS = 16;
+const size_t OUTPUT_POOL_BLOCKS = 40;
+
+// Input blocks beyond the queues: one being filled, some being processed
+const size_t SPARE_INPUT_BLOCKS = 4;
+
+// Writer batching, as BatchedWriter's default
+const uint32_t WRITER_BATCH_MS = 20;
+const size_t WRITER_MAX_SPANS = 64;
+
+// Consumer wait between checks for the end, as AudioSession's
+const uint32_t CONSUMER_WAIT_MS = 10;
+
+// Pump packets before it must stop allocating
+const int PUMP_WARMUP_PACKETS = 10;
+
+// Default worker count: hardware threads, at most this many
+const unsigned DEFAULT_MAX_WORKERS = 4;
+
+const uint16_t OUTPUT_BITS = 16;
+const double TONE_FREQUENCY = 1000.0;
+const double TONE_LEVEL_DB = -12.0;
+
+enum Mode { Threads, Coroutines };
+
+struct Options
+{
+    uint32_t sinks = 16;
+    double seconds = 10.0;
+    bool threads = true;
+    bool coroutines = true;
+    unsigned workers = 0;
+    uint32_t sampleRate = 48000;
+    uint32_t channels = 2;
+    uint32_t packetMs = 10;
+    std::string outDir;
+};
+
+// Counts and checksums what a sink writes, forwarding to its file if any
+class SinkOutput : public ByteOutput
+{
+public:
+    void SetFile(FILE* file) { m_file.SetFile(file); m_hasFile = file != nullptr; }
+
+    int64_t WriteGather(const IoSpan* spans, size_t count) override
+    {
+        int64_t written = 0;
+        if (m_hasFile) {
+            written = m_file.WriteGather(spans, count);
+        } else {
+            for (size_t i = 0; i < count; i++) written += (int64_t)spans[i].size;
+        }
+
+        uint64_t remaining = written > 0 ? (uint64_t)written : 0;
+        for (size_t i = 0; i < count && remaining > 0; i++) {
+            size_t part = spans[i].size < remaining ? spans[i].size : (size_t)remaining;
+            m_crc = Crc32c(m_crc, spans[i].data, part);
+            remaining -= part;
+        }
+        if (written > 0) m_bytes += (uint64_t)written;
+        return written;
+    }
+
+    uint32_t GetCrc() const { return m_crc; }
+    uint64_t GetBytes() const { return m_bytes; }
+
+private:
+    StdioOutput m_file;
+    bool m_hasFile = false;
+    uint32_t m_crc = 0;
+    uint64_t m_bytes = 0;
+};
+
+// Converted packet on its way to the writer stage
+struct OutputBlock
+{
+    uint8_t* block = nullptr;
+    uint32_t size = 0;
+};
+
+struct Sink
+{
+    // DSP stage
+    DspChain chain;
+    Requantizer requantizer;
+    std::vector<float> processed;
+
+    // Writer stage
+    BlockPool outputPool;
+    SinkOutput output;
+    FILE* file = nullptr;
+    uint8_t header[WAVE_HEADER_SIZE] = {};
+
+    // Threads: packet queue to the consumer thread, BatchedWriter
+    std::vector<uint8_t*> queue;
+    size_t queueMask = 0;
+    std::atomic<size_t> head{ 0 };
+    std::atomic<size_t> tail{ 0 };
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool stop = false;
+    std::unique_ptr<std::thread> consumer;
+    BatchedWriter writer;
+
+    // Coroutines: packet and block queues between the stages
+    std::unique_ptr<CoroQueue<uint8_t*>> input;
+    std::unique_ptr<CoroQueue<OutputBlock>> blocks;
+
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> writeErrors{ 0 };
+};
+
+struct Usage
+{
+    double cpuSeconds = 0.0;
+    int64_t voluntarySwitches = -1;     // -1 where the platform does not count them
+    int64_t involuntarySwitches = -1;
+};
+
+struct RunResult
+{
+    unsigned threads = 0;               // Whole process, mid-run; 0 if unknown
+    Usage usage;
+    double seconds = 0.0;
+    uint64_t packets = 0;
+    uint64_t dropped = 0;
+    uint64_t writeErrors = 0;
+    uint64_t bytes = 0;
+    std::vector<uint32_t> crcs;
+    std::vector<bool> complete;         // Sink lost nothing, its CRC is comparable
+};
+
+class Run
+{
+public:
+    Run(const Options& options, Mode mode) : m_options(options), m_mode(mode) {}
+
+    bool Execute(RunResult& result);
+
+private:
+    bool Prepare();
+    void PumpThread();
+    bool Push(Sink& sink, uint8_t* packet);
+    bool Process(Sink& sink, const uint8_t* packet, OutputBlock& out);
+    void ConsumerLoop(Sink& sink);
+    CoroTask DspStage(Sink& sink);
+    CoroTask WriterStage(Sink& sink);
+    void Finish(RunResult& result);
+
+    const Options& m_options;
+    Mode m_mode;
+    uint32_t m_packetFrames = 0;
+    uint64_t m_packetCount = 0;
+    BlockPool m_inputPool;
+    std::vector<std::unique_ptr<Sink>> m_sinks;
+    std::unique_ptr<CoroScheduler> m_scheduler;
+    std::atomic<uint64_t> m_packets{ 0 };
+};
+
+#ifdef _WIN32
+double FileTimeSeconds(const FILETIME& time)
+{
+    return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) / 1e7;
+}
+#endif
+
+Usage GetUsage()
+{
+    Usage usage;
+#ifdef _WIN32
+    FILETIME creation, exitTime, kernel, user;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) {
+        usage.cpuSeconds = FileTimeSeconds(kernel) + FileTimeSeconds(user);
+    }
+#else
+    struct rusage self;
+    if (getrusage(RUSAGE_SELF, &self) == 0) {
+        usage.cpuSeconds = self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6 +
+                           self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6;
+        usage.voluntarySwitches = self.ru_nvcsw;
+        usage.involuntarySwitches = self.ru_nivcsw;
+    }
+#endif
+    return usage;
+}
+
+// Threads of this process, 0 if unknown
+unsigned GetProcessThreadCount()
+{
+#ifdef _WIN32
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) return 0;
+    unsigned count = 0;
+    THREADENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry)) {
+        if (entry.th32OwnerProcessID == GetCurrentProcessId()) count++;
+    }
+    CloseHandle(snapshot);
+    return count;
+#else
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status) return 0;
+    char line[256];
+    unsigned count = 0;
+    while (fgets(line, sizeof(line), status)) {
+        if (strncmp(line, "Threads:", 8) == 0) {
+            count = (unsigned)atoi(line + 8);
+            break;
+        }
+    }
+    fclose(status);
+    return count;
+#endif
+}
+
+bool Run::Prepare()
+{
+    const uint32_t channels = m_options.channels;
+    m_packetFrames = m_options.sampleRate * m_options.packetMs / 1000;
+    m_packetCount = (uint64_t)(m_options.seconds * 1000.0 / m_options.packetMs);
+    if (m_packetFrames == 0 || m_packetCount == 0) return false;
+
+    // Every packet is shared by all sinks
+    size_t packetBytes = (size_t)m_packetFrames * channels * sizeof(float);
+    if (!m_inputPool.Configure(packetBytes, INPUT_QUEUE_PACKETS + SPARE_INPUT_BLOCKS)) return false;
+
+    if (m_mode == Coroutines) {
+        unsigned workers = m_options.workers;
+        if (workers == 0) {
+            workers = std::thread::hardware_concurrency();
+            if (workers == 0 || workers > DEFAULT_MAX_WORKERS) workers = DEFAULT_MAX_WORKERS;
+        }
+        m_scheduler = std::make_unique<CoroScheduler>(workers);
+    }
+
+    size_t outputBytes = (size_t)m_packetFrames * channels * OUTPUT_BITS / 8;
+    for (uint32_t i = 0; i < m_options.sinks; i++) {
+        auto sink = std::make_unique<Sink>();
+        sink->chain.Add(std::make_unique<RecordingStages>());
+        sink->chain.Prepare(m_options.sampleRate, channels, m_packetFrames);
+        sink->processed.assign((size_t)m_packetFrames * channels, 0.0f);
+        if (!sink->requantizer.Configure(channels, OUTPUT_BITS) ||
+            !sink->outputPool.Configure(outputBytes, OUTPUT_POOL_BLOCKS)) {
+            return false;
+        }
+
+        if (!m_options.outDir.empty()) {
+            std::string path = m_options.outDir + "/sink_" + std::to_string(i + 1) + ".wav";
+            sink->file = fopen(path.c_str(), "wb");
+            if (!sink->file) {
+                fprintf(stderr, "Cannot create %s\n", path.c_str());
+                return false;
+            }
+            sink->output.SetFile(sink->file);
+        }
+        BuildWaveHeader(sink->header, m_options.sampleRate, (uint16_t)channels, OUTPUT_BITS, 0);
+
+        if (m_mode == Threads) {
+            size_t size = 1;
+            while (size < INPUT_QUEUE_PACKETS) size <<= 1;
+            sink->queue.assign(size, nullptr);
+            sink->queueMask = size - 1;
+            sink->writer.SetPreamble(sink->header, sizeof(sink->header));
+            sink->writer.SetQueueDepth(OUTPUT_QUEUE_BLOCKS);
+            sink->writer.SetPolicy(BatchedWriter::Block);
+            sink->writer.SetBatchInterval(WRITER_BATCH_MS);
+        } else {
+            sink->input = std::make_unique<CoroQueue<uint8_t*>>(*m_scheduler);
+            sink->input->Configure(INPUT_QUEUE_PACKETS);
+            sink->blocks = std::make_unique<CoroQueue<OutputBlock>>(*m_scheduler);
+            sink->blocks->Configure(OUTPUT_QUEUE_BLOCKS);
+        }
+        m_sinks.push_back(std::move(sink));
+    }
+    return true;
+}
+
+// Recording chain and requantization of one packet into an output block
+bool Run::Process(Sink& sink, const uint8_t* packet, OutputBlock& out)
+{
+    out.block = sink.outputPool.Acquire();
+    if (!out.block) {
+        sink.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    sink.chain.ProcessF32((const float*)packet, sink.processed.data(), m_packetFrames);
+    sink.requantizer.Process(sink.processed.data(), m_packetFrames, out.block);
+    out.size = (uint32_t)(m_packetFrames * sink.requantizer.GetOutputBlockAlign());
+    return true;
+}
+
+// Hand a packet to a sink without waiting for it; false if it lags behind
+bool Run::Push(Sink& sink, uint8_t* packet)
+{
+    if (m_mode == Coroutines) {
+        return sink.input->TryPush(packet);
+    }
+
+    size_t tail = sink.tail.load(std::memory_order_relaxed);
+    if (tail - sink.head.load(std::memory_order_acquire) >= INPUT_QUEUE_PACKETS) return false;
+    sink.queue[tail & sink.queueMask] = packet;
+    {
+        // Publishing under the mutex keeps the consumer from missing the wake-up
+        std::lock_guard<std::mutex> lock(sink.wakeMutex);
+        sink.tail.store(tail + 1, std::memory_order_release);
+    }
+    sink.wake.notify_one();
+    return true;
+}
+
+void Run::PumpThread()
+{
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Capture);
+
+    SyntheticSource source(m_options.sampleRate, m_options.channels);
+    source.AddSine(TONE_FREQUENCY, TONE_LEVEL_DB, 1.0);
+    source.SetLooping(true);
+
+    const auto period = std::chrono::nanoseconds((int64_t)m_packetFrames * 1000000000 / m_options.sampleRate);
+    auto next = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < m_packetCount; i++) {
+        uint8_t* packet = m_inputPool.Acquire();
+        if (packet) {
+            source.Read((float*)packet, m_packetFrames);
+            for (const std::unique_ptr<Sink>& sink : m_sinks) {
+                m_inputPool.AddRef(packet);
+                if (!Push(*sink, packet)) {
+                    sink->dropped.fetch_add(1, std::memory_order_relaxed);
+                    m_inputPool.Release(packet);
+                }
+            }
+            m_inputPool.Release(packet);
+        } else {
+            for (const std::unique_ptr<Sink>& sink : m_sinks) {
+                sink->dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        m_packets.fetch_add(1, std::memory_order_relaxed);
+
+        // Past warm-up the pump must not touch the heap
+        if (i + 1 == PUMP_WARMUP_PACKETS) {
+            AllocTracker::ArmCurrentThread("sink pump");
+        }
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+
+    AllocTracker::DisarmCurrentThread();
+    ThreadScheduling::RestoreCurrentThread(scheduling);
+}
+
+// Thread per stage: the consumer runs the DSP stage and queues the blocks
+// to the sink's BatchedWriter
+void Run::ConsumerLoop(Sink& sink)
+{
+    ThreadScheduling::Applied scheduling = ThreadScheduling::ApplyToCurrentThread(ThreadScheduling::Writer);
+
+    for (;;) {
+        size_t head = sink.head.load(std::memory_order_relaxed);
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(sink.wakeMutex);
+            sink.wake.wait_for(lock, std::chrono::milliseconds(CONSUMER_WAIT_MS), [&sink, head]() {
+                return sink.stop || sink.tail.load(std::memory_order_acquire) != head;
+            });
+            stop = sink.stop;
+        }
+
+        size_t tail = sink.tail.load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            uint8_t* packet = sink.queue[head & sink.queueMask];
+            OutputBlock out;
+            if (Process(sink, packet, out) && !sink.writer.Submit(out.block, 0, out.size)) {
+                sink.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            m_inputPool.Release(packet);
+            sink.head.store(head + 1, std::memory_order_release);
+        }
+        if (stop && tail == sink.tail.load(std::memory_order_acquire)) break;
+    }
+
+    ThreadScheduling::RestoreCurrentThread(scheduling);
+}
+
+// Coroutines: the DSP stage waits for packets and hands the blocks on,
+// waiting while the writer stage is full
+CoroTask Run::DspStage(Sink& sink)
+{
+    uint8_t* packet = nullptr;
+    while (co_await sink.input->Pop(packet)) {
+        OutputBlock out;
+        if (Process(sink, packet, out) && !co_await sink.blocks->Push(out)) {
+            sink.dropped.fetch_add(1, std::memory_order_relaxed);
+            sink.outputPool.Release(out.block);
+        }
+        m_inputPool.Release(packet);
+    }
+    sink.blocks->Close();
+}
+
+// Writes what has queued up as one vectored write on the I/O thread, then
+// lets the next batch collect
+CoroTask Run::WriterStage(Sink& sink)
+{
+    IoSpan spans[WRITER_MAX_SPANS];
+    OutputBlock entries[WRITER_MAX_SPANS];
+
+    spans[0] = { sink.header, sizeof(sink.header) };
+    if (co_await m_scheduler->Write(sink.output, spans, 1) != (int64_t)sizeof(sink.header)) {
+        sink.writeErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    while (co_await sink.blocks->Pop(entries[0])) {
+        size_t count = 1;
+        while (count < WRITER_MAX_SPANS && sink.blocks->TryPop(entries[count])) count++;
+
+        int64_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            spans[i] = { entries[i].block, entries[i].size };
+            total += entries[i].size;
+        }
+        if (co_await m_scheduler->Write(sink.output, spans, count) != total) {
+            sink.writeErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < count; i++) {
+            sink.outputPool.Release(entries[i].block);
+        }
+        co_await m_scheduler->Sleep(WRITER_BATCH_MS);
+    }
+}
+
+bool Run::Execute(RunResult& result)
+{
+    Usage before = GetUsage();
+    auto start = std::chrono::steady_clock::now();
+    if (!Prepare()) return false;
+
+    for (const std::unique_ptr<Sink>& sink : m_sinks) {
+        if (m_mode == Threads) {
+            if (!sink->writer.Start(&sink->output, &sink->outputPool, "sink writer")) return false;
+            sink->consumer = std::make_unique<std::thread>(&Run::ConsumerLoop, this, std::ref(*sink));
+        } else {
+            m_scheduler->Spawn(DspStage(*sink));
+            m_scheduler->Spawn(WriterStage(*sink));
+        }
+    }
+    std::thread pump(&Run::PumpThread, this);
+
+    // Every thread of the mode is up by half time
+    std::this_thread::sleep_for(std::chrono::duration<double>(m_options.seconds / 2));
+    result.threads = GetProcessThreadCount();
+    pump.join();
+
+    // Drain the stages and finalize the files
+    for (const std::unique_ptr<Sink>& sink : m_sinks) {
+        if (m_mode == Threads) {
+            {
+                std::lock_guard<std::mutex> lock(sink->wakeMutex);
+                sink->stop = true;
+            }
+            sink->wake.notify_one();
+            sink->consumer->join();
+            sink->writer.Stop();
+        } else {
+            sink->input->Close();
+        }
+    }
+    if (m_scheduler) {
+        m_scheduler->Wait();
+        m_scheduler.reset();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Usage after = GetUsage();
+    result.usage.cpuSeconds = after.cpuSeconds - before.cpuSeconds;
+    if (after.voluntarySwitches >= 0) {
+        result.usage.voluntarySwitches = after.voluntarySwitches - before.voluntarySwitches;
+        result.usage.involuntarySwitches = after.involuntarySwitches - before.involuntarySwitches;
+    }
+    Finish(result);
+    return true;
+}
+
+void Run::Finish(RunResult& result)
+{
+    result.packets = m_packets.load();
+    for (const std::unique_ptr<Sink>& sink : m_sinks) {
+        uint64_t dropped = sink->dropped.load();
+        uint64_t writeErrors = sink->writeErrors.load() +
+            (m_mode == Threads ? sink->writer.GetStats().blocksDropped.load() : 0);
+        result.dropped += dropped;
+        result.writeErrors += writeErrors;
+        result.bytes += sink->output.GetBytes();
+        result.crcs.push_back(sink->output.GetCrc());
+        result.complete.push_back(dropped == 0 && writeErrors == 0);
+
+        if (sink->file) {
+            uint32_t dataBytes = (uint32_t)(sink->output.GetBytes() - WAVE_HEADER_SIZE);
+            BuildWaveHeader(sink->header, m_options.sampleRate, (uint16_t)m_options.channels, OUTPUT_BITS, dataBytes);
+            fseek(sink->file, 0, SEEK_SET);
+            fwrite(sink->header, 1, sizeof(sink->header), sink->file);
+            fclose(sink->file);
+            sink->file = nullptr;
+        }
+    }
+}
+
+void PrintResult(const char* name, const RunResult& result)
+{
+    char threads[32] = "n/a";
+    if (result.threads > 0) snprintf(threads, sizeof(threads), "%u", result.threads);
+    char switches[64] = "n/a";
+    if (result.usage.voluntarySwitches >= 0) {
+        snprintf(switches, sizeof(switches), "%lld (%lld involuntary)",
+            (long long)(result.usage.voluntarySwitches + result.usage.involuntarySwitches),
+            (long long)result.usage.involuntarySwitches);
+    }
+    printf("%-10s threads %s, context switches %s, CPU %.3f s (%.2f%% of a core), "
+        "%llu packets, %llu dropped, %llu write errors, %.1f MB\n",
+        name, threads, switches, result.usage.cpuSeconds,
+        result.seconds > 0.0 ? 100.0 * result.usage.cpuSeconds / result.seconds : 0.0,
+        (unsigned long long)result.packets, (unsigned long long)result.dropped,
+        (unsigned long long)result.writeErrors, result.bytes / 1048576.0);
+}
+
+// Debug builds: heap allocations made by warmed-up pipeline threads fail the
+// check. Returns false (after printing them) if there were any.
+bool CheckRealtimeAllocations()
+{
+    if (AllocTracker::GetViolationCount() == 0) return true;
+    printf("Heap allocations after warm-up: %llu, the last %zu bytes on the %s thread\n",
+        (unsigned long long)AllocTracker::GetViolationCount(), AllocTracker::GetLastViolationSize(),
+        AllocTracker::GetLastViolationThread());
+    return false;
+}
+
+int RunModes(const Options& options)
+{
+    printf("%u sinks, %.1f s of %u Hz x %u channels in %u ms packets\n", options.sinks, options.seconds,
+        options.sampleRate, options.channels, options.packetMs);
+
+    RunResult threads;
+    RunResult coroutines;
+    if (options.threads) {
+        Run run(options, Threads);
+        if (!run.Execute(threads)) {
+            fprintf(stderr, "Cannot set up the sinks\n");
+            return 1;
+        }
+        PrintResult("threads", threads);
+    }
+    if (options.coroutines) {
+        Run run(options, Coroutines);
+        if (!run.Execute(coroutines)) {
+            fprintf(stderr, "Cannot set up the sinks\n");
+            return 1;
+        }
+        PrintResult("coroutines", coroutines);
+    }
+
+    bool ok = (!options.threads || threads.dropped + threads.writeErrors == 0) &&
+              (!options.coroutines || coroutines.dropped + coroutines.writeErrors == 0);
+    if (options.threads && options.coroutines) {
+        // Same input, same stages: the sinks must write the same bytes
+        size_t mismatches = 0;
+        for (size_t i = 0; i < threads.crcs.size(); i++) {
+            if (threads.complete[i] && coroutines.complete[i] && threads.crcs[i] != coroutines.crcs[i]) {
+                mismatches++;
+            }
+        }
+        ok = ok && mismatches == 0;
+
+        auto ratio = [](double a, double b) { return b > 0.0 ? a / b : 0.0; };
+        printf("coroutines / threads: threads %.2fx, context switches %.2fx, CPU %.2fx; outputs %s\n",
+            ratio(coroutines.threads, threads.threads),
+            ratio((double)(coroutines.usage.voluntarySwitches + coroutines.usage.involuntarySwitches),
+                  (double)(threads.usage.voluntarySwitches + threads.usage.involuntarySwitches)),
+            ratio(coroutines.usage.cpuSeconds, threads.usage.cpuSeconds),
+            mismatches == 0 ? "identical" : "DIFFER");
+    }
+    ok = CheckRealtimeAllocations() && ok;
+    return ok ? 0 : 1;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--sinks=", 8) == 0) {
+            options.sinks = (uint32_t)atoi(arg + 8);
+        } else if (strncmp(arg, "--seconds=", 10) == 0) {
+            options.seconds = atof(arg + 10);
+        } else if (strncmp(arg, "--mode=", 7) == 0) {
+            options.threads = strcmp(arg + 7, "threads") == 0 || strcmp(arg + 7, "both") == 0;
+            options.coroutines = strcmp(arg + 7, "coroutines") == 0 || strcmp(arg + 7, "both") == 0;
+        } else if (strncmp(arg, "--workers=", 10) == 0) {
+            options.workers = (unsigned)atoi(arg + 10);
+        } else if (strncmp(arg, "--rate=", 7) == 0) {
+            options.sampleRate = (uint32_t)atoi(arg + 7);
+        } else if (strncmp(arg, "--channels=", 11) == 0) {
+            options.channels = (uint32_t)atoi(arg + 11);
+        } else if (strncmp(arg, "--packet-ms=", 12) == 0) {
+            options.packetMs = (uint32_t)atoi(arg + 12);
+        } else if (strncmp(arg, "--out=", 6) == 0) {
+            options.outDir = arg + 6;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        }
+    }
+
+    if (options.sinks == 0 || options.seconds <= 0.0 || (!options.threads && !options.coroutines) ||
+        options.sampleRate == 0 || options.channels == 0 || options.packetMs == 0) {
+        fprintf(stderr, "Usage: AudioSinks [--sinks=N] [--seconds=N] [--mode=threads|coroutines|both]\n"
+            "                  [--workers=N] [--rate=HZ] [--channels=N] [--packet-ms=N] [--out=DIR]\n");
+        return 2;
+    }
+
+    return RunModes(options);
+}
@@ -0,0 +1,967 @@
+// AudioSoak: accelerated-time soak test of the recording path.
+//
+//   AudioSoak [--days=N] [--speed=X] [--rotate-minutes=N] [--switch-hours=N]
+//             [--fault-minutes=N] [--sample-minutes=N] [--warmup-hours=N]
+//             [--dir=DIR] [--keep-audio] [--csv=FILE.csv]
+//
+// Drives the pipeline the capture thread runs (device pump with watchdog and
+// re-acquisition, recording DSP, file writer with peak and event sidecars,
+// loudness meter, waveform ring and history with a viewer thread reading
+// them) from a simulated device on a virtual clock, so days of audio pass in
+// minutes. --speed=X paces the clock to X times real time (default: as fast
+// as possible). The device switches format every --switch-hours, the file is
+// rotated every --rotate-minutes (0: only on switches), and the device is
+// alternately lost and stalled every --fault-minutes. Without --keep-audio
+// the WAV data is only counted; sidecars always go to DIR, and only the last
+// two files' worth are kept.
+//
+// Every --sample-minutes of simulated time it records resident memory,
+// open handles, threads, writer queue and pool use, packet processing time
+// percentiles and the cumulative counters (printed, and appended to the CSV).
+// The exit code is 1 if a cumulative counter goes backwards, a file does not
+// hold exactly the frames its timeline placed or spans a different time, a
+// header size is wrong, or after warm-up any resource, queue or p99 latency
+// trends upwards (median of the last third of the samples over the first).
+
+#include "alloc_tracker.h"
+#include "batched_writer.h"
+#include "device_watchdog.h"
+#include "event_index.h"
+#include "loudness_meter.h"
+#include "peak_file.h"
+#include "recording_pipeline.h"
+#include "sample_kernels.h"
+#include "stream_output.h"
+#include "synthetic_device.h"
+#include "wave_format.h"
+#include "waveform_history.h"
+#include "waveform_ring.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Virtual time per pump iteration, as AudioSession's device poll
+const int64_t POLL_US = 10000;
+
+// Recording setup of the live capture: 10 ms packets, 16-bit files
+const uint32_t PACKET_MS = 10;
+const uint16_t OUTPUT_BITS = 16;
+const size_t POOL_BLOCKS = 40;
+const size_t QUEUE_BLOCKS = 32;
+const uint32_t WRITER_BATCH_MS = 50;
+const uint32_t MAX_GAP_SECONDS = 10;
+const size_t MAX_GAPS = 10000;
+
+// Meters sized like AudioCapture's
+const size_t WAVEFORM_FRAMES = 48000;
+const size_t MAX_CHANNELS = 8;
+const uint32_t HISTORY_SECONDS = 24 * 3600;
+const size_t HISTORY_BUDGET_BYTES = 64 * 1024 * 1024;
+
+// The viewer reads the meters about as often as the UI redraws
+const uint32_t VIEWER_INTERVAL_MS = 33;
+const size_t VIEWER_FRAMES = 2048;
+const size_t VIEWER_PIXELS = 1000;
+
+// Faults alternate between these; both stay below MAX_GAP_SECONDS so the
+// outage is filled with silence
+const double LOST_SECONDS = 3.0;
+const double STALL_SECONDS = 5.0;
+
+// Pump packets of a file before it must stop allocating
+const int PUMP_WARMUP_PACKETS = 10;
+
+// Packet processing time histogram: 1 us buckets, the last one open-ended
+const size_t LATENCY_BUCKETS = 10000;
+
+// Samples after warm-up needed for a trend verdict
+const size_t MIN_TREND_SAMPLES = 6;
+
+// Allowed growth of the last third's median over the first third's
+const double RSS_SLACK_BYTES = 2.0 * 1024 * 1024;
+const double RSS_SLACK_RATIO = 0.02;
+const double QUEUE_SLACK_BLOCKS = 2.0;
+const double LATENCY_SLACK_US = 20.0;
+const double LATENCY_SLACK_RATIO = 0.5;
+
+// Files of the recording kept on disk (older ones are deleted)
+const uint64_t KEEP_FILES = 2;
+
+struct DeviceFormat
+{
+    const char* name;
+    uint32_t sampleRate;
+    uint32_t channels;
+    bool microphone;   // Gets the noise suppressor
+};
+
+// Cycled through on every switch
+const DeviceFormat DEVICE_FORMATS[] = {
+    { "48 kHz stereo loopback", 48000, 2, false },
+    { "44.1 kHz stereo loopback", 44100, 2, false },
+    { "48 kHz mono microphone", 48000, 1, true },
+    { "16 kHz mono microphone", 16000, 1, true },
+};
+const size_t DEVICE_FORMAT_COUNT = sizeof(DEVICE_FORMATS) / sizeof(DEVICE_FORMATS[0]);
+
+struct Options
+{
+    double days = 14.0;
+    double speed = 0.0;           // 0 = as fast as possible
+    double rotateMinutes = 60.0;
+    double switchHours = 6.0;
+    double faultMinutes = 20.0;
+    double sampleMinutes = 60.0;
+    double warmupHours = 24.0;    // The history budget is fully in use after its span
+    std::string dir = ".";
+    bool keepAudio = false;
+    std::string csvPath;
+};
+
+// Counts what the file writer writes, forwarding to the WAV if it is kept
+class CountingOutput : public ByteOutput
+{
+public:
+    void SetFile(FILE* file) { m_file.SetFile(file); m_hasFile = file != nullptr; }
+
+    int64_t WriteGather(const IoSpan* spans, size_t count) override
+    {
+        if (m_hasFile) return m_file.WriteGather(spans, count);
+        int64_t total = 0;
+        for (size_t i = 0; i < count; i++) total += (int64_t)spans[i].size;
+        return total;
+    }
+
+private:
+    StdioOutput m_file;
+    bool m_hasFile = false;
+};
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : m_counts(LATENCY_BUCKETS, 0) {}
+
+    void Add(uint64_t ns)
+    {
+        uint64_t us = ns / 1000;
+        m_counts[us < LATENCY_BUCKETS - 1 ? (size_t)us : LATENCY_BUCKETS - 1]++;
+        m_total++;
+        if (ns > m_maxNs) m_maxNs = ns;
+    }
+
+    // Upper bound of the bucket holding the percentile, in microseconds
+    double GetPercentile(double percent) const
+    {
+        if (m_total == 0) return 0.0;
+        uint64_t rank = (uint64_t)(percent / 100.0 * (double)(m_total - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            seen += m_counts[i];
+            if (seen > rank) return (double)(i + 1);
+        }
+        return (double)LATENCY_BUCKETS;
+    }
+
+    double GetMaxUs() const { return m_maxNs / 1000.0; }
+
+    void Clear()
+    {
+        std::fill(m_counts.begin(), m_counts.end(), 0);
+        m_total = 0;
+        m_maxNs = 0;
+    }
+
+private:
+    std::vector<uint64_t> m_counts;
+    uint64_t m_total = 0;
+    uint64_t m_maxNs = 0;
+};
+
+struct Sample
+{
+    double hours = 0.0;
+    double rssBytes = 0.0;
+    double handles = 0.0;
+    double threads = 0.0;
+    double queueMax = 0.0;      // Writer queue, blocks
+    double poolMax = 0.0;       // Pool blocks in use
+    double p50Us = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+    size_t format = 0;          // Index into DEVICE_FORMATS
+
+    // Cumulative
+    uint64_t deviceFrames = 0;
+    uint64_t recordedFrames = 0;
+    uint64_t losses = 0;
+    uint64_t recoveries = 0;
+    uint64_t gaps = 0;
+    uint64_t events = 0;
+    uint64_t lostPackets = 0;
+    uint64_t droppedBlocks = 0;
+    uint64_t files = 0;
+};
+
+// Resident memory of this process, 0 if unknown
+double GetResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0.0;
+    return (double)counters.WorkingSetSize;
+#else
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0.0;
+    unsigned long long size = 0, resident = 0;
+    int fields = fscanf(statm, "%llu %llu", &size, &resident);
+    fclose(statm);
+    return fields == 2 ? (double)resident * (double)sysconf(_SC_PAGESIZE) : 0.0;
+#endif
+}
+
+// Open handles (Windows) or file descriptors of this process, 0 if unknown
+unsigned GetHandleCount()
+{
+#ifdef _WIN32
+    DWORD count = 0;
+    return GetProcessHandleCount(GetCurrentProcess(), &count) ? (unsigned)count : 0;
+#else
+    DIR* fds = opendir("/proc/self/fd");
+    if (!fds) return 0;
+    unsigned count = 0;
+    while (struct dirent* entry = readdir(fds)) {
+        if (entry->d_name[0] != '.') count++;
+    }
+    closedir(fds);
+    return count > 0 ? count - 1 : 0;   // Without the one being listed
+#endif
+}
+
+// Threads of this process, 0 if unknown
+unsigned GetProcessThreadCount()
+{
+#ifdef _WIN32
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) return 0;
+    unsigned count = 0;
+    THREADENTRY32 entry;
+    entry.dwSize = sizeof(entry);
+    for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry)) {
+        if (entry.th32OwnerProcessID == GetCurrentProcessId()) count++;
+    }
+    CloseHandle(snapshot);
+    return count;
+#else
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status) return 0;
+    char line[256];
+    unsigned count = 0;
+    while (fgets(line, sizeof(line), status)) {
+        if (strncmp(line, "Threads:", 8) == 0) {
+            count = (unsigned)atoi(line + 8);
+            break;
+        }
+    }
+    fclose(status);
+    return count;
+#endif
+}
+
+double Median(std::vector<double> values)
+{
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : 0.5 * (values[middle - 1] + values[middle]);
+}
+
+class SoakRun
+{
+public:
+    explicit SoakRun(const Options& options) : m_options(options) {}
+
+    int Run();
+
+private:
+    void StartDevice(int64_t nowUs);
+    bool StartFile();
+    void FinishFile();
+    void Poll(int64_t nowUs);
+    void OnPacket(const PacketInfo& packet);
+    void TakeSample(int64_t nowUs);
+    void CheckCounters(const Sample& previous, const Sample& sample);
+    void CheckTrends();
+    void ViewerThread();
+    std::string GetFilePath(uint64_t index, const char* suffix) const;
+    void Fail(const char* message);
+
+    Options m_options;
+    bool m_failed = false;
+
+    // Device
+    size_t m_formatIndex = 0;
+    DeviceFormat m_format = DEVICE_FORMATS[0];
+    uint32_t m_packetFrames = 0;
+    std::unique_ptr<SyntheticDevice> m_device;
+    DeviceWatchdog m_watchdog;
+    bool m_reacquired = false;
+    std::vector<float> m_packet;
+    std::vector<float> m_planarBuffer;
+    std::vector<float*> m_planes;
+    const PacketKernels* m_kernels = nullptr;
+
+    // Recording
+    RecordingPipeline m_pipeline;
+    BatchedWriter m_writer;
+    CountingOutput m_output;
+    PeakOutput m_peakOutput;
+    EventOutput m_eventOutput;
+    PeakFileWriter m_peaks;
+    EventIndexWriter m_events;
+    FILE* m_wavFile = nullptr;
+    uint64_t m_fileIndex = 0;
+    uint64_t m_filePackets = 0;
+    uint64_t m_fileEndTimestamp = 0;   // End of the file's last packet, 100 ns units
+    bool m_recording = false;
+
+    // Meters and their reader
+    LoudnessMeter m_loudness;
+    WaveformRing m_waveform{ MAX_CHANNELS, WAVEFORM_FRAMES };
+    WaveformHistory m_history{ MAX_CHANNELS, HISTORY_BUDGET_BYTES };
+    std::mutex m_viewMutex;   // Held by the pump while it writes or resets the meters
+    std::atomic<bool> m_stopping{ false };
+    std::atomic<uint64_t> m_views{ 0 };      // Consistent reads of both meters
+
+    // Cumulative counters
+    uint64_t m_deviceFrames = 0;
+    std::atomic<uint64_t> m_meteredFrames{ 0 };
+    uint64_t m_recordedFrames = 0;       // Finished files
+    uint64_t m_gaps = 0;                 // Finished files
+    uint64_t m_eventCount = 0;           // Finished files
+    uint64_t m_lostPackets = 0;          // Finished files
+    uint64_t m_droppedBlocks = 0;        // Finished files
+    uint64_t m_largeFiles = 0;           // Past 4 GiB, with open-ended sizes
+
+    // Sampling
+    LatencyHistogram m_latency;
+    size_t m_queueMax = 0;
+    size_t m_poolMax = 0;
+    std::vector<Sample> m_samples;
+    FILE* m_csv = nullptr;
+};
+
+std::string SoakRun::GetFilePath(uint64_t index, const char* suffix) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/soak_%llu.wav%s", (unsigned long long)index, suffix);
+    return m_options.dir + name;
+}
+
+void SoakRun::Fail(const char* message)
+{
+    printf("FAIL: %s\n", message);
+    m_failed = true;
+}
+
+void SoakRun::StartDevice(int64_t nowUs)
+{
+    m_format = DEVICE_FORMATS[m_formatIndex % DEVICE_FORMAT_COUNT];
+    m_formatIndex++;
+    m_packetFrames = m_format.sampleRate * PACKET_MS / 1000;
+
+    // Tone, room noise and pauses, so the detectors and the suppressor have work
+    m_device = std::make_unique<SyntheticDevice>(m_format.sampleRate, m_format.channels, m_packetFrames);
+    SyntheticSource& source = m_device->GetSource();
+    source.AddSine(440.0, -18.0, 20.0);
+    source.AddNoise(-45.0, 10.0);
+    source.AddSilence(2.0);
+
+    // Faults of this device's lifetime, alternating lost and stalled
+    double lifetime = m_options.switchHours > 0.0 ? m_options.switchHours * 3600.0 : m_options.days * 86400.0;
+    if (m_options.faultMinutes > 0.0) {
+        bool lost = true;
+        for (double at = m_options.faultMinutes * 60.0; at < lifetime; at += m_options.faultMinutes * 60.0) {
+            SyntheticDevice::Fault fault;
+            fault.type = lost ? SyntheticDevice::Lost : SyntheticDevice::Stall;
+            fault.atSeconds = at;
+            fault.seconds = lost ? LOST_SECONDS : STALL_SECONDS;
+            m_device->AddFault(fault);
+            lost = !lost;
+        }
+    }
+
+    m_pipeline.Configure(m_format.sampleRate, (uint16_t)m_format.channels, SampleF32, OUTPUT_BITS,
+                         m_packetFrames, POOL_BLOCKS);
+    m_pipeline.GetNoiseSuppressor().SetEnabled(m_format.microphone);
+
+    m_packet.assign((size_t)m_packetFrames * m_format.channels, 0.0f);
+    m_planarBuffer.assign((size_t)m_packetFrames * m_format.channels, 0.0f);
+    m_planes.resize(m_format.channels);
+    for (uint32_t c = 0; c < m_format.channels; c++) {
+        m_planes[c] = m_planarBuffer.data() + (size_t)c * m_packetFrames;
+    }
+    m_kernels = GetPacketKernels(SampleF32, m_format.channels);
+
+    {
+        std::lock_guard<std::mutex> lock(m_viewMutex);
+        m_waveform.Reset(m_format.channels);
+        m_history.Reset(m_format.channels, m_format.sampleRate, HISTORY_SECONDS);
+        m_loudness.Configure(m_format.sampleRate, m_format.channels);
+    }
+
+    m_device->Start(nowUs);
+    m_watchdog.Start(nowUs);
+    m_reacquired = false;
+}
+
+bool SoakRun::StartFile()
+{
+    m_fileIndex++;
+    if (m_fileIndex > KEEP_FILES) {
+        uint64_t old = m_fileIndex - KEEP_FILES;
+        remove(GetFilePath(old, "").c_str());
+        remove(GetFilePath(old, ".peaks").c_str());
+        remove(GetFilePath(old, ".events").c_str());
+    }
+
+    m_wavFile = nullptr;
+    if (m_options.keepAudio) {
+        m_wavFile = fopen(GetFilePath(m_fileIndex, "").c_str(), "w+b");
+        if (!m_wavFile) return false;
+        uint8_t header[WAVE_HEADER_SIZE];
+        BuildWaveHeader(header, m_format.sampleRate, (uint16_t)m_format.channels, OUTPUT_BITS, 0);
+        fwrite(header, 1, sizeof(header), m_wavFile);
+    }
+    m_output.SetFile(m_wavFile);
+
+    // Sidecars on the writer thread, as in AudioCapture::StartRecording
+    bool sidecars = m_peaks.Open(fopen(GetFilePath(m_fileIndex, ".peaks").c_str(), "w+b"),
+                                 (uint16_t)m_format.channels, m_format.sampleRate) &&
+                    m_events.Open(fopen(GetFilePath(m_fileIndex, ".events").c_str(), "w+b"),
+                                  (uint16_t)m_format.channels, m_format.sampleRate, SampleS16);
+    m_peakOutput.SetOutput(&m_output, &m_peaks);
+    m_eventOutput.SetOutput(&m_peakOutput, &m_events);
+
+    m_writer.SetQueueDepth(QUEUE_BLOCKS);
+    // Paced, a full queue is handled as during capture; unpaced, the pump
+    // outruns any disk and waits for the writer instead
+    m_writer.SetPolicy(m_options.speed > 0.0 ? BatchedWriter::FillSilence : BatchedWriter::Block);
+    // Paced, the writer batches the same stretch of audio as in real time
+    uint32_t batchMs = WRITER_BATCH_MS;
+    if (m_options.speed > 1.0) {
+        batchMs = (uint32_t)(WRITER_BATCH_MS / m_options.speed);
+        if (batchMs < 1) batchMs = 1;
+    }
+    m_writer.SetBatchInterval(batchMs);
+    if (!sidecars || !m_writer.Start(&m_eventOutput, &m_pipeline.GetPool(), "soak writer")) {
+        m_peaks.Close();
+        m_events.Close();
+        if (m_wavFile) fclose(m_wavFile);
+        m_wavFile = nullptr;
+        return false;
+    }
+
+    m_pipeline.Begin(&m_writer, nullptr, MAX_GAP_SECONDS, MAX_GAPS);
+    m_filePackets = 0;
+    m_fileEndTimestamp = 0;
+    m_recording = true;
+    return true;
+}
+
+void SoakRun::FinishFile()
+{
+    if (!m_recording) return;
+    m_recording = false;
+    AllocTracker::DisarmCurrentThread();
+
+    m_pipeline.End();
+    m_writer.Stop();
+
+    const WriterStats& stats = m_writer.GetStats();
+    const PacketTimeline& timeline = m_pipeline.GetTimeline();
+    const uint64_t dataBytes = stats.bytesWritten.load();
+    const uint64_t frames = dataBytes / m_pipeline.GetBlockAlign();
+    const uint64_t lost = m_pipeline.GetLostPackets();
+    const uint64_t dropped = stats.blocksDropped.load();
+
+    m_peaks.Finish(dataBytes, dataBytes + WAVE_HEADER_SIZE);
+    m_events.Finish();
+
+    char message[256];
+    if (dataBytes % m_pipeline.GetBlockAlign() != 0) {
+        snprintf(message, sizeof(message), "file %llu: %llu bytes is not a whole number of frames",
+            (unsigned long long)m_fileIndex, (unsigned long long)dataBytes);
+        Fail(message);
+    }
+
+    // Lost packets and dropped blocks were written as silence, so the file
+    // holds exactly what the timeline placed, and the timeline spans the
+    // device time from the first packet to the last
+    if (timeline.HasStarted()) {
+        if (frames != timeline.GetOutputFrames()) {
+            snprintf(message, sizeof(message), "file %llu: %llu frames written, %llu placed",
+                (unsigned long long)m_fileIndex, (unsigned long long)frames,
+                (unsigned long long)timeline.GetOutputFrames());
+            Fail(message);
+        }
+        uint64_t elapsed = m_fileEndTimestamp - timeline.GetStartTimestamp();
+        uint64_t expected = elapsed / 10000000 * m_format.sampleRate +
+                            elapsed % 10000000 * m_format.sampleRate / 10000000;
+        uint64_t tolerance = 2 + 2 * timeline.GetGapCount();
+        uint64_t difference = frames > expected ? frames - expected : expected - frames;
+        if (difference > tolerance) {
+            snprintf(message, sizeof(message), "file %llu: %llu frames for %llu frames of device time",
+                (unsigned long long)m_fileIndex, (unsigned long long)frames, (unsigned long long)expected);
+            Fail(message);
+        }
+    }
+    if (m_peaks.GetFrames() != frames || m_events.GetDetector().GetFrames() != frames) {
+        snprintf(message, sizeof(message), "file %llu: sidecars cover %llu and %llu of %llu frames",
+            (unsigned long long)m_fileIndex, (unsigned long long)m_peaks.GetFrames(),
+            (unsigned long long)m_events.GetDetector().GetFrames(), (unsigned long long)frames);
+        Fail(message);
+    }
+
+    // The header must state the size, or leave it open past 4 GiB
+    uint8_t header[WAVE_HEADER_SIZE];
+    BuildWaveHeader(header, m_format.sampleRate, (uint16_t)m_format.channels, OUTPUT_BITS,
+        GetWaveDataSize(dataBytes, WAVE_HEADER_SIZE));
+    WaveInfo info;
+    bool large = dataBytes + WAVE_HEADER_SIZE - 8 >= WAVE_SIZE_UNKNOWN;
+    if (!ParseWaveHeader(header, sizeof(header), info) ||
+        info.dataSize != (large ? (uint64_t)WAVE_SIZE_UNKNOWN : dataBytes)) {
+        snprintf(message, sizeof(message), "file %llu: header does not describe %llu bytes",
+            (unsigned long long)m_fileIndex, (unsigned long long)dataBytes);
+        Fail(message);
+    }
+    if (large) m_largeFiles++;
+    if (m_wavFile) {
+        fseek(m_wavFile, 0, SEEK_SET);
+        fwrite(header, 1, sizeof(header), m_wavFile);
+        fclose(m_wavFile);
+        m_wavFile = nullptr;
+    }
+
+    m_recordedFrames += frames;
+    m_gaps += timeline.GetGapCount();
+    m_eventCount += m_events.GetDetector().GetTotalCount();
+    m_lostPackets += lost;
+    m_droppedBlocks += dropped;
+}
+
+void SoakRun::Poll(int64_t nowUs)
+{
+    // Same decisions as AudioSession::PumpSimulatedDevice
+    if (m_watchdog.IsLost()) {
+        if (m_watchdog.IsRetryDue(nowUs)) {
+            if (m_device->Reacquire(nowUs)) {
+                int64_t recoveryUs = m_watchdog.OnRecovered(nowUs);
+                m_history.AddSilence((size_t)(recoveryUs * m_format.sampleRate / 1000000));
+                m_reacquired = true;
+            } else {
+                m_watchdog.OnRetryFailed(nowUs);
+            }
+        }
+        return;
+    }
+
+    PacketInfo info;
+    SyntheticDevice::ReadResult result;
+    while ((result = m_device->Read(nowUs, m_packet.data(), info)) == SyntheticDevice::Packet) {
+        if (m_reacquired) {
+            info.flags |= PacketInfo::Reacquired;
+            m_reacquired = false;
+        }
+        m_watchdog.OnPacket(nowUs);
+        OnPacket(info);
+    }
+
+    if (result == SyntheticDevice::DeviceLost) {
+        m_watchdog.OnError(nowUs, true);
+    } else if (m_watchdog.IsStalled(nowUs)) {
+        m_watchdog.OnLost(nowUs, DeviceWatchdog::Stalled);
+    }
+}
+
+void SoakRun::OnPacket(const PacketInfo& packet)
+{
+    // Past warm-up the pump must not touch the heap
+    if (++m_filePackets == PUMP_WARMUP_PACKETS) {
+        AllocTracker::ArmCurrentThread("soak pump");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    m_pipeline.Record((const uint8_t*)m_packet.data(), packet);
+
+    // Meters as the capture thread feeds them
+    m_kernels->toPlanar((const uint8_t*)m_packet.data(), packet.frames, m_format.channels, m_planes.data());
+    m_history.AddPlanar(m_planes.data(), packet.frames);
+    {
+        std::lock_guard<std::mutex> lock(m_viewMutex);
+        m_waveform.WritePlanar(m_planes.data(), packet.frames);
+        m_meteredFrames.fetch_add(packet.frames, std::memory_order_relaxed);
+        m_loudness.Process(m_packet.data(), packet.frames);
+    }
+    m_latency.Add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    m_deviceFrames += packet.frames;
+    m_fileEndTimestamp = packet.timestamp + (uint64_t)packet.frames * 10000000 / m_format.sampleRate;
+    size_t queued = m_writer.GetQueuedBlocks();
+    if (queued > m_queueMax) m_queueMax = queued;
+    BlockPool& pool = m_pipeline.GetPool();
+    size_t inUse = pool.GetBlockCount() - pool.GetAvailableCount();
+    if (inUse > m_poolMax) m_poolMax = inUse;
+}
+
+void SoakRun::ViewerThread()
+{
+    std::vector<WaveformHistory::Summary> summaries(VIEWER_PIXELS);
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(VIEWER_INTERVAL_MS));
+
+        WaveformView view;
+        bool valid;
+        {
+            std::lock_guard<std::mutex> lock(m_viewMutex);
+            valid = m_waveform.Snapshot(0, VIEWER_FRAMES, view) && m_waveform.IsValid(view);
+        }
+        uint64_t end = m_history.GetFrameCount();
+        valid = m_history.GetSummaries(0, m_history.GetOldestFrame(), end, VIEWER_PIXELS, summaries.data()) && valid;
+        if (valid) m_views.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void SoakRun::TakeSample(int64_t nowUs)
+{
+    // Reporting allocates; the pump is armed again for the next packet
+    AllocTracker::DisarmCurrentThread();
+
+    Sample sample;
+    sample.hours = nowUs / 3.6e9;
+    sample.rssBytes = GetResidentBytes();
+    sample.handles = GetHandleCount();
+    sample.threads = GetProcessThreadCount();
+    sample.queueMax = (double)m_queueMax;
+    sample.poolMax = (double)m_poolMax;
+    sample.p50Us = m_latency.GetPercentile(50.0);
+    sample.p99Us = m_latency.GetPercentile(99.0);
+    sample.maxUs = m_latency.GetMaxUs();
+    sample.format = (m_formatIndex - 1) % DEVICE_FORMAT_COUNT;
+
+    // Counters of the file in progress count too
+    const WriterStats& stats = m_writer.GetStats();
+    const DeviceWatchdog::Telemetry& telemetry = m_watchdog.GetTelemetry();
+    sample.deviceFrames = m_deviceFrames;
+    sample.recordedFrames = m_recordedFrames + stats.bytesWritten.load() / m_pipeline.GetBlockAlign();
+    sample.losses = telemetry.losses.load();
+    sample.recoveries = telemetry.recoveries.load();
+    sample.gaps = m_gaps + m_pipeline.GetTimeline().GetGapCount();
+    sample.events = m_eventCount + m_events.GetDetector().GetTotalCount();
+    sample.lostPackets = m_lostPackets + m_pipeline.GetLostPackets();
+    sample.droppedBlocks = m_droppedBlocks + stats.blocksDropped.load();
+    sample.files = m_fileIndex;
+
+    if (m_meteredFrames.load(std::memory_order_relaxed) != m_deviceFrames) {
+        Fail("metered frame count differs from the frames the device delivered");
+    }
+    if (!m_samples.empty()) CheckCounters(m_samples.back(), sample);
+
+    printf("%8.1f h  RSS %7.1f MB  handles %3.0f  threads %2.0f  queue %2.0f  pool %2.0f  "
+        "p50/p99/max %4.0f/%4.0f/%6.0f us  files %llu  losses %llu  gaps %llu  events %llu\n",
+        sample.hours, sample.rssBytes / (1024.0 * 1024.0), sample.handles, sample.threads,
+        sample.queueMax, sample.poolMax, sample.p50Us, sample.p99Us, sample.maxUs,
+        (unsigned long long)sample.files, (unsigned long long)sample.losses,
+        (unsigned long long)sample.gaps, (unsigned long long)sample.events);
+    fflush(stdout);
+
+    if (m_csv) {
+        fprintf(m_csv, "%.3f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            sample.hours, sample.rssBytes, sample.handles, sample.threads, sample.queueMax, sample.poolMax,
+            sample.p50Us, sample.p99Us, sample.maxUs,
+            (unsigned long long)sample.deviceFrames, (unsigned long long)sample.recordedFrames,
+            (unsigned long long)sample.losses, (unsigned long long)sample.recoveries,
+            (unsigned long long)sample.gaps, (unsigned long long)sample.events,
+            (unsigned long long)sample.lostPackets, (unsigned long long)sample.droppedBlocks,
+            (unsigned long long)sample.files);
+        fflush(m_csv);
+    }
+
+    m_samples.push_back(sample);
+    m_latency.Clear();
+    m_queueMax = 0;
+    m_poolMax = 0;
+    if (m_recording && m_filePackets >= PUMP_WARMUP_PACKETS) {
+        AllocTracker::ArmCurrentThread("soak pump");
+    }
+}
+
+void SoakRun::CheckCounters(const Sample& previous, const Sample& sample)
+{
+    struct Counter { const char* name; uint64_t before; uint64_t after; };
+    const Counter counters[] = {
+        { "device frames", previous.deviceFrames, sample.deviceFrames },
+        { "recorded frames", previous.recordedFrames, sample.recordedFrames },
+        { "losses", previous.losses, sample.losses },
+        { "recoveries", previous.recoveries, sample.recoveries },
+        { "gaps", previous.gaps, sample.gaps },
+        { "events", previous.events, sample.events },
+        { "lost packets", previous.lostPackets, sample.lostPackets },
+        { "dropped blocks", previous.droppedBlocks, sample.droppedBlocks },
+    };
+    for (const Counter& counter : counters) {
+        if (counter.after < counter.before) {
+            char message[160];
+            snprintf(message, sizeof(message), "%s went from %llu back to %llu (wrapped?)", counter.name,
+                (unsigned long long)counter.before, (unsigned long long)counter.after);
+            Fail(message);
+        }
+    }
+}
+
+void SoakRun::CheckTrends()
+{
+    std::vector<const Sample*> steady;
+    for (const Sample& sample : m_samples) {
+        if (sample.hours >= m_options.warmupHours) steady.push_back(&sample);
+    }
+    if (steady.size() < MIN_TREND_SAMPLES) {
+        printf("Warning: %zu samples after warm-up, too few for trend checks (need %zu)\n",
+            steady.size(), MIN_TREND_SAMPLES);
+        return;
+    }
+
+    struct Metric
+    {
+        const char* name;
+        double Sample::* field;
+        double slack;
+        double slackRatio;
+        const char* unit;
+        double scale;
+        bool perFormat;    // Compared between samples of the same device format
+        bool pacedOnly;    // Unpaced, the pump outruns the writer and keeps the queue full
+    };
+    const Metric metrics[] = {
+        { "resident memory", &Sample::rssBytes, RSS_SLACK_BYTES, RSS_SLACK_RATIO, "MB", 1.0 / (1024.0 * 1024.0), false, false },
+        { "handles", &Sample::handles, 0.0, 0.0, "", 1.0, false, false },
+        { "threads", &Sample::threads, 0.0, 0.0, "", 1.0, false, false },
+        { "writer queue", &Sample::queueMax, QUEUE_SLACK_BLOCKS, 0.0, "blocks", 1.0, false, true },
+        { "pool use", &Sample::poolMax, QUEUE_SLACK_BLOCKS, 0.0, "blocks", 1.0, false, true },
+        { "p99 packet time", &Sample::p99Us, LATENCY_SLACK_US, LATENCY_SLACK_RATIO, "us", 1.0, true, false },
+    };
+
+    size_t third = steady.size() / 3;
+    for (const Metric& metric : metrics) {
+        if (metric.pacedOnly && m_options.speed <= 0.0) {
+            printf("  %-16s not judged without --speed\n", metric.name);
+            continue;
+        }
+
+        // Of the groups compared, the one that grew most is reported
+        double before = 0.0, after = 0.0;
+        bool compared = false, rising = false;
+        size_t groups = metric.perFormat ? DEVICE_FORMAT_COUNT : 1;
+        for (size_t group = 0; group < groups; group++) {
+            std::vector<double> first, last;
+            for (size_t i = 0; i < steady.size(); i++) {
+                if (metric.perFormat && steady[i]->format != group) continue;
+                if (i < third) first.push_back(steady[i]->*metric.field);
+                if (i >= steady.size() - third) last.push_back(steady[i]->*metric.field);
+            }
+            if (first.empty() || last.empty()) continue;
+
+            double groupBefore = Median(first);
+            double groupAfter = Median(last);
+            if (!compared || groupAfter - groupBefore > after - before) {
+                before = groupBefore;
+                after = groupAfter;
+            }
+            compared = true;
+            double allowance = groupBefore * metric.slackRatio > metric.slack ? groupBefore * metric.slackRatio : metric.slack;
+            rising = rising || groupAfter > groupBefore + allowance;
+        }
+        if (!compared) {
+            printf("  %-16s no format in both the first and the last third\n", metric.name);
+            continue;
+        }
+
+        printf("  %-16s %10.2f -> %10.2f %-6s %s\n", metric.name, before * metric.scale, after * metric.scale,
+            metric.unit, rising ? "RISING" : "flat");
+        if (rising) {
+            char message[128];
+            snprintf(message, sizeof(message), "%s trends upwards", metric.name);
+            Fail(message);
+        }
+    }
+}
+
+int SoakRun::Run()
+{
+    if (!m_options.csvPath.empty()) {
+        m_csv = fopen(m_options.csvPath.c_str(), "w");
+        if (!m_csv) {
+            fprintf(stderr, "%s: cannot create\n", m_options.csvPath.c_str());
+            return 2;
+        }
+        fprintf(m_csv, "hours,rss_bytes,handles,threads,queue_max,pool_max,p50_us,p99_us,max_us,device_frames,"
+            "recorded_frames,losses,recoveries,gaps,events,lost_packets,dropped_blocks,files\n");
+    }
+
+    RecordingStages& stages = m_pipeline.GetStages();
+    stages.Get<DcBlockerStage>().SetEnabled(true);
+    stages.Get<LimiterStage>().SetEnabled(true);
+
+    const int64_t endUs = (int64_t)(m_options.days * 86400.0 * 1e6);
+    const int64_t rotateUs = (int64_t)(m_options.rotateMinutes * 60.0 * 1e6);
+    const int64_t switchUs = (int64_t)(m_options.switchHours * 3600.0 * 1e6);
+    const int64_t sampleUs = (int64_t)(m_options.sampleMinutes * 60.0 * 1e6);
+
+    printf("Soak: %.1f days, %s, file every %.0f min, device switch every %.1f h, fault every %.0f min\n",
+        m_options.days, m_options.speed > 0.0 ? "paced" : "as fast as possible",
+        m_options.rotateMinutes, m_options.switchHours, m_options.faultMinutes);
+
+    std::thread viewer([this]() { ViewerThread(); });
+    const auto wallStart = std::chrono::steady_clock::now();
+
+    int64_t nowUs = 0;
+    StartDevice(nowUs);
+    bool started = StartFile();
+    int64_t nextRotation = rotateUs > 0 ? rotateUs : endUs;
+    int64_t nextSwitch = switchUs > 0 ? switchUs : endUs;
+    int64_t nextSample = sampleUs;
+
+    while (started && nowUs < endUs) {
+        nowUs += POLL_US;
+        Poll(nowUs);
+
+        // Before a switch, so the sample belongs to the device it measured
+        if (nowUs >= nextSample) {
+            TakeSample(nowUs);
+            nextSample += sampleUs;
+        }
+
+        if (nowUs >= nextSwitch) {
+            FinishFile();
+            printf("%8.1f h  switching to %s\n", nowUs / 3.6e9, DEVICE_FORMATS[m_formatIndex % DEVICE_FORMAT_COUNT].name);
+            StartDevice(nowUs);
+            started = StartFile();
+            nextSwitch += switchUs;
+            nextRotation = nowUs + (rotateUs > 0 ? rotateUs : endUs);
+        } else if (nowUs >= nextRotation) {
+            FinishFile();
+            started = StartFile();
+            nextRotation += rotateUs;
+        }
+
+        // Paced: wait for the wall clock to catch up
+        if (m_options.speed > 0.0) {
+            auto due = wallStart + std::chrono::microseconds((int64_t)(nowUs / m_options.speed));
+            std::this_thread::sleep_until(due);
+        }
+    }
+    FinishFile();
+
+    m_stopping = true;
+    viewer.join();
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    if (m_csv) fclose(m_csv);
+
+    if (!started) {
+        fprintf(stderr, "Cannot start file %llu in %s\n", (unsigned long long)m_fileIndex, m_options.dir.c_str());
+        return 2;
+    }
+
+    const DeviceWatchdog::Telemetry& telemetry = m_watchdog.GetTelemetry();
+    printf("\nSimulated %.1f h in %.1f s (%.0fx real time), %llu files (%llu past 4 GiB), %llu viewer reads\n",
+        nowUs / 3.6e9, wallSeconds, nowUs / 1e6 / wallSeconds, (unsigned long long)m_fileIndex,
+        (unsigned long long)m_largeFiles, (unsigned long long)m_views.load());
+    printf("Frames: %llu from the device, %llu recorded; %llu losses, %llu recoveries, %llu gaps, "
+        "%llu lost packets, %llu dropped blocks\n",
+        (unsigned long long)m_deviceFrames, (unsigned long long)m_recordedFrames,
+        (unsigned long long)telemetry.losses.load(), (unsigned long long)telemetry.recoveries.load(),
+        (unsigned long long)m_gaps, (unsigned long long)m_lostPackets, (unsigned long long)m_droppedBlocks);
+
+    if (telemetry.losses.load() > telemetry.recoveries.load() + (m_watchdog.IsLost() ? 1 : 0)) {
+        Fail("a device loss was not recovered");
+    }
+    if (AllocTracker::IsEnabled() && AllocTracker::GetViolationCount() > 0) {
+        char message[128];
+        snprintf(message, sizeof(message), "%llu allocations on the pump after warm-up",
+            (unsigned long long)AllocTracker::GetViolationCount());
+        Fail(message);
+    }
+
+    printf("Trends after %.0f h of warm-up (median of the first and the last third):\n", m_options.warmupHours);
+    CheckTrends();
+
+    printf(m_failed ? "FAILED\n" : "OK\n");
+    return m_failed ? 1 : 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--days=", 7) == 0) {
+            options.days = atof(arg + 7);
+        } else if (strncmp(arg, "--speed=", 8) == 0) {
+            options.speed = atof(arg + 8);
+        } else if (strncmp(arg, "--rotate-minutes=", 17) == 0) {
+            options.rotateMinutes = atof(arg + 17);
+        } else if (strncmp(arg, "--switch-hours=", 15) == 0) {
+            options.switchHours = atof(arg + 15);
+        } else if (strncmp(arg, "--fault-minutes=", 16) == 0) {
+            options.faultMinutes = atof(arg + 16);
+        } else if (strncmp(arg, "--sample-minutes=", 17) == 0) {
+            options.sampleMinutes = atof(arg + 17);
+        } else if (strncmp(arg, "--warmup-hours=", 15) == 0) {
+            options.warmupHours = atof(arg + 15);
+        } else if (strncmp(arg, "--dir=", 6) == 0) {
+            options.dir = arg + 6;
+        } else if (strcmp(arg, "--keep-audio") == 0) {
+            options.keepAudio = true;
+        } else if (strncmp(arg, "--csv=", 6) == 0) {
+            options.csvPath = arg + 6;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            return 2;
+        }
+    }
+
+    if (options.days <= 0.0 || options.speed < 0.0 || options.rotateMinutes < 0.0 || options.switchHours < 0.0 ||
+        options.faultMinutes < 0.0 || options.sampleMinutes <= 0.0 || options.warmupHours < 0.0 ||
+        options.dir.empty()) {
+        fprintf(stderr, "Usage: AudioSoak [--days=N] [--speed=X] [--rotate-minutes=N] [--switch-hours=N]\n"
+            "                 [--fault-minutes=N] [--sample-minutes=N] [--warmup-hours=N]\n"
+            "                 [--dir=DIR] [--keep-audio] [--csv=FILE.csv]\n");
+        return 2;
+    }
+
+    SoakRun run(options);
+    return run.Run();
+}
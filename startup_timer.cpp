@@ -0,0 +1,61 @@
+#include "startup_timer.h"
+#include <cstdio>
+
+StartupTimer::StartupTimer()
+    : m_origin(std::chrono::steady_clock::now())
+{
+    for (auto& mark : m_marks) mark.store(-1, std::memory_order_relaxed);
+}
+
+void StartupTimer::Mark(StartupPhase phase)
+{
+    if (phase < 0 || phase >= StartupPhaseCount) return;
+
+    std::atomic<int64_t>& mark = m_marks[phase];
+    if (mark.load(std::memory_order_relaxed) >= 0) return;
+
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - m_origin).count();
+    int64_t unset = -1;
+    mark.compare_exchange_strong(unset, elapsed, std::memory_order_release, std::memory_order_relaxed);
+}
+
+int64_t StartupTimer::GetUs(StartupPhase phase) const
+{
+    if (phase < 0 || phase >= StartupPhaseCount) return -1;
+    return m_marks[phase].load(std::memory_order_acquire);
+}
+
+bool StartupTimer::MetTarget() const
+{
+    int64_t firstFrame = GetUs(StartupFirstFrame);
+    return firstFrame >= 0 && firstFrame <= TARGET_FIRST_FRAME_US;
+}
+
+const char* StartupTimer::GetPhaseName(StartupPhase phase)
+{
+    switch (phase) {
+    case StartupWindowShown: return "window shown";
+    case StartupDevicesListed: return "devices listed";
+    case StartupClientActivated: return "client activated";
+    case StartupCaptureStarted: return "capture started";
+    case StartupFirstPacket: return "first packet";
+    case StartupFirstFrame: return "first frame";
+    default: return "unknown";
+    }
+}
+
+std::string StartupTimer::Format() const
+{
+    std::string text;
+    for (int i = 0; i < StartupPhaseCount; i++) {
+        int64_t us = GetUs((StartupPhase)i);
+        if (us < 0) continue;
+
+        char item[64];
+        snprintf(item, sizeof(item), "%s%s %.1f ms", text.empty() ? "" : ", ",
+            GetPhaseName((StartupPhase)i), us / 1000.0);
+        text += item;
+    }
+    return text;
+}
@@ -0,0 +1,347 @@
+#include "stream_output.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+// Output buffer of the named pipe; the writer backs off when it is full
+const DWORD PIPE_BUFFER_SIZE = 1 << 20;
+#else
+// Spans per writev/sendmsg call
+const int MAX_IOVECS = IOV_MAX < 64 ? IOV_MAX : 64;
+
+int BuildIovecs(const IoSpan* spans, size_t count, iovec* iov)
+{
+    int n = 0;
+    for (size_t i = 0; i < count && n < MAX_IOVECS; i++) {
+        iov[n].iov_base = (void*)spans[i].data;
+        iov[n].iov_len = spans[i].size;
+        n++;
+    }
+    return n;
+}
+
+// writev() without the process-wide SIGPIPE default action: block it for the
+// call and swallow the one a closed reader raises
+ssize_t WritevNoSigpipe(int fd, const iovec* iov, int count)
+{
+    sigset_t pipeSet, oldSet;
+    sigemptyset(&pipeSet);
+    sigaddset(&pipeSet, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+
+    ssize_t written = writev(fd, iov, count);
+    int error = errno;
+
+    if (written < 0 && error == EPIPE) {
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE)) {
+            int signal = 0;
+            sigwait(&pipeSet, &signal);
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &oldSet, nullptr);
+    errno = error;
+    return written;
+}
+
+bool IsSocket(int fd)
+{
+    struct stat info;
+    return fstat(fd, &info) == 0 && S_ISSOCK(info.st_mode);
+}
+#endif
+
+}
+
+// FileOutput
+
+int64_t FileOutput::WriteGather(const IoSpan* spans, size_t count)
+{
+#ifdef _WIN32
+    // WriteFileGather needs unbuffered, page-aligned I/O; write span by span
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        DWORD written = 0;
+        if (!WriteFile((HANDLE)m_handle, spans[i].data, (DWORD)spans[i].size, &written, nullptr)) {
+            return total > 0 ? total : -1;
+        }
+        total += written;
+        if (written < spans[i].size) break;
+    }
+    return total;
+#else
+    iovec iov[MAX_IOVECS];
+    int n = BuildIovecs(spans, count, iov);
+    for (;;) {
+        ssize_t written = writev(m_fd, iov, n);
+        if (written >= 0) return written;
+        if (errno != EINTR) return -1;
+    }
+#endif
+}
+
+// StdioOutput
+
+int64_t StdioOutput::WriteGather(const IoSpan* spans, size_t count)
+{
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (fwrite(spans[i].data, 1, spans[i].size, m_file) != spans[i].size) return -1;
+        total += (int64_t)spans[i].size;
+    }
+    return total;
+}
+
+// StreamOutput
+
+StreamOutput::~StreamOutput()
+{
+    Close();
+}
+
+bool StreamOutput::Open(const std::string& target)
+{
+    Close();
+
+    if (target.empty()) return false;
+
+    if (target == "-" || target == "stdout") {
+        m_kind = StdOut;
+    } else if (target.compare(0, 5, "pipe:") == 0) {
+#ifdef _WIN32
+        m_kind = NamedPipe;
+        m_address = "\\\\.\\pipe\\" + target.substr(5);
+#else
+        return false;
+#endif
+    } else if (target.compare(0, 5, "unix:") == 0) {
+#ifdef _WIN32
+        return false;
+#else
+        m_kind = UnixSocket;
+        m_address = target.substr(5);
+        if (m_address.empty() || m_address.size() >= sizeof(sockaddr_un::sun_path)) return false;
+#endif
+    } else if (target.compare(0, 3, "fd:") == 0) {
+#ifdef _WIN32
+        return false;
+#else
+        m_kind = Descriptor;
+        m_address = target.substr(3);
+#endif
+    } else {
+#ifdef _WIN32
+        return false;
+#else
+        m_kind = Path;
+        m_address = target;
+#endif
+    }
+
+    m_target = target;
+    m_spent = false;
+    return true;
+}
+
+void StreamOutput::Close()
+{
+    Disconnect();
+
+#ifdef _WIN32
+    if (m_kind == NamedPipe && m_handle) {
+        CloseHandle((HANDLE)m_handle);
+    }
+#endif
+
+    m_handle = nullptr;
+    m_kind = None;
+    m_target.clear();
+    m_address.clear();
+}
+
+bool StreamOutput::Connect()
+{
+    // Inherited handles cannot be reopened once the reader went away
+    if (m_spent) return false;
+
+#ifdef _WIN32
+    switch (m_kind) {
+    case StdOut: {
+        HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+        if (handle == nullptr || handle == INVALID_HANDLE_VALUE) return false;
+        m_handle = handle;
+        return true;
+    }
+
+    case NamedPipe: {
+        if (!m_handle) {
+            HANDLE pipe = CreateNamedPipeA(m_address.c_str(), PIPE_ACCESS_OUTBOUND,
+                PIPE_TYPE_BYTE | PIPE_NOWAIT, 1, PIPE_BUFFER_SIZE, 0, 0, nullptr);
+            if (pipe == INVALID_HANDLE_VALUE) return false;
+            m_handle = pipe;
+        }
+
+        // Non-blocking listen: connected only once a client has opened it
+        if (ConnectNamedPipe((HANDLE)m_handle, nullptr)) return true;
+        DWORD error = GetLastError();
+        if (error == ERROR_PIPE_CONNECTED) return true;
+        if (error == ERROR_NO_DATA) {
+            // Previous client closed its end; listen again
+            DisconnectNamedPipe((HANDLE)m_handle);
+        }
+        return false;
+    }
+
+    default:
+        return false;
+    }
+#else
+    switch (m_kind) {
+    case StdOut:
+        m_fd = STDOUT_FILENO;
+        m_ownsFd = false;
+        break;
+
+    case Descriptor: {
+        char* end = nullptr;
+        long fd = strtol(m_address.c_str(), &end, 10);
+        if (end == m_address.c_str() || *end != '\0' || fd < 0 || fcntl((int)fd, F_GETFD) < 0) return false;
+        m_fd = (int)fd;
+        m_ownsFd = false;
+        break;
+    }
+
+    case UnixSocket: {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, m_address.c_str(), m_address.size() + 1);
+        if (connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+            close(fd);
+            return false;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        m_fd = fd;
+        m_ownsFd = true;
+        break;
+    }
+
+    case Path: {
+        // ENXIO while a FIFO has no reader; retried on the next Connect()
+        int fd = open(m_address.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) return false;
+        m_fd = fd;
+        m_ownsFd = true;
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    m_isSocket = IsSocket(m_fd);
+    return true;
+#endif
+}
+
+void StreamOutput::Disconnect()
+{
+#ifdef _WIN32
+    if (m_kind == NamedPipe && m_handle) {
+        DisconnectNamedPipe((HANDLE)m_handle);
+    } else if (m_kind == StdOut && m_handle) {
+        m_handle = nullptr;
+        m_spent = true;
+    }
+#else
+    if (m_fd >= 0) {
+        if (m_ownsFd) {
+            close(m_fd);
+        } else {
+            m_spent = true;
+        }
+    }
+    m_fd = -1;
+    m_ownsFd = false;
+    m_isSocket = false;
+#endif
+}
+
+int64_t StreamOutput::WriteGather(const IoSpan* spans, size_t count)
+{
+#ifdef _WIN32
+    if (!m_handle) return -1;
+
+    // No vectored writes for pipes; a non-blocking pipe takes what fits
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        DWORD written = 0;
+        if (!WriteFile((HANDLE)m_handle, spans[i].data, (DWORD)spans[i].size, &written, nullptr)) {
+            return total > 0 ? total : -1;
+        }
+        total += written;
+        if (written < spans[i].size) break;
+    }
+    return total;
+#else
+    if (m_fd < 0) return -1;
+
+    iovec iov[MAX_IOVECS];
+    int n = BuildIovecs(spans, count, iov);
+
+    for (;;) {
+        ssize_t written;
+        if (m_isSocket) {
+            msghdr message = {};
+            message.msg_iov = iov;
+            message.msg_iovlen = n;
+            written = sendmsg(m_fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } else {
+            // Inherited pipes may be blocking; only write once there is room
+            pollfd pfd = { m_fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, 0) == 0) return 0;
+            written = WritevNoSigpipe(m_fd, iov, n);
+        }
+
+        if (written >= 0) return written;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+#endif
+}
+
+void StreamOutput::WaitWritable(uint32_t timeoutMs)
+{
+#ifdef _WIN32
+    // Non-blocking pipes cannot be waited on; poll at a short interval
+    Sleep(timeoutMs < 5 ? timeoutMs : 5);
+#else
+    if (m_fd < 0) return;
+    pollfd pfd = { m_fd, POLLOUT, 0 };
+    poll(&pfd, 1, (int)timeoutMs);
+#endif
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "batched_writer.h"
+
+// ByteOutput over an already open file (HANDLE on Windows, descriptor
+// elsewhere). The owner keeps the file open for the writer's lifetime.
+class FileOutput : public ByteOutput
+{
+public:
+    void SetFile(void* handle) { m_handle = handle; }
+    void SetFile(int fd) { m_fd = fd; }
+
+    int64_t WriteGather(const IoSpan* spans, size_t count) override;
+
+private:
+    void* m_handle = nullptr;
+    int m_fd = -1;
+};
+
+// ByteOutput over a stdio stream opened by the owner (offline tools)
+class StdioOutput : public ByteOutput
+{
+public:
+    explicit StdioOutput(FILE* file = nullptr) : m_file(file) {}
+
+    void SetFile(FILE* file) { m_file = file; }
+
+    int64_t WriteGather(const IoSpan* spans, size_t count) override;
+
+private:
+    FILE* m_file;
+};
+
+// Live PCM output for external encoders. Targets:
+//   "-" or "stdout"   standard output
+//   "pipe:NAME"       Windows: named pipe server \\.\pipe\NAME
+//   "unix:PATH"       POSIX: connect to a listening stream socket
+//   "fd:N"            POSIX: already open descriptor (e.g. one end of a socketpair)
+//   other             POSIX: FIFO or file path
+// Sockets and pipes opened here are non-blocking; a full output reports 0
+// and the queue in BatchedWriter absorbs the backlog or applies its overflow
+// policy. Connect() (re)opens the target, so a consumer that goes away can
+// come back; inherited outputs (stdout, fd:N) cannot be reopened.
+class StreamOutput : public ByteOutput
+{
+public:
+    enum Format {
+        RawPcm,  // Interleaved samples only
+        Wave     // WAV header with open-ended sizes, then samples
+    };
+
+    StreamOutput() = default;
+    ~StreamOutput();
+
+    StreamOutput(const StreamOutput&) = delete;
+    StreamOutput& operator=(const StreamOutput&) = delete;
+
+    // Parse the target; the connection itself is made by Connect()
+    bool Open(const std::string& target);
+    void Close();
+
+    bool IsOpen() const { return m_kind != None; }
+    const std::string& GetTarget() const { return m_target; }
+
+    bool Connect() override;
+    void Disconnect() override;
+    int64_t WriteGather(const IoSpan* spans, size_t count) override;
+    void WaitWritable(uint32_t timeoutMs) override;
+
+private:
+    enum Kind { None, StdOut, NamedPipe, UnixSocket, Descriptor, Path };
+
+    Kind m_kind = None;
+    std::string m_target;
+    std::string m_address;   // Pipe name, socket path or file path
+
+    void* m_handle = nullptr;    // Windows
+    int m_fd = -1;               // POSIX
+    bool m_isSocket = false;
+    bool m_ownsFd = false;
+    bool m_spent = false;        // Inherited output was closed by the reader
+};
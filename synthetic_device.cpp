@@ -0,0 +1,85 @@
+#include "synthetic_device.h"
+#include <algorithm>
+
+SyntheticDevice::SyntheticDevice(uint32_t sampleRate, uint32_t channels, uint32_t packetFrames)
+    : m_source(sampleRate, channels)
+    , m_sampleRate(sampleRate)
+    , m_packetFrames(packetFrames)
+{
+    m_source.SetLooping(true);
+}
+
+void SyntheticDevice::AddFault(const Fault& fault)
+{
+    m_faults.push_back(fault);
+    std::sort(m_faults.begin(), m_faults.end(), [](const Fault& a, const Fault& b) {
+        return a.atSeconds < b.atSeconds;
+    });
+}
+
+void SyntheticDevice::Start(int64_t nowUs)
+{
+    m_startUs = nowUs;
+    m_epochStartUs = nowUs;
+    m_position = 0;
+    m_epochs = 1;
+    m_nextFault = 0;
+    m_failure = Packet;
+}
+
+int64_t SyntheticDevice::GetFaultStartUs(const Fault& fault) const
+{
+    return m_startUs + (int64_t)(fault.atSeconds * 1e6);
+}
+
+int64_t SyntheticDevice::GetFaultEndUs(const Fault& fault) const
+{
+    return GetFaultStartUs(fault) + (int64_t)(fault.seconds * 1e6);
+}
+
+SyntheticDevice::ReadResult SyntheticDevice::Read(int64_t nowUs, float* interleaved, PacketInfo& packet)
+{
+    if (m_failure != Packet) return m_failure;
+
+    // A fault kills the epoch; packets not yet read are gone with it
+    if (m_nextFault < m_faults.size() && nowUs >= GetFaultStartUs(m_faults[m_nextFault])) {
+        m_failure = m_faults[m_nextFault].type == Lost ? DeviceLost : NoData;
+        m_nextFault++;
+        return m_failure;
+    }
+
+    // A packet is available once its last frame has been "captured"
+    uint64_t captured = (uint64_t)(nowUs - m_epochStartUs) * m_sampleRate / 1000000;
+    if (nowUs < m_epochStartUs || captured < m_position + m_packetFrames) return NoData;
+
+    m_source.Read(interleaved, m_packetFrames);
+    packet = PacketInfo();
+    packet.devicePosition = m_position;
+    packet.timestamp = (uint64_t)m_epochStartUs * 10 + m_position * 10000000 / m_sampleRate;
+    packet.frames = m_packetFrames;
+    m_position += m_packetFrames;
+    return Packet;
+}
+
+bool SyntheticDevice::Reacquire(int64_t nowUs)
+{
+    if (IsFaultActive(nowUs)) return false;
+
+    // Faults that came and went while the device was already dead are over
+    while (m_nextFault < m_faults.size() && GetFaultEndUs(m_faults[m_nextFault]) <= nowUs) {
+        m_nextFault++;
+    }
+    m_epochStartUs = nowUs;
+    m_position = 0;
+    m_epochs++;
+    m_failure = Packet;
+    return true;
+}
+
+bool SyntheticDevice::IsFaultActive(int64_t nowUs) const
+{
+    for (const Fault& fault : m_faults) {
+        if (nowUs >= GetFaultStartUs(fault) && nowUs < GetFaultEndUs(fault)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "packet_timeline.h"
+#include "synthetic_source.h"
+
+// Capture device simulated on top of a SyntheticSource. Packets become
+// available as wall-clock time passes, like a shared-mode device buffer
+// polled by the capture loop, and scheduled faults make the device fail the
+// way real ones do (unplugged, driver hung). Used to exercise device-loss
+// recovery without hardware. Times are microseconds on the caller's clock;
+// packet timestamps are the same clock in 100 ns units.
+class SyntheticDevice
+{
+public:
+    enum FaultType {
+        Lost,   // Reads fail as with an invalidated device from the fault start
+        Stall   // Reads return nothing from the fault start, without an error
+    };
+
+    // Re-acquiring the device fails while a fault lasts; after it the device
+    // comes back with positions starting at 0
+    struct Fault
+    {
+        FaultType type = Lost;
+        double atSeconds = 0.0;     // After Start()
+        double seconds = 0.0;
+    };
+
+    enum ReadResult {
+        Packet,
+        NoData,
+        DeviceLost
+    };
+
+    SyntheticDevice(uint32_t sampleRate, uint32_t channels, uint32_t packetFrames);
+
+    // Signal delivered by the device (looped)
+    SyntheticSource& GetSource() { return m_source; }
+
+    void AddFault(const Fault& fault);
+
+    void Start(int64_t nowUs);
+
+    // Next packet due by `nowUs` into `interleaved` (GetPacketFrames() frames)
+    ReadResult Read(int64_t nowUs, float* interleaved, PacketInfo& packet);
+
+    // Open the device again after a loss; false while a fault lasts
+    bool Reacquire(int64_t nowUs);
+
+    bool IsFaultActive(int64_t nowUs) const;
+    uint32_t GetPacketFrames() const { return m_packetFrames; }
+    uint64_t GetEpochs() const { return m_epochs; }   // Start plus successful re-acquisitions
+
+private:
+    int64_t GetFaultStartUs(const Fault& fault) const;
+    int64_t GetFaultEndUs(const Fault& fault) const;
+
+    SyntheticSource m_source;
+    uint32_t m_sampleRate;
+    uint32_t m_packetFrames;
+    std::vector<Fault> m_faults;
+
+    int64_t m_startUs = 0;
+    int64_t m_epochStartUs = 0;      // Position 0 of the current device epoch
+    uint64_t m_position = 0;         // Next frame in this epoch
+    uint64_t m_epochs = 0;
+    size_t m_nextFault = 0;          // First fault not yet hit
+    ReadResult m_failure = Packet;   // Failure mode of a dead epoch (Packet = alive)
+};
@@ -0,0 +1,172 @@
+#include "synthetic_source.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+const uint64_t NOISE_SEED = 0x9E3779B97F4A7C15ull;
+
+double DbToGain(double db)
+{
+    return pow(10.0, db / 20.0);
+}
+
+}
+
+SyntheticSource::SyntheticSource(uint32_t sampleRate, uint32_t channels)
+    : m_sampleRate(sampleRate), m_channels(channels), m_noiseState(NOISE_SEED)
+{
+}
+
+void SyntheticSource::AddSegment(const Segment& segment)
+{
+    m_segments.push_back(segment);
+    m_segmentFrames.push_back((uint64_t)llround(segment.seconds * m_sampleRate));
+}
+
+void SyntheticSource::AddSine(double frequency, double levelDb, double seconds, uint32_t channelMask)
+{
+    Segment segment;
+    segment.type = Sine;
+    segment.frequency = frequency;
+    segment.levelDb = levelDb;
+    segment.seconds = seconds;
+    segment.channelMask = channelMask;
+    AddSegment(segment);
+}
+
+void SyntheticSource::AddNoise(double levelDb, double seconds, uint32_t channelMask)
+{
+    Segment segment;
+    segment.type = WhiteNoise;
+    segment.levelDb = levelDb;
+    segment.seconds = seconds;
+    segment.channelMask = channelMask;
+    AddSegment(segment);
+}
+
+void SyntheticSource::AddSilence(double seconds)
+{
+    Segment segment;
+    segment.type = Silence;
+    segment.seconds = seconds;
+    AddSegment(segment);
+}
+
+void SyntheticSource::Rewind()
+{
+    m_segmentIndex = 0;
+    m_segmentPosition = 0;
+    m_position = 0;
+    m_phase = 0.0;
+    m_noiseState = NOISE_SEED;
+}
+
+bool SyntheticSource::IsFinished() const
+{
+    return !m_looping && m_segmentIndex >= m_segments.size();
+}
+
+uint64_t SyntheticSource::GetTotalFrames() const
+{
+    uint64_t total = 0;
+    for (uint64_t frames : m_segmentFrames) total += frames;
+    return total;
+}
+
+float SyntheticSource::NextNoise()
+{
+    // xorshift64*, uniform in [-1, 1)
+    m_noiseState ^= m_noiseState >> 12;
+    m_noiseState ^= m_noiseState << 25;
+    m_noiseState ^= m_noiseState >> 27;
+    uint64_t value = m_noiseState * 0x2545F4914F6CDD1Dull;
+    return (float)((double)(value >> 40) / (double)(1ull << 23) - 1.0);
+}
+
+size_t SyntheticSource::Read(float* interleaved, size_t frames)
+{
+    size_t produced = 0;
+
+    while (produced < frames) {
+        if (m_segmentIndex >= m_segments.size()) {
+            if (!m_looping || m_segments.empty()) break;
+            m_segmentIndex = 0;
+            m_segmentPosition = 0;
+        }
+
+        const Segment& segment = m_segments[m_segmentIndex];
+        uint64_t remaining = m_segmentFrames[m_segmentIndex] - m_segmentPosition;
+        size_t count = (size_t)std::min<uint64_t>(remaining, frames - produced);
+        float* out = interleaved + produced * m_channels;
+
+        double gain = DbToGain(segment.levelDb);
+        double phaseStep = segment.frequency / m_sampleRate;
+
+        for (size_t i = 0; i < count; i++) {
+            float sample = 0.0f;
+            switch (segment.type) {
+                case Sine:
+                    sample = (float)(gain * sin(2.0 * PI * m_phase));
+                    m_phase += phaseStep;
+                    if (m_phase >= 1.0) m_phase -= 1.0;
+                    break;
+                case WhiteNoise:
+                    // Uniform noise with the requested RMS
+                    sample = (float)(gain * sqrt(3.0) * NextNoise());
+                    break;
+                case Silence:
+                    break;
+            }
+
+            for (uint32_t c = 0; c < m_channels; c++) {
+                bool active = segment.channelMask == 0 || (segment.channelMask & (1u << c));
+                out[i * m_channels + c] = active ? sample : 0.0f;
+            }
+        }
+
+        produced += count;
+        m_position += count;
+        m_segmentPosition += count;
+        if (m_segmentPosition >= m_segmentFrames[m_segmentIndex]) {
+            m_segmentIndex++;
+            m_segmentPosition = 0;
+        }
+    }
+
+    return produced;
+}
+
+bool SyntheticSource::LoadEbuTest(int testNumber)
+{
+    // All reference signals are 1 kHz sines in every channel
+    struct Step { double levelDb; double seconds; };
+    std::vector<Step> steps;
+
+    switch (testNumber) {
+        // EBU Tech 3341, expected integrated loudness in the comment
+        case 1: steps = { { -23.0, 20.0 } }; break;                                       // -23 LUFS
+        case 2: steps = { { -33.0, 20.0 } }; break;                                       // -33 LUFS
+        case 3: steps = { { -36.0, 10.0 }, { -23.0, 60.0 }, { -36.0, 10.0 } }; break;     // -23 LUFS
+        case 4: steps = { { -72.0, 10.0 }, { -36.0, 10.0 }, { -23.0, 60.0 },
+                          { -36.0, 10.0 }, { -72.0, 10.0 } }; break;                      // -23 LUFS
+        case 5: steps = { { -26.0, 20.0 }, { -20.0, 20.1 }, { -26.0, 20.0 } }; break;     // -23 LUFS
+        // EBU Tech 3342, expected loudness range in the comment
+        case 101: steps = { { -20.0, 20.0 }, { -30.0, 20.0 } }; break;                    // 10 LU
+        case 102: steps = { { -20.0, 20.0 }, { -15.0, 20.0 } }; break;                    // 5 LU
+        case 103: steps = { { -40.0, 20.0 }, { -20.0, 20.0 } }; break;                    // 20 LU
+        case 104: steps = { { -50.0, 20.0 }, { -35.0, 20.0 }, { -20.0, 20.0 },
+                            { -35.0, 20.0 }, { -50.0, 20.0 } }; break;                    // 15 LU
+        default: return false;
+    }
+
+    m_segments.clear();
+    m_segmentFrames.clear();
+    Rewind();
+
+    for (const Step& step : steps) {
+        AddSine(1000.0, step.levelDb, step.seconds);
+    }
+    return true;
+}
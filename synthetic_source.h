@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Deterministic signal generator used in place of a capture device.
+// Produces interleaved float frames from a list of segments (sine, noise,
+// silence), e.g. the EBU Tech 3341/3342 loudness reference signals.
+class SyntheticSource
+{
+public:
+    enum SignalType {
+        Silence,
+        Sine,
+        WhiteNoise
+    };
+
+    struct Segment
+    {
+        SignalType type = Silence;
+        double frequency = 1000.0;   // Hz (Sine only)
+        double levelDb = 0.0;        // dBFS: sine peak / noise RMS
+        double seconds = 0.0;
+        uint32_t channelMask = 0;    // Channels carrying the signal (0 = all)
+    };
+
+    SyntheticSource(uint32_t sampleRate, uint32_t channels);
+
+    void AddSegment(const Segment& segment);
+    void AddSine(double frequency, double levelDb, double seconds, uint32_t channelMask = 0);
+    void AddNoise(double levelDb, double seconds, uint32_t channelMask = 0);
+    void AddSilence(double seconds);
+
+    // Repeat the segment list forever instead of finishing
+    void SetLooping(bool looping) { m_looping = looping; }
+
+    // Fill up to `frames` interleaved frames; returns the number produced
+    // (less than requested only when the last segment ends)
+    size_t Read(float* interleaved, size_t frames);
+
+    // Restart from the first segment with the same noise seed
+    void Rewind();
+
+    bool IsFinished() const;
+    uint64_t GetFramePosition() const { return m_position; }
+    uint64_t GetTotalFrames() const;
+    uint32_t GetSampleRate() const { return m_sampleRate; }
+    uint32_t GetChannels() const { return m_channels; }
+
+    // Segment lists of the EBU reference tests. testNumber follows Tech 3341
+    // (1-5 for integrated loudness) and Tech 3342 (101-104 for LRA cases
+    // 1-4). Returns false for unknown tests.
+    bool LoadEbuTest(int testNumber);
+
+private:
+    float NextNoise();
+
+    uint32_t m_sampleRate;
+    uint32_t m_channels;
+    std::vector<Segment> m_segments;
+    std::vector<uint64_t> m_segmentFrames;
+    size_t m_segmentIndex = 0;
+    uint64_t m_segmentPosition = 0;
+    uint64_t m_position = 0;
+    double m_phase = 0.0;
+    uint64_t m_noiseState = 0;
+    bool m_looping = false;
+};
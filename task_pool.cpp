@@ -0,0 +1,118 @@
+#include "task_pool.h"
+
+namespace {
+
+// Worker the current thread belongs to, so nested submits stay local
+thread_local const TaskPool* t_pool = nullptr;
+thread_local unsigned t_workerIndex = 0;
+
+}
+
+TaskPool::TaskPool(unsigned threads)
+{
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    for (unsigned i = 0; i < threads; i++) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        m_threads.emplace_back(&TaskPool::WorkerThread, this, i);
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void TaskPool::Submit(Task task)
+{
+    unsigned index = t_pool == this
+        ? t_workerIndex
+        : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % (unsigned)m_queues.size();
+
+    // Counted before it becomes visible so a worker never takes a task the
+    // counters do not know about yet
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        // Pairs with the predicate check in WorkerThread so no wake-up is lost
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_queued.fetch_add(1, std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void TaskPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_idle.wait(lock, [this]() { return m_pending.load(std::memory_order_acquire) == 0; });
+}
+
+bool TaskPool::TryTake(unsigned index, Task& task)
+{
+    // Own deque from the back
+    {
+        Queue& own = *m_queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Steal from the front of the others, starting with the next worker
+    const unsigned count = (unsigned)m_queues.size();
+    for (unsigned offset = 1; offset < count; offset++) {
+        Queue& victim = *m_queues[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::WorkerThread(unsigned index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+
+    for (;;) {
+        Task task;
+        if (TryTake(index, task)) {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+
+            if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(m_wakeMutex);
+                m_idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wake.wait(lock, [this]() {
+            return m_stopping || m_queued.load(std::memory_order_acquire) > 0;
+        });
+        if (m_stopping && m_queued.load(std::memory_order_acquire) == 0) break;
+    }
+
+    t_pool = nullptr;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for offline tools.
+// Every worker has its own deque: tasks submitted from a worker go to the
+// back of its deque and it pops from the back (depth first, cache warm),
+// while idle workers steal from the front of the others (the oldest, usually
+// largest pieces of work). Tasks submitted from outside are spread round
+// robin. Tasks may submit further tasks; Wait() returns once all are done.
+class TaskPool
+{
+public:
+    using Task = std::function<void()>;
+
+    // threads == 0: one per hardware thread
+    explicit TaskPool(unsigned threads = 0);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    void Submit(Task task);
+
+    // Block until every submitted task (and everything they submitted) ran.
+    // Must not be called from a task.
+    void Wait();
+
+    unsigned GetThreadCount() const { return (unsigned)m_threads.size(); }
+
+    // Tasks taken from another worker's deque so far
+    uint64_t GetStealCount() const { return m_steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerThread(unsigned index);
+    bool TryTake(unsigned index, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;      // Tasks queued or stopping
+    std::condition_variable m_idle;      // Nothing pending any more
+    std::atomic<size_t> m_queued{ 0 };   // Tasks sitting in deques
+    std::atomic<size_t> m_pending{ 0 };  // Tasks submitted but not finished
+    std::atomic<unsigned> m_nextQueue{ 0 };
+    std::atomic<uint64_t> m_steals{ 0 };
+    bool m_stopping = false;
+};
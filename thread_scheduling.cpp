@@ -0,0 +1,281 @@
+#include "thread_scheduling.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <avrt.h>
+#pragma comment(lib, "avrt.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Defaults: the capture thread is realtime, writers slightly elevated
+ThreadScheduling::Policy g_policies[ThreadScheduling::ROLE_COUNT] = {
+    { ThreadScheduling::Realtime, 80, 0 },
+    { ThreadScheduling::Elevated, 0, 0 },
+    { ThreadScheduling::Default, 0, 0 },
+};
+
+std::atomic<bool> g_enabled{ true };
+
+// Realtime priorities at or above this use MMCSS "critical"
+const int MMCSS_CRITICAL_PRIORITY = 50;
+
+bool SetAffinity(uint64_t mask)
+{
+    if (mask == 0) return false;
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < 64; cpu++) {
+        if (mask & (1ull << cpu)) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+#ifndef _WIN32
+// Per-thread nice value (Linux threads have their own)
+bool SetThreadNice(int nice)
+{
+#ifdef __linux__
+    return setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice) == 0;
+#else
+    (void)nice;
+    return false;
+#endif
+}
+#endif
+
+}
+
+namespace ThreadScheduling {
+
+void SetPolicy(Role role, const Policy& policy)
+{
+    if (role < 0 || role >= ROLE_COUNT) return;
+    g_policies[role] = policy;
+}
+
+Policy GetPolicy(Role role)
+{
+    if (role < 0 || role >= ROLE_COUNT) return Policy();
+    return g_policies[role];
+}
+
+void SetEnabled(bool enabled)
+{
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsEnabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+bool ParsePolicy(const char* text, Policy& policy)
+{
+    if (!text || !*text) return false;
+
+    Policy parsed;
+    const char* end = text;
+    while (*end && *end != ':' && *end != '@') end++;
+    size_t length = (size_t)(end - text);
+
+    auto is = [&](const char* name) { return strlen(name) == length && strncmp(text, name, length) == 0; };
+    if (is("default")) {
+        parsed.schedulingClass = Default;
+    } else if (is("elevated") || is("high")) {
+        parsed.schedulingClass = Elevated;
+    } else if (is("realtime") || is("rt")) {
+        parsed.schedulingClass = Realtime;
+        parsed.priority = 80;
+    } else {
+        return false;
+    }
+
+    if (*end == ':') {
+        char* next = nullptr;
+        long priority = strtol(end + 1, &next, 10);
+        if (next == end + 1 || priority < 1 || priority > 99) return false;
+        parsed.priority = (int)priority;
+        end = next;
+    }
+
+    if (*end == '@') {
+        char* next = nullptr;
+        unsigned long long mask = strtoull(end + 1, &next, 0);
+        if (next == end + 1 || mask == 0) return false;
+        parsed.affinity = mask;
+        end = next;
+    }
+
+    if (*end != '\0') return false;
+    policy = parsed;
+    return true;
+}
+
+const char* GetRoleName(Role role)
+{
+    switch (role) {
+    case Capture: return "capture";
+    case Writer: return "writer";
+    case Background: return "background";
+    default: return "unknown";
+    }
+}
+
+const char* GetSchedulingClassName(Class schedulingClass)
+{
+    switch (schedulingClass) {
+    case Elevated: return "elevated";
+    case Realtime: return "realtime";
+    default: return "default";
+    }
+}
+
+Applied ApplyToCurrentThread(Role role)
+{
+    Applied applied;
+    if (!IsEnabled()) return applied;
+
+    Policy policy = GetPolicy(role);
+    applied.affinitySet = SetAffinity(policy.affinity);
+
+#ifdef _WIN32
+    if (policy.schedulingClass == Realtime) {
+        // MMCSS boosts the thread above normal priorities without needing admin rights
+        DWORD taskIndex = 0;
+        HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+        if (task) {
+            AvSetMmThreadPriority(task, policy.priority >= MMCSS_CRITICAL_PRIORITY ? AVRT_PRIORITY_CRITICAL : AVRT_PRIORITY_HIGH);
+            applied.mmcssHandle = task;
+            applied.schedulingClass = Realtime;
+            return applied;
+        }
+        if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+            applied.schedulingClass = Elevated;
+        }
+    } else if (policy.schedulingClass == Elevated) {
+        if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL)) {
+            applied.schedulingClass = Elevated;
+        }
+    }
+#else
+    if (policy.schedulingClass == Realtime) {
+        sched_param param = {};
+        param.sched_priority = policy.priority > 0 ? policy.priority : 1;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0 ||
+            pthread_setschedparam(pthread_self(), SCHED_RR, &param) == 0) {
+            applied.schedulingClass = Realtime;
+            return applied;
+        }
+        // No CAP_SYS_NICE / RLIMIT_RTPRIO: best effort with nice
+        if (SetThreadNice(-20) || SetThreadNice(-10)) {
+            applied.schedulingClass = Elevated;
+        }
+    } else if (policy.schedulingClass == Elevated) {
+        if (SetThreadNice(-5)) {
+            applied.schedulingClass = Elevated;
+        }
+    }
+#endif
+
+    return applied;
+}
+
+void RestoreCurrentThread(const Applied& applied)
+{
+#ifdef _WIN32
+    if (applied.mmcssHandle) {
+        AvRevertMmThreadCharacteristics((HANDLE)applied.mmcssHandle);
+    } else if (applied.schedulingClass != Default) {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+    }
+#else
+    if (applied.schedulingClass == Realtime) {
+        sched_param param = {};
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    } else if (applied.schedulingClass == Elevated) {
+        SetThreadNice(0);
+    }
+#endif
+}
+
+bool LockMemory(const void* data, size_t size)
+{
+    if (!data || size == 0) return false;
+#ifdef _WIN32
+    // VirtualLock is limited by the minimum working set; grow it first
+    SIZE_T minimum = 0, maximum = 0;
+    if (GetProcessWorkingSetSize(GetCurrentProcess(), &minimum, &maximum)) {
+        SetProcessWorkingSetSize(GetCurrentProcess(), minimum + size, maximum + size);
+    }
+    return VirtualLock((LPVOID)data, size) != 0;
+#else
+    return mlock(data, size) == 0;
+#endif
+}
+
+void UnlockMemory(const void* data, size_t size)
+{
+    if (!data || size == 0) return;
+#ifdef _WIN32
+    VirtualUnlock((LPVOID)data, size);
+#else
+    munlock(data, size);
+#endif
+}
+
+}
+
+void WakeJitterMeter::Reset()
+{
+    memset(m_buckets, 0, sizeof(m_buckets));
+    m_count = 0;
+    m_max = 0;
+}
+
+void WakeJitterMeter::Record(int64_t lateMicroseconds)
+{
+    if (lateMicroseconds < 0) lateMicroseconds = 0;
+
+    int64_t bucket = lateMicroseconds / BUCKET_MICROSECONDS;
+    if (bucket >= BUCKET_COUNT) bucket = BUCKET_COUNT - 1;
+
+    m_buckets[bucket]++;
+    m_count++;
+    if (lateMicroseconds > m_max) m_max = lateMicroseconds;
+}
+
+int64_t WakeJitterMeter::GetPercentile(double fraction) const
+{
+    if (m_count == 0) return 0;
+
+    uint64_t target = (uint64_t)(fraction * (double)m_count);
+    if (target >= m_count) target = m_count - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += m_buckets[i];
+        if (seen > target) {
+            // Upper edge of the bucket, but never beyond the observed maximum
+            int64_t edge = (int64_t)(i + 1) * BUCKET_MICROSECONDS;
+            return edge < m_max ? edge : m_max;
+        }
+    }
+    return m_max;
+}
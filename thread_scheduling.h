@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Scheduling policy for pipeline threads, configured per role.
+// Realtime maps to MMCSS "Pro Audio" on Windows (falling back to
+// THREAD_PRIORITY_TIME_CRITICAL) and to SCHED_FIFO, then SCHED_RR, then the
+// lowest nice value on Linux. Every step degrades gracefully when the
+// process lacks the privilege; ApplyToCurrentThread reports what was
+// actually applied. Affinity masks pin a role to CPUs; giving Background a
+// mask that excludes the pipeline CPUs keeps the UI off them.
+namespace ThreadScheduling {
+
+enum Role {
+    Capture,     // Capture/pump thread (also runs the recording DSP chain)
+    Writer,      // File and stream writer threads
+    Background,  // UI and everything else
+    ROLE_COUNT
+};
+
+enum Class {
+    Default,     // Leave the thread alone
+    Elevated,    // Above-normal priority, no realtime class
+    Realtime     // MMCSS / SCHED_FIFO
+};
+
+struct Policy
+{
+    Class schedulingClass = Default;
+    int priority = 0;          // Realtime: 1-99 (SCHED_FIFO priority; >= 50 uses MMCSS critical)
+    uint64_t affinity = 0;     // CPU bit mask, 0 = any CPU
+};
+
+// What ApplyToCurrentThread managed to do
+struct Applied
+{
+    Class schedulingClass = Default;
+    bool affinitySet = false;
+    void* mmcssHandle = nullptr;   // Windows: reverted by RestoreCurrentThread
+};
+
+void SetPolicy(Role role, const Policy& policy);
+Policy GetPolicy(Role role);
+
+// Turn all policies off (every role behaves as Default)
+void SetEnabled(bool enabled);
+bool IsEnabled();
+
+// Parse "<class>[:<priority>][@<cpu mask>]", e.g. "realtime:80@0x4",
+// "elevated", "default". Class names: default, elevated/high, realtime/rt.
+bool ParsePolicy(const char* text, Policy& policy);
+
+const char* GetRoleName(Role role);
+const char* GetSchedulingClassName(Class schedulingClass);
+
+// Apply the role's policy to the calling thread
+Applied ApplyToCurrentThread(Role role);
+
+// Undo what ApplyToCurrentThread did (call on the same thread before exit)
+void RestoreCurrentThread(const Applied& applied);
+
+// Keep a buffer resident (VirtualLock / mlock) so the realtime path never
+// page-faults on it
+bool LockMemory(const void* data, size_t size);
+void UnlockMemory(const void* data, size_t size);
+
+}
+
+// Histogram of how late a periodic thread wakes up. Written by one thread;
+// read after that thread stopped (or accept slightly torn values).
+class WakeJitterMeter
+{
+public:
+    void Reset();
+
+    // Lateness of one wake-up in microseconds (negative counts as 0)
+    void Record(int64_t lateMicroseconds);
+
+    uint64_t GetCount() const { return m_count; }
+    int64_t GetMax() const { return m_max; }
+
+    // Lateness in microseconds at or below which `fraction` of wake-ups fell
+    int64_t GetPercentile(double fraction) const;
+
+private:
+    static const int BUCKET_MICROSECONDS = 50;
+    static const int BUCKET_COUNT = 1024;   // Up to 51.2 ms, beyond is clamped
+
+    uint32_t m_buckets[BUCKET_COUNT] = {};
+    uint64_t m_count = 0;
+    int64_t m_max = 0;
+};
@@ -0,0 +1,116 @@
+#include "trace_replay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace {
+
+// Test tone used for traces recorded without payload
+const double TONE_FREQUENCY = 997.0;
+const double TONE_LEVEL_DB = -20.0;
+
+const double TRACE_UNITS_PER_SEC = 10000000.0;
+
+}
+
+bool TraceReplay::Open(const char* path)
+{
+    return m_reader.Open(path);
+}
+
+const uint8_t* TraceReplay::SynthesizePayload(uint32_t frames)
+{
+    const TraceFormat& format = m_reader.GetFormat();
+    size_t samples = (size_t)frames * format.channels;
+    bool isFloat = format.isFloat && format.bitsPerSample == 32;
+
+    if (format.bitsPerSample != 16 && !isFloat) {
+        m_payload.assign((size_t)frames * format.GetBlockAlign(), 0);
+        return m_payload.data();
+    }
+
+    m_tone.resize(samples);
+    size_t produced = m_toneSource ? m_toneSource->Read(m_tone.data(), frames) : 0;
+    std::fill(m_tone.begin() + produced * format.channels, m_tone.end(), 0.0f);
+    if (isFloat) {
+        return (const uint8_t*)m_tone.data();
+    }
+
+    m_toneS16.resize(samples);
+    for (size_t i = 0; i < samples; i++) {
+        float x = m_tone[i] * 32767.0f;
+        m_toneS16[i] = (int16_t)(x > 32767.0f ? 32767.0f : (x < -32768.0f ? -32768.0f : x));
+    }
+    return (const uint8_t*)m_toneS16.data();
+}
+
+bool TraceReplay::Run(Timing timing, const PacketSink& sink, const std::atomic<bool>* stop)
+{
+    const TraceFormat& format = m_reader.GetFormat();
+    if (!m_reader.Rewind()) return false;
+
+    m_packets = 0;
+    m_frames = 0;
+    m_lostRecords = 0;
+    m_traceSeconds = 0.0;
+    m_lateness.Reset();
+
+    if (!format.hasPayload) {
+        m_toneSource = std::make_unique<SyntheticSource>(format.sampleRate, format.channels);
+        m_toneSource->AddSine(TONE_FREQUENCY, TONE_LEVEL_DB, 1.0);
+        m_toneSource->SetLooping(true);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool haveFirst = false;
+    uint64_t firstArrival = 0, lastArrival = 0;
+
+    TracePacket record;
+    bool complete = true;
+    for (;;) {
+        if (stop && stop->load(std::memory_order_relaxed)) break;
+        if (!m_reader.Next(record, m_payload)) {
+            complete = !m_reader.IsTruncated();
+            break;
+        }
+        if (record.type == TracePacket::Lost) {
+            m_lostRecords += record.frames;
+            continue;
+        }
+        if (record.type != TracePacket::Packet) continue;
+
+        if (!haveFirst) {
+            firstArrival = record.arrival;
+            haveFirst = true;
+        }
+        lastArrival = record.arrival;
+
+        if (timing == OriginalTiming) {
+            auto due = start + std::chrono::microseconds((record.arrival - firstArrival) / 10);
+            std::this_thread::sleep_until(due);
+            auto late = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - due);
+            m_lateness.Record(late.count());
+        }
+
+        PacketInfo packet;
+        packet.devicePosition = record.devicePosition;
+        packet.timestamp = record.timestamp;
+        packet.frames = record.frames;
+        packet.flags = GetTracePacketFlags(record.deviceFlags);
+
+        const uint8_t* data = nullptr;
+        if (!(packet.flags & PacketInfo::Silent)) {
+            data = record.payloadBytes > 0 ? m_payload.data() : SynthesizePayload(record.frames);
+        }
+        sink(data, packet);
+
+        m_packets++;
+        m_frames += record.frames;
+    }
+
+    m_traceSeconds = haveFirst ? (lastArrival - firstArrival) / TRACE_UNITS_PER_SEC : 0.0;
+    m_elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return complete;
+}
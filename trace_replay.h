@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "capture_trace.h"
+#include "synthetic_source.h"
+#include "thread_scheduling.h"
+
+// Feeds a capture trace back as if a device delivered it, on any platform.
+// Packets keep their sizes, flags and device positions; payload comes from
+// the trace or, for metadata-only traces, from a deterministic test tone
+// (16-bit and float traces; other depths get silence).
+// AsFastAsPossible measures throughput; OriginalTiming waits for each
+// packet's recorded arrival time and measures how late delivery was.
+class TraceReplay
+{
+public:
+    enum Timing {
+        AsFastAsPossible,
+        OriginalTiming
+    };
+
+    // Called for every packet; data is null for silent packets
+    using PacketSink = std::function<void(const uint8_t* data, const PacketInfo& packet)>;
+
+    bool Open(const char* path);
+    const TraceFormat& GetFormat() const { return m_reader.GetFormat(); }
+
+    // Replay the whole trace, or until *stop becomes true. Returns false if
+    // it could not be read to the end.
+    bool Run(Timing timing, const PacketSink& sink, const std::atomic<bool>* stop = nullptr);
+
+    uint64_t GetPackets() const { return m_packets; }
+    uint64_t GetFrames() const { return m_frames; }
+    uint64_t GetLostRecords() const { return m_lostRecords; }   // Holes in the trace itself
+    double GetTraceSeconds() const { return m_traceSeconds; }   // First to last arrival
+    double GetElapsedSeconds() const { return m_elapsedSeconds; }
+
+    // OriginalTiming: how late each packet was delivered
+    const WakeJitterMeter& GetLateness() const { return m_lateness; }
+
+private:
+    const uint8_t* SynthesizePayload(uint32_t frames);
+
+    CaptureTraceReader m_reader;
+    std::vector<uint8_t> m_payload;
+    std::unique_ptr<SyntheticSource> m_toneSource;
+    std::vector<float> m_tone;
+    std::vector<int16_t> m_toneS16;
+
+    uint64_t m_packets = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_lostRecords = 0;
+    double m_traceSeconds = 0.0;
+    double m_elapsedSeconds = 0.0;
+    WakeJitterMeter m_lateness;
+};
@@ -0,0 +1,148 @@
+#include "wave_format.h"
+#include <cstring>
+
+namespace {
+
+void PutU16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+void PutU32(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+// Fixed-size ASCII field, zero padded
+void PutText(uint8_t* p, const char* text, size_t size)
+{
+    size_t length = text ? strlen(text) : 0;
+    if (length > size) length = size;
+    if (length > 0) memcpy(p, text, length);
+}
+
+}
+
+void BuildWaveHeader(uint8_t* header, uint32_t sampleRate, uint16_t channels,
+                     uint16_t bitsPerSample, uint32_t dataSize)
+{
+    uint16_t blockAlign = (uint16_t)(channels * bitsPerSample / 8);
+
+    memcpy(header, "RIFF", 4);
+    PutU32(header + 4, dataSize == WAVE_SIZE_UNKNOWN ? WAVE_SIZE_UNKNOWN : dataSize + 36);
+    memcpy(header + 8, "WAVE", 4);
+
+    memcpy(header + 12, "fmt ", 4);
+    PutU32(header + 16, 16);
+    PutU16(header + 20, 1);  // PCM
+    PutU16(header + 22, channels);
+    PutU32(header + 24, sampleRate);
+    PutU32(header + 28, sampleRate * blockAlign);
+    PutU16(header + 32, blockAlign);
+    PutU16(header + 34, bitsPerSample);
+
+    memcpy(header + 36, "data", 4);
+    PutU32(header + 40, dataSize);
+}
+
+void BuildBroadcastWaveHeader(uint8_t* header, uint32_t sampleRate, uint16_t channels,
+                              uint16_t bitsPerSample, uint32_t dataSize,
+                              const BroadcastExtension& bext, uint32_t trailingSize)
+{
+    // Same layout as the plain header with "bext" between "fmt " and "data"
+    uint8_t plain[WAVE_HEADER_SIZE];
+    BuildWaveHeader(plain, sampleRate, channels, bitsPerSample, dataSize);
+
+    memcpy(header, plain, 36);
+    if (dataSize != WAVE_SIZE_UNKNOWN) {
+        uint32_t padding = dataSize & 1;
+        PutU32(header + 4, dataSize + padding + (uint32_t)(BROADCAST_WAVE_HEADER_SIZE - 8) + trailingSize);
+    }
+
+    uint8_t* chunk = header + 36;
+    memset(chunk, 0, BEXT_CHUNK_SIZE);
+    memcpy(chunk, "bext", 4);
+    PutU32(chunk + 4, (uint32_t)(BEXT_CHUNK_SIZE - 8));
+
+    uint8_t* body = chunk + 8;
+    PutText(body, bext.description, 256);
+    PutText(body + 256, bext.originator, 32);
+    PutText(body + 288, bext.originatorReference, 32);
+    PutText(body + 320, bext.originationDate, 10);
+    PutText(body + 330, bext.originationTime, 8);
+    PutU32(body + 338, (uint32_t)bext.timeReference);
+    PutU32(body + 342, (uint32_t)(bext.timeReference >> 32));
+    PutU16(body + 346, 1);  // Version; UMID and loudness fields stay zero
+
+    memcpy(header + 36 + BEXT_CHUNK_SIZE, plain + 36, 8);
+}
+
+void BuildCueChunk(uint8_t* chunk, const uint32_t* frames, size_t count)
+{
+    memcpy(chunk, "cue ", 4);
+    PutU32(chunk + 4, (uint32_t)(GetCueChunkSize(count) - 8));
+    PutU32(chunk + 8, (uint32_t)count);
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t* point = chunk + 12 + i * 24;
+        PutU32(point, (uint32_t)(i + 1));   // Cue point ID
+        PutU32(point + 4, frames[i]);       // Play order position
+        memcpy(point + 8, "data", 4);
+        PutU32(point + 12, 0);              // Chunk start
+        PutU32(point + 16, 0);              // Block start
+        PutU32(point + 20, frames[i]);      // Sample offset
+    }
+}
+
+namespace {
+
+uint16_t GetU16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t GetU32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+}
+
+bool ParseWaveHeader(const uint8_t* data, size_t size, WaveInfo& info)
+{
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) return false;
+
+    bool haveFormat = false;
+    size_t position = 12;
+    while (position + 8 <= size) {
+        const uint8_t* chunk = data + position;
+        uint32_t chunkSize = GetU32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunkSize < 16 || position + 8 + 16 > size) return false;
+            info.formatTag = GetU16(chunk + 8);
+            info.channels = GetU16(chunk + 10);
+            info.sampleRate = GetU32(chunk + 12);
+            info.blockAlign = GetU16(chunk + 20);
+            info.bitsPerSample = GetU16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE: the subformat GUID starts with the real tag
+            if (info.formatTag == 0xFFFE && chunkSize >= 40 && position + 8 + 26 <= size) {
+                info.formatTag = GetU16(chunk + 8 + 24);
+            }
+            haveFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat || info.channels == 0 || info.blockAlign == 0) return false;
+            info.dataOffset = position + 8;
+            info.dataSize = chunkSize;
+            return true;
+        }
+
+        // Chunks are padded to an even size
+        position += 8 + (size_t)chunkSize + (chunkSize & 1);
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Canonical PCM WAV header (RIFF, "fmt " and "data" chunk headers)
+const size_t WAVE_HEADER_SIZE = 44;
+
+// RIFF/data size for streams whose length is not known up front; readers
+// treat it as "until end of stream"
+const uint32_t WAVE_SIZE_UNKNOWN = 0xFFFFFFFFu;
+
+// Data size to put in a header for `dataSize` bytes of samples in a file
+// with `overhead` bytes of headers and trailing chunks: the size itself, or
+// WAVE_SIZE_UNKNOWN once the RIFF size no longer fits in 32 bits (past
+// 4 GiB; readers then take the data up to the end of the file)
+inline uint32_t GetWaveDataSize(uint64_t dataSize, uint64_t overhead)
+{
+    return dataSize + (dataSize & 1) + overhead - 8 < WAVE_SIZE_UNKNOWN ? (uint32_t)dataSize : WAVE_SIZE_UNKNOWN;
+}
+
+// Fill `header` (WAVE_HEADER_SIZE bytes) for `dataSize` bytes of PCM
+void BuildWaveHeader(uint8_t* header, uint32_t sampleRate, uint16_t channels,
+                     uint16_t bitsPerSample, uint32_t dataSize);
+
+// Broadcast Wave (EBU Tech 3285) "bext" chunk, version 1 without coding
+// history. Strings are truncated to their field sizes.
+struct BroadcastExtension
+{
+    const char* description = "";
+    const char* originator = "";
+    const char* originatorReference = "";
+    char originationDate[11] = "";   // "yyyy-mm-dd"
+    char originationTime[9] = "";    // "hh:mm:ss"
+    uint64_t timeReference = 0;      // First sample, counted from midnight
+};
+
+// Size of the bext chunk including its chunk header
+const size_t BEXT_CHUNK_SIZE = 8 + 602;
+
+// Header of a Broadcast Wave file: RIFF, "fmt ", "bext" and the "data"
+// chunk header
+const size_t BROADCAST_WAVE_HEADER_SIZE = WAVE_HEADER_SIZE + BEXT_CHUNK_SIZE;
+
+// Fill `header` (BROADCAST_WAVE_HEADER_SIZE bytes). trailingSize counts the
+// chunks that follow the data chunk (e.g. "cue "), for the RIFF size.
+void BuildBroadcastWaveHeader(uint8_t* header, uint32_t sampleRate, uint16_t channels,
+                              uint16_t bitsPerSample, uint32_t dataSize,
+                              const BroadcastExtension& bext, uint32_t trailingSize = 0);
+
+// Size of a "cue " chunk with `count` cue points
+inline size_t GetCueChunkSize(size_t count) { return 12 + count * 24; }
+
+// Fill `chunk` (GetCueChunkSize(count) bytes) with cue points at the given
+// sample frames of the data chunk
+void BuildCueChunk(uint8_t* chunk, const uint32_t* frames, size_t count);
+
+// Layout of an existing WAV file, from ParseWaveHeader
+struct WaveInfo
+{
+    uint16_t formatTag = 0;        // 1 = PCM, 3 = IEEE float (from WAVE_FORMAT_EXTENSIBLE's subformat)
+    uint16_t channels = 0;
+    uint32_t sampleRate = 0;
+    uint16_t bitsPerSample = 0;
+    uint16_t blockAlign = 0;
+    uint64_t dataOffset = 0;       // File offset of the first sample
+    uint64_t dataSize = 0;         // Bytes of samples; WAVE_SIZE_UNKNOWN if open-ended
+};
+
+// Walk the RIFF chunks in the first `size` bytes of a file up to the "data"
+// chunk header. Fails if either chunk lies beyond `size` or the file is not
+// RIFF/WAVE.
+bool ParseWaveHeader(const uint8_t* data, size_t size, WaveInfo& info);
@@ -0,0 +1,337 @@
+#include "waveform_history.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+// The coarsest level holds the whole history in at most this many entries,
+// a few per pixel of a view of everything
+const uint64_t COARSEST_MAX_ENTRIES = 4096;
+
+// Entries a query merges per pixel at least, so entries straddling the
+// pixel edges blur its RMS little
+const uint64_t MIN_ENTRIES_PER_PIXEL = 4;
+
+const float STORED_SCALE = 32767.0f;
+
+int16_t ToStored(float value)
+{
+    value = std::clamp(value, -1.0f, 1.0f);
+    return (int16_t)lrintf(value * STORED_SCALE);
+}
+
+float FromStored(int16_t value)
+{
+    return value / STORED_SCALE;
+}
+
+}
+
+WaveformHistory::WaveformHistory(size_t maxChannels, size_t budgetBytes)
+    : m_maxChannels(maxChannels), m_budgetBytes(budgetBytes)
+{
+}
+
+bool WaveformHistory::Reset(uint32_t channels, uint32_t sampleRate, uint32_t seconds)
+{
+    if (channels == 0 || channels > m_maxChannels || sampleRate == 0 || seconds == 0) return false;
+    if (m_storage && channels == m_channels.load(std::memory_order_relaxed) &&
+        sampleRate == m_sampleRate.load(std::memory_order_relaxed) && seconds == m_seconds) {
+        return true;
+    }
+
+    if (!m_storage) {
+        // Zeroed here so the writer never faults in fresh pages
+        m_storageEntries = m_budgetBytes / sizeof(Entry);
+        if (m_storageEntries < channels) return false;
+        m_storage.reset(new Entry[m_storageEntries]());
+    }
+
+    // Readers seeing an odd sequence (or a changed one) retry
+    m_layoutSequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Levels up to one that covers the history in a few thousand entries
+    const uint64_t historyFrames = (uint64_t)seconds * sampleRate;
+    m_levelCount = 1;
+    m_levels[0].frames = BASE_FRAMES;
+    while (m_levelCount < MAX_LEVELS &&
+           (historyFrames + m_levels[m_levelCount - 1].frames - 1) / m_levels[m_levelCount - 1].frames >
+               COARSEST_MAX_ENTRIES) {
+        m_levels[m_levelCount].frames = m_levels[m_levelCount - 1].frames * LEVEL_FACTOR;
+        m_levelCount++;
+    }
+
+    // Coarsest first, so the whole history is always held; the finest level
+    // gets the rest of the budget
+    uint64_t available = m_storageEntries / channels;
+    for (size_t level = m_levelCount; level-- > 0;) {
+        uint64_t needed = (historyFrames + m_levels[level].frames - 1) / m_levels[level].frames;
+        m_levels[level].capacity = std::min(needed, available);
+        available -= m_levels[level].capacity;
+    }
+
+    Entry* next = m_storage.get();
+    for (size_t level = 0; level < MAX_LEVELS; level++) {
+        Level& current = m_levels[level];
+        if (level >= m_levelCount) {
+            current.frames = 0;
+            current.capacity = 0;
+        }
+        current.entries = next;
+        next += current.capacity * channels;
+        current.reserved.store(0, std::memory_order_relaxed);
+        current.committed.store(0, std::memory_order_relaxed);
+    }
+
+    m_seconds = seconds;
+    m_accumulators.assign(MAX_LEVELS * channels, Accumulator());
+    m_channels.store(channels, std::memory_order_relaxed);
+    m_sampleRate.store(sampleRate, std::memory_order_relaxed);
+    ClearAccumulators();
+    m_frames.store(0, std::memory_order_relaxed);
+
+    m_layoutSequence.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void WaveformHistory::ClearAccumulators()
+{
+    for (Accumulator& accumulator : m_accumulators) {
+        accumulator.min = FLT_MAX;
+        accumulator.max = -FLT_MAX;
+        accumulator.sumSquares = 0.0;
+    }
+    m_partialFrames = 0;
+    std::fill(m_partialEntries, m_partialEntries + MAX_LEVELS, 0u);
+}
+
+void WaveformHistory::AddPlanar(const float* const* planes, size_t frames)
+{
+    const uint32_t channels = m_channels.load(std::memory_order_relaxed);
+    if (channels == 0) return;
+
+    // Finest entries are completed at fixed frame boundaries
+    for (size_t done = 0; done < frames;) {
+        size_t count = std::min<size_t>(frames - done, BASE_FRAMES - m_partialFrames);
+        for (uint32_t c = 0; c < channels; c++) {
+            Accumulator& accumulator = m_accumulators[c];
+            const float* samples = planes[c] + done;
+            float low = accumulator.min;
+            float high = accumulator.max;
+            float squares = 0.0f;
+            for (size_t i = 0; i < count; i++) {
+                low = std::min(low, samples[i]);
+                high = std::max(high, samples[i]);
+                squares += samples[i] * samples[i];
+            }
+            accumulator.min = low;
+            accumulator.max = high;
+            accumulator.sumSquares += squares;
+        }
+
+        done += count;
+        m_partialFrames += (uint32_t)count;
+        if (m_partialFrames == BASE_FRAMES) {
+            CompleteEntry(0);
+            m_partialFrames = 0;
+        }
+    }
+    m_frames.store(m_frames.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+}
+
+void WaveformHistory::AddSilence(size_t frames)
+{
+    const uint32_t channels = m_channels.load(std::memory_order_relaxed);
+    if (channels == 0) return;
+
+    for (size_t done = 0; done < frames;) {
+        size_t count = std::min<size_t>(frames - done, BASE_FRAMES - m_partialFrames);
+        for (uint32_t c = 0; c < channels; c++) {
+            Accumulator& accumulator = m_accumulators[c];
+            accumulator.min = std::min(accumulator.min, 0.0f);
+            accumulator.max = std::max(accumulator.max, 0.0f);
+        }
+
+        done += count;
+        m_partialFrames += (uint32_t)count;
+        if (m_partialFrames == BASE_FRAMES) {
+            CompleteEntry(0);
+            m_partialFrames = 0;
+        }
+    }
+    m_frames.store(m_frames.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+}
+
+void WaveformHistory::CompleteEntry(size_t level)
+{
+    const uint32_t channels = m_channels.load(std::memory_order_relaxed);
+    Level& current = m_levels[level];
+    Accumulator* accumulators = &m_accumulators[level * channels];
+    const double merged = level == 0 ? BASE_FRAMES : LEVEL_FACTOR;   // Samples or entries
+
+    uint64_t index = current.committed.load(std::memory_order_relaxed);
+    if (current.capacity > 0) {
+        // Announce the slot about to be overwritten before touching it
+        current.reserved.store(index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        Entry* entry = current.entries + (index % current.capacity) * channels;
+        for (uint32_t c = 0; c < channels; c++) {
+            entry[c].min = ToStored(accumulators[c].min);
+            entry[c].max = ToStored(accumulators[c].max);
+            entry[c].rms = ToStored((float)std::sqrt(accumulators[c].sumSquares / merged));
+        }
+    } else {
+        current.reserved.store(index + 1, std::memory_order_relaxed);
+    }
+    current.committed.store(index + 1, std::memory_order_release);
+
+    // Into the entry being built one level up
+    bool upComplete = false;
+    if (level + 1 < m_levelCount) {
+        Accumulator* up = &m_accumulators[(level + 1) * channels];
+        for (uint32_t c = 0; c < channels; c++) {
+            up[c].min = std::min(up[c].min, accumulators[c].min);
+            up[c].max = std::max(up[c].max, accumulators[c].max);
+            up[c].sumSquares += accumulators[c].sumSquares / merged;
+        }
+        upComplete = ++m_partialEntries[level + 1] == LEVEL_FACTOR;
+    }
+
+    for (uint32_t c = 0; c < channels; c++) {
+        accumulators[c].min = FLT_MAX;
+        accumulators[c].max = -FLT_MAX;
+        accumulators[c].sumSquares = 0.0;
+    }
+
+    if (upComplete) {
+        CompleteEntry(level + 1);
+        m_partialEntries[level + 1] = 0;
+    }
+}
+
+uint64_t WaveformHistory::GetOldestFrame() const
+{
+    uint64_t oldest = GetFrameCount();
+    for (size_t level = 0; level < m_levelCount; level++) {
+        const Level& current = m_levels[level];
+        if (current.capacity == 0) continue;
+        uint64_t committed = current.committed.load(std::memory_order_acquire);
+        uint64_t first = committed > current.capacity ? committed - current.capacity : 0;
+        oldest = std::min(oldest, first * current.frames);
+    }
+    return oldest;
+}
+
+size_t WaveformHistory::FindLevel(uint64_t framesPerPixel) const
+{
+    // Coarsest level with a few entries per pixel, else the finest held
+    size_t found = MAX_LEVELS;
+    for (size_t level = 0; level < m_levelCount; level++) {
+        if (m_levels[level].capacity == 0) continue;
+        if (found == MAX_LEVELS || m_levels[level].frames * MIN_ENTRIES_PER_PIXEL <= framesPerPixel) found = level;
+    }
+    return found;
+}
+
+void WaveformHistory::MergeRange(size_t level, uint32_t channel, uint64_t start, uint64_t end, bool older,
+                                 bool newer, Merge& merge, uint64_t* lowestRead) const
+{
+    // Copies: a concurrent Reset() may change the layout, which the caller
+    // detects afterwards; until then nothing may divide by zero or index
+    // outside the storage
+    const Level& current = m_levels[level];
+    const uint64_t capacity = current.capacity;
+    const uint64_t frames = current.frames;
+    const Entry* entries = current.entries;
+    if (capacity == 0 || frames == 0) return;
+
+    const uint64_t committed = current.committed.load(std::memory_order_acquire);
+    const uint64_t first = committed > capacity ? committed - capacity : 0;
+    const uint64_t heldStart = first * frames;
+    const uint64_t heldEnd = committed * frames;
+
+    // Older than this level holds: coarser levels; newer than its last
+    // entry: finer levels
+    if (start < heldStart) {
+        if (older) {
+            size_t up = level + 1;
+            while (up < m_levelCount && m_levels[up].capacity == 0) up++;
+            if (up < m_levelCount) {
+                MergeRange(up, channel, start, std::min(end, heldStart), true, false, merge, lowestRead);
+            }
+        }
+        start = heldStart;
+    }
+    if (end > heldEnd) {
+        if (newer) {
+            size_t down = level;
+            while (down > 0 && m_levels[down - 1].capacity == 0) down--;
+            if (down > 0) {
+                MergeRange(down - 1, channel, std::max(start, heldEnd), end, false, true, merge, lowestRead);
+            }
+        }
+        end = heldEnd;
+    }
+    if (start >= end) return;
+
+    const uint32_t channels = m_channels.load(std::memory_order_relaxed);
+    const Entry* storageEnd = m_storage.get() + m_storageEntries;
+    const uint64_t firstEntry = start / frames;
+    const uint64_t endEntry = (end + frames - 1) / frames;
+    lowestRead[level] = std::min(lowestRead[level], firstEntry);
+
+    for (uint64_t index = firstEntry; index < endEntry; index++) {
+        const Entry* entry = entries + (index % capacity) * channels + channel;
+        if (entry >= storageEnd) return;
+        float rms = FromStored(entry->rms);
+        merge.min = std::min(merge.min, FromStored(entry->min));
+        merge.max = std::max(merge.max, FromStored(entry->max));
+        merge.sumSquares += (double)rms * rms * frames;
+        merge.frames += frames;
+    }
+}
+
+bool WaveformHistory::GetSummaries(uint32_t channel, uint64_t startFrame, uint64_t endFrame, size_t pixels,
+                                   Summary* out) const
+{
+    const uint32_t sequence = m_layoutSequence.load(std::memory_order_acquire);
+    if (sequence & 1) return false;
+
+    std::fill(out, out + pixels, Summary());
+    if (channel >= m_channels.load(std::memory_order_acquire) || endFrame <= startFrame || m_levelCount == 0) {
+        return m_layoutSequence.load(std::memory_order_acquire) == sequence;
+    }
+
+    uint64_t lowestRead[MAX_LEVELS];
+    std::fill(lowestRead, lowestRead + MAX_LEVELS, UINT64_MAX);
+
+    const uint64_t span = endFrame - startFrame;
+    for (size_t pixel = 0; pixel < pixels; pixel++) {
+        uint64_t start = startFrame + span * pixel / pixels;
+        uint64_t end = std::max(startFrame + span * (pixel + 1) / pixels, start + 1);
+        size_t level = FindLevel(end - start);
+        if (level == MAX_LEVELS) break;
+
+        Merge merge;
+        MergeRange(level, channel, start, end, true, true, merge, lowestRead);
+        if (merge.frames > 0) {
+            out[pixel].min = merge.min;
+            out[pixel].max = merge.max;
+            out[pixel].rms = (float)std::sqrt(merge.sumSquares / merge.frames);
+            out[pixel].empty = false;
+        }
+    }
+
+    // None of the entries read may have been overwritten meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (size_t level = 0; level < m_levelCount; level++) {
+        if (lowestRead[level] == UINT64_MAX) continue;
+        if (m_levels[level].reserved.load(std::memory_order_relaxed) > lowestRead[level] + m_levels[level].capacity) {
+            return false;
+        }
+    }
+    return m_layoutSequence.load(std::memory_order_relaxed) == sequence;
+}
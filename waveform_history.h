@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Hours of waveform overview in a fixed memory budget. The captured stream
+// is summarized as min/max/RMS per channel at several time scales (256
+// frames per entry, then 16 times coarser per level); every level is a ring.
+// The budget is laid out coarsest first: the coarsest levels hold the whole
+// history, the finest level gets what is left, so recent audio has the most
+// detail. A query for any time range picks, per pixel, the level with a few
+// entries per pixel that still holds that part, so it costs O(pixels)
+// whatever the range.
+// One writer (the capture thread) adds frames without allocating; any
+// number of readers query lock-free and retry if the writer overwrote what
+// they read, as with WaveformRing.
+class WaveformHistory
+{
+public:
+    static const uint32_t BASE_FRAMES = 256;     // Frames per entry of the finest level
+    static const uint32_t LEVEL_FACTOR = 16;     // Entries merged into one of the next level
+    static const size_t MAX_LEVELS = 6;
+
+    // One pixel of a query; empty where nothing is held
+    struct Summary
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+        bool empty = true;
+    };
+
+    WaveformHistory(size_t maxChannels, size_t budgetBytes);
+
+    WaveformHistory(const WaveformHistory&) = delete;
+    WaveformHistory& operator=(const WaveformHistory&) = delete;
+
+    // Writer side ----------------------------------------------------------
+
+    // Lay the budget out for this format so the coarsest level covers
+    // `seconds`, and start empty. Keeps the history if the format did not
+    // change (e.g. the device was re-acquired). Allocates the budget on first
+    // use; the writer must be idle.
+    bool Reset(uint32_t channels, uint32_t sampleRate, uint32_t seconds);
+
+    // Append frames given as one float plane per channel; allocates nothing
+    void AddPlanar(const float* const* planes, size_t frames);
+
+    // Append silence (silent packets keep the time axis)
+    void AddSilence(size_t frames);
+
+    // Reader side ----------------------------------------------------------
+
+    // Frames added since Reset(): the end of the history
+    uint64_t GetFrameCount() const { return m_frames.load(std::memory_order_acquire); }
+
+    // First frame any level still holds
+    uint64_t GetOldestFrame() const;
+
+    uint32_t GetSampleRate() const { return m_sampleRate.load(std::memory_order_acquire); }
+    uint32_t GetChannelCount() const { return m_channels.load(std::memory_order_acquire); }
+
+    // Summaries of `channel` for `pixels` equal slices of [startFrame,
+    // endFrame). False if the writer overwrote data being read or the
+    // history was reset meanwhile; try again.
+    bool GetSummaries(uint32_t channel, uint64_t startFrame, uint64_t endFrame, size_t pixels, Summary* out) const;
+
+    // Frames per entry and frames held by each level (0 if the budget left
+    // it no room), for display and tests
+    size_t GetLevelCount() const { return m_levelCount; }
+    uint64_t GetLevelFrames(size_t level) const { return m_levels[level].frames; }
+    uint64_t GetLevelSpan(size_t level) const { return m_levels[level].capacity * m_levels[level].frames; }
+
+    size_t GetBudgetBytes() const { return m_budgetBytes; }
+
+private:
+    // Stored per channel per entry, scaled to int16
+    struct Entry
+    {
+        int16_t min;
+        int16_t max;
+        int16_t rms;
+    };
+
+    struct Level
+    {
+        uint64_t frames = 0;           // Per entry
+        uint64_t capacity = 0;         // Entries in the ring
+        Entry* entries = nullptr;      // capacity * channels, entry-major
+
+        // Writer sequence cursors (entries), as in WaveformRing: m_reserved
+        // moves before an entry is overwritten, m_committed after
+        std::atomic<uint64_t> reserved{ 0 };
+        std::atomic<uint64_t> committed{ 0 };
+    };
+
+    // Running summary of the entry being built, per level and channel
+    struct Accumulator
+    {
+        float min;
+        float max;
+        double sumSquares;             // Of the samples (finest level) or entry RMS
+    };
+
+    // Merged summaries of one query pixel
+    struct Merge
+    {
+        float min = 1.0f;
+        float max = -1.0f;
+        double sumSquares = 0.0;
+        uint64_t frames = 0;
+    };
+
+    void ClearAccumulators();
+    void CompleteEntry(size_t level);
+    void MergeRange(size_t level, uint32_t channel, uint64_t start, uint64_t end, bool older, bool newer,
+                    Merge& merge, uint64_t* lowestRead) const;
+    size_t FindLevel(uint64_t framesPerPixel) const;
+
+    size_t m_maxChannels;
+    size_t m_budgetBytes;
+    std::unique_ptr<Entry[]> m_storage;
+    size_t m_storageEntries = 0;
+
+    Level m_levels[MAX_LEVELS];
+    size_t m_levelCount = 0;
+    std::atomic<uint32_t> m_channels{ 0 };
+    std::atomic<uint32_t> m_sampleRate{ 0 };
+    uint32_t m_seconds = 0;
+
+    // Odd while Reset() changes the layout
+    std::atomic<uint32_t> m_layoutSequence{ 0 };
+
+    // Writer state
+    std::vector<Accumulator> m_accumulators;   // MAX_LEVELS * channels
+    uint32_t m_partialFrames = 0;              // Frames in the finest entry being built
+    uint32_t m_partialEntries[MAX_LEVELS] = {};  // Entries merged into each coarser entry being built
+    std::atomic<uint64_t> m_frames{ 0 };
+};
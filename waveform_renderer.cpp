@@ -0,0 +1,245 @@
+#include "waveform_renderer.h"
+#include <algorithm>
+
+namespace {
+
+// Layout (matches the original GDI drawing)
+const int LEVEL_BAR_WIDTH = 50;
+const int LEVEL_BAR_HEIGHT = 30;
+const int LEVEL_BAR_TOP = 5;
+const int WAVEFORM_MARGIN = 10;
+const int OVERVIEW_MARGIN = 3;   // Above and below the overview
+
+// Columns are filled top to bottom, so rows a multiple of 1 KiB apart would
+// land in a few cache sets (a 1024-pixel canvas draws ~5x slower); such
+// strides are padded by a cache line
+const int STRIDE_ALIAS_PIXELS = 256;
+const int STRIDE_PAD_PIXELS = 16;
+
+const uint32_t COLOR_BACKGROUND = WaveformRenderer::MakeColor(30, 30, 30);
+const uint32_t COLOR_BAR_BACKGROUND = WaveformRenderer::MakeColor(50, 50, 50);
+const uint32_t COLOR_LEVEL = WaveformRenderer::MakeColor(0, 255, 0);
+const uint32_t COLOR_BAR_BORDER = WaveformRenderer::MakeColor(100, 100, 100);
+const uint32_t COLOR_WAVEFORM = WaveformRenderer::MakeColor(0, 200, 100);
+const uint32_t COLOR_WAVEFORM_BORDER = WaveformRenderer::MakeColor(70, 70, 70);
+const uint32_t COLOR_CENTER_LINE = WaveformRenderer::MakeColor(50, 50, 50);
+const uint32_t COLOR_RMS = WaveformRenderer::MakeColor(120, 230, 170);
+
+}
+
+void WaveformRenderer::Resize(int width, int height)
+{
+    width = std::max(0, width);
+    height = std::max(0, height);
+
+    // Only reallocate when the canvas grows; shrinking keeps the old stride
+    if (width > m_stride || height > m_rows) {
+        m_stride = std::max(width, m_stride);
+        if (m_stride % STRIDE_ALIAS_PIXELS == 0) m_stride += STRIDE_PAD_PIXELS;
+        m_rows = std::max(height, m_rows);
+        m_pixels.assign((size_t)m_stride * m_rows, COLOR_BACKGROUND);
+    }
+
+    m_width = width;
+    m_height = height;
+
+    size_t columns = (size_t)std::max(0, GetColumnCount());
+    if (columns > m_columnMin.size()) {
+        m_columnMin.resize(columns, 0.0f);
+        m_columnMax.resize(columns, 0.0f);
+        m_columnRms.resize(columns, 0.0f);
+    }
+    m_columnsUsed = std::min(m_columnsUsed, (int)columns);
+}
+
+int WaveformRenderer::GetWaveformTop() const
+{
+    return LEVEL_BAR_TOP + LEVEL_BAR_HEIGHT + 5;
+}
+
+int WaveformRenderer::GetWaveformHeight() const
+{
+    return m_height - GetWaveformTop() - 5;
+}
+
+int WaveformRenderer::GetColumnCount() const
+{
+    return m_width - 2 * WAVEFORM_MARGIN;
+}
+
+int WaveformRenderer::GetColumnLeft()
+{
+    return WAVEFORM_MARGIN;
+}
+
+void WaveformRenderer::SetWaveform(const float* first, size_t firstCount,
+                                   const float* second, size_t secondCount)
+{
+    m_columnsUsed = 0;
+
+    int columns = GetColumnCount();
+    size_t total = firstCount + secondCount;
+    if (columns <= 0 || total == 0) return;
+
+    // Show the most recent samples, a whole number of samples per column
+    size_t samplesPerColumn = std::max<size_t>(1, total / columns);
+    size_t shown = std::min(total, samplesPerColumn * columns);
+    size_t index = total - shown;
+
+    m_columnsUsed = (int)(shown / samplesPerColumn);
+
+    for (int x = 0; x < m_columnsUsed; x++) {
+        float minSample = 1.0f;
+        float maxSample = -1.0f;
+        size_t remaining = samplesPerColumn;
+
+        // A column can straddle the boundary between the two ranges
+        while (remaining > 0) {
+            const float* data;
+            size_t available;
+            if (index < firstCount) {
+                data = first + index;
+                available = firstCount - index;
+            } else {
+                data = second + (index - firstCount);
+                available = total - index;
+            }
+
+            size_t count = std::min(remaining, available);
+            for (size_t i = 0; i < count; i++) {
+                minSample = std::min(minSample, data[i]);
+                maxSample = std::max(maxSample, data[i]);
+            }
+            index += count;
+            remaining -= count;
+        }
+
+        m_columnMin[x] = minSample;
+        m_columnMax[x] = maxSample;
+        m_columnRms[x] = 0.0f;
+    }
+}
+
+void WaveformRenderer::SetSummaries(const WaveformHistory::Summary* summaries, size_t count)
+{
+    m_columnsUsed = (int)std::min(count, m_columnMin.size());
+    for (int x = 0; x < m_columnsUsed; x++) {
+        // An empty column has max below min, which draws nothing
+        const WaveformHistory::Summary& summary = summaries[x];
+        m_columnMin[x] = summary.empty ? 1.0f : summary.min;
+        m_columnMax[x] = summary.empty ? -1.0f : summary.max;
+        m_columnRms[x] = summary.empty ? 0.0f : summary.rms;
+    }
+}
+
+void WaveformRenderer::Render(float level)
+{
+    if (m_width <= 0 || m_height <= 0) return;
+
+    // Clear background
+    FillRect(0, 0, m_width, m_height, COLOR_BACKGROUND);
+
+    // Volume bar at top
+    int barX = (m_width - LEVEL_BAR_WIDTH) / 2;
+    int barY = LEVEL_BAR_TOP;
+    FillRect(barX, barY, barX + LEVEL_BAR_WIDTH, barY + LEVEL_BAR_HEIGHT, COLOR_BAR_BACKGROUND);
+
+    level = std::clamp(level, 0.0f, 1.0f);
+    int levelHeight = (int)(level * LEVEL_BAR_HEIGHT);
+    FillRect(barX, barY + LEVEL_BAR_HEIGHT - levelHeight,
+             barX + LEVEL_BAR_WIDTH, barY + LEVEL_BAR_HEIGHT, COLOR_LEVEL);
+    DrawFrame(barX, barY, barX + LEVEL_BAR_WIDTH, barY + LEVEL_BAR_HEIGHT, 2, COLOR_BAR_BORDER);
+
+    // Waveform below the bar
+    int waveformY = GetWaveformTop();
+    int waveformHeight = GetWaveformHeight();
+    if (waveformHeight <= 10) return;
+
+    DrawColumns(waveformY, waveformHeight, false);
+}
+
+void WaveformRenderer::RenderOverview()
+{
+    if (m_width <= 0 || m_height <= 0) return;
+
+    FillRect(0, 0, m_width, m_height, COLOR_BACKGROUND);
+    int height = m_height - 2 * OVERVIEW_MARGIN - 1;
+    if (height <= 10) return;
+
+    DrawColumns(OVERVIEW_MARGIN, height, true);
+}
+
+void WaveformRenderer::DrawColumns(int top, int height, bool withRms)
+{
+    int centerY = top + height / 2;
+    int halfHeight = height / 2 - 2;
+
+    DrawFrame(WAVEFORM_MARGIN, top, m_width - WAVEFORM_MARGIN, top + height + 1, 1, COLOR_WAVEFORM_BORDER);
+    FillRect(WAVEFORM_MARGIN, centerY, m_width - WAVEFORM_MARGIN, centerY + 1, COLOR_CENTER_LINE);
+
+    // One vertical span per column, from the column's max down to its min
+    for (int x = 0; x < m_columnsUsed; x++) {
+        float maxSample = std::clamp(m_columnMax[x], -1.0f, 1.0f);
+        float minSample = std::clamp(m_columnMin[x], -1.0f, 1.0f);
+        int spanTop = centerY - (int)(maxSample * halfHeight);
+        int spanBottom = centerY - (int)(minSample * halfHeight);
+        FillSpan(x + WAVEFORM_MARGIN, spanTop, spanBottom + 1, COLOR_WAVEFORM);
+
+        if (withRms && m_columnRms[x] > 0.0f) {
+            int rms = (int)(std::min(m_columnRms[x], 1.0f) * halfHeight);
+            FillSpan(x + WAVEFORM_MARGIN, centerY - rms, centerY + rms + 1, COLOR_RMS);
+        }
+    }
+}
+
+void WaveformRenderer::FillRect(int left, int top, int right, int bottom, uint32_t color)
+{
+    left = std::max(left, 0);
+    top = std::max(top, 0);
+    right = std::min(right, m_width);
+    bottom = std::min(bottom, m_height);
+    if (left >= right || top >= bottom) return;
+
+    for (int y = top; y < bottom; y++) {
+        uint32_t* row = m_pixels.data() + (size_t)y * m_stride;
+        std::fill(row + left, row + right, color);
+    }
+}
+
+void WaveformRenderer::FillSpan(int x, int top, int bottom, uint32_t color)
+{
+    if (x < 0 || x >= m_width) return;
+    top = std::max(top, 0);
+    bottom = std::min(bottom, m_height);
+    if (top >= bottom) return;
+
+    uint32_t* pixel = m_pixels.data() + (size_t)top * m_stride + x;
+    for (int y = top; y < bottom; y++) {
+        *pixel = color;
+        pixel += m_stride;
+    }
+}
+
+void WaveformRenderer::DrawFrame(int left, int top, int right, int bottom, int thickness, uint32_t color)
+{
+    FillRect(left, top, right, top + thickness, color);
+    FillRect(left, bottom - thickness, right, bottom, color);
+    FillRect(left, top, left + thickness, bottom, color);
+    FillRect(right - thickness, top, right, bottom, color);
+}
+
+uint32_t WaveformRenderer::Checksum() const
+{
+    uint32_t hash = 2166136261u;
+    for (int y = 0; y < m_height; y++) {
+        const uint32_t* row = m_pixels.data() + (size_t)y * m_stride;
+        for (int x = 0; x < m_width; x++) {
+            uint32_t pixel = row[x];
+            for (int b = 0; b < 4; b++) {
+                hash ^= (pixel >> (b * 8)) & 0xFF;
+                hash *= 16777619u;
+            }
+        }
+    }
+    return hash;
+}
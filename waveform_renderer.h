@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "waveform_history.h"
+
+// Software rasterizer for the live waveform view and the history overview.
+// Draws the level bar, grid and waveform into a persistent 32-bit pixel
+// buffer (0x00RRGGBB, top-down rows) so the UI only has to present it with a
+// single blit. Contains no platform code so it can be checked on any OS.
+class WaveformRenderer
+{
+public:
+    WaveformRenderer() = default;
+
+    // Set the visible canvas size. The pixel buffer is only reallocated when
+    // the canvas grows beyond its current capacity.
+    void Resize(int width, int height);
+
+    // Reduce waveform samples into per-column min/max values. The samples are
+    // given as up to two contiguous ranges (e.g. the two halves of a ring
+    // buffer) and are treated as one sequence, oldest first.
+    void SetWaveform(const float* first, size_t firstCount,
+                     const float* second = nullptr, size_t secondCount = 0);
+
+    // Rasterize the whole frame using the current level and column data
+    void Render(float level);
+
+    // Columns the waveform spans at the current size, from canvas x
+    // GetColumnLeft() on
+    int GetColumnCount() const;
+    static int GetColumnLeft();
+
+    // Column data for the history overview: one summary per column, e.g.
+    // from WaveformHistory::GetSummaries over GetColumnCount() pixels
+    void SetSummaries(const WaveformHistory::Summary* summaries, size_t count);
+
+    // Rasterize the history overview (no level bar): each column's min/max
+    // with its RMS on top in a lighter color; empty columns stay blank
+    void RenderOverview();
+
+    const uint32_t* GetPixels() const { return m_pixels.data(); }
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    int GetStride() const { return m_stride; }  // In pixels
+
+    // FNV-1a hash of the visible pixels, used to compare rendered frames
+    uint32_t Checksum() const;
+
+    static uint32_t MakeColor(uint8_t r, uint8_t g, uint8_t b)
+    {
+        return (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+    }
+
+private:
+    void FillRect(int left, int top, int right, int bottom, uint32_t color);
+    void FillSpan(int x, int top, int bottom, uint32_t color);
+    void DrawFrame(int left, int top, int right, int bottom, int thickness, uint32_t color);
+    int GetWaveformTop() const;
+    int GetWaveformHeight() const;
+    void DrawColumns(int top, int height, bool withRms);
+
+    std::vector<uint32_t> m_pixels;
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0;
+    int m_rows = 0;  // Allocated rows
+
+    // Per-column waveform extents, reused between frames
+    std::vector<float> m_columnMin;
+    std::vector<float> m_columnMax;
+    std::vector<float> m_columnRms;   // Overview only
+    int m_columnsUsed = 0;
+};
@@ -0,0 +1,94 @@
+#include "waveform_ring.h"
+#include <algorithm>
+#include <cstring>
+
+WaveformRing::WaveformRing(size_t maxChannels, size_t capacityFrames)
+    : m_maxChannels(maxChannels)
+{
+    m_capacity = 1;
+    while (m_capacity < capacityFrames) m_capacity <<= 1;
+    m_mask = m_capacity - 1;
+    m_data.assign(m_maxChannels * m_capacity, 0.0f);
+}
+
+void WaveformRing::Reset(size_t channels)
+{
+    channels = std::min(channels, m_maxChannels);
+
+    // Overwrite the whole ring with silence as one write so that any view a
+    // reader still holds becomes invalid, while indices stay monotonic
+    m_channels.store(m_maxChannels, std::memory_order_relaxed);
+    Write(m_capacity, [](size_t, size_t) { return 0.0f; });
+    m_channels.store(channels, std::memory_order_release);
+}
+
+void WaveformRing::WritePlanar(const float* const* planes, size_t frames)
+{
+    if (frames == 0) return;
+
+    size_t channels = m_channels.load(std::memory_order_relaxed);
+    uint64_t start = m_committed.load(std::memory_order_relaxed);
+
+    m_reserved.store(start + frames, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Only the last ring length survives; copy it in at most two pieces
+    size_t skip = frames > m_capacity ? frames - m_capacity : 0;
+    size_t offset = (size_t)((start + skip) & m_mask);
+    size_t count = frames - skip;
+    size_t firstCount = std::min(count, m_capacity - offset);
+    for (size_t c = 0; c < channels; c++) {
+        float* channelData = m_data.data() + c * m_capacity;
+        const float* source = planes[c] + skip;
+        memcpy(channelData + offset, source, firstCount * sizeof(float));
+        memcpy(channelData, source + firstCount, (count - firstCount) * sizeof(float));
+    }
+
+    m_committed.store(start + frames, std::memory_order_release);
+}
+
+WaveformView WaveformRing::MakeView(size_t channel, uint64_t start, uint64_t end) const
+{
+    WaveformView view;
+    view.startSample = start;
+    if (end <= start) return view;
+
+    const float* channelData = m_data.data() + channel * m_capacity;
+    size_t offset = (size_t)(start & m_mask);
+    size_t count = (size_t)(end - start);
+    size_t firstCount = std::min(count, m_capacity - offset);
+
+    view.first = std::span<const float>(channelData + offset, firstCount);
+    view.second = std::span<const float>(channelData, count - firstCount);
+    return view;
+}
+
+bool WaveformRing::Snapshot(size_t channel, size_t frames, WaveformView& view) const
+{
+    if (channel >= GetChannelCount()) return false;
+
+    uint64_t end = m_committed.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>({ (uint64_t)frames, (uint64_t)m_capacity, end });
+    view = MakeView(channel, end - count, end);
+    return true;
+}
+
+bool WaveformRing::ReadSince(size_t channel, uint64_t sampleIndex, size_t maxFrames, WaveformView& view) const
+{
+    if (channel >= GetChannelCount()) return false;
+
+    uint64_t end = m_committed.load(std::memory_order_acquire);
+    uint64_t oldest = end > m_capacity ? end - m_capacity : 0;
+    uint64_t start = std::min(std::max(sampleIndex, oldest), end);
+    uint64_t count = std::min<uint64_t>(end - start, (uint64_t)maxFrames);
+    view = MakeView(channel, start, start + count);
+    return true;
+}
+
+bool WaveformRing::IsValid(const WaveformView& view) const
+{
+    // Order the caller's reads of the view before re-reading the cursor
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t reserved = m_reserved.load(std::memory_order_relaxed);
+    return reserved <= view.startSample + m_capacity;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Consistent view of a range of one channel's recent samples. The range may
+// wrap around the ring end, so it is split into two spans (oldest first).
+// The spans point straight into the ring; check WaveformRing::IsValid after
+// consuming them to make sure the writer did not overwrite them meanwhile.
+struct WaveformView
+{
+    uint64_t startSample = 0;        // Absolute index of first[0]
+    std::span<const float> first;
+    std::span<const float> second;
+
+    size_t size() const { return first.size() + second.size(); }
+    bool empty() const { return size() == 0; }
+    uint64_t endSample() const { return startSample + size(); }
+};
+
+// Lock-free planar ring of the most recent samples per channel.
+// One writer at a time publishes frames with Write(); any number of readers
+// take zero-copy views validated by the writer's sequence cursors instead of
+// a mutex. Storage is allocated once for the maximum channel count so the
+// ring is never reallocated under a reader.
+class WaveformRing
+{
+public:
+    // capacityFrames is rounded up to a power of two
+    WaveformRing(size_t maxChannels, size_t capacityFrames);
+
+    // Writer side ----------------------------------------------------------
+
+    // Change the active channel count and drop old data (writer must be idle)
+    void Reset(size_t channels);
+
+    // Append frames. sampleAt(frame, channel) returns the float sample for
+    // frame [0, frames) of the block being written.
+    template <typename SampleFn>
+    void Write(size_t frames, SampleFn sampleAt);
+
+    // Append frames given as one float plane per channel (planes[c][frame])
+    void WritePlanar(const float* const* planes, size_t frames);
+
+    // Reader side ----------------------------------------------------------
+
+    // Most recent `frames` samples of a channel (fewer if not available yet)
+    bool Snapshot(size_t channel, size_t frames, WaveformView& view) const;
+
+    // Samples from absolute index `sampleIndex` up to `maxFrames` of them.
+    // If the data at sampleIndex was already overwritten the view starts at
+    // the oldest sample still held (view.startSample > sampleIndex).
+    bool ReadSince(size_t channel, uint64_t sampleIndex, size_t maxFrames, WaveformView& view) const;
+
+    // True if none of the view's samples were overwritten since it was taken
+    bool IsValid(const WaveformView& view) const;
+
+    // Absolute index one past the newest published sample
+    uint64_t GetWriteIndex() const { return m_committed.load(std::memory_order_acquire); }
+
+    size_t GetCapacity() const { return m_capacity; }
+    size_t GetChannelCount() const { return m_channels.load(std::memory_order_acquire); }
+
+private:
+    WaveformView MakeView(size_t channel, uint64_t start, uint64_t end) const;
+
+    std::vector<float> m_data;       // Planar: channel c at [c * m_capacity]
+    size_t m_maxChannels;
+    size_t m_capacity;
+    size_t m_mask;
+    std::atomic<size_t> m_channels{0};
+
+    // Writer sequence cursors. m_reserved is advanced before a block is
+    // written and m_committed after; readers validate against m_reserved.
+    std::atomic<uint64_t> m_reserved{0};
+    std::atomic<uint64_t> m_committed{0};
+};
+
+template <typename SampleFn>
+void WaveformRing::Write(size_t frames, SampleFn sampleAt)
+{
+    if (frames == 0) return;
+
+    size_t channels = m_channels.load(std::memory_order_relaxed);
+    uint64_t start = m_committed.load(std::memory_order_relaxed);
+
+    // Announce the slots about to be overwritten before touching them
+    m_reserved.store(start + frames, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Anything older than one ring length would be overwritten anyway
+    size_t skip = frames > m_capacity ? frames - m_capacity : 0;
+    for (size_t c = 0; c < channels; c++) {
+        float* channelData = m_data.data() + c * m_capacity;
+        for (size_t i = skip; i < frames; i++) {
+            channelData[(start + i) & m_mask] = sampleAt(i, c);
+        }
+    }
+
+    m_committed.store(start + frames, std::memory_order_release);
+}